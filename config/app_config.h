@@ -127,6 +127,11 @@
 
 // </e>
 
+// Keep RTC1 counting without active timers, it is the time base for sleep statistics
+#ifndef APP_TIMER_KEEPS_RTC_ACTIVE
+#define APP_TIMER_KEEPS_RTC_ACTIVE 1
+#endif
+
 #ifndef DEV_ID
 #define DEV_ID                      "4163"
 #endif
@@ -139,6 +144,28 @@
 #define HSV_STEP                    1
 #endif
 
+#ifndef LED_TIMER_PERIOD_MS
+#define LED_TIMER_PERIOD_MS         10
+#endif
+
+// Animation speeds in units per second, integrated over real elapsed time
+#ifndef HSV_RATE
+#define HSV_RATE                    (HSV_STEP * 1000 / LED_TIMER_PERIOD_MS)
+#endif
+
+#ifndef LED1_BLINK_SLOW_RATE
+#define LED1_BLINK_SLOW_RATE        500
+#endif
+
+#ifndef LED1_BLINK_FAST_RATE
+#define LED1_BLINK_FAST_RATE        2000
+#endif
+
+// Must stay below the app_timer maximum timeout (512 s - APP_TIMER_SAFE_WINDOW_MS)
+#ifndef ESL_CLOCK_KEEPALIVE_MS
+#define ESL_CLOCK_KEEPALIVE_MS      120000
+#endif
+
 #ifndef DEBOUNCE_DELAY_MS
 #define DEBOUNCE_DELAY_MS           50
 #endif
@@ -147,14 +174,143 @@
 #define DOUBLE_CLICK_DELAY_MS       300
 #endif
 
+// Idle time after the last color change before it is written to flash
+#ifndef ESL_RGB_COMMIT_DELAY_MS
+#define ESL_RGB_COMMIT_DELAY_MS     5000
+#endif
+
+#ifndef ESL_INPUT_MAX_BUTTONS
+#define ESL_INPUT_MAX_BUTTONS       4
+#endif
+
+#ifndef ESL_INPUT_MAX_ENCODERS
+#define ESL_INPUT_MAX_ENCODERS      2
+#endif
+
+// Quadrature transitions per mechanical detent
+#ifndef ESL_INPUT_ENC_STEPS_PER_DETENT
+#define ESL_INPUT_ENC_STEPS_PER_DETENT  4
+#endif
+
+// Optional rotary encoder, e.g. NRF_GPIO_PIN_MAP(0,13) / NRF_GPIO_PIN_MAP(0,15)
+// #define ESL_INPUT_ENC_PIN_A
+// #define ESL_INPUT_ENC_PIN_B
+
+// Every button takes one and every encoder two low power (PORT) slots
+#ifndef NRFX_GPIOTE_CONFIG_NUM_OF_LOW_POWER_EVENTS
+#define NRFX_GPIOTE_CONFIG_NUM_OF_LOW_POWER_EVENTS  (ESL_INPUT_MAX_BUTTONS + 2 * ESL_INPUT_MAX_ENCODERS)
+#endif
+
+// Scheduler queue depth per priority and maximum payload copied per item
+#ifndef ESL_SCHED_QUEUE_SIZE
+#define ESL_SCHED_QUEUE_SIZE        4
+#endif
+
+#ifndef ESL_SCHED_MAX_DATA_SIZE
+#define ESL_SCHED_MAX_DATA_SIZE     64
+#endif
+
+#ifndef ESL_SCHED_STATS_SLOTS
+#define ESL_SCHED_STATS_SLOTS       8
+#endif
+
+// <q> CRC16_ENABLED  - crc16 - CRC16 calculation routines, used by saved color records
+#ifndef CRC16_ENABLED
+#define CRC16_ENABLED 1
+#endif
+
 #ifndef ESL_NVMC_BYTE_VALID
 #define ESL_NVMC_BYTE_VALID         (0xA5)
 #endif
 
+#ifndef ESL_NVMC_BYTE_DELETED
+#define ESL_NVMC_BYTE_DELETED       (0x00)
+#endif
+
+// Hash index slots for saved color names, power of two
+#ifndef ESL_NVMC_INDEX_SIZE
+#define ESL_NVMC_INDEX_SIZE         1024
+#endif
+
+// Flash pages for saved colors, one of them is always kept erased
+#ifndef ESL_NVMC_COLOR_PAGES
+#define ESL_NVMC_COLOR_PAGES        8
+#endif
+
+// Flash job queue length and slice sizes. A word write takes ~41 us and a
+// full page erase ~85 ms, split into partial erase steps of this length.
+#ifndef ESL_NVMC_JOB_QUEUE_SIZE
+#define ESL_NVMC_JOB_QUEUE_SIZE     16
+#endif
+
+#ifndef ESL_NVMC_WRITE_SLICE_WORDS
+#define ESL_NVMC_WRITE_SLICE_WORDS  4
+#endif
+
+#ifndef ESL_NVMC_ERASE_SLICE_MS
+#define ESL_NVMC_ERASE_SLICE_MS     2
+#endif
+
 #ifndef ESL_NVMC_BYTE_NOT_INIT
 #define ESL_NVMC_BYTE_NOT_INIT      (0xFF)
 #endif
 
+// Flash pages for animation clips, below the saved colors
+#ifndef ESL_CLIP_PAGES
+#define ESL_CLIP_PAGES              16
+#endif
+
+#ifndef ESL_CLIP_MAX
+#define ESL_CLIP_MAX                16
+#endif
+
+// Frames expanded per playback buffer, two buffers are played alternately
+#ifndef ESL_CLIP_CHUNK_FRAMES
+#define ESL_CLIP_CHUNK_FRAMES       16
+#endif
+
+// Flash pages for CLI macros, below the clips, and how many are kept
+#ifndef ESL_MACRO_PAGES
+#define ESL_MACRO_PAGES             2
+#endif
+
+#ifndef ESL_MACRO_MAX
+#define ESL_MACRO_MAX               16
+#endif
+
+// Including the terminator
+#ifndef ESL_MACRO_NAME_LEN
+#define ESL_MACRO_NAME_LEN          16
+#endif
+
+#ifndef ESL_MACRO_TEXT_LEN
+#define ESL_MACRO_TEXT_LEN          160
+#endif
+
+// Live color stream: frames buffered, default playout delay, how far ahead
+// a frame may be, and PWM periods per tick of the playout clock
+#ifndef ESL_STREAM_BUF_FRAMES
+#define ESL_STREAM_BUF_FRAMES       64
+#endif
+
+#ifndef ESL_STREAM_DELAY_MS
+#define ESL_STREAM_DELAY_MS         40
+#endif
+
+#ifndef ESL_STREAM_AHEAD_MAX_MS
+#define ESL_STREAM_AHEAD_MAX_MS     500
+#endif
+
+#ifndef ESL_STREAM_TICK_PERIODS
+#define ESL_STREAM_TICK_PERIODS     2
+#endif
+
+// Port the CLI and the binary protocol run on, esl_transport_usb or
+// esl_transport_uart
+#ifndef ESL_TRANSPORT
+#define ESL_TRANSPORT               esl_transport_usb
+#endif
+
 #ifndef CDC_ACM_COMM_INTERFACE
 #define CDC_ACM_COMM_INTERFACE      2
 #endif
@@ -175,12 +331,78 @@
 #define CDC_ACM_DATA_EPOUT          NRF_DRV_USBD_EPOUT4
 #endif
 
-#ifndef ESL_USB_COMM_BUFFER_SIZE
-#define ESL_USB_COMM_BUFFER_SIZE    64
+// UART transport on pins of the dongle's edge, 8N1 without flow control
+#ifndef ESL_UART_TX_PIN
+#define ESL_UART_TX_PIN             NRF_GPIO_PIN_MAP(0,20)
+#endif
+
+#ifndef ESL_UART_RX_PIN
+#define ESL_UART_RX_PIN             NRF_GPIO_PIN_MAP(0,22)
 #endif
 
+#ifndef ESL_UART_BAUDRATE
+#define ESL_UART_BAUDRATE           NRF_UARTE_BAUDRATE_115200
+#endif
+
+// Received bytes waiting for the main loop, power of two. About 20 ms at
+// 115200 baud.
+#ifndef ESL_UART_RX_RING_SIZE
+#define ESL_UART_RX_RING_SIZE       256
+#endif
+
+#ifndef NRFX_UARTE_ENABLED
+#define NRFX_UARTE_ENABLED          1
+#endif
+
+#ifndef NRFX_UARTE0_ENABLED
+#define NRFX_UARTE0_ENABLED         1
+#endif
+
+// Longest command line on any transport, long enough to define a macro of
+// ESL_MACRO_TEXT_LEN in one line
+#ifndef ESL_CLI_LINE_SIZE
+#define ESL_CLI_LINE_SIZE           192
+#endif
+
+#ifndef ESL_CLI_MAX_ARGS
+#define ESL_CLI_MAX_ARGS            4
+#endif
+
+// Commands in one line or macro, all parsed before any of them runs
+#ifndef ESL_CLI_BATCH_MAX
+#define ESL_CLI_BATCH_MAX           8
+#endif
+
+// Transports hand over received bytes in runs of up to one full speed USB
+// bulk packet
 #ifndef READ_SIZE
-#define READ_SIZE                   1
+#define READ_SIZE                   64
+#endif
+
+// Received bytes waiting to be assembled into lines, power of two. Reads
+// pause while less than READ_SIZE is free, so the host is held off instead
+// of input being dropped.
+#ifndef ESL_RX_RING_SIZE
+#define ESL_RX_RING_SIZE            256
+#endif
+
+// Output waiting to be sent, power of two. Input isn't taken while less
+// than ESL_TX_RESERVE is free, which is room for the longest reply
+// (stats as JSON, about 2.5 kB with every scheduler slot in use). Each
+// further command of a batch waits for the same room, or the batch stops
+// there with the error reply the rest of the reserve leaves room for.
+#ifndef ESL_TX_RING_SIZE
+#define ESL_TX_RING_SIZE            4096
+#endif
+
+#ifndef ESL_TX_RESERVE
+#define ESL_TX_RESERVE              3072
+#endif
+
+// Free output space a listing waits for before its next entry: a macro as
+// JSON with every character escaped
+#ifndef ESL_LIST_ENTRY_MAX
+#define ESL_LIST_ENTRY_MAX          1152
 #endif
 
 #ifndef ANSI_COLOR_GREEN
@@ -0,0 +1,247 @@
+#include "esl_cli.h"
+
+#include <string.h>
+
+static inline bool is_space(char c) {
+    return c == ' ' || c == '\t';
+}
+
+// Cuts the next token out of the line, NULL at the end. A token in double
+// quotes keeps its spaces and loses the quotes.
+static char *token_next(char **cursor) {
+    char *p = *cursor;
+
+    while (is_space(*p)) {
+        p++;
+    }
+    if (*p == '\0') {
+        *cursor = p;
+        return NULL;
+    }
+
+    if (*p == '"') {
+        char *token = ++p;
+        while (*p != '\0' && *p != '"') {
+            p++;
+        }
+        if (*p != '\0') {
+            *p++ = '\0';
+        }
+        *cursor = p;
+        return token;
+    }
+
+    char *token = p;
+    while (*p != '\0' && !is_space(*p)) {
+        p++;
+    }
+    if (*p != '\0') {
+        *p++ = '\0';
+    }
+    *cursor = p;
+    return token;
+}
+
+// Whole token has to be a decimal number, overflow is an error rather than
+// wrapping into range
+static bool int_parse(const char *token, int32_t *value) {
+    bool negative = *token == '-';
+    int64_t acc = 0;
+
+    if (negative || *token == '+') {
+        token++;
+    }
+    if (*token == '\0') {
+        return false;
+    }
+    for (; *token != '\0'; token++) {
+        if (*token < '0' || *token > '9') {
+            return false;
+        }
+        acc = acc * 10 + (*token - '0');
+        if (acc > (int64_t)INT32_MAX + 1) {
+            return false;
+        }
+    }
+    acc = negative ? -acc : acc;
+    if (acc > INT32_MAX) {
+        return false;
+    }
+    *value = acc;
+    return true;
+}
+
+// Shortest form only, no surrogates, nothing past U+10FFFF (RFC 3629), so
+// strings stored from here can go out as JSON and CBOR text
+static bool utf8_is_valid(const char *str) {
+    const uint8_t *p = (const uint8_t *)str;
+
+    while (*p != '\0') {
+        uint8_t c = *p++;
+        uint8_t more;
+        uint32_t cp;
+        if (c < 0x80) {
+            continue;
+        } else if (c >= 0xC2 && c <= 0xDF) {
+            more = 1;
+            cp = c & 0x1F;
+        } else if (c >= 0xE0 && c <= 0xEF) {
+            more = 2;
+            cp = c & 0x0F;
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            more = 3;
+            cp = c & 0x07;
+        } else {
+            return false;
+        }
+        uint32_t min = more == 1 ? 0x80 : more == 2 ? 0x800 : 0x10000;
+        for (; more > 0; more--, p++) {
+            if ((*p & 0xC0) != 0x80) {
+                return false;
+            }
+            cp = (cp << 6) | (*p & 0x3F);
+        }
+        if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static esl_ret_code_t arg_parse(esl_cli_arg_spec_t const *spec, char *token, esl_cli_arg_t *arg) {
+    switch (spec->type) {
+    case ESL_CLI_ARG_INT:
+        if (!int_parse(token, &arg->num)) {
+            return ESL_ERR_CLI_VALUE_ERROR;
+        }
+        if (arg->num < spec->min || arg->num > spec->max) {
+            return ESL_ERR_CLI_ARG_RANGE;
+        }
+        return ESL_SUCCESS;
+
+    case ESL_CLI_ARG_STR: {
+        size_t len = strlen(token);
+        if (len < spec->min || len > spec->max) {
+            return ESL_ERR_CLI_ARG_LENGTH;
+        }
+        if (!utf8_is_valid(token)) {
+            return ESL_ERR_CLI_VALUE_ERROR;
+        }
+        arg->str = token;
+        return ESL_SUCCESS;
+    }
+
+    case ESL_CLI_ARG_FLAG:
+        if (strcmp(token, spec->word) != 0) {
+            return ESL_ERR_CLI_VALUE_ERROR;
+        }
+        arg->num = 1;
+        return ESL_SUCCESS;
+
+    case ESL_CLI_ARG_CHOICE: {
+        size_t len = strlen(token);
+        const char *word = spec->word;
+        for (arg->num = 0; ; arg->num++) {
+            const char *end = strchr(word, '|');
+            size_t word_len = end ? (size_t)(end - word) : strlen(word);
+            if (word_len == len && memcmp(word, token, len) == 0) {
+                return ESL_SUCCESS;
+            }
+            if (end == NULL) {
+                return ESL_ERR_CLI_VALUE_ERROR;
+            }
+            word = end + 1;
+        }
+    }
+
+    default:
+        return ESL_ERROR;
+    }
+}
+
+char *esl_cli_split(char **cursor) {
+    char *p = *cursor;
+    bool quoted = false;
+
+    if (p == NULL) {
+        return NULL;
+    }
+    char *cmd = p;
+    for (; *p != '\0'; p++) {
+        if (*p == '"') {
+            quoted = !quoted;
+        } else if (*p == ESL_CLI_SEPARATOR && !quoted) {
+            *p = '\0';
+            *cursor = p + 1;
+            return cmd;
+        }
+    }
+    *cursor = NULL;
+    return cmd;
+}
+
+esl_cli_cmd_t const *esl_cli_find(esl_cli_cmd_t const *table, size_t count, const char *name) {
+    size_t lo = 0;
+    size_t hi = count;
+
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        int cmp = strcmp(name, table[mid].name);
+        if (cmp == 0) {
+            return &table[mid];
+        } else if (cmp < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return NULL;
+}
+
+bool esl_cli_table_is_sorted(esl_cli_cmd_t const *table, size_t count) {
+    for (size_t i = 1; i < count; i++) {
+        if (strcmp(table[i - 1].name, table[i].name) >= 0) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (table[i].args_max > ESL_CLI_MAX_ARGS || table[i].args_min > table[i].args_max) {
+            return false;
+        }
+    }
+    return true;
+}
+
+esl_ret_code_t esl_cli_parse(char *line, esl_cli_cmd_t const *table, size_t count, esl_cli_parsed_t *parsed) {
+    char *cursor = line;
+    char *token = token_next(&cursor);
+
+    parsed->cmd = NULL;
+    parsed->arg_count = 0;
+    parsed->bad_arg = 0;
+
+    if (token == NULL) {
+        return ESL_ERR_CLI_EMPTY;
+    }
+    parsed->cmd = esl_cli_find(table, count, token);
+    if (parsed->cmd == NULL) {
+        return ESL_ERR_CLI_NOT_FOUND;
+    }
+
+    esl_cli_cmd_t const *cmd = parsed->cmd;
+    while ((token = token_next(&cursor)) != NULL) {
+        if (parsed->arg_count == cmd->args_max) {
+            return ESL_ERR_CLI_ARG_COUNT;
+        }
+        parsed->bad_arg = parsed->arg_count;
+        esl_ret_code_t res = arg_parse(&cmd->args[parsed->arg_count], token, &parsed->args[parsed->arg_count]);
+        if (res != ESL_SUCCESS) {
+            return res;
+        }
+        parsed->arg_count++;
+    }
+    if (parsed->arg_count < cmd->args_min) {
+        return ESL_ERR_CLI_ARG_COUNT;
+    }
+    return ESL_SUCCESS;
+}
@@ -0,0 +1,82 @@
+#ifndef ESL_CLI_H
+#define ESL_CLI_H
+
+#include "esl_utils.h"
+#include "sdk_config.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Command line parsing without copies or allocation. The line is split in
+// place, the command is looked up by binary search in a table sorted by
+// name, and every argument is checked against the command's schema in the
+// same pass, so handlers get values that are already in range.
+// Several commands can share a line, separated by ESL_CLI_SEPARATOR.
+
+#define ESL_CLI_SEPARATOR           ';'
+
+typedef enum {
+    ESL_CLI_ARG_INT     = 0,    // Decimal, min..max
+    ESL_CLI_ARG_STR     = 1,    // min..max bytes of UTF-8
+    ESL_CLI_ARG_FLAG    = 2,    // Only the word itself, value 1
+    ESL_CLI_ARG_CHOICE  = 3,    // One of the '|' separated words, value is its index
+} esl_cli_arg_type_t;
+
+typedef struct {
+    esl_cli_arg_type_t type;
+    int32_t min;
+    int32_t max;
+    const char *word;           // ESL_CLI_ARG_FLAG and ESL_CLI_ARG_CHOICE
+} esl_cli_arg_spec_t;
+
+#define ESL_CLI_INT(lo, hi)         { .type = ESL_CLI_ARG_INT, .min = (lo), .max = (hi) }
+#define ESL_CLI_STR(max_len)        { .type = ESL_CLI_ARG_STR, .min = 1, .max = (max_len) }
+#define ESL_CLI_FLAG(flag_word)     { .type = ESL_CLI_ARG_FLAG, .min = 1, .max = 1, .word = (flag_word) }
+#define ESL_CLI_CHOICE(words)       { .type = ESL_CLI_ARG_CHOICE, .word = (words) }
+
+typedef union {
+    int32_t num;                // ESL_CLI_ARG_INT, ESL_CLI_ARG_FLAG and ESL_CLI_ARG_CHOICE
+    const char *str;
+} esl_cli_arg_t;
+
+typedef esl_ret_code_t (*esl_cli_handler_t)(esl_cli_arg_t const *args, uint8_t arg_count);
+
+typedef struct {
+    const char *name;
+    const char *description;
+    esl_cli_handler_t handler;
+    esl_cli_arg_spec_t const *args;
+    uint8_t args_min;           // The rest are optional
+    uint8_t args_max;
+    bool quiet_in_batch;        // Success reply left out in a batch, its summary covers it
+    bool ends_batch;            // Lists after it returns, nothing may follow it in a batch
+} esl_cli_cmd_t;
+
+// All arguments required, or only the first n
+#define ESL_CLI_SPECS_COUNT(specs)  (sizeof(specs) / sizeof((specs)[0]))
+#define ESL_CLI_ARGS(specs)         .args = (specs), .args_min = ESL_CLI_SPECS_COUNT(specs), .args_max = ESL_CLI_SPECS_COUNT(specs)
+#define ESL_CLI_ARGS_OPT(specs, n)  .args = (specs), .args_min = (n), .args_max = ESL_CLI_SPECS_COUNT(specs)
+// Commands that change something are marked ESL_CLI_QUIET, queries keep
+// their replies in a batch
+#define ESL_CLI_QUIET               .quiet_in_batch = true
+#define ESL_CLI_LISTING             .ends_batch = true
+
+typedef struct {
+    esl_cli_cmd_t const *cmd;   // Set once the command is found
+    esl_cli_arg_t args[ESL_CLI_MAX_ARGS];
+    uint8_t arg_count;
+    uint8_t bad_arg;            // Index of the argument that failed
+} esl_cli_parsed_t;
+
+// Splits line in place. Errors: ESL_ERR_CLI_EMPTY, ESL_ERR_CLI_NOT_FOUND,
+// ESL_ERR_CLI_ARG_COUNT, ESL_ERR_CLI_VALUE_ERROR (not a number, not one of
+// the words, or not UTF-8), ESL_ERR_CLI_ARG_RANGE and ESL_ERR_CLI_ARG_LENGTH.
+esl_ret_code_t esl_cli_parse(char *line, esl_cli_cmd_t const *table, size_t count, esl_cli_parsed_t *parsed);
+// Cuts the next command out of a line with several of them, NULL once all
+// were taken. Separators inside double quotes don't count.
+char *esl_cli_split(char **cursor);
+esl_cli_cmd_t const *esl_cli_find(esl_cli_cmd_t const *table, size_t count, const char *name);
+// Lookup needs the table sorted by name, check it once at startup
+bool esl_cli_table_is_sorted(esl_cli_cmd_t const *table, size_t count);
+
+#endif // ESL_CLI_H
@@ -0,0 +1,55 @@
+#include "esl_cli_cmds.h"
+#include "esl_nvmc.h"
+#include "esl_clip.h"
+#include "esl_macro.h"
+
+#define RGB_ARGS                    ESL_CLI_INT(0, 255), ESL_CLI_INT(0, 255), ESL_CLI_INT(0, 255)
+#define HSV_ARGS                    ESL_CLI_INT(0, 360), ESL_CLI_INT(0, 100), ESL_CLI_INT(0, 100)
+#define NAME_ARG                    ESL_CLI_STR(ESL_NVMC_COLOR_NAME_LEN - 1)
+
+static const esl_cli_arg_spec_t rgb_args[] = { RGB_ARGS };
+static const esl_cli_arg_spec_t hsv_args[] = { HSV_ARGS };
+static const esl_cli_arg_spec_t rgb_name_args[] = { RGB_ARGS, NAME_ARG };
+static const esl_cli_arg_spec_t hsv_name_args[] = { HSV_ARGS, NAME_ARG };
+static const esl_cli_arg_spec_t name_args[] = { NAME_ARG };
+static const esl_cli_arg_spec_t rename_args[] = { NAME_ARG, NAME_ARG };
+static const esl_cli_arg_spec_t clip_rec_args[] = { ESL_CLI_INT(ESL_CLIP_FRAME_MS_MIN, ESL_CLIP_FRAME_MS_MAX) };
+static const esl_cli_arg_spec_t clip_key_args[] = { RGB_ARGS, ESL_CLI_INT(1, ESL_CLIP_HOLD_MAX) };
+static const esl_cli_arg_spec_t macro_name_args[] = { ESL_CLI_STR(ESL_MACRO_NAME_LEN - 1) };
+static const esl_cli_arg_spec_t macro_add_args[] = { ESL_CLI_STR(ESL_MACRO_NAME_LEN - 1), ESL_CLI_STR(ESL_MACRO_TEXT_LEN - 1) };
+static const esl_cli_arg_spec_t clip_play_args[] = { ESL_CLI_INT(0, ESL_CLIP_MAX - 1), ESL_CLI_FLAG("loop") };
+// In the order of esl_reply_mode_t
+static const esl_cli_arg_spec_t output_args[] = { ESL_CLI_CHOICE("text|json|cbor") };
+
+// Keep sorted by name, lookup is a binary search
+const esl_cli_cmd_t esl_cli_cmds[] = {
+    { "add_current_color", "add_current_color <color_name>: save current color\n\r", esl_cli_cmd_add_current_color, ESL_CLI_ARGS(name_args), ESL_CLI_QUIET },
+    { "add_hsv_color", "add_hsv_color <H> <S> <V> <color_name>: save HSV color\n\r", esl_cli_cmd_add_hsv_color, ESL_CLI_ARGS(hsv_name_args), ESL_CLI_QUIET },
+    { "add_rgb_color", "add_rgb_color <R> <G> <B> <color_name>: save RGB color\n\r", esl_cli_cmd_add_rgb_color, ESL_CLI_ARGS(rgb_name_args), ESL_CLI_QUIET },
+    { "apply_color", "apply_color <color_name>: apply saved color\n\r", esl_cli_cmd_apply_color, ESL_CLI_ARGS(name_args), ESL_CLI_QUIET },
+    { "clip_end", "clip_end: finish recording\n\r", esl_cli_cmd_clip_end, ESL_CLI_QUIET },
+    { "clip_erase", "clip_erase: delete all clips\n\r", esl_cli_cmd_clip_erase, ESL_CLI_QUIET },
+    { "clip_fade", "clip_fade <R> <G> <B> <frames>: add a fade to the clip\n\r", esl_cli_cmd_clip_fade, ESL_CLI_ARGS(clip_key_args), ESL_CLI_QUIET },
+    { "clip_key", "clip_key <R> <G> <B> <frames>: add a color to the clip\n\r", esl_cli_cmd_clip_key, ESL_CLI_ARGS(clip_key_args), ESL_CLI_QUIET },
+    { "clip_list", "clip_list: display all clips\n\r", esl_cli_cmd_clip_list, ESL_CLI_LISTING },
+    { "clip_play", "clip_play <idx> [loop]: play a clip\n\r", esl_cli_cmd_clip_play, ESL_CLI_ARGS_OPT(clip_play_args, 1), ESL_CLI_QUIET },
+    { "clip_rec", "clip_rec <frame_ms>: start recording a clip\n\r", esl_cli_cmd_clip_rec, ESL_CLI_ARGS(clip_rec_args), ESL_CLI_QUIET },
+    { "clip_stop", "clip_stop: stop playback\n\r", esl_cli_cmd_clip_stop, ESL_CLI_QUIET },
+    { "del_color", "del_color <color_name>: delete saved color\n\r", esl_cli_cmd_del_color, ESL_CLI_ARGS(name_args), ESL_CLI_QUIET },
+    { "help", "help: show list of commands\n\r", esl_cli_cmd_help, ESL_CLI_LISTING },
+    { "hsv", "hsv <H> <S> <V>: set new color based on HSV\n\r", esl_cli_cmd_hsv, ESL_CLI_ARGS(hsv_args), ESL_CLI_QUIET },
+    { "list_colors", "list_colors: display all saved colors\n\r", esl_cli_cmd_list_colors, ESL_CLI_LISTING },
+    { "macro_add", "macro_add <name> \"<cmd>; <cmd>...\": save commands as a macro\n\r", esl_cli_cmd_macro_add, ESL_CLI_ARGS(macro_add_args), ESL_CLI_QUIET },
+    { "macro_del", "macro_del <name>: delete a macro\n\r", esl_cli_cmd_macro_del, ESL_CLI_ARGS(macro_name_args), ESL_CLI_QUIET },
+    { "macro_erase", "macro_erase: delete all macros\n\r", esl_cli_cmd_macro_erase, ESL_CLI_QUIET },
+    { "macro_list", "macro_list: display all macros\n\r", esl_cli_cmd_macro_list, ESL_CLI_LISTING },
+    { "macro_run", "macro_run <name>: run a macro as one batch\n\r", esl_cli_cmd_macro_run, ESL_CLI_ARGS(macro_name_args), ESL_CLI_QUIET },
+    { "output", "output <text|json|cbor>: reply format until the port is closed\n\r", esl_cli_cmd_output, ESL_CLI_ARGS(output_args), ESL_CLI_QUIET },
+    { "rename_color", "rename_color <old_name> <new_name>: rename saved color\n\r", esl_cli_cmd_rename_color, ESL_CLI_ARGS(rename_args), ESL_CLI_QUIET },
+    { "rgb", "rgb <R> <G> <B>: set new color based on RGB\n\r", esl_cli_cmd_rgb, ESL_CLI_ARGS(rgb_args), ESL_CLI_QUIET },
+    { "save", "save: store current color now\n\r", esl_cli_cmd_save, ESL_CLI_QUIET },
+    { "stats", "stats: show runtime statistics\n\r", esl_cli_cmd_stats },
+};
+
+
+const size_t esl_cli_cmds_count = sizeof(esl_cli_cmds) / sizeof(esl_cli_cmds[0]);
@@ -0,0 +1,38 @@
+#ifndef ESL_CLI_CMDS_H
+#define ESL_CLI_CMDS_H
+
+#include "esl_cli.h"
+
+// Command table of the CLI, sorted by name. The handlers live in main.c.
+
+extern const esl_cli_cmd_t esl_cli_cmds[];
+extern const size_t esl_cli_cmds_count;
+
+esl_ret_code_t esl_cli_cmd_rgb(esl_cli_arg_t const *args, uint8_t arg_count);
+esl_ret_code_t esl_cli_cmd_hsv(esl_cli_arg_t const *args, uint8_t arg_count);
+esl_ret_code_t esl_cli_cmd_add_rgb_color(esl_cli_arg_t const *args, uint8_t arg_count);
+esl_ret_code_t esl_cli_cmd_add_hsv_color(esl_cli_arg_t const *args, uint8_t arg_count);
+esl_ret_code_t esl_cli_cmd_add_current_color(esl_cli_arg_t const *args, uint8_t arg_count);
+esl_ret_code_t esl_cli_cmd_list_colors(esl_cli_arg_t const *args, uint8_t arg_count);
+esl_ret_code_t esl_cli_cmd_help(esl_cli_arg_t const *args, uint8_t arg_count);
+esl_ret_code_t esl_cli_cmd_stats(esl_cli_arg_t const *args, uint8_t arg_count);
+esl_ret_code_t esl_cli_cmd_save(esl_cli_arg_t const *args, uint8_t arg_count);
+esl_ret_code_t esl_cli_cmd_apply_color(esl_cli_arg_t const *args, uint8_t arg_count);
+esl_ret_code_t esl_cli_cmd_del_color(esl_cli_arg_t const *args, uint8_t arg_count);
+esl_ret_code_t esl_cli_cmd_rename_color(esl_cli_arg_t const *args, uint8_t arg_count);
+esl_ret_code_t esl_cli_cmd_clip_rec(esl_cli_arg_t const *args, uint8_t arg_count);
+esl_ret_code_t esl_cli_cmd_clip_key(esl_cli_arg_t const *args, uint8_t arg_count);
+esl_ret_code_t esl_cli_cmd_clip_fade(esl_cli_arg_t const *args, uint8_t arg_count);
+esl_ret_code_t esl_cli_cmd_clip_end(esl_cli_arg_t const *args, uint8_t arg_count);
+esl_ret_code_t esl_cli_cmd_clip_play(esl_cli_arg_t const *args, uint8_t arg_count);
+esl_ret_code_t esl_cli_cmd_clip_stop(esl_cli_arg_t const *args, uint8_t arg_count);
+esl_ret_code_t esl_cli_cmd_clip_list(esl_cli_arg_t const *args, uint8_t arg_count);
+esl_ret_code_t esl_cli_cmd_clip_erase(esl_cli_arg_t const *args, uint8_t arg_count);
+esl_ret_code_t esl_cli_cmd_macro_add(esl_cli_arg_t const *args, uint8_t arg_count);
+esl_ret_code_t esl_cli_cmd_macro_run(esl_cli_arg_t const *args, uint8_t arg_count);
+esl_ret_code_t esl_cli_cmd_macro_del(esl_cli_arg_t const *args, uint8_t arg_count);
+esl_ret_code_t esl_cli_cmd_macro_list(esl_cli_arg_t const *args, uint8_t arg_count);
+esl_ret_code_t esl_cli_cmd_macro_erase(esl_cli_arg_t const *args, uint8_t arg_count);
+esl_ret_code_t esl_cli_cmd_output(esl_cli_arg_t const *args, uint8_t arg_count);
+
+#endif // ESL_CLI_CMDS_H
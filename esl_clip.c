@@ -0,0 +1,357 @@
+#include "esl_clip.h"
+#include "esl_nvmc.h"
+#include "esl_sched.h"
+#include "nrf_log.h"
+
+#include <string.h>
+
+#define WORD_ERASED                 (0xFFFFFFFF)
+#define KEY_FADE                    (0x80)
+// Period of the PWM: 500 kHz base clock counting up to PWM_TOP_VAL
+#define PWM_PERIOD_US               ((uint32_t)PWM_TOP_VAL * 2)
+
+// Written once recording ends, so an interrupted clip never shows up. The
+// state is in the last word, so a valid header always has its count.
+typedef struct {
+    uint32_t keyframes;
+    uint8_t state;              // ESL_NVMC_BYTE_VALID
+    uint8_t reserved;
+    uint16_t frame_ms;
+} clip_hdr_t;
+
+// Hold stays below 0x7F, so a keyframe never reads as an erased word
+typedef struct {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    uint8_t hold;               // Frames, KEY_FADE to fade from the previous keyframe
+} clip_key_t;
+
+typedef struct {
+    clip_key_t const *keys;     // In flash
+    esl_clip_info_t info;
+} clip_t;
+
+typedef struct {
+    clip_t const *clip;
+    uint32_t key;               // Keyframe being expanded
+    uint8_t step;               // Frames of it already produced
+    uint8_t prev[3];            // Color of the previous keyframe
+    bool loop;
+    bool ended;                 // Last frame produced
+    int8_t end_buf;             // Buffer holding the last frame, -1 before
+    esl_clip_done_handler_t done_handler;
+} clip_player_t;
+
+static esl_pwm_context_t *pwm;
+static clip_t clips[ESL_CLIP_MAX];
+static uint8_t clips_count = 0;
+static uint8_t clips_pending = 0;           // Ended, header still queued
+static uint32_t free_addr;                  // Next free word of the clip region
+
+static bool recording = false;
+static uint32_t rec_hdr_addr;
+static uint32_t rec_addr;                   // Next keyframe
+static uint32_t rec_frame_ms;
+
+static clip_player_t player;
+static volatile bool playing = false;
+static nrf_pwm_values_individual_t play_buf[2][ESL_CLIP_CHUNK_FRAMES];
+static nrf_pwm_sequence_t play_seq[2];
+static volatile bool buf_ready[2];
+static esl_clip_stats_t clip_stats;
+
+static uint32_t word_at(uint32_t addr) {
+    return *(const uint32_t *)addr;
+}
+
+static void clip_add(uint32_t hdr_addr) {
+    clip_hdr_t const *hdr = (clip_hdr_t const *)hdr_addr;
+    clip_t *clip = &clips[clips_count++];
+
+    clip->keys = (clip_key_t const *)(hdr_addr + sizeof(*hdr));
+    clip->info.frame_ms = hdr->frame_ms;
+    clip->info.keyframes = hdr->keyframes;
+    clip->info.frames = 0;
+    for (uint32_t i = 0; i < hdr->keyframes; i++) {
+        clip->info.frames += clip->keys[i].hold & ~KEY_FADE;
+    }
+}
+
+// Clips are stored back to back, each header followed by its keyframes.
+// Keyframes never read as erased, so a recording that was cut short runs up
+// to the next erased word; the next clip starts one word after it. A valid
+// header that doesn't fit hides everything after it until the region is erased.
+void esl_clip_init(esl_pwm_context_t *pwm_ctx) {
+    pwm = pwm_ctx;
+    clips_count = 0;
+    clips_pending = 0;
+    recording = false;
+    playing = false;
+    memset(&clip_stats, 0, sizeof(clip_stats));
+
+    uint32_t addr = CLIPS_START_ADDR;
+    while (addr + sizeof(clip_hdr_t) <= CLIPS_END_ADDR) {
+        clip_hdr_t const *hdr = (clip_hdr_t const *)addr;
+
+        if (hdr->state != ESL_NVMC_BYTE_VALID) {
+            uint32_t end = addr + sizeof(*hdr);
+            while (end < CLIPS_END_ADDR && word_at(end) != WORD_ERASED) {
+                end += sizeof(uint32_t);
+            }
+            if (end == addr + sizeof(*hdr) && word_at(addr) == WORD_ERASED && word_at(addr + sizeof(uint32_t)) == WORD_ERASED) {
+                break;
+            }
+            NRF_LOG_WARNING("Clips: skipping unfinished recording at 0x%x", addr);
+            addr = end + sizeof(uint32_t);
+            continue;
+        }
+
+        if (hdr->keyframes == 0 || hdr->keyframes > (CLIPS_END_ADDR - addr - sizeof(*hdr)) / sizeof(clip_key_t) ||
+            clips_count == ESL_CLIP_MAX) {
+            NRF_LOG_WARNING("Clips: unreadable clip at 0x%x", addr);
+            addr = CLIPS_END_ADDR;
+            break;
+        }
+        clip_add(addr);
+        addr += sizeof(*hdr) + hdr->keyframes * sizeof(clip_key_t);
+    }
+    if (addr > CLIPS_END_ADDR) {
+        addr = CLIPS_END_ADDR;
+    }
+    free_addr = addr;
+    NRF_LOG_INFO("Clips: %d found, %d bytes free", clips_count, CLIPS_END_ADDR - free_addr);
+}
+
+esl_ret_code_t esl_clip_record_start(uint16_t frame_ms) {
+    if (recording || frame_ms < ESL_CLIP_FRAME_MS_MIN || frame_ms > ESL_CLIP_FRAME_MS_MAX) {
+        return ESL_ERROR;
+    }
+    if (clips_count + clips_pending == ESL_CLIP_MAX || free_addr + sizeof(clip_hdr_t) + sizeof(clip_key_t) > CLIPS_END_ADDR) {
+        return ESL_ERR_NVMC_MEMORY_FULL;
+    }
+
+    recording = true;
+    rec_hdr_addr = free_addr;
+    rec_addr = free_addr + sizeof(clip_hdr_t);
+    rec_frame_ms = frame_ms;
+    return ESL_SUCCESS;
+}
+
+esl_ret_code_t esl_clip_record_key(uint8_t r, uint8_t g, uint8_t b, uint8_t frames, bool fade) {
+    if (!recording || frames == 0 || frames > ESL_CLIP_HOLD_MAX) {
+        return ESL_ERROR;
+    }
+    if (rec_addr + sizeof(clip_key_t) > CLIPS_END_ADDR) {
+        return ESL_ERR_NVMC_MEMORY_FULL;
+    }
+
+    clip_key_t key = { .r = r, .g = g, .b = b, .hold = frames | (fade ? KEY_FADE : 0) };
+    esl_ret_code_t res = esl_nvmc_write(rec_addr, &key, sizeof(key), NULL, NULL);
+    if (res == ESL_ERR_BUSY) {
+        return res;
+    }
+    // The word is used up even if the write failed
+    rec_addr += sizeof(key);
+    return res;
+}
+
+// Keyframes are read from flash, so a clip only shows up once its header
+// is written. A header that didn't make it leaves the recording for the
+// boot scan to skip.
+static void clip_committed(esl_ret_code_t result, void *p_context) {
+    clips_pending--;
+    if (result == ESL_SUCCESS) {
+        clip_add((uint32_t)(uintptr_t)p_context);
+    }
+}
+
+esl_ret_code_t esl_clip_record_end(uint8_t *clip_idx) {
+    if (!recording) {
+        return ESL_ERROR;
+    }
+
+    uint32_t keyframes = (rec_addr - rec_hdr_addr - sizeof(clip_hdr_t)) / sizeof(clip_key_t);
+    if (keyframes == 0) {
+        recording = false;
+        return ESL_ERROR;
+    }
+
+    clip_hdr_t hdr = {
+        .keyframes = keyframes,
+        .state = ESL_NVMC_BYTE_VALID,
+        .reserved = 0xFF,
+        .frame_ms = rec_frame_ms
+    };
+    esl_ret_code_t res = esl_nvmc_write(rec_hdr_addr, &hdr, sizeof(hdr), clip_committed, (void *)(uintptr_t)rec_hdr_addr);
+    if (res == ESL_ERR_BUSY) {
+        // Still recording, can be ended again
+        return res;
+    }
+    recording = false;
+    if (res != ESL_SUCCESS) {
+        // Left for the boot scan to skip, which expects an erased word after it
+        free_addr = rec_addr + sizeof(uint32_t);
+        return res;
+    }
+    free_addr = rec_addr;
+    *clip_idx = clips_count + clips_pending++;
+    return ESL_SUCCESS;
+}
+
+// Waits for ended clips to be committed, they would show up after the erase
+esl_ret_code_t esl_clip_erase_all(void) {
+    if (clips_pending > 0) {
+        return ESL_ERR_BUSY;
+    }
+    esl_ret_code_t res = esl_nvmc_erase_pages(CLIPS_START_ADDR, ESL_CLIP_PAGES, NULL, NULL);
+    if (res != ESL_SUCCESS) {
+        return res;
+    }
+    esl_clip_stop();
+    recording = false;
+    clips_count = 0;
+    free_addr = CLIPS_START_ADDR;
+    return ESL_SUCCESS;
+}
+
+uint8_t esl_clip_count(void) {
+    return clips_count;
+}
+
+bool esl_clip_info_get(uint8_t idx, esl_clip_info_t *info) {
+    if (idx >= clips_count) {
+        return false;
+    }
+    *info = clips[idx].info;
+    return true;
+}
+
+// Produces the next frame of the clip
+static void frame_next(uint8_t rgb[3]) {
+    clip_key_t key = player.clip->keys[player.key];
+    uint8_t hold = key.hold & ~KEY_FADE;
+    uint8_t target[3] = { key.r, key.g, key.b };
+
+    player.step++;
+    for (uint8_t i = 0; i < 3; i++) {
+        rgb[i] = (key.hold & KEY_FADE) ?
+                 player.prev[i] + ((int)target[i] - player.prev[i]) * player.step / hold : target[i];
+    }
+
+    if (player.step == hold) {
+        memcpy(player.prev, target, sizeof(player.prev));
+        player.step = 0;
+        if (++player.key == player.clip->info.keyframes) {
+            player.key = 0;
+            player.ended = !player.loop;
+        }
+    }
+}
+
+// Expands the next chunk of frames into a buffer. Once the clip has ended
+// the last color is held until the buffer holding it has been played.
+static void buf_refill(uint8_t buf_idx) {
+    uint32_t start = esl_cycles_get();
+    nrf_pwm_values_individual_t *values = play_buf[buf_idx];
+    bool ended_before = player.ended;
+    uint8_t rgb[3];
+
+    memcpy(rgb, player.prev, sizeof(rgb));
+    for (uint32_t i = 0; i < ESL_CLIP_CHUNK_FRAMES; i++) {
+        if (!player.ended) {
+            frame_next(rgb);
+        }
+        values[i].channel_0 = pwm->pwm_seq_values.channel_0;    // LED1 keeps its own state
+        values[i].channel_1 = rgb[0];
+        values[i].channel_2 = rgb[1];
+        values[i].channel_3 = rgb[2];
+    }
+    if (player.ended && !ended_before) {
+        player.end_buf = buf_idx;
+    }
+    buf_ready[buf_idx] = true;
+
+    uint32_t cycles = esl_cycles_get() - start;
+    clip_stats.chunks++;
+    if (cycles > clip_stats.max_refill_cycles) {
+        clip_stats.max_refill_cycles = cycles;
+    }
+}
+
+static void refill_work(void *p_data, uint16_t data_size) {
+    if (playing) {
+        buf_refill(*(uint8_t *)p_data);
+    }
+}
+
+static void finish_work(void *p_data, uint16_t data_size) {
+    if (!playing) {
+        return;
+    }
+    esl_clip_done_handler_t done_handler = player.done_handler;
+    esl_clip_stop();
+    if (done_handler) {
+        done_handler();
+    }
+}
+
+// PWM interrupt: the other buffer starts playing now, so it has to be ready
+static void stream_handler(uint8_t buf_idx) {
+    buf_ready[buf_idx] = false;
+    if (!buf_ready[buf_idx ^ 1]) {
+        clip_stats.underruns++;
+    }
+
+    if (player.end_buf == buf_idx) {
+        esl_sched_post(ESL_SCHED_PRIO_HIGH, finish_work, NULL, 0);
+    } else {
+        esl_sched_post(ESL_SCHED_PRIO_HIGH, refill_work, &buf_idx, sizeof(buf_idx));
+    }
+}
+
+esl_ret_code_t esl_clip_play(uint8_t idx, bool loop, esl_clip_done_handler_t done_handler) {
+    if (idx >= clips_count) {
+        return ESL_ERR_NVMC_NOT_FOUND;
+    }
+    esl_clip_stop();
+
+    clip_t const *clip = &clips[idx];
+    uint32_t periods = clip->info.frame_ms * 1000 / PWM_PERIOD_US;
+
+    memset(&player, 0, sizeof(player));
+    player.clip = clip;
+    player.loop = loop;
+    player.end_buf = -1;
+    player.done_handler = done_handler;     // Fades into the first keyframe start from black
+
+    for (uint8_t i = 0; i < 2; i++) {
+        play_seq[i] = (nrf_pwm_sequence_t){
+            .values.p_individual = play_buf[i],
+            .length = ESL_CLIP_CHUNK_FRAMES * sizeof(nrf_pwm_values_individual_t) / sizeof(uint16_t),
+            .repeats = periods > 0 ? periods - 1 : 0,
+            .end_delay = 0
+        };
+        buf_refill(i);
+    }
+
+    playing = true;
+    esl_pwm_stream_start(pwm, &play_seq[0], &play_seq[1], stream_handler);
+    return ESL_SUCCESS;
+}
+
+void esl_clip_stop(void) {
+    if (!playing) {
+        return;
+    }
+    playing = false;
+    esl_pwm_stream_stop(pwm);
+}
+
+bool esl_clip_is_playing(void) {
+    return playing;
+}
+
+void esl_clip_stats_get(esl_clip_stats_t *stats) {
+    *stats = clip_stats;
+}
@@ -0,0 +1,51 @@
+#ifndef ESL_CLIP_H
+#define ESL_CLIP_H
+
+#include "esl_utils.h"
+#include "esl_pwm.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Light animation clips, kept in flash as keyframes. EasyDMA can't read
+// flash, so playback expands them a chunk of frames at a time into two
+// small RAM buffers the PWM plays alternately.
+
+#define ESL_CLIP_HOLD_MAX           (100)   // Frames per keyframe
+#define ESL_CLIP_FRAME_MS_MIN       (10)
+#define ESL_CLIP_FRAME_MS_MAX       (1000)
+
+typedef struct {
+    uint16_t frame_ms;
+    uint32_t keyframes;
+    uint32_t frames;            // Length of one pass
+} esl_clip_info_t;
+
+typedef struct {
+    uint32_t chunks;            // Buffers refilled
+    uint32_t underruns;         // Buffers played again before they were refilled
+    uint32_t max_refill_cycles;
+} esl_clip_stats_t;
+
+typedef void (*esl_clip_done_handler_t)(void);
+
+void esl_clip_init(esl_pwm_context_t *pwm_ctx);     // Call after esl_nvmc_init()
+
+// Keyframes are written to flash as they come, the clip only shows up once
+// recording has ended and its header is in flash. A full flash queue
+// returns ESL_ERR_BUSY and nothing is recorded, the call can be repeated.
+// A keyframe holds its color for a number of frames, or fades to it from
+// the previous one.
+esl_ret_code_t esl_clip_record_start(uint16_t frame_ms);
+esl_ret_code_t esl_clip_record_key(uint8_t r, uint8_t g, uint8_t b, uint8_t frames, bool fade);
+esl_ret_code_t esl_clip_record_end(uint8_t *clip_idx);
+esl_ret_code_t esl_clip_erase_all(void);
+uint8_t esl_clip_count(void);
+bool esl_clip_info_get(uint8_t idx, esl_clip_info_t *info);
+
+// The handler runs from the scheduler once a clip that doesn't loop has ended
+esl_ret_code_t esl_clip_play(uint8_t idx, bool loop, esl_clip_done_handler_t done_handler);
+void esl_clip_stop(void);
+bool esl_clip_is_playing(void);
+void esl_clip_stats_get(esl_clip_stats_t *stats);
+
+#endif // ESL_CLIP_H
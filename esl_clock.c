@@ -0,0 +1,32 @@
+#include "esl_clock.h"
+#include "app_util_platform.h"
+
+APP_TIMER_DEF(keepalive_timer_id);
+static uint64_t clock_base = 0;
+static uint32_t clock_last_cnt = 0;
+
+// The 24-bit RTC counter wraps every 512 s. Reading the clock at least once
+// per wrap period is enough to extend it, so an otherwise idle system only
+// wakes up every ESL_CLOCK_KEEPALIVE_MS.
+static void keepalive_timeout_handler(void *p_context) {
+    (void)esl_clock_ticks();
+}
+
+void esl_clock_init(void) {
+    clock_last_cnt = app_timer_cnt_get();
+    app_timer_create(&keepalive_timer_id, APP_TIMER_MODE_REPEATED, keepalive_timeout_handler);
+    app_timer_start(keepalive_timer_id, APP_TIMER_TICKS(ESL_CLOCK_KEEPALIVE_MS), NULL);
+}
+
+uint64_t esl_clock_ticks(void) {
+    uint64_t ticks;
+
+    CRITICAL_REGION_ENTER();
+    uint32_t cnt = app_timer_cnt_get();
+    clock_base += app_timer_cnt_diff_compute(cnt, clock_last_cnt);
+    clock_last_cnt = cnt;
+    ticks = clock_base;
+    CRITICAL_REGION_EXIT();
+
+    return ticks;
+}
@@ -0,0 +1,16 @@
+#ifndef ESL_CLOCK_H
+#define ESL_CLOCK_H
+
+#include "app_timer.h"
+#include <stdint.h>
+
+// Monotonic 64-bit time base derived from the RTC1 counter used by app_timer
+
+#define ESL_CLOCK_FREQ              APP_TIMER_CLOCK_FREQ
+#define ESL_CLOCK_TICKS_TO_MS(t)    ((uint64_t)(t) * 1000 / ESL_CLOCK_FREQ)
+#define ESL_CLOCK_TICKS_TO_US(t)    ((uint64_t)(t) * 1000000 / ESL_CLOCK_FREQ)
+
+void esl_clock_init(void);      // Call after app_timer_init()
+uint64_t esl_clock_ticks(void);
+
+#endif // ESL_CLOCK_H
@@ -0,0 +1,38 @@
+#include "esl_utils.h"
+#include "nrf.h"
+
+// Cortex-M4 specifics of esl_utils.h, host builds have their own
+
+void esl_cycles_init(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+uint32_t esl_cycles_get(void) {
+    return DWT->CYCCNT;
+}
+
+// Placed by the linker script
+extern uint32_t __StackTop;
+extern uint32_t __StackLimit;
+
+// Leaves a margin under the caller's frame for this function's own use
+void esl_stack_paint(void) {
+    uint32_t *sp = (uint32_t *)__get_MSP() - 16;
+    for (uint32_t *p = &__StackLimit; p < sp; p++) {
+        *p = ESL_STACK_PAINT;
+    }
+}
+
+uint32_t esl_stack_used_max(void) {
+    uint32_t const *p = &__StackLimit;
+    while (p < &__StackTop && *p == ESL_STACK_PAINT) {
+        p++;
+    }
+    return (uint32_t)&__StackTop - (uint32_t)p;
+}
+
+uint32_t esl_stack_size(void) {
+    return (uint32_t)&__StackTop - (uint32_t)&__StackLimit;
+}
@@ -0,0 +1,77 @@
+#include "esl_fmt.h"
+
+#include <string.h>
+
+static const char digit_pairs[200] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+// Filled from the end, then moved to the front
+uint8_t esl_fmt_u32_ascii(uint32_t value, char *buf) {
+    char tmp[ESL_FMT_U32_MAX];
+    char *p = tmp + sizeof(tmp);
+
+    while (value >= 100) {
+        uint32_t pair = (value % 100) * 2;
+        value /= 100;
+        *--p = digit_pairs[pair + 1];
+        *--p = digit_pairs[pair];
+    }
+    if (value >= 10) {
+        *--p = digit_pairs[value * 2 + 1];
+        *--p = digit_pairs[value * 2];
+    } else {
+        *--p = '0' + value;
+    }
+
+    uint8_t len = tmp + sizeof(tmp) - p;
+    memcpy(buf, p, len);
+    return len;
+}
+
+void esl_fmt_str(esl_txq_t *q, const char *str) {
+    esl_txq_msg_append(q, str, strlen(str));
+}
+
+void esl_fmt_lit(esl_txq_t *q, esl_fmt_lit_t const *lit) {
+    esl_txq_msg_append(q, lit->str, lit->len);
+}
+
+void esl_fmt_char(esl_txq_t *q, char c) {
+    esl_txq_msg_append(q, &c, 1);
+}
+
+void esl_fmt_u32(esl_txq_t *q, uint32_t value) {
+    char buf[ESL_FMT_U32_MAX];
+    esl_txq_msg_append(q, buf, esl_fmt_u32_ascii(value, buf));
+}
+
+void esl_fmt_i32(esl_txq_t *q, int32_t value) {
+    char buf[ESL_FMT_U32_MAX + 1];
+    uint8_t len = 0;
+
+    if (value < 0) {
+        buf[len++] = '-';
+    }
+    // Negated as unsigned so INT32_MIN works
+    len += esl_fmt_u32_ascii(value < 0 ? 0u - (uint32_t)value : (uint32_t)value, &buf[len]);
+    esl_txq_msg_append(q, buf, len);
+}
+
+void esl_fmt_hex32(esl_txq_t *q, uint32_t value) {
+    static const char hex[] = "0123456789abcdef";
+    char buf[10] = { '0', 'x' };
+
+    for (uint8_t i = 0; i < 8; i++) {
+        buf[9 - i] = hex[(value >> (4 * i)) & 0xF];
+    }
+    esl_txq_msg_append(q, buf, sizeof(buf));
+}
@@ -0,0 +1,32 @@
+#ifndef ESL_FMT_H
+#define ESL_FMT_H
+
+#include "esl_txq.h"
+#include <stdint.h>
+
+// Reply formatting without printf or a staging buffer: every piece goes
+// straight into the message being built in the output queue (see
+// esl_txq_msg_begin()). Numbers are converted two digits at a time.
+
+#define ESL_FMT_U32_MAX             (10)    // Digits in UINT32_MAX
+
+// Text known at compile time, length included
+typedef struct {
+    const char *str;
+    uint16_t len;
+} esl_fmt_lit_t;
+
+#define ESL_FMT_LIT(literal)        { (literal), sizeof(literal) - 1 }
+#define ESL_FMT_TEXT(q, literal)    esl_txq_msg_append((q), (literal), sizeof(literal) - 1)
+
+// Writes the digits without a terminator, returns how many
+uint8_t esl_fmt_u32_ascii(uint32_t value, char *buf);
+
+void esl_fmt_str(esl_txq_t *q, const char *str);
+void esl_fmt_lit(esl_txq_t *q, esl_fmt_lit_t const *lit);
+void esl_fmt_char(esl_txq_t *q, char c);
+void esl_fmt_u32(esl_txq_t *q, uint32_t value);
+void esl_fmt_i32(esl_txq_t *q, int32_t value);
+void esl_fmt_hex32(esl_txq_t *q, uint32_t value);      // 0x and 8 digits
+
+#endif // ESL_FMT_H
@@ -0,0 +1,92 @@
+#include "esl_frame.h"
+#include "crc16.h"
+
+#include <string.h>
+
+#define HDR_SIZE                    (2)
+#define CRC_SIZE                    (2)
+#define COBS_BLOCK_MAX              (0xFF)
+
+#if ESL_FRAME_RAW_MAX >= COBS_BLOCK_MAX - 1
+#error "Frames are assumed to fit in a single COBS block"
+#endif
+
+// Each zero is replaced by the distance to the next one
+static uint16_t cobs_encode(uint8_t const *in, uint16_t size, uint8_t *out) {
+    uint16_t code_idx = 0;
+    uint16_t out_idx = 1;
+    uint8_t code = 1;
+
+    for (uint16_t i = 0; i < size; i++) {
+        if (in[i] == 0) {
+            out[code_idx] = code;
+            code_idx = out_idx++;
+            code = 1;
+        } else {
+            out[out_idx++] = in[i];
+            code++;
+        }
+    }
+    out[code_idx] = code;
+    return out_idx;
+}
+
+static int32_t cobs_decode(uint8_t const *in, uint16_t size, uint8_t *out, uint16_t out_max) {
+    uint16_t in_idx = 0;
+    uint16_t out_idx = 0;
+
+    while (in_idx < size) {
+        uint8_t code = in[in_idx++];
+        if (code == 0 || in_idx + code - 1 > size || out_idx + code > out_max + 1) {
+            return -1;
+        }
+        memcpy(&out[out_idx], &in[in_idx], code - 1);
+        in_idx += code - 1;
+        out_idx += code - 1;
+        if (code != COBS_BLOCK_MAX && in_idx < size) {
+            if (out_idx == out_max) {
+                return -1;
+            }
+            out[out_idx++] = 0;
+        }
+    }
+    return out_idx;
+}
+
+uint16_t esl_frame_encode(esl_msg_t const *msg, uint8_t *out) {
+    uint8_t raw[ESL_FRAME_RAW_MAX];
+    uint8_t len = msg->len > ESL_FRAME_PAYLOAD_MAX ? ESL_FRAME_PAYLOAD_MAX : msg->len;
+
+    raw[0] = msg->type;
+    raw[1] = msg->seq;
+    memcpy(&raw[HDR_SIZE], msg->payload, len);
+    uint16_t crc = crc16_compute(raw, HDR_SIZE + len, NULL);
+    raw[HDR_SIZE + len] = crc & 0xFF;
+    raw[HDR_SIZE + len + 1] = crc >> 8;
+
+    out[0] = ESL_FRAME_DELIM;
+    out[1] = ESL_FRAME_DELIM;
+    uint16_t size = 2 + cobs_encode(raw, HDR_SIZE + len + CRC_SIZE, &out[2]);
+    out[size++] = ESL_FRAME_DELIM;
+    return size;
+}
+
+esl_ret_code_t esl_frame_decode(uint8_t const *data, uint16_t size, esl_msg_t *msg) {
+    uint8_t raw[ESL_FRAME_RAW_MAX];
+    int32_t raw_size = cobs_decode(data, size, raw, sizeof(raw));
+
+    if (raw_size < HDR_SIZE + CRC_SIZE) {
+        return ESL_ERR_FRAME_INVALID;
+    }
+    uint16_t len = raw_size - HDR_SIZE - CRC_SIZE;
+    uint16_t crc = raw[HDR_SIZE + len] | (raw[HDR_SIZE + len + 1] << 8);
+    if (crc16_compute(raw, HDR_SIZE + len, NULL) != crc) {
+        return ESL_ERR_FRAME_CRC;
+    }
+
+    msg->type = raw[0];
+    msg->seq = raw[1];
+    msg->len = len;
+    memcpy(msg->payload, &raw[HDR_SIZE], len);
+    return ESL_SUCCESS;
+}
@@ -0,0 +1,61 @@
+#ifndef ESL_FRAME_H
+#define ESL_FRAME_H
+
+#include "esl_utils.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Binary control protocol, sharing the CDC port with the text CLI. A message
+// is [type][seq][payload][crc16 LE], COBS encoded so it has no zero bytes,
+// and sent between two ESL_FRAME_DELIM bytes, which never occur in text or
+// JSON output. One more goes ahead of it: a receiver that took a stray zero
+// for the start of a frame closes that one there, and finds this frame all
+// the same, as a delimiter right after an opening one opens the frame
+// again. Replies carry the request type with ESL_MSG_REPLY set, the
+// same seq, and an esl_msg_status_t as the first payload byte.
+// CBOR output does have zero bytes, and a frame in it would break up the
+// CBOR. While the CLI is in CBOR mode the port is CBOR only: requests are
+// dropped without a reply (stats counts them), switch the CLI back to text
+// or JSON to use both.
+
+#define ESL_FRAME_DELIM             (0x00)
+#define ESL_FRAME_PAYLOAD_MAX       (40)
+#define ESL_FRAME_RAW_MAX           (2 + ESL_FRAME_PAYLOAD_MAX + 2)
+#define ESL_FRAME_ENCODED_MAX       (ESL_FRAME_RAW_MAX + 1)         // Between the delimiters
+#define ESL_FRAME_WIRE_MAX          (ESL_FRAME_ENCODED_MAX + 3)
+
+typedef enum {
+    ESL_MSG_SET_RGB     = 0x01,     // r, g, b
+    ESL_MSG_SET_HSV     = 0x02,     // hue (LE16), saturation, brightness
+    ESL_MSG_SAVE        = 0x03,     // Store the current color now
+    ESL_MSG_APPLY       = 0x04,     // Saved color name, not terminated
+    ESL_MSG_QUERY       = 0x05,     // Reply: r, g, b, hue (LE16), saturation, brightness
+    ESL_MSG_STREAM_START = 0x06,    // Optional delay ms (LE16)
+    ESL_MSG_STREAM_FRAME = 0x07,    // Timestamp ms (LE32), r, g, b. No reply.
+    ESL_MSG_STREAM_STOP = 0x08,     // Reply: frames, applied, underruns, overruns (LE32 each)
+    ESL_MSG_REPLY       = 0x80,
+} esl_msg_type_t;
+
+typedef enum {
+    ESL_MSG_OK              = 0,
+    ESL_MSG_ERR_LENGTH      = 1,
+    ESL_MSG_ERR_VALUE       = 2,
+    ESL_MSG_ERR_NOT_FOUND   = 3,
+    ESL_MSG_ERR_UNKNOWN     = 4,    // Type not supported
+    ESL_MSG_ERR_FAILED      = 5,
+} esl_msg_status_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t seq;
+    uint8_t len;
+    uint8_t payload[ESL_FRAME_PAYLOAD_MAX];
+} esl_msg_t;
+
+// Writes the frame with its delimiters, at most ESL_FRAME_WIRE_MAX bytes.
+// Returns its size.
+uint16_t esl_frame_encode(esl_msg_t const *msg, uint8_t *out);
+// Decodes what was received between two delimiters
+esl_ret_code_t esl_frame_decode(uint8_t const *data, uint16_t size, esl_msg_t *msg);
+
+#endif // ESL_FRAME_H
@@ -0,0 +1,128 @@
+#include "esl_input.h"
+#include "nrfx_gpiote.h"
+
+typedef struct {
+    uint32_t pin;
+    bool active_low;
+    bool pressed;
+} esl_input_button_t;
+
+typedef struct {
+    uint32_t pin_a;
+    uint32_t pin_b;
+    uint8_t prev_state;     // Last sampled (A << 1) | B
+    int8_t accum;           // Quarter steps accumulated towards a detent
+} esl_input_encoder_t;
+
+// Quadrature decoding table indexed by (prev_state << 2) | new_state.
+// Invalid transitions (both lines changed at once) count as 0.
+static const int8_t enc_state_table[16] = {
+     0, -1,  1,  0,
+     1,  0,  0, -1,
+    -1,  0,  0,  1,
+     0,  1, -1,  0
+};
+
+static esl_input_button_t buttons[ESL_INPUT_MAX_BUTTONS];
+static uint8_t buttons_count = 0;
+static esl_input_encoder_t encoders[ESL_INPUT_MAX_ENCODERS];
+static uint8_t encoders_count = 0;
+static esl_input_evt_handler_t evt_handler = NULL;
+
+static inline uint32_t pin_level(const uint32_t *ports, uint32_t pin) {
+    return (ports[pin >> 5] >> (pin & 0x1F)) & 1;
+}
+
+static void emit(esl_input_evt_type_t type, uint8_t id, int8_t direction) {
+    if (evt_handler) {
+        esl_input_evt_t evt = { .type = type, .id = id, .direction = direction };
+        evt_handler(&evt);
+    }
+}
+
+// Called by the GPIOTE driver from the PORT event for every toggled pin.
+// Both ports are sampled once, so subsequent calls for the same event find
+// no further changes and return quickly.
+static void port_event_handler(nrfx_gpiote_pin_t pin, nrf_gpiote_polarity_t action) {
+    uint32_t ports[2] = {
+        nrf_gpio_port_in_read(NRF_P0),
+        nrf_gpio_port_in_read(NRF_P1)
+    };
+
+    for (uint8_t i = 0; i < buttons_count; i++) {
+        esl_input_button_t *btn = &buttons[i];
+        bool pressed = pin_level(ports, btn->pin) != btn->active_low;
+        if (pressed != btn->pressed) {
+            btn->pressed = pressed;
+            emit(pressed ? ESL_INPUT_EVT_BTN_PRESSED : ESL_INPUT_EVT_BTN_RELEASED, i, 0);
+        }
+    }
+
+    for (uint8_t i = 0; i < encoders_count; i++) {
+        esl_input_encoder_t *enc = &encoders[i];
+        uint8_t state = (pin_level(ports, enc->pin_a) << 1) | pin_level(ports, enc->pin_b);
+        if (state == enc->prev_state) {
+            continue;
+        }
+        enc->accum += enc_state_table[(enc->prev_state << 2) | state];
+        enc->prev_state = state;
+
+        if (enc->accum >= ESL_INPUT_ENC_STEPS_PER_DETENT) {
+            enc->accum = 0;
+            emit(ESL_INPUT_EVT_ENC_STEP, i, 1);
+        } else if (enc->accum <= -ESL_INPUT_ENC_STEPS_PER_DETENT) {
+            enc->accum = 0;
+            emit(ESL_INPUT_EVT_ENC_STEP, i, -1);
+        }
+    }
+}
+
+static bool sense_pin_init(uint32_t pin, nrf_gpio_pin_pull_t pull) {
+    // hi_accuracy = false selects the PORT event instead of an IN channel
+    nrfx_gpiote_in_config_t in_config = NRFX_GPIOTE_CONFIG_IN_SENSE_TOGGLE(false);
+    in_config.pull = pull;
+    if (nrfx_gpiote_in_init(pin, &in_config, port_event_handler) != NRFX_SUCCESS) {
+        return false;
+    }
+    nrfx_gpiote_in_event_enable(pin, true);
+    return true;
+}
+
+void esl_input_init(esl_input_evt_handler_t handler) {
+    if (!nrfx_gpiote_is_init()) {
+        nrfx_gpiote_init();
+    }
+    evt_handler = handler;
+}
+
+int8_t esl_input_button_add(uint32_t pin, nrf_gpio_pin_pull_t pull, bool active_low) {
+    if (buttons_count >= ESL_INPUT_MAX_BUTTONS || !sense_pin_init(pin, pull)) {
+        return -1;
+    }
+
+    esl_input_button_t *btn = &buttons[buttons_count];
+    btn->pin = pin;
+    btn->active_low = active_low;
+    btn->pressed = nrf_gpio_pin_read(pin) != active_low;
+    return buttons_count++;
+}
+
+int8_t esl_input_encoder_add(uint32_t pin_a, uint32_t pin_b, nrf_gpio_pin_pull_t pull) {
+    if (encoders_count >= ESL_INPUT_MAX_ENCODERS) {
+        return -1;
+    }
+    if (!sense_pin_init(pin_a, pull) || !sense_pin_init(pin_b, pull)) {
+        return -1;
+    }
+
+    esl_input_encoder_t *enc = &encoders[encoders_count];
+    enc->pin_a = pin_a;
+    enc->pin_b = pin_b;
+    enc->prev_state = (nrf_gpio_pin_read(pin_a) << 1) | nrf_gpio_pin_read(pin_b);
+    enc->accum = 0;
+    return encoders_count++;
+}
+
+bool esl_input_button_is_pressed(uint8_t btn_id) {
+    return btn_id < buttons_count && buttons[btn_id].pressed;
+}
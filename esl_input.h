@@ -0,0 +1,30 @@
+#ifndef ESL_INPUT_H
+#define ESL_INPUT_H
+
+#include "nrf_gpio.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Input layer built on the GPIOTE PORT event (SENSE mechanism). All buttons
+// and encoders share a single interrupt and no GPIOTE channel is consumed.
+
+typedef enum {
+    ESL_INPUT_EVT_BTN_PRESSED   = 0,
+    ESL_INPUT_EVT_BTN_RELEASED  = 1,
+    ESL_INPUT_EVT_ENC_STEP      = 2,
+} esl_input_evt_type_t;
+
+typedef struct {
+    esl_input_evt_type_t type;
+    uint8_t id;             // Button or encoder id returned by *_add()
+    int8_t direction;       // Encoder only: +1 clockwise, -1 counter-clockwise
+} esl_input_evt_t;
+
+typedef void (*esl_input_evt_handler_t)(esl_input_evt_t const *evt);
+
+void esl_input_init(esl_input_evt_handler_t handler);
+int8_t esl_input_button_add(uint32_t pin, nrf_gpio_pin_pull_t pull, bool active_low);   // Returns id or -1
+int8_t esl_input_encoder_add(uint32_t pin_a, uint32_t pin_b, nrf_gpio_pin_pull_t pull); // Returns id or -1
+bool esl_input_button_is_pressed(uint8_t btn_id);
+
+#endif // ESL_INPUT_H
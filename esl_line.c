@@ -0,0 +1,139 @@
+#include "esl_line.h"
+
+#include <string.h>
+
+#define RING_MASK                   (ESL_RX_RING_SIZE - 1)
+
+#if (ESL_RX_RING_SIZE & RING_MASK) != 0
+#error "ESL_RX_RING_SIZE must be a power of two"
+#endif
+
+typedef enum {
+    SCAN_TEXT,
+    SCAN_LINE_END,
+    SCAN_SKIP,                  // Second half of "\r\n"
+    SCAN_FRAME,                 // Byte belongs to a frame, delimiters included
+    SCAN_FRAME_END,
+} scan_result_t;
+
+// Sorts one received byte, the same way for echo and for assembly
+static scan_result_t scan_byte(esl_line_scan_t *scan, uint8_t c) {
+    bool after_cr = scan->last_cr;
+    scan->last_cr = false;
+
+    if (c == ESL_FRAME_DELIM) {
+        if (scan->in_frame && scan->frame_len > 0) {
+            scan->in_frame = false;
+            return SCAN_FRAME_END;
+        }
+        scan->in_frame = true;
+        scan->frame_len = 0;
+        return SCAN_FRAME;
+    }
+    if (scan->in_frame) {
+        if (scan->frame_len < UINT16_MAX) {
+            scan->frame_len++;
+        }
+        return SCAN_FRAME;
+    }
+
+    scan->last_cr = c == '\r';
+    if (c == '\n' && after_cr) {
+        return SCAN_SKIP;
+    }
+    return (c == '\r' || c == '\n') ? SCAN_LINE_END : SCAN_TEXT;
+}
+
+void esl_line_init(esl_line_t *lb) {
+    lb->head = 0;
+    lb->tail = 0;
+    lb->line_len = 0;
+    lb->too_long = false;
+    memset(&lb->scan, 0, sizeof(lb->scan));
+    memset(&lb->echo_scan, 0, sizeof(lb->echo_scan));
+    lb->frames_dropped = 0;
+}
+
+uint16_t esl_line_free(esl_line_t const *lb) {
+    return ESL_RX_RING_SIZE - (uint16_t)(lb->head - lb->tail);
+}
+
+uint16_t esl_line_push(esl_line_t *lb, void const *data, uint16_t size) {
+    uint16_t free = esl_line_free(lb);
+    if (size > free) {
+        size = free;
+    }
+
+    // At most two copies, before and after the wrap
+    uint16_t start = lb->head & RING_MASK;
+    uint16_t first = ESL_RX_RING_SIZE - start < size ? ESL_RX_RING_SIZE - start : size;
+    memcpy(&lb->ring[start], data, first);
+    memcpy(lb->ring, (uint8_t const *)data + first, size - first);
+    lb->head += size;
+    return size;
+}
+
+uint16_t esl_line_echo(esl_line_t *lb, void const *data, uint16_t size, char *echo) {
+    uint8_t const *bytes = data;
+    uint16_t echo_len = 0;
+
+    for (uint16_t i = 0; i < size; i++) {
+        switch (scan_byte(&lb->echo_scan, bytes[i])) {
+        case SCAN_TEXT:
+            echo[echo_len++] = bytes[i];
+            break;
+        case SCAN_LINE_END:
+            echo[echo_len++] = '\r';
+            echo[echo_len++] = '\n';
+            break;
+        default:
+            break;
+        }
+    }
+    return echo_len;
+}
+
+esl_line_result_t esl_line_get(esl_line_t *lb, void **data, uint16_t *size) {
+    while (lb->tail != lb->head) {
+        uint8_t c = lb->ring[lb->tail++ & RING_MASK];
+
+        switch (scan_byte(&lb->scan, c)) {
+        case SCAN_TEXT:
+            if (lb->line_len < sizeof(lb->line) - 1) {
+                lb->line[lb->line_len++] = c;
+            } else {
+                lb->too_long = true;
+            }
+            break;
+
+        case SCAN_LINE_END: {
+            bool too_long = lb->too_long;
+            lb->line[lb->line_len] = '\0';
+            *data = lb->line;
+            *size = lb->line_len;
+            lb->line_len = 0;
+            lb->too_long = false;
+            return too_long ? ESL_LINE_TOO_LONG : ESL_LINE_READY;
+        }
+
+        case SCAN_FRAME:
+            if (c != ESL_FRAME_DELIM && lb->scan.frame_len <= sizeof(lb->frame)) {
+                lb->frame[lb->scan.frame_len - 1] = c;
+            }
+            break;
+
+        case SCAN_SKIP:
+            break;
+
+        case SCAN_FRAME_END:
+            if (lb->scan.frame_len > sizeof(lb->frame)) {
+                lb->frames_dropped++;
+                break;
+            }
+            *data = lb->frame;
+            *size = lb->scan.frame_len;
+            return ESL_LINE_FRAME;
+        }
+    }
+    return ESL_LINE_NONE;
+}
@@ -0,0 +1,51 @@
+#ifndef ESL_LINE_H
+#define ESL_LINE_H
+
+#include "sdk_config.h"
+#include "esl_frame.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Command line assembler. Received packets are pushed into a byte ring in
+// one go; lines are taken out later, one at a time, from thread context.
+// "\r", "\n" and "\r\n" all end a line. Binary frames between two
+// ESL_FRAME_DELIM bytes are split out of the text; a delimiter right after
+// an opening one opens the frame again, so stray delimiters can't leave the
+// two sides out of step.
+
+typedef enum {
+    ESL_LINE_NONE       = 0,    // No complete line yet
+    ESL_LINE_READY      = 1,
+    ESL_LINE_TOO_LONG   = 2,    // Line didn't fit and was dropped
+    ESL_LINE_FRAME      = 3,    // Encoded frame, without delimiters
+} esl_line_result_t;
+
+typedef struct {
+    bool in_frame;
+    uint16_t frame_len;
+    bool last_cr;               // Skip a "\n" right after "\r"
+} esl_line_scan_t;
+
+typedef struct {
+    uint8_t ring[ESL_RX_RING_SIZE];
+    uint16_t head;              // Next byte to push
+    uint16_t tail;              // Next byte to assemble
+    char line[ESL_CLI_LINE_SIZE];
+    uint16_t line_len;
+    bool too_long;              // Dropping the rest of the current line
+    uint8_t frame[ESL_FRAME_ENCODED_MAX];
+    esl_line_scan_t scan;       // Where assembly is at
+    esl_line_scan_t echo_scan;  // Where echo is at, ahead of assembly
+    uint32_t frames_dropped;    // Frames too long for the buffer
+} esl_line_t;
+
+void esl_line_init(esl_line_t *lb);
+uint16_t esl_line_free(esl_line_t const *lb);
+uint16_t esl_line_push(esl_line_t *lb, void const *data, uint16_t size);   // Returns bytes taken
+// Terminal echo of received data, frames left out and line ends as "\r\n".
+// echo needs room for 2 * size bytes. Returns the echo size.
+uint16_t esl_line_echo(esl_line_t *lb, void const *data, uint16_t size, char *echo);
+// The line or frame stays valid until the next call, and may be modified
+esl_line_result_t esl_line_get(esl_line_t *lb, void **data, uint16_t *size);
+
+#endif // ESL_LINE_H
@@ -0,0 +1,321 @@
+#include "esl_macro.h"
+#include "esl_nvmc.h"
+#include "nrf_log.h"
+
+#include <string.h>
+
+#define WORD_ERASED                 (0xFFFFFFFF)
+#define BODY_MAX                    (ESL_MACRO_NAME_LEN - 1 + ESL_MACRO_TEXT_LEN - 1)
+#define BODY_WORDS(size)            (((size) + sizeof(uint32_t) - 1) / sizeof(uint32_t))
+// Flash jobs carry a few words each, longer bodies go out in several
+#define WRITE_CHUNK_WORDS           (8)
+
+// Written once the name and text that follow it are in flash. The state is
+// in the last word, so a committed header always has its lengths; deleting
+// clears the state in place. Anything other than an erased or valid state
+// is a delete that was cut short.
+typedef struct {
+    uint8_t name_len;
+    uint8_t text_len;
+    uint16_t reserved;
+    uint8_t state;              // ESL_NVMC_BYTE_VALID or ESL_NVMC_BYTE_DELETED
+    uint8_t reserved2[3];
+} macro_hdr_t;
+
+static uint32_t macros[ESL_MACRO_MAX];     // Header addresses, oldest first
+static uint8_t macros_count = 0;
+static uint32_t free_addr;
+static uint8_t macros_pending = 0;          // Adds and deletes still queued
+static uint32_t last_queued = 0;            // Newest record queued
+static esl_macro_stats_t macro_stats;
+
+static uint32_t word_at(uint32_t addr) {
+    return *(const uint32_t *)addr;
+}
+
+static macro_hdr_t const *hdr_at(uint32_t addr) {
+    return (macro_hdr_t const *)addr;
+}
+
+static const char *name_at(uint32_t addr) {
+    return (const char *)(addr + sizeof(macro_hdr_t));
+}
+
+static uint32_t record_size(macro_hdr_t const *hdr) {
+    return sizeof(*hdr) + BODY_WORDS(hdr->name_len + hdr->text_len) * sizeof(uint32_t);
+}
+
+static int8_t index_find(const char *name) {
+    size_t len = strlen(name);
+
+    for (uint8_t i = 0; i < macros_count; i++) {
+        if (hdr_at(macros[i])->name_len == len && memcmp(name_at(macros[i]), name, len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void index_remove(uint8_t idx) {
+    memmove(&macros[idx], &macros[idx + 1], (macros_count - idx - 1) * sizeof(macros[0]));
+    macros_count--;
+}
+
+// Only the state word is written again
+static esl_ret_code_t tombstone(uint32_t addr, esl_nvmc_done_handler_t handler) {
+    macro_hdr_t hdr = *hdr_at(addr);
+    hdr.state = ESL_NVMC_BYTE_DELETED;
+    return esl_nvmc_write(addr + offsetof(macro_hdr_t, state), &hdr.state,
+                          sizeof(hdr) - offsetof(macro_hdr_t, state), handler, (void *)(uintptr_t)addr);
+}
+
+static int8_t index_find_at(uint32_t addr) {
+    char name[ESL_MACRO_NAME_LEN];
+    memcpy(name, name_at(addr), hdr_at(addr)->name_len);
+    name[hdr_at(addr)->name_len] = '\0';
+    return index_find(name);
+}
+
+// A macro is only indexed once its header is in flash, as name and text are
+// read from there. The new copy is committed before the old one goes; if
+// the delete doesn't make it, boot keeps the newer copy anyway.
+static void macro_committed(esl_ret_code_t result, void *p_context) {
+    uint32_t addr = (uint32_t)(uintptr_t)p_context;
+
+    macros_pending--;
+    if (result != ESL_SUCCESS) {
+        macro_stats.failed++;
+        // Boot skips the record up to the erased word after it. Records
+        // queued behind it can't keep that word free.
+        if (addr == last_queued) {
+            free_addr += sizeof(uint32_t);
+        }
+        return;
+    }
+
+    int8_t old = index_find_at(addr);
+    if (old >= 0) {
+        tombstone(macros[old], NULL);
+        index_remove(old);
+    }
+    macros[macros_count++] = addr;
+}
+
+// A delete that didn't make it to flash puts the macro back
+static void macro_deleted(esl_ret_code_t result, void *p_context) {
+    uint32_t addr = (uint32_t)(uintptr_t)p_context;
+
+    macros_pending--;
+    if (result != ESL_SUCCESS) {
+        macro_stats.failed++;
+        if (index_find_at(addr) < 0 && macros_count < ESL_MACRO_MAX) {
+            macros[macros_count++] = addr;
+        }
+    }
+}
+
+// Bytes that could read as erased flash or break the terminal are refused
+static bool is_printable(const char *str) {
+    for (; *str != '\0'; str++) {
+        if (*str < ' ' || *str > '~') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Macros are stored back to back like clips. Name and text never read as
+// an erased word, so a record whose header is missing runs up to the next
+// erased word and the next record starts one word after it. When a name
+// shows up twice, a replace was cut short and the newer copy wins.
+void esl_macro_init(void) {
+    macros_count = 0;
+    macros_pending = 0;
+    last_queued = 0;
+    memset(&macro_stats, 0, sizeof(macro_stats));
+
+    uint32_t addr = MACROS_START_ADDR;
+    while (addr + sizeof(macro_hdr_t) <= MACROS_END_ADDR) {
+        macro_hdr_t const *hdr = hdr_at(addr);
+
+        if (hdr->state == ESL_NVMC_BYTE_NOT_INIT) {
+            uint32_t end = addr + sizeof(*hdr);
+            while (end < MACROS_END_ADDR && word_at(end) != WORD_ERASED) {
+                end += sizeof(uint32_t);
+            }
+            if (end == addr + sizeof(*hdr) && word_at(addr) == WORD_ERASED) {
+                break;
+            }
+            NRF_LOG_WARNING("Macros: skipping unfinished record at 0x%x", addr);
+            macro_stats.torn++;
+            addr = end + sizeof(uint32_t);
+            continue;
+        }
+
+        if (hdr->name_len == 0 || hdr->name_len >= ESL_MACRO_NAME_LEN ||
+            hdr->text_len == 0 || hdr->text_len >= ESL_MACRO_TEXT_LEN ||
+            addr + record_size(hdr) > MACROS_END_ADDR) {
+            NRF_LOG_WARNING("Macros: unreadable record at 0x%x", addr);
+            addr = MACROS_END_ADDR;
+            break;
+        }
+
+        if (hdr->state == ESL_NVMC_BYTE_VALID) {
+            char name[ESL_MACRO_NAME_LEN];
+            memcpy(name, name_at(addr), hdr->name_len);
+            name[hdr->name_len] = '\0';
+
+            int8_t old = index_find(name);
+            if (old >= 0) {
+                index_remove(old);
+            }
+            if (macros_count < ESL_MACRO_MAX) {
+                macros[macros_count++] = addr;
+            }
+        }
+        addr += record_size(hdr);
+    }
+    if (addr > MACROS_END_ADDR) {
+        addr = MACROS_END_ADDR;
+    }
+    free_addr = addr;
+    NRF_LOG_INFO("Macros: %d found, %d bytes free", macros_count, MACROS_END_ADDR - free_addr);
+}
+
+esl_ret_code_t esl_macro_add(const char *name, const char *text) {
+    size_t name_len = strlen(name);
+    size_t text_len = strlen(text);
+
+    if (name_len == 0 || name_len >= ESL_MACRO_NAME_LEN || text_len == 0 || text_len >= ESL_MACRO_TEXT_LEN) {
+        return ESL_ERR_CLI_ARG_LENGTH;
+    }
+    if (!is_printable(name) || !is_printable(text)) {
+        return ESL_ERR_CLI_VALUE_ERROR;
+    }
+
+    int8_t old = index_find(name);
+    uint32_t body_words = BODY_WORDS(name_len + text_len);
+    uint32_t addr = free_addr;
+    if ((old < 0 && macros_count + macros_pending >= ESL_MACRO_MAX) ||
+        addr + sizeof(macro_hdr_t) + body_words * sizeof(uint32_t) > MACROS_END_ADDR) {
+        return ESL_ERR_NVMC_MEMORY_FULL;
+    }
+    // The body chunks and the header go in together
+    if (esl_nvmc_jobs_free() < (body_words + WRITE_CHUNK_WORDS - 1) / WRITE_CHUNK_WORDS + 1) {
+        return ESL_ERR_BUSY;
+    }
+
+    union {
+        char bytes[BODY_MAX];
+        uint32_t words[BODY_WORDS(BODY_MAX)];
+    } body;
+    memset(&body, 0xFF, sizeof(body));
+    memcpy(body.bytes, name, name_len);
+    memcpy(body.bytes + name_len, text, text_len);
+
+    uint32_t body_addr = addr + sizeof(macro_hdr_t);
+    for (uint32_t word = 0; word < body_words; word += WRITE_CHUNK_WORDS) {
+        uint32_t words = body_words - word < WRITE_CHUNK_WORDS ? body_words - word : WRITE_CHUNK_WORDS;
+        uint32_t chunk_addr = body_addr + word * sizeof(uint32_t);
+        size_t size = words * sizeof(uint32_t);
+        esl_ret_code_t res = word == 0 ? esl_nvmc_write(chunk_addr, &body.words[word], size, NULL, NULL)
+                                       : esl_nvmc_write_chained(chunk_addr, &body.words[word], size, NULL, NULL);
+        if (res != ESL_SUCCESS) {
+            // What made it in is skipped at boot up to the erased word after it
+            if (word > 0) {
+                free_addr = body_addr + (word + 1) * sizeof(uint32_t);
+            }
+            return res;
+        }
+    }
+
+    macro_hdr_t hdr = {
+        .name_len = name_len,
+        .text_len = text_len,
+        .reserved = 0xFFFF,
+        .state = ESL_NVMC_BYTE_VALID,
+        .reserved2 = { 0xFF, 0xFF, 0xFF }
+    };
+    esl_ret_code_t res = esl_nvmc_write_chained(addr, &hdr, sizeof(hdr), macro_committed, (void *)(uintptr_t)addr);
+    free_addr = body_addr + body_words * sizeof(uint32_t);
+    if (res != ESL_SUCCESS) {
+        free_addr += sizeof(uint32_t);
+        return res;
+    }
+    macros_pending++;
+    last_queued = addr;
+    return ESL_SUCCESS;
+}
+
+esl_ret_code_t esl_macro_find(const char *name, char *text, size_t size) {
+    int8_t idx = index_find(name);
+    if (idx < 0) {
+        return ESL_ERR_NVMC_NOT_FOUND;
+    }
+
+    macro_hdr_t const *hdr = hdr_at(macros[idx]);
+    if (hdr->text_len >= size) {
+        return ESL_ERROR;
+    }
+    memcpy(text, name_at(macros[idx]) + hdr->name_len, hdr->text_len);
+    text[hdr->text_len] = '\0';
+    return ESL_SUCCESS;
+}
+
+esl_ret_code_t esl_macro_delete(const char *name) {
+    int8_t idx = index_find(name);
+    if (idx < 0) {
+        return ESL_ERR_NVMC_NOT_FOUND;
+    }
+
+    esl_ret_code_t res = tombstone(macros[idx], macro_deleted);
+    if (res != ESL_SUCCESS) {
+        return res;
+    }
+    macros_pending++;
+    index_remove(idx);
+    return ESL_SUCCESS;
+}
+
+// Waits for queued adds and deletes, their handlers would index erased records
+esl_ret_code_t esl_macro_erase_all(void) {
+    if (macros_pending > 0) {
+        return ESL_ERR_BUSY;
+    }
+    esl_ret_code_t res = esl_nvmc_erase_pages(MACROS_START_ADDR, ESL_MACRO_PAGES, NULL, NULL);
+    if (res != ESL_SUCCESS) {
+        return res;
+    }
+    macros_count = 0;
+    free_addr = MACROS_START_ADDR;
+    return ESL_SUCCESS;
+}
+
+uint8_t esl_macro_count(void) {
+    return macros_count;
+}
+
+bool esl_macro_get(uint8_t idx, char *name, size_t name_size, char *text, size_t text_size) {
+    if (idx >= macros_count) {
+        return false;
+    }
+
+    macro_hdr_t const *hdr = hdr_at(macros[idx]);
+    if (hdr->name_len >= name_size || hdr->text_len >= text_size) {
+        return false;
+    }
+    memcpy(name, name_at(macros[idx]), hdr->name_len);
+    name[hdr->name_len] = '\0';
+    memcpy(text, name_at(macros[idx]) + hdr->name_len, hdr->text_len);
+    text[hdr->text_len] = '\0';
+    return true;
+}
+
+void esl_macro_stats_get(esl_macro_stats_t *stats) {
+    *stats = macro_stats;
+    stats->bytes_used = 0;
+    for (uint8_t i = 0; i < macros_count; i++) {
+        stats->bytes_used += record_size(hdr_at(macros[i]));
+    }
+    stats->bytes_free = MACROS_END_ADDR - free_addr;
+}
@@ -0,0 +1,37 @@
+#ifndef ESL_MACRO_H
+#define ESL_MACRO_H
+
+#include "esl_utils.h"
+#include "sdk_config.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Named command lines kept in flash, run by the firmware as one batch.
+// Records are appended; replacing or deleting a macro marks the old record
+// deleted, the space only comes back with esl_macro_erase_all().
+
+typedef struct {
+    uint32_t torn;              // Unfinished records skipped at boot
+    uint32_t failed;            // Adds and deletes whose flash write failed
+    uint32_t bytes_used;        // Flash taken by live macros
+    uint32_t bytes_free;
+} esl_macro_stats_t;
+
+void esl_macro_init(void);      // Call after esl_nvmc_init()
+
+// Name and text are printable ASCII. Replaces a macro of the same name once
+// its flash writes have run from esl_nvmc_process().
+// Errors: ESL_ERR_CLI_ARG_LENGTH, ESL_ERR_CLI_VALUE_ERROR, ESL_ERR_NVMC_MEMORY_FULL,
+// ESL_ERR_BUSY with the flash queue full.
+esl_ret_code_t esl_macro_add(const char *name, const char *text);
+// Copies the text out with its terminator, so it can be parsed in place
+esl_ret_code_t esl_macro_find(const char *name, char *text, size_t size);
+esl_ret_code_t esl_macro_delete(const char *name);
+esl_ret_code_t esl_macro_erase_all(void);
+uint8_t esl_macro_count(void);
+bool esl_macro_get(uint8_t idx, char *name, size_t name_size, char *text, size_t text_size);
+
+void esl_macro_stats_get(esl_macro_stats_t *stats);
+
+#endif // ESL_MACRO_H
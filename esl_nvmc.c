@@ -0,0 +1,1606 @@
+#include "esl_nvmc.h"
+#include "nrfx_nvmc.h"
+#include "nrf_log.h"
+#include "crc16.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#if ESL_NVMC_COLOR_PAGES < 2 || ESL_NVMC_COLOR_PAGES > 64
+#error "ESL_NVMC_COLOR_PAGES must be between 2 and 64"
+#endif
+
+#define LOG_WORDS                   (PAGE_SIZE / sizeof(uint32_t))
+#define PAGE_WORDS                  (PAGE_SIZE / sizeof(uint32_t))
+#define WORD_ERASED                 (0xFFFFFFFF)
+#define RECORD_VERSION              (2)
+#define RECORD_V1_VERSION           (1)
+#define RECORD_V1_SLOTS             ((PAGE_WORDS - PAGE_HDR_WORDS) * sizeof(uint32_t) / sizeof(color_record_v1_t))
+#define PAGE_HDR_WORDS              (2)
+#define RECORD_FIXED_SIZE           (offsetof(color_record_t, name))
+#define RECORD_WORDS(name_len)      ((RECORD_FIXED_SIZE + (name_len) + sizeof(uint32_t) - 1) / sizeof(uint32_t))
+#define RECORD_MAX_WORDS            RECORD_WORDS(ESL_NVMC_COLOR_NAME_LEN - 1)
+#define PAGE_RECORDS_MAX            ((PAGE_WORDS - PAGE_HDR_WORDS) / RECORD_WORDS(1))
+#define BITMAP_WORDS                ((PAGE_RECORDS_MAX + 31) / 32)
+#define SUMMARY_ENTRIES             (PAGE_SIZE / sizeof(summary_entry_t))
+// One page always stays erased for compaction. Keeping a record's worth of
+// room per page means the emptiest page always frees enough for one more.
+#define COLORS_WORDS_MAX            ((ESL_NVMC_COLOR_PAGES - 1) * (PAGE_WORDS - PAGE_HDR_WORDS - RECORD_MAX_WORDS))
+// The index is kept at most 3/4 full so probe sequences stay short
+#define COLORS_INDEX_CAPACITY       (ESL_NVMC_INDEX_SIZE * 3 / 4)
+// Index entries are word offsets from COLORS_START_ADDR. Records never
+// start at the first or last word of a page, so 0 and 0xFFFF are free.
+#define INDEX_EMPTY                 (0x0000)
+#define INDEX_DELETED               (0xFFFF)
+#define LOC(page, off)              ((uint16_t)((page) * PAGE_WORDS + (off)))
+#define LOC_PAGE(loc)               ((loc) / PAGE_WORDS)
+#define LOC_NONE                    INDEX_EMPTY
+#define JOB_MAX_WORDS               (sizeof(summary_entry_t) / sizeof(uint32_t))
+// Jobs a color operation queues at most: a page header, the body and header
+// of a record, and the tombstone of the record it replaces
+#define COLOR_OP_JOBS               (4)
+// Background color work only runs while this many more jobs are free
+#define WORK_STEP_JOBS              (2)
+
+#if ESL_NVMC_JOB_QUEUE_SIZE < COLOR_OP_JOBS + WORK_STEP_JOBS + 1
+#error "ESL_NVMC_JOB_QUEUE_SIZE is too small for a color operation and background work"
+#endif
+
+// Saved color record as laid out in flash, sized to the name and padded to
+// whole words. The body is written first and the header last, so a record
+// only counts once its header is in place and the CRC matches. Tombstoning
+// rewrites the header with state cleared.
+typedef struct {
+    uint8_t state;              // ESL_NVMC_BYTE_VALID or ESL_NVMC_BYTE_DELETED
+    uint8_t version;
+    uint16_t crc;               // CRC16 over the body
+} color_record_hdr_t;
+
+typedef struct {
+    color_record_hdr_t hdr;
+    uint16_t seq;               // Bumped when a name is replaced, newest copy wins after a power cut
+    uint8_t name_len;           // Also needed to find the next record when the header is missing
+    uint8_t rgb[3];
+    char name[ESL_NVMC_COLOR_NAME_LEN - 1];     // name_len bytes, not terminated
+} color_record_t;
+
+// Records are built in RAM with the padding erased
+typedef union {
+    color_record_t record;
+    uint32_t words[RECORD_MAX_WORDS];
+} color_record_buf_t;
+
+// Record of the previous format, in fixed size slots after the page header:
+// the whole esl_nvmc_saved_color_t and a sequence number over all records.
+// Pages holding these are converted at boot.
+typedef struct {
+    color_record_hdr_t hdr;
+    uint32_t seq;
+    esl_nvmc_saved_color_t color;
+} color_record_v1_t;
+
+typedef enum {
+    RECORD_FREE,
+    RECORD_LIVE,
+    RECORD_DELETED,
+    RECORD_TORN                 // Uncommitted or corrupted, skipped until compaction
+} record_state_t;
+
+// Written to the summary page when a color page is sealed, so boot can index
+// the page without checking every record in it
+typedef struct {
+    uint16_t crc;               // CRC16 over the rest of the entry
+    uint8_t page;
+    uint8_t reserved;
+    uint32_t seq;               // Page sequence the entry describes
+    uint32_t used;              // Words written, including tombstones and torn records
+    uint32_t committed[BITMAP_WORDS];   // Committed records, by position in the page
+} summary_entry_t;
+
+typedef struct {
+    uint32_t seq;               // WORD_ERASED while the page is free
+    uint16_t used;              // Words written, including the page header
+    uint16_t live;              // Words of live records
+    bool summarized;
+} colors_page_t;
+
+typedef enum {
+    NVMC_JOB_WRITE,
+    NVMC_JOB_ERASE
+} nvmc_job_type_t;
+
+typedef struct {
+    nvmc_job_type_t type;
+    bool chained;               // Skipped if the job before it failed
+    uint32_t addr;
+    uint32_t words;             // Words to write, or pages to erase
+    uint32_t done;              // Words written or pages erased so far
+    uint32_t data[JOB_MAX_WORDS];
+    esl_nvmc_done_handler_t handler;
+    void *p_context;
+} nvmc_job_t;
+
+// RAM side of a queued record write or tombstone. The index is updated when
+// the jobs are queued; record_committed() puts it back if they fail.
+typedef struct {
+    bool used;
+    uint16_t loc;               // Record written, LOC_NONE for a delete
+    uint16_t old_loc;           // Record it replaces or deletes, LOC_NONE if none
+    uint8_t words;
+    uint8_t old_words;
+} color_commit_t;
+
+// Flash jobs run in order from the main loop, one short slice at a time
+static nvmc_job_t jobs[ESL_NVMC_JOB_QUEUE_SIZE];
+static volatile uint8_t jobs_head = 0;      // Job in progress
+static volatile uint8_t jobs_tail = 0;      // Next free slot
+static bool erase_started = false;
+static esl_ret_code_t last_result = ESL_SUCCESS;    // Of the last job done
+static uint8_t colors_jobs = 0;             // Queued jobs in the color region
+
+// Last color log, alternating between two pages
+static const uint32_t last_rgb_pages[2] = { LAST_COLOR_PG_ADDR, LAST_COLOR_SPARE_PG_ADDR };
+static uint8_t last_rgb_page = 0;           // Active page
+static uint32_t last_rgb_idx = 0;           // Cached index of the next free word
+static esl_nvmc_rgb_data_t last_rgb;        // Newest stored record
+static bool last_rgb_valid = false;
+static esl_nvmc_stats_t nvmc_stats;
+
+// Saved colors, appended to a head page and spread over the whole region.
+// Each page starts with its sequence number and the complement of it.
+static colors_page_t colors_pages[ESL_NVMC_COLOR_PAGES];
+static int16_t colors_head = -1;            // Page receiving new records
+static uint32_t colors_page_seq = 0;        // Sequence number of the next opened page
+static uint32_t live_colors_count = 0;
+static uint32_t live_colors_words = 0;
+static uint32_t summary_idx = 0;            // Next free summary entry
+static int16_t evac_victim = -1;            // Page being compacted
+static uint32_t evac_off = 0;               // Next record of it to look at
+static color_commit_t commits[ESL_NVMC_JOB_QUEUE_SIZE];
+static uint8_t commits_pending = 0;
+
+// Open addressing hash index: name -> record location
+static uint16_t name_index[ESL_NVMC_INDEX_SIZE];
+
+static esl_ret_code_t job_write(uint32_t addr, void const *src, size_t size, bool chained,
+                                esl_nvmc_done_handler_t handler, void *p_context);
+static bool job_step(void);
+
+static esl_ret_code_t page_erase(uint32_t addr) {
+    return esl_nvmc_erase(addr, NULL, NULL);
+}
+
+static bool page_is_erased(uint32_t page_addr) {
+    const uint32_t *words = (const uint32_t *)page_addr;
+    for (uint32_t i = 0; i < LOG_WORDS; i++) {
+        if (words[i] != WORD_ERASED) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Records are appended back to back, so the first erased word of a page
+// is found with a binary search instead of a linear scan.
+static uint32_t log_free_idx(uint32_t page_addr) {
+    const uint32_t *words = (const uint32_t *)page_addr;
+    uint32_t lo = 0;
+    uint32_t hi = LOG_WORDS;
+
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (words[mid] == WORD_ERASED) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return lo;
+}
+
+// Newest valid record at or below idx, skipping anything torn or corrupted
+static bool log_newest(uint32_t page_addr, uint32_t idx, esl_nvmc_rgb_data_t *rgb) {
+    const uint32_t *words = (const uint32_t *)page_addr;
+
+    while (idx-- > 0) {
+        esl_nvmc_rgb_data_t record;
+        memcpy(&record, &words[idx], sizeof(record));
+        if (record.magic_number == ESL_NVMC_BYTE_VALID) {
+            *rgb = record;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void last_rgb_log_init(void) {
+    uint32_t used[2] = {
+        log_free_idx(last_rgb_pages[0]),
+        log_free_idx(last_rgb_pages[1])
+    };
+
+    if (used[0] && used[1]) {
+        // Power was lost while switching pages. The full page is the old one,
+        // otherwise keep whichever page holds a valid record.
+        esl_nvmc_rgb_data_t rgb;
+        uint8_t stale;
+        if (used[0] == LOG_WORDS) {
+            stale = 0;
+        } else if (used[1] == LOG_WORDS) {
+            stale = 1;
+        } else {
+            stale = log_newest(last_rgb_pages[0], used[0], &rgb) ? 1 : 0;
+        }
+        // The first record on the new page may not have made it
+        if (!log_newest(last_rgb_pages[stale ^ 1], used[stale ^ 1], &rgb)) {
+            stale ^= 1;
+        }
+        NRF_LOG_WARNING("Last color log: erasing stale page %d", stale);
+        page_erase(last_rgb_pages[stale]);
+        used[stale] = 0;
+    }
+
+    last_rgb_page = used[1] ? 1 : 0;
+    last_rgb_idx = used[last_rgb_page];
+    last_rgb_valid = log_newest(last_rgb_pages[last_rgb_page], last_rgb_idx, &last_rgb);
+}
+
+// FNV-1a over at most the stored name length
+static uint32_t name_hash(const char *name) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < ESL_NVMC_COLOR_NAME_LEN && name[i]; i++) {
+        hash = (hash ^ (uint8_t)name[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t colors_page_addr(uint8_t page) {
+    return COLORS_START_ADDR + page * PAGE_SIZE;
+}
+
+static uint32_t record_addr(uint16_t loc) {
+    return COLORS_START_ADDR + loc * sizeof(uint32_t);
+}
+
+// Records are read in place from memory mapped flash. While jobs for the
+// color region are queued, the record is put together in buf from flash
+// and the queued data instead, as flash will hold it once they have run,
+// so reads never wait for the queue.
+static color_record_t const * record_get(uint16_t loc, color_record_buf_t *buf) {
+    uint32_t addr = record_addr(loc);
+    if (colors_jobs == 0) {
+        return (color_record_t const *)addr;
+    }
+
+    uint32_t page_addr = addr & ~(PAGE_SIZE - 1);
+    uint32_t words = PAGE_WORDS - loc % PAGE_WORDS;
+    if (words > RECORD_MAX_WORDS) {
+        words = RECORD_MAX_WORDS;
+    }
+    uint32_t end = addr + words * sizeof(uint32_t);
+
+    memset(buf, 0xFF, sizeof(*buf));
+    memcpy(buf->words, (const void *)addr, words * sizeof(uint32_t));
+    for (uint8_t i = jobs_head; i != jobs_tail; i = (i + 1) % ESL_NVMC_JOB_QUEUE_SIZE) {
+        nvmc_job_t const *job = &jobs[i];
+        if (job->type == NVMC_JOB_ERASE) {
+            if (page_addr >= job->addr && page_addr < job->addr + job->words * PAGE_SIZE) {
+                memset(buf->words, 0xFF, words * sizeof(uint32_t));
+            }
+            continue;
+        }
+        if (job->addr >= end || job->addr + job->words * sizeof(uint32_t) <= addr) {
+            continue;
+        }
+        // Programming only clears bits, a slice already done changes nothing
+        for (uint32_t n = 0; n < job->words; n++) {
+            uint32_t word_addr = job->addr + n * sizeof(uint32_t);
+            if (word_addr >= addr && word_addr < end) {
+                buf->words[(word_addr - addr) / sizeof(uint32_t)] &= job->data[n];
+            }
+        }
+    }
+    nvmc_stats.colors_pending_reads++;
+    return &buf->record;
+}
+
+// A page is in use once its header is written. A page whose erase was cut
+// short fails the complement check.
+static bool page_header_read(uint8_t page, uint32_t *seq) {
+    const uint32_t *words = (const uint32_t *)colors_page_addr(page);
+    *seq = words[0];
+    return words[0] != WORD_ERASED && words[1] == ~words[0];
+}
+
+// Sequence numbers only order copies of one name, so they may wrap
+static bool seq_newer(uint16_t seq, uint16_t than) {
+    return (int16_t)(seq - than) > 0;
+}
+
+static uint16_t record_crc(color_record_t const *record) {
+    return crc16_compute((uint8_t const *)&record->seq,
+                         RECORD_FIXED_SIZE - sizeof(record->hdr) + record->name_len, NULL);
+}
+
+static bool record_is_free(color_record_t const *record) {
+    const uint32_t *words = (const uint32_t *)record;
+    return words[0] == WORD_ERASED && words[1] == WORD_ERASED;
+}
+
+// Size of the record at off in its page, 0 if there is none or its length
+// can't be trusted
+static uint32_t record_words(color_record_t const *record, uint32_t off) {
+    if (off + RECORD_WORDS(1) > PAGE_WORDS) {
+        return 0;
+    }
+    if (record_is_free(record) || record->name_len == 0 ||
+        record->name_len >= ESL_NVMC_COLOR_NAME_LEN ||
+        off + RECORD_WORDS(record->name_len) > PAGE_WORDS) {
+        return 0;
+    }
+    return RECORD_WORDS(record->name_len);
+}
+
+// Words from the record at off to the next one, 0 at the end of the page. A
+// record whose length can't be read was cut short while its body was being
+// written. No word of a whole body reads as erased, so it runs up to the
+// next erased word, and the next record starts one word after that.
+static uint32_t record_span(uint8_t page, uint32_t off, color_record_t const *record) {
+    uint32_t words = record_words(record, off);
+    if (words > 0 || off + RECORD_WORDS(1) > PAGE_WORDS || record_is_free(record)) {
+        return words;
+    }
+
+    const uint32_t *page_words = (const uint32_t *)colors_page_addr(page);
+    uint32_t end = off + 1;
+    while (end < PAGE_WORDS && page_words[end] != WORD_ERASED) {
+        end++;
+    }
+    return (end < PAGE_WORDS ? end + 1 : PAGE_WORDS) - off;
+}
+
+static record_state_t record_state(color_record_t const *record) {
+    uint32_t hdr_word;
+    memcpy(&hdr_word, &record->hdr, sizeof(hdr_word));
+
+    if (hdr_word == WORD_ERASED) {
+        return record_is_free(record) ? RECORD_FREE : RECORD_TORN;
+    }
+    if (record->hdr.state == ESL_NVMC_BYTE_DELETED) {
+        return RECORD_DELETED;
+    }
+    if (record->hdr.state != ESL_NVMC_BYTE_VALID ||
+        record->hdr.version != RECORD_VERSION ||
+        record->hdr.crc != record_crc(record)) {
+        return RECORD_TORN;
+    }
+    return RECORD_LIVE;
+}
+
+static uint32_t record_encode(color_record_buf_t *buf, esl_nvmc_saved_color_t const *color, uint16_t seq) {
+    uint8_t name_len = strnlen(color->fields.color_name, ESL_NVMC_COLOR_NAME_LEN - 1);
+
+    memset(buf, 0xFF, sizeof(*buf));
+    buf->record.seq = seq;
+    buf->record.name_len = name_len;
+    buf->record.rgb[0] = color->fields.rgb_data.r_val;
+    buf->record.rgb[1] = color->fields.rgb_data.g_val;
+    buf->record.rgb[2] = color->fields.rgb_data.b_val;
+    memcpy(buf->record.name, color->fields.color_name, name_len);
+    buf->record.hdr.state = ESL_NVMC_BYTE_VALID;
+    buf->record.hdr.version = RECORD_VERSION;
+    buf->record.hdr.crc = record_crc(&buf->record);
+    return RECORD_WORDS(name_len);
+}
+
+static void record_decode(color_record_t const *record, esl_nvmc_saved_color_t *color) {
+    uint32_t start = esl_cycles_get();
+
+    memset(color, 0, sizeof(*color));
+    color->fields.rgb_data.magic_number = ESL_NVMC_BYTE_VALID;
+    color->fields.rgb_data.r_val = record->rgb[0];
+    color->fields.rgb_data.g_val = record->rgb[1];
+    color->fields.rgb_data.b_val = record->rgb[2];
+    memcpy(color->fields.color_name, record->name, record->name_len);
+
+    nvmc_stats.colors_decodes++;
+    nvmc_stats.colors_decode_cycles += esl_cycles_get() - start;
+}
+
+static uint32_t loc_words(uint16_t loc) {
+    color_record_buf_t buf;
+    return RECORD_WORDS(record_get(loc, &buf)->name_len);
+}
+
+static void live_add(uint16_t loc, uint32_t words) {
+    colors_pages[LOC_PAGE(loc)].live += words;
+    live_colors_count++;
+    live_colors_words += words;
+}
+
+static void live_sub(uint16_t loc, uint32_t words) {
+    colors_pages[LOC_PAGE(loc)].live -= words;
+    live_colors_count--;
+    live_colors_words -= words;
+}
+
+// Returns the index position holding name, or -1. Names are compared in
+// flash without decoding the record.
+static int32_t index_probe(const char *name, uint8_t name_len) {
+    uint32_t pos = name_hash(name) & (ESL_NVMC_INDEX_SIZE - 1);
+    color_record_buf_t buf;
+
+    for (uint32_t probe = 0; probe < ESL_NVMC_INDEX_SIZE; probe++) {
+        uint16_t entry = name_index[pos];
+        if (entry == INDEX_EMPTY) {
+            return -1;
+        }
+        if (entry != INDEX_DELETED) {
+            color_record_t const *record = record_get(entry, &buf);
+            if (record->name_len == name_len && memcmp(record->name, name, name_len) == 0) {
+                return pos;
+            }
+        }
+        pos = (pos + 1) & (ESL_NVMC_INDEX_SIZE - 1);
+    }
+    return -1;
+}
+
+static int32_t index_lookup(const char *name) {
+    return index_probe(name, strnlen(name, ESL_NVMC_COLOR_NAME_LEN));
+}
+
+static void index_insert(const char *name, uint16_t loc) {
+    uint32_t pos = name_hash(name) & (ESL_NVMC_INDEX_SIZE - 1);
+
+    while (name_index[pos] != INDEX_EMPTY && name_index[pos] != INDEX_DELETED) {
+        pos = (pos + 1) & (ESL_NVMC_INDEX_SIZE - 1);
+    }
+    name_index[pos] = loc;
+}
+
+// Names in flash are not terminated, the hash and probe need a copy
+static void record_name(color_record_t const *record, char name[ESL_NVMC_COLOR_NAME_LEN]) {
+    memcpy(name, record->name, record->name_len);
+    name[record->name_len] = '\0';
+}
+
+static color_commit_t * commit_alloc(uint16_t loc, uint32_t words, uint16_t old_loc) {
+    for (uint8_t i = 0; i < ESL_NVMC_JOB_QUEUE_SIZE; i++) {
+        if (!commits[i].used) {
+            commits[i].used = true;
+            commits[i].loc = loc;
+            commits[i].old_loc = old_loc;
+            commits[i].words = words;
+            commits[i].old_words = old_loc != LOC_NONE ? loc_words(old_loc) : 0;
+            commits_pending++;
+            return &commits[i];
+        }
+    }
+    // One per queued job at most, so there is always a free one
+    return NULL;
+}
+
+static void commit_free(color_commit_t *commit) {
+    commit->used = false;
+    commits_pending--;
+}
+
+static void record_committed(esl_ret_code_t result, void *p_context);
+
+// Second write of the header word, clearing the state byte only
+static esl_ret_code_t record_tombstone(uint16_t loc, bool chained, color_commit_t *commit) {
+    color_record_buf_t buf;
+    color_record_hdr_t hdr = record_get(loc, &buf)->hdr;
+    hdr.state = ESL_NVMC_BYTE_DELETED;
+    return job_write(record_addr(loc), &hdr, sizeof(hdr), chained,
+                     commit ? record_committed : NULL, commit);
+}
+
+// Called once a record's header or a delete's tombstone is in flash. On
+// failure the index goes back to what flash holds: the new record is
+// dropped and the one it replaced comes back, unless the name has moved on
+// since, in which case the replaced record is tombstoned after all.
+static void record_committed(esl_ret_code_t result, void *p_context) {
+    color_commit_t commit = *(color_commit_t *)p_context;
+
+    commit_free(p_context);
+    if (result == ESL_SUCCESS) {
+        return;
+    }
+    nvmc_stats.colors_rollbacks++;
+    NRF_LOG_ERROR("Saved colors: write failed, index rolled back");
+
+    bool indexed = commit.loc == LOC_NONE;
+    for (uint32_t pos = 0; !indexed && pos < ESL_NVMC_INDEX_SIZE; pos++) {
+        if (name_index[pos] == commit.loc) {
+            name_index[pos] = INDEX_DELETED;
+            live_sub(commit.loc, commit.words);
+            indexed = true;
+        }
+    }
+    if (commit.old_loc == LOC_NONE) {
+        return;
+    }
+    if (!indexed) {
+        record_tombstone(commit.old_loc, false, NULL);
+        return;
+    }
+
+    color_record_buf_t buf;
+    color_record_t const *old = record_get(commit.old_loc, &buf);
+    char name[ESL_NVMC_COLOR_NAME_LEN];
+    record_name(old, name);
+    if (index_probe(name, old->name_len) < 0) {
+        index_insert(name, commit.old_loc);
+        live_add(commit.old_loc, commit.old_words);
+        if (LOC_PAGE(commit.old_loc) == evac_victim) {
+            // Back on the page being compacted, it has to be moved again
+            evac_off = PAGE_HDR_WORDS;
+        }
+    }
+}
+
+// Queues a record at the end of the head page: the body, then the header
+// that commits it, then optionally the tombstone of the record it replaces.
+// Each only runs if the one before succeeded. The record may be a buffer in
+// RAM or a record being copied in flash. The space is used up even if a
+// write fails, so a damaged spot is never retried.
+static esl_ret_code_t record_queue(color_record_t const *record, uint32_t words, uint16_t old_loc, bool tombstone) {
+    colors_page_t *head = &colors_pages[colors_head];
+    uint16_t loc = LOC(colors_head, head->used);
+    uint32_t addr = record_addr(loc);
+
+    head->used += words;
+    esl_ret_code_t res = esl_nvmc_write(addr + sizeof(record->hdr), &record->seq,
+                                        words * sizeof(uint32_t) - sizeof(record->hdr), NULL, NULL);
+    if (res != ESL_SUCCESS) {
+        return res;
+    }
+    color_commit_t *commit = commit_alloc(loc, words, old_loc);
+    res = job_write(addr, &record->hdr, sizeof(record->hdr), true, record_committed, commit);
+    if (res != ESL_SUCCESS) {
+        commit_free(commit);
+        return res;
+    }
+    if (tombstone) {
+        record_tombstone(old_loc, true, NULL);
+    }
+    return ESL_SUCCESS;
+}
+
+// Boot runs before anything else uses flash, so it may wait for the queue
+static void boot_jobs_wait(uint8_t jobs) {
+    while (esl_nvmc_jobs_free() < jobs && job_step()) {}
+}
+
+static void boot_tombstone(uint16_t loc) {
+    boot_jobs_wait(1);
+    record_tombstone(loc, false, NULL);
+}
+
+// Indexes a live record found at boot. Two live copies of a name are left
+// behind by a replace or compaction that was cut short: the newest wins,
+// and on equal sequence numbers the copy in the newer page.
+static void index_add(uint8_t page, uint32_t off) {
+    color_record_buf_t buf, other_buf;
+    color_record_t const *record = record_get(LOC(page, off), &buf);
+    uint32_t words = RECORD_WORDS(record->name_len);
+    char name[ESL_NVMC_COLOR_NAME_LEN];
+
+    record_name(record, name);
+    int32_t pos = index_probe(name, record->name_len);
+    if (pos < 0) {
+        index_insert(name, LOC(page, off));
+        live_add(LOC(page, off), words);
+        return;
+    }
+
+    uint16_t other = name_index[pos];
+    color_record_t const *other_record = record_get(other, &other_buf);
+    bool newer = seq_newer(record->seq, other_record->seq) ||
+                 (record->seq == other_record->seq &&
+                  colors_pages[page].seq > colors_pages[LOC_PAGE(other)].seq);
+    if (newer) {
+        boot_tombstone(other);
+        colors_pages[LOC_PAGE(other)].live -= words;
+        name_index[pos] = LOC(page, off);
+        colors_pages[page].live += words;
+    } else {
+        boot_tombstone(LOC(page, off));
+    }
+}
+
+// Pages described by the summary trust the records committed when the page
+// was sealed, everything else is checked record by record. Records are
+// walked by their stored length, see record_span() for those without one.
+static void index_page(uint8_t page, summary_entry_t const *entry) {
+    colors_page_t *pg = &colors_pages[page];
+    uint32_t end = entry ? entry->used : PAGE_WORDS;
+    uint32_t off = PAGE_HDR_WORDS;
+    color_record_buf_t buf;
+
+    for (uint32_t n = 0; off < end; n++) {
+        color_record_t const *record = record_get(LOC(page, off), &buf);
+        uint32_t words = record_span(page, off, record);
+        if (words == 0) {
+            if (off < PAGE_WORDS && !record_is_free(record)) {
+                nvmc_stats.colors_torn++;
+                off = PAGE_WORDS;
+            }
+            break;
+        }
+
+        if (record_words(record, off) == 0) {
+            nvmc_stats.colors_torn++;
+        } else if (entry) {
+            if ((entry->committed[n / 32] & (1u << (n % 32))) &&
+                record->hdr.state == ESL_NVMC_BYTE_VALID) {
+                index_add(page, off);
+            }
+        } else {
+            record_state_t state = record_state(record);
+            if (state == RECORD_LIVE) {
+                index_add(page, off);
+            } else if (state == RECORD_TORN) {
+                nvmc_stats.colors_torn++;
+            }
+        }
+        off += words;
+    }
+
+    pg->used = entry ? entry->used : off;
+    pg->summarized = entry != NULL;
+    if (entry) {
+        nvmc_stats.colors_pages_summarized++;
+    } else {
+        nvmc_stats.colors_pages_scanned++;
+    }
+}
+
+static summary_entry_t const * summary_at(uint32_t idx) {
+    return (summary_entry_t const *)(COLORS_SUMMARY_PG_ADDR + idx * sizeof(summary_entry_t));
+}
+
+static uint16_t summary_crc(summary_entry_t const *entry) {
+    return crc16_compute((uint8_t const *)entry + sizeof(entry->crc), sizeof(*entry) - sizeof(entry->crc), NULL);
+}
+
+static bool summary_is_free(summary_entry_t const *entry) {
+    const uint32_t *words = (const uint32_t *)entry;
+    for (uint32_t i = 0; i < sizeof(*entry) / sizeof(uint32_t); i++) {
+        if (words[i] != WORD_ERASED) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Finds the latest valid entry of every page and the first free entry
+static void summary_load(summary_entry_t const *latest[]) {
+    for (summary_idx = 0; summary_idx < SUMMARY_ENTRIES; summary_idx++) {
+        summary_entry_t const *entry = summary_at(summary_idx);
+        if (summary_is_free(entry)) {
+            break;
+        }
+        if (entry->page < ESL_NVMC_COLOR_PAGES && entry->used <= PAGE_WORDS &&
+            entry->crc == summary_crc(entry)) {
+            latest[entry->page] = entry;
+        }
+    }
+}
+
+// Records a sealed page. Losing the entry only costs a full scan at boot.
+static esl_ret_code_t summary_add(uint8_t page) {
+    colors_page_t *pg = &colors_pages[page];
+    summary_entry_t entry;
+
+    memset(&entry, 0, sizeof(entry));
+    entry.page = page;
+    entry.seq = pg->seq;
+    entry.used = pg->used;
+
+    uint32_t off = PAGE_HDR_WORDS;
+    color_record_buf_t buf;
+    for (uint32_t n = 0; off < pg->used; n++) {
+        color_record_t const *record = record_get(LOC(page, off), &buf);
+        uint32_t words = record_span(page, off, record);
+        if (words == 0) {
+            break;
+        }
+        record_state_t state = record_words(record, off) ? record_state(record) : RECORD_TORN;
+        if (state == RECORD_LIVE || state == RECORD_DELETED) {
+            entry.committed[n / 32] |= 1u << (n % 32);
+        }
+        off += words;
+    }
+    entry.crc = summary_crc(&entry);
+
+    esl_ret_code_t res = esl_nvmc_write(COLORS_SUMMARY_PG_ADDR + summary_idx * sizeof(entry), &entry,
+                                        sizeof(entry), NULL, NULL);
+    if (res == ESL_ERR_BUSY) {
+        return res;
+    }
+    if (res == ESL_SUCCESS) {
+        pg->summarized = true;
+    }
+    summary_idx++;
+    return ESL_SUCCESS;
+}
+
+// Sealed pages are neither the head nor being compacted
+static bool page_is_sealed(uint8_t page) {
+    return colors_pages[page].seq != WORD_ERASED && page != colors_head && page != evac_victim;
+}
+
+// Summarizes one sealed page, or starts the summary page over once it is
+// full. There are more entries per page than color pages, so starting over
+// always leaves room. Waits while records are being committed, as their
+// state goes into the entry.
+static bool summary_step(void) {
+    if (commits_pending > 0) {
+        return false;
+    }
+    if (summary_idx == SUMMARY_ENTRIES) {
+        if (page_erase(COLORS_SUMMARY_PG_ADDR) != ESL_SUCCESS) {
+            return false;
+        }
+        summary_idx = 0;
+        nvmc_stats.colors_summary_rewrites++;
+        for (uint8_t page = 0; page < ESL_NVMC_COLOR_PAGES; page++) {
+            colors_pages[page].summarized = false;
+        }
+        return true;
+    }
+    for (uint8_t page = 0; page < ESL_NVMC_COLOR_PAGES; page++) {
+        if (page_is_sealed(page) && !colors_pages[page].summarized) {
+            return summary_add(page) == ESL_SUCCESS;
+        }
+    }
+    return false;
+}
+
+static void evac_start(uint8_t victim) {
+    evac_victim = victim;
+    evac_off = PAGE_HDR_WORDS;
+}
+
+// Moves the next live record of the page being compacted to the head page.
+// Only the copy the index points at is moved, older ones go with the page.
+// Once every record is moved and committed, the page is erased.
+static bool evac_step(void) {
+    colors_page_t *victim = &colors_pages[evac_victim];
+    colors_page_t *head = &colors_pages[colors_head];
+    color_record_buf_t buf;
+
+    while (evac_off < victim->used) {
+        uint16_t loc = LOC(evac_victim, evac_off);
+        color_record_t const *record = record_get(loc, &buf);
+        uint32_t words = record_span(evac_victim, evac_off, record);
+        if (words == 0) {
+            evac_off = victim->used;
+            break;
+        }
+        if (record_words(record, evac_off) == 0) {
+            evac_off += words;
+            continue;
+        }
+
+        char name[ESL_NVMC_COLOR_NAME_LEN];
+        record_name(record, name);
+        int32_t pos = index_probe(name, record->name_len);
+        if (pos < 0 || name_index[pos] != loc) {
+            evac_off += words;
+            continue;
+        }
+        if (head->used + words > PAGE_WORDS) {
+            // Only after a failed write put a record back, the page stays
+            NRF_LOG_ERROR("Saved colors: no room to finish compacting page %d", evac_victim);
+            evac_victim = -1;
+            return false;
+        }
+
+        uint16_t new_loc = LOC(colors_head, head->used);
+        if (record_queue(record, words, loc, false) != ESL_SUCCESS) {
+            return false;
+        }
+        name_index[pos] = new_loc;
+        live_sub(loc, words);
+        live_add(new_loc, words);
+        evac_off += words;
+        return true;
+    }
+
+    if (commits_pending > 0 || page_erase(colors_page_addr(evac_victim)) != ESL_SUCCESS) {
+        return false;
+    }
+    victim->seq = WORD_ERASED;
+    victim->used = 0;
+    victim->live = 0;
+    victim->summarized = false;
+    nvmc_stats.colors_compactions++;
+    NRF_LOG_INFO("Saved colors: page %d compacted", evac_victim);
+    evac_victim = -1;
+    return true;
+}
+
+// Compaction and summaries are queued from the main loop a step at a time,
+// always leaving room in the queue for a color operation
+static void colors_work(void) {
+    while (esl_nvmc_jobs_free() >= COLOR_OP_JOBS + WORK_STEP_JOBS) {
+        bool progress = evac_victim >= 0 ? evac_step() : summary_step();
+        if (!progress) {
+            break;
+        }
+    }
+}
+
+static bool colors_work_pending(void) {
+    if (evac_victim >= 0 || summary_idx == SUMMARY_ENTRIES) {
+        return true;
+    }
+    for (uint8_t page = 0; page < ESL_NVMC_COLOR_PAGES; page++) {
+        if (page_is_sealed(page) && !colors_pages[page].summarized) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int16_t page_free_find(void);
+static int16_t colors_victim_find(bool skip_head);
+static esl_ret_code_t head_advance(void);
+
+static color_record_v1_t const * record_v1_at(uint8_t page, uint32_t slot) {
+    return (color_record_v1_t const *)(colors_page_addr(page) + PAGE_HDR_WORDS * sizeof(uint32_t) +
+                                       slot * sizeof(color_record_v1_t));
+}
+
+// Committed, live or deleted, and intact
+static bool record_v1_ok(color_record_v1_t const *record) {
+    return (record->hdr.state == ESL_NVMC_BYTE_VALID || record->hdr.state == ESL_NVMC_BYTE_DELETED) &&
+           record->hdr.version == RECORD_V1_VERSION &&
+           record->hdr.crc == crc16_compute((uint8_t const *)&record->seq,
+                                            sizeof(record->seq) + sizeof(record->color), NULL);
+}
+
+// The first slot of an old page may be torn, so the second one is checked
+// too. A record of the current format can't pass the old CRC.
+static bool page_is_v1(uint8_t page) {
+    return record_v1_ok(record_v1_at(page, 0)) || record_v1_ok(record_v1_at(page, 1));
+}
+
+// Whether the old pages still to convert hold a newer live copy of the name
+static bool record_v1_superseded(uint64_t pages, color_record_v1_t const *record) {
+    for (uint8_t page = 0; page < ESL_NVMC_COLOR_PAGES; page++) {
+        if (!(pages & (1ull << page))) {
+            continue;
+        }
+        for (uint32_t slot = 0; slot < RECORD_V1_SLOTS; slot++) {
+            color_record_v1_t const *other = record_v1_at(page, slot);
+            if (other->hdr.state == ESL_NVMC_BYTE_VALID && other->seq > record->seq &&
+                strncmp(other->color.fields.color_name, record->color.fields.color_name,
+                        ESL_NVMC_COLOR_NAME_LEN - 1) == 0 &&
+                record_v1_ok(other)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Converts pages of the previous format one at a time: the newest copy of
+// each name is appended to the head page as a record of the current format,
+// then the old page is erased. Names already indexed were converted by a
+// boot that was cut short and are skipped.
+static void colors_migrate(uint64_t pages) {
+    NRF_LOG_WARNING("Saved colors: converting pages of record version %d", RECORD_V1_VERSION);
+
+    // The old summary entries describe none of the new pages
+    boot_jobs_wait(1);
+    page_erase(COLORS_SUMMARY_PG_ADDR);
+    summary_idx = 0;
+
+    for (uint8_t page = 0; page < ESL_NVMC_COLOR_PAGES; page++) {
+        if (!(pages & (1ull << page))) {
+            continue;
+        }
+        for (uint32_t slot = 0; slot < RECORD_V1_SLOTS; slot++) {
+            color_record_v1_t const *old = record_v1_at(page, slot);
+            if (old->hdr.state != ESL_NVMC_BYTE_VALID || !record_v1_ok(old) ||
+                record_v1_superseded(pages, old)) {
+                continue;
+            }
+            esl_nvmc_saved_color_t color = old->color;
+            color.fields.color_name[ESL_NVMC_COLOR_NAME_LEN - 1] = '\0';
+            if (color.fields.color_name[0] == '\0' || index_lookup(color.fields.color_name) >= 0) {
+                continue;
+            }
+
+            color_record_buf_t buf;
+            uint32_t words = record_encode(&buf, &color, 0);
+            if (colors_head < 0 || colors_pages[colors_head].used + words > PAGE_WORDS) {
+                boot_jobs_wait(1);
+                if (head_advance() != ESL_SUCCESS) {
+                    NRF_LOG_ERROR("Saved colors: no room to convert '%s'", color.fields.color_name);
+                    continue;
+                }
+            }
+            boot_jobs_wait(2);
+            uint16_t loc = LOC(colors_head, colors_pages[colors_head].used);
+            if (record_queue(&buf.record, words, LOC_NONE, false) == ESL_SUCCESS) {
+                index_insert(color.fields.color_name, loc);
+                live_add(loc, words);
+                nvmc_stats.colors_migrated++;
+            }
+        }
+
+        // Every copy is in flash before the old page goes
+        while (job_step()) {}
+        page_erase(colors_page_addr(page));
+        while (job_step()) {}
+        colors_pages[page].seq = WORD_ERASED;
+        colors_pages[page].used = 0;
+        colors_pages[page].summarized = false;
+        pages &= ~(1ull << page);
+    }
+}
+
+static void colors_init(void) {
+    uint32_t start = esl_cycles_get();
+    summary_entry_t const *latest[ESL_NVMC_COLOR_PAGES] = { NULL };
+
+    uint64_t old_pages = 0;
+
+    summary_load(latest);
+
+    for (uint8_t page = 0; page < ESL_NVMC_COLOR_PAGES; page++) {
+        colors_page_t *pg = &colors_pages[page];
+        uint32_t seq;
+
+        if (!page_header_read(page, &seq)) {
+            // Free, or an erase was cut short
+            pg->seq = WORD_ERASED;
+            if (!page_is_erased(colors_page_addr(page))) {
+                NRF_LOG_WARNING("Saved colors: erasing invalid page %d", page);
+                page_erase(colors_page_addr(page));
+            }
+            continue;
+        }
+
+        pg->seq = seq;
+        if (page_is_v1(page)) {
+            // In use and full until converted
+            old_pages |= 1ull << page;
+            pg->used = PAGE_WORDS;
+            pg->summarized = true;
+            if (seq >= colors_page_seq) {
+                colors_page_seq = seq + 1;
+            }
+            continue;
+        }
+        if (seq >= colors_page_seq) {
+            colors_page_seq = seq + 1;
+            colors_head = page;
+        }
+        index_page(page, (latest[page] && latest[page]->seq == seq) ? latest[page] : NULL);
+    }
+
+    if (old_pages) {
+        colors_migrate(old_pages);
+    }
+
+    // A compaction cut short leaves no erased page behind. Its records were
+    // being copied to the head page, which still has room for the rest; the
+    // main loop finishes it. Sealed pages that lost their summary entry get
+    // a new one the same way, so they are only scanned once.
+    if (colors_head >= 0 && page_free_find() < 0) {
+        int16_t victim = colors_victim_find(true);
+        NRF_LOG_WARNING("Saved colors: finishing compaction of page %d", victim);
+        evac_start(victim);
+    }
+
+    nvmc_stats.colors_scan_cycles = esl_cycles_get() - start;
+    NRF_LOG_INFO("Retrieved all saved colors! count: %d, torn: %d", live_colors_count, nvmc_stats.colors_torn);
+}
+
+void esl_nvmc_init(void) {
+    jobs_head = jobs_tail = 0;
+    erase_started = false;
+    last_result = ESL_SUCCESS;
+    colors_jobs = 0;
+    last_rgb_page = 0;
+    last_rgb_idx = 0;
+    last_rgb_valid = false;
+    memset(&nvmc_stats, 0, sizeof(nvmc_stats));
+    memset(colors_pages, 0, sizeof(colors_pages));
+    colors_head = -1;
+    colors_page_seq = 0;
+    live_colors_count = 0;
+    live_colors_words = 0;
+    summary_idx = 0;
+    evac_victim = -1;
+    evac_off = 0;
+    memset(commits, 0, sizeof(commits));
+    commits_pending = 0;
+    memset(name_index, 0, sizeof(name_index));
+
+    last_rgb_log_init();
+    colors_init();
+}
+
+bool esl_nvmc_is_busy(void) {
+    return jobs_head != jobs_tail;
+}
+
+uint8_t esl_nvmc_jobs_free(void) {
+    return (jobs_head + ESL_NVMC_JOB_QUEUE_SIZE - jobs_tail - 1) % ESL_NVMC_JOB_QUEUE_SIZE;
+}
+
+// Whether an erase of the page holding addr is queued
+static bool erase_pending(uint32_t addr) {
+    for (uint8_t i = jobs_head; i != jobs_tail; i = (i + 1) % ESL_NVMC_JOB_QUEUE_SIZE) {
+        if (jobs[i].type == NVMC_JOB_ERASE && addr >= jobs[i].addr &&
+            addr < jobs[i].addr + jobs[i].words * PAGE_SIZE) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Returns a free job slot, NULL if the queue is full. Callers hand
+// ESL_ERR_BUSY back up rather than wait for it.
+static nvmc_job_t * job_alloc(void) {
+    if (esl_nvmc_jobs_free() == 0) {
+        nvmc_stats.queue_full++;
+        return NULL;
+    }
+    return &jobs[jobs_tail];
+}
+
+static bool in_colors(uint32_t addr) {
+    return addr >= COLORS_START_ADDR && addr < COLORS_END_ADDR;
+}
+
+static void job_commit(void) {
+    if (in_colors(jobs[jobs_tail].addr)) {
+        colors_jobs++;
+    }
+    jobs_tail = (jobs_tail + 1) % ESL_NVMC_JOB_QUEUE_SIZE;
+}
+
+static esl_ret_code_t job_write(uint32_t addr, void const *src, size_t size, bool chained,
+                                esl_nvmc_done_handler_t handler, void *p_context)
+{
+    uint32_t words = (size + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+    if (addr % sizeof(uint32_t) != 0) {
+        NRF_LOG_ERROR("Address is not aligned!");
+        return ESL_ERROR;
+    }
+    if (words > JOB_MAX_WORDS) {
+        return ESL_ERROR;
+    }
+
+    nvmc_job_t *job = job_alloc();
+    if (job == NULL) {
+        return ESL_ERR_BUSY;
+    }
+    memset(job->data, 0xFF, sizeof(job->data));
+    memcpy(job->data, src, size);
+
+    // Words of a page that is about to be erased are writable by definition
+    if (!erase_pending(addr)) {
+        for (uint32_t i = 0; i < words; i++) {
+            if (!nrfx_nvmc_word_writable_check(addr + i * sizeof(uint32_t), job->data[i])) {
+                return ESL_ERR_NVMC_NOT_WRITABLE;
+            }
+        }
+    }
+
+    job->type = NVMC_JOB_WRITE;
+    job->chained = chained;
+    job->addr = addr;
+    job->words = words;
+    job->done = 0;
+    job->handler = handler;
+    job->p_context = p_context;
+    job_commit();
+    return ESL_SUCCESS;
+}
+
+esl_ret_code_t esl_nvmc_write(uint32_t addr, void const * src, size_t size,
+                              esl_nvmc_done_handler_t handler, void *p_context)
+{
+    return job_write(addr, src, size, false, handler, p_context);
+}
+
+esl_ret_code_t esl_nvmc_write_chained(uint32_t addr, void const * src, size_t size,
+                                      esl_nvmc_done_handler_t handler, void *p_context)
+{
+    return job_write(addr, src, size, true, handler, p_context);
+}
+
+esl_ret_code_t esl_nvmc_erase_pages(uint32_t page_addr, uint32_t pages,
+                                    esl_nvmc_done_handler_t handler, void *p_context)
+{
+    if (page_addr % PAGE_SIZE != 0 || pages == 0) {
+        NRF_LOG_ERROR("Address is not page aligned!");
+        return ESL_ERROR;
+    }
+
+    nvmc_job_t *job = job_alloc();
+    if (job == NULL) {
+        return ESL_ERR_BUSY;
+    }
+    job->type = NVMC_JOB_ERASE;
+    job->chained = false;
+    job->addr = page_addr;
+    job->words = pages;
+    job->done = 0;
+    job->handler = handler;
+    job->p_context = p_context;
+    job_commit();
+    return ESL_SUCCESS;
+}
+
+esl_ret_code_t esl_nvmc_erase(uint32_t page_addr, esl_nvmc_done_handler_t handler, void *p_context) {
+    return esl_nvmc_erase_pages(page_addr, 1, handler, p_context);
+}
+
+// The CPU stalls on instruction fetch while the NVMC is busy, so each slice
+// is kept short: a few words of a write, or one partial erase step.
+static bool job_step(void) {
+    if (jobs_head == jobs_tail) {
+        return false;
+    }
+
+    nvmc_job_t *job = &jobs[jobs_head];
+    esl_ret_code_t res = ESL_SUCCESS;
+    bool done;
+    uint32_t start = esl_cycles_get();
+
+    if (job->chained && last_result != ESL_SUCCESS) {
+        // What it builds on isn't in flash, so it isn't written either
+        res = last_result;
+        done = true;
+    } else if (job->type == NVMC_JOB_WRITE) {
+        for (uint32_t n = 0; n < ESL_NVMC_WRITE_SLICE_WORDS && job->done < job->words; n++) {
+            uint32_t addr = job->addr + job->done * sizeof(uint32_t);
+            if (!nrfx_nvmc_word_writable_check(addr, job->data[job->done])) {
+                res = ESL_ERR_NVMC_NOT_WRITABLE;
+                break;
+            }
+            nrfx_nvmc_word_write(addr, job->data[job->done]);
+            while (!nrfx_nvmc_write_done_check()) {}
+            job->done++;
+        }
+        done = res != ESL_SUCCESS || job->done == job->words;
+        if (res != ESL_SUCCESS) {
+            nvmc_stats.write_failures++;
+            NRF_LOG_ERROR("Flash write at 0x%x failed", job->addr);
+        }
+    } else {
+        if (!erase_started) {
+            nrfx_nvmc_page_partial_erase_init(job->addr + job->done * PAGE_SIZE, ESL_NVMC_ERASE_SLICE_MS);
+            erase_started = true;
+        }
+        if (nrfx_nvmc_page_partial_erase_continue()) {
+            erase_started = false;
+            job->done++;
+            nvmc_stats.page_erases++;
+        }
+        done = job->done == job->words;
+    }
+
+    uint32_t stall = esl_cycles_get() - start;
+    uint32_t *max_stall = job->type == NVMC_JOB_WRITE ? &nvmc_stats.max_write_stall_cycles
+                                                      : &nvmc_stats.max_erase_stall_cycles;
+    if (stall > *max_stall) {
+        *max_stall = stall;
+    }
+
+    if (done) {
+        esl_nvmc_done_handler_t handler = job->handler;
+        void *p_context = job->p_context;
+        if (in_colors(job->addr)) {
+            colors_jobs--;
+        }
+        last_result = res;
+        jobs_head = (jobs_head + 1) % ESL_NVMC_JOB_QUEUE_SIZE;
+        if (handler) {
+            handler(res, p_context);
+        }
+    }
+    return jobs_head != jobs_tail;
+}
+
+// Queues background color work while there is room, then runs one slice
+bool esl_nvmc_process(void) {
+    colors_work();
+    bool jobs_left = job_step();
+    return jobs_left || colors_work_pending();
+}
+
+void esl_nvmc_flush(void) {
+    while (esl_nvmc_process()) {}
+}
+
+esl_ret_code_t esl_nvmc_read(uint32_t addr, void *buffer, size_t size) {
+    if (addr % sizeof(uint32_t) != 0) {
+        NRF_LOG_ERROR("Address is not aligned!");
+        return ESL_ERROR;
+    }
+    memcpy(buffer, (const void *)addr, size);
+    return ESL_SUCCESS;
+}
+
+bool esl_nvmc_last_rgb_load(esl_nvmc_rgb_data_t *rgb) {
+    if (log_newest(last_rgb_pages[last_rgb_page], last_rgb_idx, rgb)) {
+        return true;
+    }
+
+    if (last_rgb_idx != 0) {
+        // Page holds data but no valid record
+        NRF_LOG_ERROR("Last color log corrupted");
+        page_erase(last_rgb_pages[last_rgb_page]);
+        last_rgb_idx = 0;
+    }
+    return false;
+}
+
+// Appends one word to the log. The page is only erased once it is full and
+// the log has moved on to the spare page.
+esl_ret_code_t esl_nvmc_last_rgb_save(uint8_t r, uint8_t g, uint8_t b) {
+    esl_nvmc_rgb_data_t curr_rgb = {
+        .magic_number = ESL_NVMC_BYTE_VALID,
+        .r_val = r,
+        .g_val = g,
+        .b_val = b
+    };
+
+    if (last_rgb_valid && memcmp(&last_rgb, &curr_rgb, sizeof(curr_rgb)) == 0) {
+        nvmc_stats.last_rgb_unchanged++;
+        return ESL_SUCCESS;
+    }
+
+    uint8_t page = last_rgb_page;
+    uint32_t idx = last_rgb_idx;
+    if (idx == LOG_WORDS) {
+        page ^= 1;
+        idx = 0;
+    }
+
+    // The record and the erase that may follow it go in together
+    if (esl_nvmc_jobs_free() < (page != last_rgb_page ? 3 : 2)) {
+        nvmc_stats.queue_full++;
+        return ESL_ERR_BUSY;
+    }
+
+    // A cut write leaves only the low half of the word programmed, which
+    // holds the magic byte. The color goes in first and the magic byte is
+    // programmed over it, so a record is either whole or not valid.
+    uint32_t addr = last_rgb_pages[page] + idx * sizeof(uint32_t);
+    esl_nvmc_rgb_data_t body = curr_rgb;
+    body.magic_number = 0xFF;
+    esl_ret_code_t res = ESL_SUCCESS;
+    if (body.r_val != 0xFF || body.g_val != 0xFF || body.b_val != 0xFF) {
+        res = esl_nvmc_write(addr, &body, sizeof(body), NULL, NULL);
+    }
+    if (res == ESL_SUCCESS) {
+        res = esl_nvmc_write_chained(addr, &curr_rgb, sizeof(curr_rgb), NULL, NULL);
+    }
+    if (res != ESL_SUCCESS) {
+        NRF_LOG_ERROR("Not writable");
+        return res;
+    }
+
+    if (page != last_rgb_page) {
+        // The erase is queued behind the new record, so the full page is
+        // only retired once the record is in place
+        page_erase(last_rgb_pages[last_rgb_page]);
+        nvmc_stats.last_rgb_erases++;
+        last_rgb_page = page;
+    }
+    last_rgb_idx = idx + 1;
+    last_rgb = curr_rgb;
+    last_rgb_valid = true;
+    nvmc_stats.last_rgb_saves++;
+
+    NRF_LOG_INFO("Address: 0x%x", addr);
+    NRF_LOG_INFO("RGB Data: %d %d %d", curr_rgb.r_val, curr_rgb.g_val, curr_rgb.b_val);
+    return ESL_SUCCESS;
+}
+
+static int16_t page_free_find(void) {
+    for (uint8_t page = 0; page < ESL_NVMC_COLOR_PAGES; page++) {
+        if (colors_pages[page].seq == WORD_ERASED) {
+            return page;
+        }
+    }
+    return -1;
+}
+
+static uint8_t pages_free_count(void) {
+    uint8_t count = 0;
+    for (uint8_t page = 0; page < ESL_NVMC_COLOR_PAGES; page++) {
+        if (colors_pages[page].seq == WORD_ERASED) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// Seals the head page and starts appending to a free one. The sealed page
+// is summarized from the main loop.
+static esl_ret_code_t head_advance(void) {
+    int16_t page = page_free_find();
+    if (page < 0) {
+        return ESL_ERR_NVMC_MEMORY_FULL;
+    }
+
+    uint32_t header[PAGE_HDR_WORDS] = { colors_page_seq, ~colors_page_seq };
+    esl_ret_code_t res = esl_nvmc_write(colors_page_addr(page), header, sizeof(header), NULL, NULL);
+    if (res != ESL_SUCCESS) {
+        return res;
+    }
+
+    colors_pages[page].seq = colors_page_seq++;
+    colors_pages[page].used = PAGE_HDR_WORDS;
+    colors_pages[page].live = 0;
+    colors_pages[page].summarized = false;
+    colors_head = page;
+    return ESL_SUCCESS;
+}
+
+// Page with the fewest words of live records, optionally leaving out the head
+static int16_t colors_victim_find(bool skip_head) {
+    int16_t victim = -1;
+
+    for (uint8_t page = 0; page < ESL_NVMC_COLOR_PAGES; page++) {
+        if (colors_pages[page].seq == WORD_ERASED || (skip_head && page == colors_head)) {
+            continue;
+        }
+        if (victim < 0 || colors_pages[page].live < colors_pages[victim].live) {
+            victim = page;
+        }
+    }
+    return victim;
+}
+
+// Frees the page holding the fewest live records: a new head page is opened
+// and the main loop moves the records there, then erases the page
+static esl_ret_code_t colors_compact(void) {
+    int16_t victim = colors_victim_find(false);
+    if (victim < 0) {
+        return ESL_ERR_NVMC_MEMORY_FULL;
+    }
+
+    esl_ret_code_t res = head_advance();
+    if (res != ESL_SUCCESS) {
+        return res;
+    }
+    evac_start(victim);
+    return ESL_SUCCESS;
+}
+
+// Free words of the head page, less what compaction still has to move there
+static uint32_t head_room(void) {
+    uint32_t taken = colors_pages[colors_head].used;
+    if (evac_victim >= 0) {
+        taken += colors_pages[evac_victim].live;
+    }
+    return taken < PAGE_WORDS ? PAGE_WORDS - taken : 0;
+}
+
+// Makes sure the head page has room for a record of the given size
+static esl_ret_code_t colors_reserve(uint32_t words) {
+    if (live_colors_count >= COLORS_INDEX_CAPACITY || live_colors_words + words > COLORS_WORDS_MAX) {
+        return ESL_ERR_NVMC_MEMORY_FULL;
+    }
+    if (colors_head >= 0 && head_room() >= words) {
+        return ESL_SUCCESS;
+    }
+    if (evac_victim >= 0) {
+        // Room comes back once the compaction in progress is done
+        return ESL_ERR_BUSY;
+    }
+    // One erased page is kept for compaction
+    if (pages_free_count() >= 2) {
+        return head_advance();
+    }
+
+    esl_ret_code_t res = colors_compact();
+    if (res == ESL_SUCCESS && head_room() < words) {
+        res = ESL_ERR_NVMC_MEMORY_FULL;
+    }
+    return res;
+}
+
+// Color operations only start when all of their jobs fit in the queue, so
+// one is never left half queued
+static esl_ret_code_t color_op_room(uint8_t jobs) {
+    if (esl_nvmc_jobs_free() < jobs) {
+        nvmc_stats.queue_full++;
+        return ESL_ERR_BUSY;
+    }
+    return ESL_SUCCESS;
+}
+
+// Appends a record to the reserved space and indexes it in place of the
+// record at old_pos, if there is one. The old record is tombstoned once the
+// new one is committed.
+static esl_ret_code_t color_append(color_record_buf_t const *buf, uint32_t words, int32_t old_pos) {
+    uint16_t loc = LOC(colors_head, colors_pages[colors_head].used);
+    uint16_t old_loc = old_pos >= 0 ? name_index[old_pos] : LOC_NONE;
+
+    esl_ret_code_t res = record_queue(&buf->record, words, old_loc, old_pos >= 0);
+    if (res != ESL_SUCCESS) {
+        return res;
+    }
+    if (old_pos >= 0) {
+        live_sub(old_loc, loc_words(old_loc));
+        name_index[old_pos] = INDEX_DELETED;
+    }
+    char name[ESL_NVMC_COLOR_NAME_LEN];
+    record_name(&buf->record, name);
+    index_insert(name, loc);
+    live_add(loc, words);
+    return ESL_SUCCESS;
+}
+
+// Drops the record at an index position from flash and index
+static esl_ret_code_t color_remove(int32_t pos) {
+    uint16_t loc = name_index[pos];
+    uint32_t words = loc_words(loc);
+    color_commit_t *commit = commit_alloc(LOC_NONE, 0, loc);
+    esl_ret_code_t res = record_tombstone(loc, false, commit);
+    if (res != ESL_SUCCESS) {
+        commit_free(commit);
+        return res;
+    }
+    name_index[pos] = INDEX_DELETED;
+    live_sub(loc, words);
+    return ESL_SUCCESS;
+}
+
+static bool name_is_valid(const char *name) {
+    size_t len = strnlen(name, ESL_NVMC_COLOR_NAME_LEN);
+    return len > 0 && len < ESL_NVMC_COLOR_NAME_LEN;
+}
+
+// Adding an existing name replaces the stored color. The new record is
+// committed before the old one is tombstoned, so the name is never lost.
+esl_ret_code_t esl_nvmc_color_add(esl_nvmc_saved_color_t const *color) {
+    const char *name = color->fields.color_name;
+    if (!name_is_valid(name)) {
+        return ESL_ERROR;
+    }
+    esl_ret_code_t res = color_op_room(COLOR_OP_JOBS);
+    if (res != ESL_SUCCESS) {
+        return res;
+    }
+
+    int32_t old_pos = index_lookup(name);
+    color_record_buf_t buf;
+    uint16_t seq = old_pos >= 0 ? record_get(name_index[old_pos], &buf)->seq + 1 : 0;
+    uint32_t words = record_encode(&buf, color, seq);
+
+    res = colors_reserve(words);
+    if (res == ESL_ERR_NVMC_MEMORY_FULL && old_pos >= 0) {
+        // No room for a second copy: replacing is only possible by dropping
+        // the old version first, which is no use while a compaction runs
+        if (evac_victim >= 0) {
+            return ESL_ERR_BUSY;
+        }
+        if (color_remove(old_pos) != ESL_SUCCESS) {
+            return ESL_ERR_NVMC_MEMORY_FULL;
+        }
+        old_pos = -1;
+        res = colors_reserve(words);
+    }
+    if (res != ESL_SUCCESS) {
+        return res;
+    }
+    return color_append(&buf, words, old_pos);
+}
+
+esl_ret_code_t esl_nvmc_color_find(const char *name, esl_nvmc_saved_color_t *color) {
+    int32_t pos = index_lookup(name);
+    if (pos < 0) {
+        return ESL_ERR_NVMC_NOT_FOUND;
+    }
+    color_record_buf_t buf;
+    record_decode(record_get(name_index[pos], &buf), color);
+    return ESL_SUCCESS;
+}
+
+esl_ret_code_t esl_nvmc_color_delete(const char *name) {
+    int32_t pos = index_lookup(name);
+    if (pos < 0) {
+        return ESL_ERR_NVMC_NOT_FOUND;
+    }
+    esl_ret_code_t res = color_op_room(1);
+    if (res != ESL_SUCCESS) {
+        return res;
+    }
+    return color_remove(pos);
+}
+
+// Writes the color under the new name, then tombstones the old record
+esl_ret_code_t esl_nvmc_color_rename(const char *old_name, const char *new_name) {
+    if (!name_is_valid(new_name)) {
+        return ESL_ERROR;
+    }
+    int32_t old_pos = index_lookup(old_name);
+    if (old_pos < 0) {
+        return ESL_ERR_NVMC_NOT_FOUND;
+    }
+    if (index_lookup(new_name) >= 0) {
+        return ESL_ERR_NVMC_EXISTS;
+    }
+    esl_ret_code_t res = color_op_room(COLOR_OP_JOBS);
+    if (res != ESL_SUCCESS) {
+        return res;
+    }
+
+    esl_nvmc_saved_color_t renamed;
+    color_record_buf_t buf;
+    record_decode(record_get(name_index[old_pos], &buf), &renamed);
+    memset(renamed.fields.color_name, 0, sizeof(renamed.fields.color_name));
+    strncpy(renamed.fields.color_name, new_name, sizeof(renamed.fields.color_name) - 1);
+    uint32_t words = record_encode(&buf, &renamed, 0);
+
+    res = colors_reserve(words);
+    if (res != ESL_SUCCESS) {
+        return res;
+    }
+    return color_append(&buf, words, old_pos);
+}
+
+uint32_t esl_nvmc_color_count(void) {
+    return live_colors_count;
+}
+
+// Iterates over live colors in storage order, start with *iter = 0. Only
+// the copy the index points at counts, one being compacted may be in two
+// places for a while.
+bool esl_nvmc_color_next(uint32_t *iter, esl_nvmc_saved_color_t *color) {
+    color_record_buf_t buf;
+
+    while (*iter < ESL_NVMC_COLOR_PAGES * PAGE_WORDS) {
+        uint8_t page = *iter / PAGE_WORDS;
+        uint32_t off = *iter % PAGE_WORDS;
+        uint32_t words = 0;
+        color_record_t const *record = NULL;
+
+        if (colors_pages[page].seq != WORD_ERASED && off < colors_pages[page].used) {
+            off = off < PAGE_HDR_WORDS ? PAGE_HDR_WORDS : off;
+            record = record_get(LOC(page, off), &buf);
+            words = record_span(page, off, record);
+        }
+        if (words == 0) {
+            *iter = (page + 1) * PAGE_WORDS;
+            continue;
+        }
+
+        *iter = LOC(page, off) + words;
+        if (record_words(record, off) > 0 && record_state(record) == RECORD_LIVE) {
+            char name[ESL_NVMC_COLOR_NAME_LEN];
+            record_name(record, name);
+            int32_t pos = index_probe(name, record->name_len);
+            if (pos >= 0 && name_index[pos] == LOC(page, off)) {
+                record_decode(record, color);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void esl_nvmc_stats_get(esl_nvmc_stats_t *stats) {
+    *stats = nvmc_stats;
+    stats->last_rgb_idx = last_rgb_idx;
+    stats->colors_bytes_used = live_colors_words * sizeof(uint32_t);
+    stats->colors_bytes_max = COLORS_WORDS_MAX * sizeof(uint32_t);
+}
@@ -0,0 +1,106 @@
+#ifndef ESL_NVMC_H
+#define ESL_NVMC_H
+
+#include "esl_utils.h"
+#include "sdk_config.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define BOOTLOADER_START_ADDR       (0x000E0000)
+#define PAGE_SIZE                   (0x1000)
+#define APP_DATA_END_ADDR           BOOTLOADER_START_ADDR
+#define LAST_COLOR_SPARE_PG_ADDR    (BOOTLOADER_START_ADDR - 1 * PAGE_SIZE)
+#define COLORS_SUMMARY_PG_ADDR      (BOOTLOADER_START_ADDR - 2 * PAGE_SIZE)
+#define LAST_COLOR_PG_ADDR          (BOOTLOADER_START_ADDR - 3 * PAGE_SIZE)
+#define COLORS_END_ADDR             LAST_COLOR_PG_ADDR
+#define COLORS_START_ADDR           (COLORS_END_ADDR - ESL_NVMC_COLOR_PAGES * PAGE_SIZE)
+#define CLIPS_END_ADDR              COLORS_START_ADDR
+#define CLIPS_START_ADDR            (CLIPS_END_ADDR - ESL_CLIP_PAGES * PAGE_SIZE)
+#define MACROS_END_ADDR             CLIPS_START_ADDR
+#define MACROS_START_ADDR           (MACROS_END_ADDR - ESL_MACRO_PAGES * PAGE_SIZE)
+#define APP_DATA_START_ADDR         MACROS_START_ADDR
+#define ESL_NVMC_COLOR_NAME_LEN     (32)
+
+typedef struct {
+    uint8_t magic_number;
+    uint8_t r_val;
+    uint8_t g_val;
+    uint8_t b_val;
+} esl_nvmc_rgb_data_t;
+
+typedef union {
+    struct
+    {
+        esl_nvmc_rgb_data_t rgb_data;
+        char                color_name[ESL_NVMC_COLOR_NAME_LEN];
+    } fields;
+    uint8_t bits[36];
+} __attribute__((packed)) esl_nvmc_saved_color_t;
+
+typedef struct {
+    uint32_t last_rgb_saves;
+    uint32_t last_rgb_erases;
+    uint32_t last_rgb_unchanged;    // Saves skipped, value already stored
+    uint32_t last_rgb_idx;      // Next free record in the active log page
+    uint32_t colors_compactions;
+    uint32_t colors_torn;           // Uncommitted or corrupted records skipped
+    uint32_t colors_scan_cycles;    // Boot scan and index build
+    uint32_t colors_pages_scanned;  // Pages checked record by record at boot
+    uint32_t colors_pages_summarized;   // Pages indexed from the summary page at boot
+    uint32_t colors_summary_rewrites;
+    uint32_t colors_bytes_used;     // Flash taken by live records
+    uint32_t colors_bytes_max;
+    uint32_t colors_decodes;
+    uint32_t colors_decode_cycles;  // Total over all decodes
+    uint32_t colors_pending_reads;  // Record reads served with writes still queued
+    uint32_t colors_rollbacks;      // Index changes undone after a failed write
+    uint32_t colors_migrated;       // Records converted from the fixed size format at boot
+    uint32_t page_erases;
+    uint32_t write_failures;
+    uint32_t queue_full;        // Requests turned away with ESL_ERR_BUSY
+    uint32_t max_write_stall_cycles;
+    uint32_t max_erase_stall_cycles;
+} esl_nvmc_stats_t;
+
+typedef void (*esl_nvmc_done_handler_t)(esl_ret_code_t result, void *p_context);
+
+void esl_nvmc_init(void);
+bool esl_nvmc_is_busy(void);    // True while flash jobs are queued
+uint8_t esl_nvmc_jobs_free(void);
+
+// Writes and erases are queued and executed in order by esl_nvmc_process().
+// Data is copied, the handler (may be NULL) is called once the job is done.
+// A full queue returns ESL_ERR_BUSY, nothing waits for it to drain.
+esl_ret_code_t esl_nvmc_write(uint32_t addr, const void *src, size_t size,
+                              esl_nvmc_done_handler_t handler, void *p_context);
+// Same, but skipped with the previous job's error if that one failed
+esl_ret_code_t esl_nvmc_write_chained(uint32_t addr, const void *src, size_t size,
+                                      esl_nvmc_done_handler_t handler, void *p_context);
+esl_ret_code_t esl_nvmc_erase(uint32_t page_addr, esl_nvmc_done_handler_t handler, void *p_context);
+esl_ret_code_t esl_nvmc_erase_pages(uint32_t page_addr, uint32_t pages,
+                                    esl_nvmc_done_handler_t handler, void *p_context);
+// Runs one slice, returns true while jobs or background color work remain
+bool esl_nvmc_process(void);
+void esl_nvmc_flush(void);
+esl_ret_code_t esl_nvmc_read(uint32_t addr, void *buffer, size_t size);
+
+// Last used color, kept as an append-only log of one word records
+bool esl_nvmc_last_rgb_load(esl_nvmc_rgb_data_t *rgb);
+esl_ret_code_t esl_nvmc_last_rgb_save(uint8_t r, uint8_t g, uint8_t b);   // No-op if unchanged
+
+// User saved colors, looked up by name through a hash index. Colors are
+// stored in a compact form and decoded into the caller's buffer. Changes
+// show up right away and are rolled back if their flash writes fail.
+// Compaction runs from esl_nvmc_process(); changes needing room it hasn't
+// freed yet return ESL_ERR_BUSY.
+esl_ret_code_t esl_nvmc_color_add(esl_nvmc_saved_color_t const *color);
+esl_ret_code_t esl_nvmc_color_find(const char *name, esl_nvmc_saved_color_t *color);
+esl_ret_code_t esl_nvmc_color_delete(const char *name);
+esl_ret_code_t esl_nvmc_color_rename(const char *old_name, const char *new_name);
+uint32_t esl_nvmc_color_count(void);
+bool esl_nvmc_color_next(uint32_t *iter, esl_nvmc_saved_color_t *color);    // Start with *iter = 0
+
+void esl_nvmc_stats_get(esl_nvmc_stats_t *stats);
+
+#endif // ESL_NVMC_H
@@ -0,0 +1,36 @@
+#include "esl_power.h"
+#include "nrf.h"
+#include "esl_clock.h"
+
+static esl_power_stats_t power_stats;
+static uint64_t last_wakeup_tick;
+
+void esl_power_init(void) {
+    power_stats = (esl_power_stats_t){0};
+    last_wakeup_tick = esl_clock_ticks();
+}
+
+void esl_power_idle(void) {
+    uint64_t sleep_tick = esl_clock_ticks();
+    power_stats.awake_ticks += sleep_tick - last_wakeup_tick;
+
+#if (__FPU_USED == 1)
+    // Pending FPU exceptions would keep the CPU from sleeping (nRF52 errata 87)
+    __set_FPSCR(__get_FPSCR() & ~(0x0000009F));
+    (void) __get_FPSCR();
+    NVIC_ClearPendingIRQ(FPU_IRQn);
+#endif
+
+    // A single WFE is race free: an interrupt taken after the caller checked
+    // its queues has already set the event register, so WFE returns at once
+    // and the main loop gets another pass.
+    __WFE();
+
+    last_wakeup_tick = esl_clock_ticks();
+    power_stats.sleep_ticks += last_wakeup_tick - sleep_tick;
+    power_stats.wakeups++;
+}
+
+void esl_power_stats_get(esl_power_stats_t *stats) {
+    *stats = power_stats;
+}
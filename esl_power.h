@@ -0,0 +1,16 @@
+#ifndef ESL_POWER_H
+#define ESL_POWER_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t wakeups;
+    uint64_t sleep_ticks;   // esl_clock ticks spent in WFE
+    uint64_t awake_ticks;   // esl_clock ticks spent running
+} esl_power_stats_t;
+
+void esl_power_init(void);
+void esl_power_idle(void);  // Sleep until the next event or interrupt
+void esl_power_stats_get(esl_power_stats_t *stats);
+
+#endif // ESL_POWER_H
@@ -1,4 +1,43 @@
 #include "esl_pwm.h"
+#include "esl_clock.h"
+
+#include <stddef.h>
+
+static esl_pwm_stream_handler_t stream_handler = NULL;
+
+static void pwm_event_handler(nrfx_pwm_evt_type_t event_type) {
+    if (stream_handler == NULL) {
+        return;
+    }
+    if (event_type == NRFX_PWM_EVT_END_SEQ0) {
+        stream_handler(0);
+    } else if (event_type == NRFX_PWM_EVT_END_SEQ1) {
+        stream_handler(1);
+    }
+}
+
+// Converts the time elapsed at a rate given in units per second into whole
+// units. The remainder is carried over, so animation speed follows wall time
+// no matter how irregularly the caller is scheduled.
+static int integrate(uint32_t *acc, uint32_t rate, uint32_t dt_ticks) {
+    *acc += rate * dt_ticks;
+    int units = *acc / ESL_CLOCK_FREQ;
+    *acc %= ESL_CLOCK_FREQ;
+    return units;
+}
+
+// Moves value by units in the current direction, reversing at the limits
+static int bounce(int value, int units, bool *direction, int min, int max) {
+    value += *direction ? units : -units;
+    if (value >= max) {
+        value = max;
+        *direction = false;
+    } else if (value <= min) {
+        value = min;
+        *direction = true;
+    }
+    return value;
+}
 
 void esl_pwm_init(esl_pwm_context_t *ctx) {
     static const nrfx_pwm_t pwm0_instance = NRFX_PWM_INSTANCE(0); // Declare PWM instance
@@ -20,7 +59,7 @@ void esl_pwm_init(esl_pwm_context_t *ctx) {
     pwm_config.load_mode = NRF_PWM_LOAD_INDIVIDUAL;
     pwm_config.base_clock = NRF_PWM_CLK_500kHz;
 
-    nrfx_pwm_init(&pwm0_instance, &pwm_config, NULL);
+    nrfx_pwm_init(&pwm0_instance, &pwm_config, pwm_event_handler);
     ctx->pwm_instance = &pwm0_instance;    
     
     ctx->pwm_seq_values = (nrf_pwm_values_individual_t){0};
@@ -31,6 +70,7 @@ void esl_pwm_init(esl_pwm_context_t *ctx) {
         .end_delay = 0
     };
     
+    ctx->streaming = false;
     ctx->current_input_mode = ESL_PWM_IN_NO_INPUT;
     ctx->current_blink_mode = ESL_PWM_CONST_OFF;
     
@@ -63,10 +103,11 @@ void esl_pwm_update_duty_cycle(esl_pwm_context_t *ctx, esl_io_pin_t out_pin, uin
     }
 }
 
-void esl_pwm_update_led1(esl_pwm_context_t *ctx) {
+void esl_pwm_update_led1(esl_pwm_context_t *ctx, uint32_t dt_ticks) {
     static bool led1_direction = true;
     static int led1_duty_cycle = 0;
-    int step = (ctx->current_blink_mode == ESL_PWM_BLINK_SLOW) ? 5 : 20;
+    static uint32_t led1_acc = 0;
+    uint32_t rate = (ctx->current_blink_mode == ESL_PWM_BLINK_SLOW) ? LED1_BLINK_SLOW_RATE : LED1_BLINK_FAST_RATE;
 
     switch (ctx->current_blink_mode) {
         case ESL_PWM_CONST_OFF:
@@ -79,19 +120,8 @@ void esl_pwm_update_led1(esl_pwm_context_t *ctx) {
 
         case ESL_PWM_BLINK_SLOW:
         case ESL_PWM_BLINK_FAST:
-            if (led1_direction) {
-                led1_duty_cycle += step;
-            } else {
-                led1_duty_cycle -= step;
-            }
-
-            if (led1_duty_cycle >= PWM_TOP_VAL * 0.9) {
-                led1_duty_cycle = PWM_TOP_VAL * 0.9;
-                led1_direction = false;
-            } else if (led1_duty_cycle <= 0) {
-                led1_duty_cycle = 0;
-                led1_direction = true;
-            }
+            led1_duty_cycle = bounce(led1_duty_cycle, integrate(&led1_acc, rate, dt_ticks),
+                                     &led1_direction, 0, PWM_TOP_VAL * 0.9);
             esl_pwm_update_duty_cycle(ctx, LED1, led1_duty_cycle);
             break;
 
@@ -103,62 +133,51 @@ void esl_pwm_update_led1(esl_pwm_context_t *ctx) {
 #endif // PWM_TOP_VAL
 
 #ifdef HSV_STEP
-void esl_pwm_update_hsv(esl_pwm_context_t *ctx) {
+void esl_pwm_update_hsv(esl_pwm_context_t *ctx, uint32_t dt_ticks) {
     static bool hue_direction = true;
     static bool saturation_direction = true;
     static bool brightness_direction = true;
+    static uint32_t hsv_acc = 0;
+    int units = integrate(&hsv_acc, HSV_RATE, dt_ticks);
 
     switch (ctx->current_input_mode) {
         case ESL_PWM_IN_HUE:
-            if (hue_direction) {
-                ctx->hsv_state.hue += HSV_STEP;
-                if (ctx->hsv_state.hue >= 360) {
-                    ctx->hsv_state.hue = 360;
-                    hue_direction = false;
-                }
-            } else {
-                ctx->hsv_state.hue -= HSV_STEP;
-                if (ctx->hsv_state.hue <= 0) {
-                    ctx->hsv_state.hue = 0;
-                    hue_direction = true;
-                }
-            }
+            ctx->hsv_state.hue = bounce(ctx->hsv_state.hue, units, &hue_direction, 0, 360);
             break;
         case ESL_PWM_IN_SATURATION:
-            if (saturation_direction) {
-                ctx->hsv_state.saturation += HSV_STEP;
-                if (ctx->hsv_state.saturation >= 100) {
-                    ctx->hsv_state.saturation = 100;
-                    saturation_direction = false;
-                }
-            } else {
-                ctx->hsv_state.saturation -= HSV_STEP;
-                if (ctx->hsv_state.saturation <= 0) {
-                    ctx->hsv_state.saturation = 0;
-                    saturation_direction = true;
-                }
-            }
+            ctx->hsv_state.saturation = bounce(ctx->hsv_state.saturation, units, &saturation_direction, 0, 100);
             break;
         case ESL_PWM_IN_BRIGHTNESS:
-            if (brightness_direction) {
-                ctx->hsv_state.brightness += HSV_STEP;
-                if (ctx->hsv_state.brightness >= 100) {
-                    ctx->hsv_state.brightness = 100;
-                    brightness_direction = false;
-                }
-            } else {
-                ctx->hsv_state.brightness -= HSV_STEP;
-                if (ctx->hsv_state.brightness <= 0) {
-                    ctx->hsv_state.brightness = 0;
-                    brightness_direction = true;
-                }
-            }
+            ctx->hsv_state.brightness = bounce(ctx->hsv_state.brightness, units, &brightness_direction, 0, 100);
             break;
         default:
             break;
     }
 }
 
+// Move the component selected by the input mode one step in the given direction
+void esl_pwm_step_hsv(esl_pwm_context_t *ctx, int8_t direction) {
+    int delta = direction * HSV_STEP;
+
+    switch (ctx->current_input_mode) {
+        case ESL_PWM_IN_HUE:
+            ctx->hsv_state.hue = (ctx->hsv_state.hue + 360 + delta) % 360;
+            break;
+        case ESL_PWM_IN_SATURATION: {
+            int saturation = ctx->hsv_state.saturation + delta;
+            ctx->hsv_state.saturation = saturation < 0 ? 0 : (saturation > 100 ? 100 : saturation);
+            break;
+        }
+        case ESL_PWM_IN_BRIGHTNESS: {
+            int brightness = ctx->hsv_state.brightness + delta;
+            ctx->hsv_state.brightness = brightness < 0 ? 0 : (brightness > 100 ? 100 : brightness);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
 #endif // HSV_STEP
 
 void esl_pwm_update_rgb(esl_pwm_context_t *ctx) {
@@ -168,5 +187,24 @@ void esl_pwm_update_rgb(esl_pwm_context_t *ctx) {
 }
 
 void esl_pwm_play_seq(esl_pwm_context_t *ctx) {
+    if (ctx->streaming) {
+        return;
+    }
     nrfx_pwm_simple_playback(ctx->pwm_instance, &ctx->pwm_sequence, 1, NRFX_PWM_FLAG_LOOP);
+}
+
+void esl_pwm_stream_start(esl_pwm_context_t *ctx, nrf_pwm_sequence_t const *seq0,
+                          nrf_pwm_sequence_t const *seq1, esl_pwm_stream_handler_t handler) {
+    stream_handler = handler;
+    ctx->streaming = true;
+    nrfx_pwm_complex_playback(ctx->pwm_instance, seq0, seq1, 1,
+                              NRFX_PWM_FLAG_LOOP | NRFX_PWM_FLAG_SIGNAL_END_SEQ0 |
+                              NRFX_PWM_FLAG_SIGNAL_END_SEQ1 | NRFX_PWM_FLAG_NO_EVT_FINISHED);
+}
+
+void esl_pwm_stream_stop(esl_pwm_context_t *ctx) {
+    nrfx_pwm_stop(ctx->pwm_instance, true);
+    stream_handler = NULL;
+    ctx->streaming = false;
+    esl_pwm_play_seq(ctx);
 }
\ No newline at end of file
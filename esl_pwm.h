@@ -33,6 +33,9 @@ typedef struct
     uint8_t blue;
 } esl_pwm_rgb_t;
 
+// Called from the PWM interrupt once a stream buffer has been played out
+typedef void (*esl_pwm_stream_handler_t)(uint8_t buf_idx);
+
 typedef struct {
     const nrfx_pwm_t * pwm_instance;
     nrf_pwm_values_individual_t pwm_seq_values;
@@ -41,14 +44,22 @@ typedef struct {
     esl_pwm_blink_mode_t current_blink_mode;
     esl_pwm_hsv_t hsv_state;
     esl_pwm_rgb_t rgb_state;
+    volatile bool streaming;    // A stream owns the outputs, esl_pwm_play_seq() is ignored
 } esl_pwm_context_t;
 
 
 void esl_pwm_init(esl_pwm_context_t *ctx);
 void esl_pwm_update_duty_cycle(esl_pwm_context_t *ctx, esl_io_pin_t out_pin, uint8_t val);
-void esl_pwm_update_hsv(esl_pwm_context_t *ctx);
-void esl_pwm_update_led1(esl_pwm_context_t *ctx);
+void esl_pwm_update_hsv(esl_pwm_context_t *ctx, uint32_t dt_ticks);
+void esl_pwm_step_hsv(esl_pwm_context_t *ctx, int8_t direction);
+void esl_pwm_update_led1(esl_pwm_context_t *ctx, uint32_t dt_ticks);
 void esl_pwm_update_rgb(esl_pwm_context_t *ctx);
 void esl_pwm_play_seq(esl_pwm_context_t *ctx);
 
+// Plays two sequences back to back in a loop. The buffers stay in use until
+// the stream is stopped; the one just played is refilled while the other plays.
+void esl_pwm_stream_start(esl_pwm_context_t *ctx, nrf_pwm_sequence_t const *seq0,
+                          nrf_pwm_sequence_t const *seq1, esl_pwm_stream_handler_t handler);
+void esl_pwm_stream_stop(esl_pwm_context_t *ctx);   // Returns the outputs to esl_pwm_play_seq()
+
 #endif
\ No newline at end of file
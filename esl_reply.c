@@ -0,0 +1,250 @@
+#include "esl_reply.h"
+
+#include <string.h>
+
+// CBOR major types (RFC 8949) and the bytes used as they are
+#define CBOR_UINT                   (0)
+#define CBOR_NEGINT                 (1)
+#define CBOR_TEXT                   (3)
+#define CBOR_ARRAY_OPEN             (0x9F)  // Indefinite length, ends with a break
+#define CBOR_MAP_OPEN               (0xBF)
+#define CBOR_FALSE                  (0xF4)
+#define CBOR_TRUE                   (0xF5)
+#define CBOR_BREAK                  (0xFF)
+
+static void cbor_byte(esl_txq_t *q, uint8_t byte) {
+    esl_txq_msg_append(q, &byte, 1);
+}
+
+// Shortest form of the argument, big endian
+static void cbor_head(esl_txq_t *q, uint8_t major, uint32_t value) {
+    uint8_t buf[5];
+    uint8_t len;
+
+    if (value < 24) {
+        buf[0] = (major << 5) | value;
+        len = 1;
+    } else if (value <= UINT8_MAX) {
+        buf[0] = (major << 5) | 24;
+        buf[1] = value;
+        len = 2;
+    } else if (value <= UINT16_MAX) {
+        buf[0] = (major << 5) | 25;
+        buf[1] = value >> 8;
+        buf[2] = value;
+        len = 3;
+    } else {
+        buf[0] = (major << 5) | 26;
+        buf[1] = value >> 24;
+        buf[2] = value >> 16;
+        buf[3] = value >> 8;
+        buf[4] = value;
+        len = 5;
+    }
+    esl_txq_msg_append(q, buf, len);
+}
+
+static void cbor_text(esl_txq_t *q, const char *str, uint16_t len) {
+    cbor_head(q, CBOR_TEXT, len);
+    esl_txq_msg_append(q, str, len);
+}
+
+// Runs that need no escaping are copied as they are, UTF-8 included, as
+// JSON is UTF-8. Control characters are written as \u00XX.
+static void json_text(esl_txq_t *q, const char *str, uint16_t len) {
+    static const char hex[] = "0123456789abcdef";
+    uint16_t start = 0;
+
+    esl_fmt_char(q, '"');
+    for (uint16_t i = 0; i < len; i++) {
+        uint8_t c = str[i];
+        if (c >= ' ' && c != 0x7F && c != '"' && c != '\\') {
+            continue;
+        }
+        esl_txq_msg_append(q, str + start, i - start);
+        if (c == '"' || c == '\\') {
+            char esc[2] = { '\\', c };
+            esl_txq_msg_append(q, esc, sizeof(esc));
+        } else {
+            char esc[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF] };
+            esl_txq_msg_append(q, esc, sizeof(esc));
+        }
+        start = i + 1;
+    }
+    esl_txq_msg_append(q, str + start, len - start);
+    esl_fmt_char(q, '"');
+}
+
+// Starts the next entry of the map or list at the current depth. Keys are
+// literals and never need escaping.
+static void key_write(esl_reply_t *r, const char *key) {
+    if (r->mode == ESL_REPLY_MODE_JSON) {
+        uint8_t bit = 1 << r->depth;
+        if (r->has_items & bit) {
+            esl_fmt_char(r->q, ',');
+        }
+        r->has_items |= bit;
+        if (key != NULL) {
+            esl_fmt_char(r->q, '"');
+            esl_fmt_str(r->q, key);
+            ESL_FMT_TEXT(r->q, "\":");
+        }
+    } else if (key != NULL) {
+        cbor_text(r->q, key, strlen(key));
+    }
+}
+
+// Label in text, key in the machine modes. False when the value is left out.
+static bool value_begin(esl_reply_t *r, const char *key, const char *label) {
+    if (r->mode == ESL_REPLY_MODE_TEXT) {
+        if (label != NULL) {
+            esl_fmt_str(r->q, label);
+        }
+        return true;
+    }
+    if (key == NULL) {
+        return false;
+    }
+    key_write(r, key);
+    return true;
+}
+
+static void nest_begin(esl_reply_t *r, const char *key, char json_open, uint8_t cbor_open) {
+    if (r->mode == ESL_REPLY_MODE_TEXT) {
+        return;
+    }
+    key_write(r, key);
+    if (r->mode == ESL_REPLY_MODE_JSON) {
+        esl_fmt_char(r->q, json_open);
+    } else {
+        cbor_byte(r->q, cbor_open);
+    }
+    r->depth++;
+    r->has_items &= ~(1 << r->depth);
+}
+
+static void nest_end(esl_reply_t *r, char json_close) {
+    if (r->mode == ESL_REPLY_MODE_TEXT) {
+        return;
+    }
+    r->depth--;
+    if (r->mode == ESL_REPLY_MODE_JSON) {
+        esl_fmt_char(r->q, json_close);
+    } else {
+        cbor_byte(r->q, CBOR_BREAK);
+    }
+}
+
+void esl_reply_open(esl_reply_t *r, esl_txq_t *q, esl_reply_mode_t mode) {
+    r->q = q;
+    r->mode = mode;
+    r->depth = 0;
+    r->has_items = 0;
+    if (mode == ESL_REPLY_MODE_JSON) {
+        esl_fmt_char(q, '{');
+    } else if (mode == ESL_REPLY_MODE_CBOR) {
+        cbor_byte(q, CBOR_MAP_OPEN);
+    }
+}
+
+void esl_reply_close(esl_reply_t *r) {
+    if (r->mode == ESL_REPLY_MODE_JSON) {
+        ESL_FMT_TEXT(r->q, "}\n");
+    } else if (r->mode == ESL_REPLY_MODE_CBOR) {
+        cbor_byte(r->q, CBOR_BREAK);
+    }
+}
+
+void esl_reply_u32(esl_reply_t *r, const char *key, const char *label, uint32_t value) {
+    if (!value_begin(r, key, label)) {
+        return;
+    }
+    if (r->mode == ESL_REPLY_MODE_CBOR) {
+        cbor_head(r->q, CBOR_UINT, value);
+    } else {
+        esl_fmt_u32(r->q, value);
+    }
+}
+
+void esl_reply_i32(esl_reply_t *r, const char *key, const char *label, int32_t value) {
+    if (!value_begin(r, key, label)) {
+        return;
+    }
+    if (r->mode != ESL_REPLY_MODE_CBOR) {
+        esl_fmt_i32(r->q, value);
+    } else if (value < 0) {
+        cbor_head(r->q, CBOR_NEGINT, (uint32_t)(-1 - value));     // Can't overflow
+    } else {
+        cbor_head(r->q, CBOR_UINT, value);
+    }
+}
+
+// Machine modes get the number
+void esl_reply_hex32(esl_reply_t *r, const char *key, const char *label, uint32_t value) {
+    if (r->mode == ESL_REPLY_MODE_TEXT) {
+        value_begin(r, key, label);
+        esl_fmt_hex32(r->q, value);
+    } else {
+        esl_reply_u32(r, key, label, value);
+    }
+}
+
+void esl_reply_str(esl_reply_t *r, const char *key, const char *label, const char *str) {
+    esl_reply_strn(r, key, label, str, strlen(str));
+}
+
+void esl_reply_strn(esl_reply_t *r, const char *key, const char *label, const char *str, uint16_t len) {
+    if (!value_begin(r, key, label)) {
+        return;
+    }
+    switch (r->mode) {
+    case ESL_REPLY_MODE_JSON:
+        json_text(r->q, str, len);
+        break;
+    case ESL_REPLY_MODE_CBOR:
+        cbor_text(r->q, str, len);
+        break;
+    default:
+        esl_txq_msg_append(r->q, str, len);
+        break;
+    }
+}
+
+void esl_reply_bool(esl_reply_t *r, const char *key, const char *text, bool value) {
+    if (!value_begin(r, key, NULL)) {
+        return;
+    }
+    switch (r->mode) {
+    case ESL_REPLY_MODE_JSON:
+        esl_fmt_str(r->q, value ? "true" : "false");
+        break;
+    case ESL_REPLY_MODE_CBOR:
+        cbor_byte(r->q, value ? CBOR_TRUE : CBOR_FALSE);
+        break;
+    default:
+        esl_fmt_str(r->q, text);
+        break;
+    }
+}
+
+void esl_reply_tag(esl_reply_t *r, const char *key, const char *value) {
+    if (r->mode != ESL_REPLY_MODE_TEXT) {
+        esl_reply_str(r, key, NULL, value);
+    }
+}
+
+void esl_reply_obj_begin(esl_reply_t *r, const char *key) {
+    nest_begin(r, key, '{', CBOR_MAP_OPEN);
+}
+
+void esl_reply_obj_end(esl_reply_t *r) {
+    nest_end(r, '}');
+}
+
+void esl_reply_list_begin(esl_reply_t *r, const char *key) {
+    nest_begin(r, key, '[', CBOR_ARRAY_OPEN);
+}
+
+void esl_reply_list_end(esl_reply_t *r) {
+    nest_end(r, ']');
+}
@@ -0,0 +1,56 @@
+#ifndef ESL_REPLY_H
+#define ESL_REPLY_H
+
+#include "esl_fmt.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Replies described once, as values with a text label and a key, and
+// written in the session's output mode: text shows the labels, JSON and
+// CBOR the keys. Pieces that only make sense to a person (ESL_REPLY_TEXT,
+// values without a key) are left out of the machine modes, and tags are
+// left out of text. Everything goes straight into the message being built
+// in the output queue, see esl_txq_msg_begin(). Strings have to be UTF-8,
+// they go out as JSON and CBOR text as they are.
+
+typedef enum {
+    ESL_REPLY_MODE_TEXT = 0,
+    ESL_REPLY_MODE_JSON = 1,    // One object per line
+    ESL_REPLY_MODE_CBOR = 2,    // One indefinite length map per reply, back to back
+} esl_reply_mode_t;
+
+#define ESL_REPLY_DEPTH_MAX         (8)     // Reply map included
+
+typedef struct {
+    esl_txq_t *q;
+    esl_reply_mode_t mode;
+    uint8_t depth;
+    uint8_t has_items;          // Bit per depth, JSON needs a comma before the next
+} esl_reply_t;
+
+// Text only, the literal's length is known at compile time
+#define ESL_REPLY_TEXT(r, literal) \
+    do { if ((r)->mode == ESL_REPLY_MODE_TEXT) ESL_FMT_TEXT((r)->q, literal); } while (0)
+
+void esl_reply_open(esl_reply_t *r, esl_txq_t *q, esl_reply_mode_t mode);
+void esl_reply_close(esl_reply_t *r);
+
+// label goes before the value in text and may be NULL. A NULL key keeps
+// the value out of the machine modes.
+void esl_reply_u32(esl_reply_t *r, const char *key, const char *label, uint32_t value);
+void esl_reply_i32(esl_reply_t *r, const char *key, const char *label, int32_t value);
+void esl_reply_hex32(esl_reply_t *r, const char *key, const char *label, uint32_t value);
+void esl_reply_str(esl_reply_t *r, const char *key, const char *label, const char *str);
+void esl_reply_strn(esl_reply_t *r, const char *key, const char *label, const char *str, uint16_t len);
+// text is what a person reads for the state, e.g. "running"
+void esl_reply_bool(esl_reply_t *r, const char *key, const char *text, bool value);
+// Machine modes only, for what text says in its prose
+void esl_reply_tag(esl_reply_t *r, const char *key, const char *value);
+
+// Nesting, nothing in text. Objects in a list have no key.
+void esl_reply_obj_begin(esl_reply_t *r, const char *key);
+void esl_reply_obj_end(esl_reply_t *r);
+void esl_reply_list_begin(esl_reply_t *r, const char *key);
+void esl_reply_list_end(esl_reply_t *r);
+
+#endif // ESL_REPLY_H
@@ -0,0 +1,122 @@
+#include "esl_sched.h"
+#include "esl_utils.h"
+#include "sdk_config.h"
+#include "app_util_platform.h"
+
+#include <string.h>
+
+typedef struct {
+    esl_sched_handler_t handler;
+    uint16_t data_size;
+    uint8_t data[ESL_SCHED_MAX_DATA_SIZE];
+} esl_sched_item_t;
+
+typedef struct {
+    esl_sched_item_t items[ESL_SCHED_QUEUE_SIZE];
+    volatile uint8_t head;      // Next item to execute
+    volatile uint8_t tail;      // Next free slot
+} esl_sched_queue_t;
+
+static esl_sched_queue_t queues[ESL_SCHED_PRIO_COUNT];
+static esl_sched_stats_t stats[ESL_SCHED_STATS_SLOTS];
+static volatile uint32_t dropped_count = 0;
+
+static void stats_update(esl_sched_handler_t handler, uint32_t cycles) {
+    for (uint8_t i = 0; i < ESL_SCHED_STATS_SLOTS; i++) {
+        if (stats[i].handler == handler || stats[i].handler == NULL) {
+            stats[i].handler = handler;
+            stats[i].runs++;
+            stats[i].total_cycles += cycles;
+            if (cycles > stats[i].max_cycles) {
+                stats[i].max_cycles = cycles;
+            }
+            return;
+        }
+    }
+}
+
+// Pops the oldest item of the highest non-empty priority
+static bool pop(esl_sched_item_t *item) {
+    bool found = false;
+
+    CRITICAL_REGION_ENTER();
+    for (uint8_t prio = 0; prio < ESL_SCHED_PRIO_COUNT; prio++) {
+        esl_sched_queue_t *queue = &queues[prio];
+        if (queue->head != queue->tail) {
+            esl_sched_item_t *src = &queue->items[queue->head];
+            item->handler = src->handler;
+            item->data_size = src->data_size;
+            memcpy(item->data, src->data, src->data_size);
+            queue->head = (queue->head + 1) % ESL_SCHED_QUEUE_SIZE;
+            found = true;
+            break;
+        }
+    }
+    CRITICAL_REGION_EXIT();
+
+    return found;
+}
+
+void esl_sched_init(void) {
+    memset(queues, 0, sizeof(queues));
+    memset(stats, 0, sizeof(stats));
+    dropped_count = 0;
+    esl_cycles_init();
+}
+
+bool esl_sched_post(esl_sched_prio_t prio, esl_sched_handler_t handler, void const *p_data, uint16_t data_size) {
+    if (prio >= ESL_SCHED_PRIO_COUNT || handler == NULL || data_size > ESL_SCHED_MAX_DATA_SIZE) {
+        return false;
+    }
+
+    bool posted = false;
+
+    CRITICAL_REGION_ENTER();
+    esl_sched_queue_t *queue = &queues[prio];
+    uint8_t next_tail = (queue->tail + 1) % ESL_SCHED_QUEUE_SIZE;
+    if (next_tail != queue->head) {
+        esl_sched_item_t *dst = &queue->items[queue->tail];
+        dst->handler = handler;
+        dst->data_size = data_size;
+        if (data_size) {
+            memcpy(dst->data, p_data, data_size);
+        }
+        queue->tail = next_tail;
+        posted = true;
+    } else {
+        dropped_count++;
+    }
+    CRITICAL_REGION_EXIT();
+
+    return posted;
+}
+
+void esl_sched_execute(void) {
+    esl_sched_item_t item;
+
+    while (pop(&item)) {
+        uint32_t start = esl_cycles_get();
+        item.handler(item.data, item.data_size);
+        stats_update(item.handler, esl_cycles_get() - start);
+    }
+}
+
+bool esl_sched_is_empty(void) {
+    for (uint8_t prio = 0; prio < ESL_SCHED_PRIO_COUNT; prio++) {
+        if (queues[prio].head != queues[prio].tail) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t esl_sched_dropped_get(void) {
+    return dropped_count;
+}
+
+esl_sched_stats_t const * esl_sched_stats_get(uint8_t idx) {
+    if (idx >= ESL_SCHED_STATS_SLOTS || stats[idx].handler == NULL) {
+        return NULL;
+    }
+    return &stats[idx];
+}
@@ -0,0 +1,35 @@
+#ifndef ESL_SCHED_H
+#define ESL_SCHED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Run-to-completion scheduler. Interrupt handlers post work items, the main
+// loop executes them in priority order from thread context.
+
+typedef enum {
+    ESL_SCHED_PRIO_HIGH     = 0,
+    ESL_SCHED_PRIO_NORMAL   = 1,
+    ESL_SCHED_PRIO_LOW      = 2,
+    ESL_SCHED_PRIO_COUNT
+} esl_sched_prio_t;
+
+typedef void (*esl_sched_handler_t)(void *p_data, uint16_t data_size);
+
+typedef struct {
+    esl_sched_handler_t handler;
+    uint32_t runs;
+    uint64_t total_cycles;
+    uint32_t max_cycles;
+} esl_sched_stats_t;
+
+void esl_sched_init(void);
+// Copies data_size bytes of p_data into the queue. Safe to call from any interrupt.
+bool esl_sched_post(esl_sched_prio_t prio, esl_sched_handler_t handler, void const *p_data, uint16_t data_size);
+void esl_sched_execute(void);   // Run queued items until all queues are empty
+bool esl_sched_is_empty(void);
+uint32_t esl_sched_dropped_get(void);
+// Per-handler execution time accounting
+esl_sched_stats_t const * esl_sched_stats_get(uint8_t idx);
+
+#endif // ESL_SCHED_H
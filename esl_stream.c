@@ -0,0 +1,161 @@
+#include "esl_stream.h"
+#include "app_util_platform.h"
+
+#include <string.h>
+
+// Period of the PWM: 500 kHz base clock counting up to PWM_TOP_VAL
+#define PWM_PERIOD_US               ((uint32_t)PWM_TOP_VAL * 2)
+// Each buffer plays for one tick, the resolution of the playout clock
+#define TICK_US                     (ESL_STREAM_TICK_PERIODS * PWM_PERIOD_US)
+
+#if (ESL_STREAM_BUF_FRAMES & (ESL_STREAM_BUF_FRAMES - 1)) != 0
+#error "ESL_STREAM_BUF_FRAMES must be a power of two"
+#endif
+
+typedef struct {
+    uint32_t due_us;            // On the playout clock
+    uint8_t rgb[3];
+} stream_frame_t;
+
+static esl_pwm_context_t *pwm;
+static volatile bool active = false;
+
+// Filled from thread context, drained by the PWM interrupt
+static stream_frame_t frames[ESL_STREAM_BUF_FRAMES];
+static volatile uint16_t head = 0;          // Next frame to apply
+static volatile uint16_t tail = 0;          // Next free slot
+
+static volatile uint32_t clock_us;          // Start of the tick being prepared
+static uint32_t delay_us;
+static uint32_t offset_us;                  // Host time to playout clock
+static uint32_t last_ts_ms;
+static bool anchored;                       // First frame seen
+static uint8_t current[3];
+
+static nrf_pwm_values_individual_t play_buf[2];
+static nrf_pwm_sequence_t play_seq[2];
+static esl_stream_stats_t stream_stats;
+
+static void buf_fill(uint8_t buf_idx) {
+    play_buf[buf_idx].channel_0 = pwm->pwm_seq_values.channel_0;    // LED1 keeps its own state
+    play_buf[buf_idx].channel_1 = current[0];
+    play_buf[buf_idx].channel_2 = current[1];
+    play_buf[buf_idx].channel_3 = current[2];
+}
+
+// PWM interrupt: the buffer just played is next after the one starting now
+static void stream_handler(uint8_t buf_idx) {
+    uint32_t now = clock_us += TICK_US;
+    uint16_t h = head;
+
+    while (h != tail && (int32_t)(frames[h].due_us - now) <= 0) {
+        memcpy(current, frames[h].rgb, sizeof(current));
+        h = (h + 1) % ESL_STREAM_BUF_FRAMES;
+        stream_stats.applied++;
+    }
+    head = h;
+    buf_fill(buf_idx);
+}
+
+void esl_stream_init(esl_pwm_context_t *pwm_ctx) {
+    pwm = pwm_ctx;
+    memset(&stream_stats, 0, sizeof(stream_stats));
+}
+
+void esl_stream_start(uint16_t delay_ms) {
+    esl_stream_stop();
+
+    head = tail = 0;
+    clock_us = 0;
+    memset(&stream_stats, 0, sizeof(stream_stats));
+    delay_us = (delay_ms ? delay_ms : ESL_STREAM_DELAY_MS) * 1000;
+    anchored = false;
+    current[0] = pwm->rgb_state.red;
+    current[1] = pwm->rgb_state.green;
+    current[2] = pwm->rgb_state.blue;
+
+    for (uint8_t i = 0; i < 2; i++) {
+        play_seq[i] = (nrf_pwm_sequence_t){
+            .values.p_individual = &play_buf[i],
+            .length = NRF_PWM_VALUES_LENGTH(play_buf[i]),
+            .repeats = ESL_STREAM_TICK_PERIODS - 1,
+            .end_delay = 0
+        };
+        buf_fill(i);
+    }
+
+    active = true;
+    esl_pwm_stream_start(pwm, &play_seq[0], &play_seq[1], stream_handler);
+}
+
+void esl_stream_stop(void) {
+    if (!active) {
+        return;
+    }
+    active = false;
+    esl_pwm_stream_stop(pwm);
+}
+
+bool esl_stream_is_active(void) {
+    return active;
+}
+
+// The first frame sets the playout clock. A frame that comes after its time
+// means the buffer ran dry; the clock is set back so the buffer fills up to
+// the full delay again, instead of every later frame being just as late.
+// Frames too far ahead, from a host clock running fast or jumping, set it
+// forward.
+esl_ret_code_t esl_stream_push(uint32_t timestamp_ms, uint8_t r, uint8_t g, uint8_t b) {
+    if (!active) {
+        return ESL_ERROR;
+    }
+
+    uint32_t now = clock_us;
+    if (!anchored) {
+        offset_us = now + delay_us - timestamp_ms * 1000;
+        anchored = true;
+    } else if ((int32_t)(timestamp_ms - last_ts_ms) <= 0) {
+        stream_stats.out_of_order++;
+        return ESL_ERROR;
+    }
+
+    uint32_t due = timestamp_ms * 1000 + offset_us;
+    if ((int32_t)(due - now) < 0) {
+        stream_stats.underruns++;
+        offset_us += now - due + delay_us;
+        due = now + delay_us;
+    } else if (due - now > ESL_STREAM_AHEAD_MAX_MS * 1000) {
+        stream_stats.early++;
+        offset_us -= due - now - delay_us;
+        due = now + delay_us;
+    }
+
+    uint16_t depth = (tail - head + ESL_STREAM_BUF_FRAMES) % ESL_STREAM_BUF_FRAMES;
+    if (depth == ESL_STREAM_BUF_FRAMES - 1) {
+        stream_stats.overruns++;
+        return ESL_ERROR;
+    }
+    last_ts_ms = timestamp_ms;
+
+    CRITICAL_REGION_ENTER();
+    frames[tail].due_us = due;
+    frames[tail].rgb[0] = r;
+    frames[tail].rgb[1] = g;
+    frames[tail].rgb[2] = b;
+    tail = (tail + 1) % ESL_STREAM_BUF_FRAMES;
+    CRITICAL_REGION_EXIT();
+
+    stream_stats.frames++;
+    if (depth + 1 > stream_stats.max_depth) {
+        stream_stats.max_depth = depth + 1;
+    }
+    return ESL_SUCCESS;
+}
+
+uint16_t esl_stream_depth(void) {
+    return (tail - head + ESL_STREAM_BUF_FRAMES) % ESL_STREAM_BUF_FRAMES;
+}
+
+void esl_stream_stats_get(esl_stream_stats_t *stats) {
+    *stats = stream_stats;
+}
@@ -0,0 +1,35 @@
+#ifndef ESL_STREAM_H
+#define ESL_STREAM_H
+
+#include "esl_utils.h"
+#include "esl_pwm.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Live color stream from the host. Frames carry the host's timestamp and
+// wait in a jitter buffer until their time, delay ms after the first one.
+// The PWM interrupt applies them on a period boundary, so the transport's
+// scheduling jitter doesn't reach the LEDs as long as frames are less than
+// delay late.
+
+// Counted from the last esl_stream_start(), kept after it stops
+typedef struct {
+    uint32_t frames;            // Queued
+    uint32_t applied;           // Reached the LEDs
+    uint32_t underruns;         // Came after their time, the buffer was empty
+    uint32_t overruns;          // Buffer full, dropped
+    uint32_t early;             // More than ESL_STREAM_AHEAD_MAX_MS ahead, clock moved
+    uint32_t out_of_order;      // Timestamp not after the previous one, dropped
+    uint32_t max_depth;
+} esl_stream_stats_t;
+
+void esl_stream_init(esl_pwm_context_t *pwm_ctx);
+// delay_ms 0 picks ESL_STREAM_DELAY_MS. Takes over the PWM until stopped.
+void esl_stream_start(uint16_t delay_ms);
+void esl_stream_stop(void);     // Returns to the color set before the stream
+bool esl_stream_is_active(void);
+esl_ret_code_t esl_stream_push(uint32_t timestamp_ms, uint8_t r, uint8_t g, uint8_t b);
+uint16_t esl_stream_depth(void);
+void esl_stream_stats_get(esl_stream_stats_t *stats);
+
+#endif // ESL_STREAM_H
@@ -0,0 +1,37 @@
+#ifndef ESL_TRANSPORT_H
+#define ESL_TRANSPORT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Byte stream under the CLI and the binary protocol. One transport is
+// linked in, picked with ESL_TRANSPORT. Events reach the handler in thread
+// context, from process() in the main loop or from work it triggers.
+
+typedef enum {
+    ESL_TRANSPORT_EVT_OPEN      = 0,    // A peer is listening, nothing received yet
+    ESL_TRANSPORT_EVT_CLOSE     = 1,    // Gone, a tx() in flight won't complete
+    ESL_TRANSPORT_EVT_RX        = 2,    // data holds up to READ_SIZE bytes
+    ESL_TRANSPORT_EVT_TX_DONE   = 3,    // The last tx() is out, the next may start
+} esl_transport_evt_t;
+
+// data and size are only set for RX and valid during the call. The return
+// value only matters for RX: false when another READ_SIZE bytes wouldn't
+// fit, nothing is received then until rx_resume().
+typedef bool (*esl_transport_handler_t)(esl_transport_evt_t evt, uint8_t const *data, uint16_t size);
+
+typedef struct {
+    void (*init)(esl_transport_handler_t handler);
+    void (*process)(void);
+    // Starts sending and returns right away, data stays untouched until
+    // TX_DONE. One transfer at a time. False when there is no peer.
+    bool (*tx)(uint8_t const *data, uint16_t size);
+    void (*rx_resume)(void);
+} esl_transport_t;
+
+extern esl_transport_t const esl_transport_usb;     // USB CDC ACM
+extern esl_transport_t const esl_transport_uart;    // UARTE0, ESL_UART_* pins
+extern esl_transport_t const esl_transport_pty;     // Host build, pseudo-terminal
+extern esl_transport_t const esl_transport_script;  // Host checks, driven from the check
+
+#endif // ESL_TRANSPORT_H
@@ -0,0 +1,112 @@
+#include "esl_transport.h"
+#include "nrfx_uarte.h"
+#include "app_error.h"
+#include "app_util_platform.h"
+
+// Bytes come in one at a time through two alternating EasyDMA buffers, so
+// reception never stops between them, and wait in a ring for process().
+// There is no flow control: while the handler is paused and the ring is
+// full, further bytes are lost. A UART has no notion of a peer, the port
+// counts as open from the first process() on.
+
+static nrfx_uarte_t const uarte = NRFX_UARTE_INSTANCE(0);
+static esl_transport_handler_t evt_handler;
+static uint8_t rx_dma[2];
+static uint8_t rx_ring[ESL_UART_RX_RING_SIZE];
+static volatile uint16_t rx_head = 0;       // Written by the interrupt
+static uint16_t rx_tail = 0;
+static volatile bool tx_done = false;
+static bool rx_paused = false;
+static bool opened = false;
+
+static void rx_arm(void) {
+    nrfx_uarte_rx(&uarte, &rx_dma[0], 1);
+    nrfx_uarte_rx(&uarte, &rx_dma[1], 1);   // Taken as the next buffer
+}
+
+static void uarte_evt_handler(nrfx_uarte_event_t const *p_event, void *p_context) {
+    switch (p_event->type) {
+    case NRFX_UARTE_EVT_RX_DONE:
+    {
+        uint8_t *buf = p_event->data.rxtx.p_data;
+        if (p_event->data.rxtx.bytes && (uint16_t)(rx_head - rx_tail) < ESL_UART_RX_RING_SIZE) {
+            rx_ring[rx_head & (ESL_UART_RX_RING_SIZE - 1)] = *buf;
+            rx_head++;
+        }
+        nrfx_uarte_rx(&uarte, buf, 1);
+        break;
+    }
+    case NRFX_UARTE_EVT_TX_DONE:
+        tx_done = true;
+        break;
+    case NRFX_UARTE_EVT_ERROR:
+        // Reception stops on framing and overrun errors
+        rx_arm();
+        break;
+    default:
+        break;
+    }
+}
+
+static void uart_init(esl_transport_handler_t handler) {
+    nrfx_uarte_config_t config = {
+        .pseltxd = ESL_UART_TX_PIN,
+        .pselrxd = ESL_UART_RX_PIN,
+        .pselcts = NRF_UARTE_PSEL_DISCONNECTED,
+        .pselrts = NRF_UARTE_PSEL_DISCONNECTED,
+        .p_context = NULL,
+        .hwfc = NRF_UARTE_HWFC_DISABLED,
+        .parity = NRF_UARTE_PARITY_EXCLUDED,
+        .baudrate = ESL_UART_BAUDRATE,
+        .interrupt_priority = APP_IRQ_PRIORITY_LOWEST,
+    };
+
+    evt_handler = handler;
+    APP_ERROR_CHECK(nrfx_uarte_init(&uarte, &config, uarte_evt_handler));
+    rx_arm();
+}
+
+// Hands over the ring in contiguous runs of up to READ_SIZE
+static void rx_deliver(void) {
+    while (!rx_paused && rx_tail != rx_head) {
+        uint16_t start = rx_tail & (ESL_UART_RX_RING_SIZE - 1);
+        uint16_t size = (uint16_t)(rx_head - rx_tail);
+        if (size > ESL_UART_RX_RING_SIZE - start) {
+            size = ESL_UART_RX_RING_SIZE - start;
+        }
+        if (size > READ_SIZE) {
+            size = READ_SIZE;
+        }
+        bool more = evt_handler(ESL_TRANSPORT_EVT_RX, &rx_ring[start], size);
+        rx_tail += size;
+        rx_paused = !more;
+    }
+}
+
+static void uart_process(void) {
+    if (!opened) {
+        opened = true;
+        evt_handler(ESL_TRANSPORT_EVT_OPEN, NULL, 0);
+    }
+    if (tx_done) {
+        tx_done = false;
+        evt_handler(ESL_TRANSPORT_EVT_TX_DONE, NULL, 0);
+    }
+    rx_deliver();
+}
+
+static bool uart_tx(uint8_t const *data, uint16_t size) {
+    return nrfx_uarte_tx(&uarte, data, size) == NRFX_SUCCESS;
+}
+
+static void uart_rx_resume(void) {
+    rx_paused = false;
+    rx_deliver();
+}
+
+esl_transport_t const esl_transport_uart = {
+    .init = uart_init,
+    .process = uart_process,
+    .tx = uart_tx,
+    .rx_resume = uart_rx_resume,
+};
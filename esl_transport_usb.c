@@ -0,0 +1,82 @@
+#include "esl_transport.h"
+#include "app_usbd.h"
+#include "app_usbd_cdc_acm.h"
+#include "app_error.h"
+
+static void cdc_acm_ev_handler(app_usbd_class_inst_t const * p_inst,
+                               app_usbd_cdc_acm_user_event_t event);
+
+APP_USBD_CDC_ACM_GLOBAL_DEF(
+    esl_usb_cdc_acm,
+    cdc_acm_ev_handler,
+    CDC_ACM_COMM_INTERFACE,
+    CDC_ACM_DATA_INTERFACE,
+    CDC_ACM_COMM_EPIN,
+    CDC_ACM_DATA_EPIN,
+    CDC_ACM_DATA_EPOUT,
+    APP_USBD_CDC_COMM_PROTOCOL_NONE
+);
+
+static esl_transport_handler_t evt_handler;
+static uint8_t rx_buffer[READ_SIZE];
+
+// Takes in what the CDC class already holds and leaves a read pending. While
+// the handler can't take another packet no read is pending and the host waits.
+static void rx_fetch(void) {
+    while (app_usbd_cdc_acm_read_any(&esl_usb_cdc_acm, rx_buffer, READ_SIZE) == NRF_SUCCESS) {
+        if (!evt_handler(ESL_TRANSPORT_EVT_RX, rx_buffer, app_usbd_cdc_acm_rx_size(&esl_usb_cdc_acm))) {
+            return;
+        }
+    }
+}
+
+// The class events come from app_usbd_event_queue_process(), in the main loop
+static void cdc_acm_ev_handler(app_usbd_class_inst_t const * p_inst,
+                               app_usbd_cdc_acm_user_event_t event)
+{
+    switch (event)
+    {
+    case APP_USBD_CDC_ACM_USER_EVT_PORT_OPEN:
+        evt_handler(ESL_TRANSPORT_EVT_OPEN, NULL, 0);
+        rx_fetch();
+        break;
+    case APP_USBD_CDC_ACM_USER_EVT_PORT_CLOSE:
+        evt_handler(ESL_TRANSPORT_EVT_CLOSE, NULL, 0);
+        break;
+    case APP_USBD_CDC_ACM_USER_EVT_TX_DONE:
+        evt_handler(ESL_TRANSPORT_EVT_TX_DONE, NULL, 0);
+        break;
+    case APP_USBD_CDC_ACM_USER_EVT_RX_DONE:
+        if (evt_handler(ESL_TRANSPORT_EVT_RX, rx_buffer, app_usbd_cdc_acm_rx_size(&esl_usb_cdc_acm))) {
+            rx_fetch();
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// USB itself is brought up by the log backend, this only adds the class
+static void usb_init(esl_transport_handler_t handler) {
+    evt_handler = handler;
+    app_usbd_class_inst_t const * class_cdc_acm = app_usbd_cdc_acm_class_inst_get(&esl_usb_cdc_acm);
+    ret_code_t ret = app_usbd_class_append(class_cdc_acm);
+    APP_ERROR_CHECK(ret);
+}
+
+static void usb_process(void) {
+    while (app_usbd_event_queue_process())
+    {
+    }
+}
+
+static bool usb_tx(uint8_t const *data, uint16_t size) {
+    return app_usbd_cdc_acm_write(&esl_usb_cdc_acm, data, size) == NRF_SUCCESS;
+}
+
+esl_transport_t const esl_transport_usb = {
+    .init = usb_init,
+    .process = usb_process,
+    .tx = usb_tx,
+    .rx_resume = rx_fetch,
+};
@@ -0,0 +1,89 @@
+#include "esl_txq.h"
+
+#include <string.h>
+
+#define RING_MASK                   (ESL_TX_RING_SIZE - 1)
+
+#if (ESL_TX_RING_SIZE & RING_MASK) != 0 || ESL_TX_RING_SIZE > 0x8000
+#error "ESL_TX_RING_SIZE must be a power of two, 32 kB at most"
+#endif
+
+void esl_txq_init(esl_txq_t *q) {
+    memset(q, 0, sizeof(*q));
+}
+
+void esl_txq_clear(esl_txq_t *q) {
+    q->tail = q->head;
+    q->in_flight = 0;
+}
+
+uint16_t esl_txq_used(esl_txq_t const *q) {
+    return (uint16_t)(q->head - q->tail);
+}
+
+uint16_t esl_txq_free(esl_txq_t const *q) {
+    return ESL_TX_RING_SIZE - esl_txq_used(q);
+}
+
+void esl_txq_msg_begin(esl_txq_t *q) {
+    q->msg_head = q->head;
+    q->msg_dropped = false;
+}
+
+void esl_txq_msg_append(esl_txq_t *q, void const *data, uint16_t size) {
+    if (q->msg_dropped) {
+        return;
+    }
+    if (size > ESL_TX_RING_SIZE - (uint16_t)(q->msg_head - q->tail)) {
+        q->msg_dropped = true;
+        q->dropped++;
+        return;
+    }
+
+    uint16_t start = q->msg_head & RING_MASK;
+    uint16_t first = ESL_TX_RING_SIZE - start < size ? ESL_TX_RING_SIZE - start : size;
+    memcpy(&q->ring[start], data, first);
+    memcpy(q->ring, (uint8_t const *)data + first, size - first);
+    q->msg_head += size;
+}
+
+void esl_txq_msg_cancel(esl_txq_t *q) {
+    q->msg_dropped = true;
+}
+
+bool esl_txq_msg_end(esl_txq_t *q) {
+    if (q->msg_dropped) {
+        return false;
+    }
+    q->head = q->msg_head;
+    if (esl_txq_used(q) > q->high_water) {
+        q->high_water = esl_txq_used(q);
+    }
+    return true;
+}
+
+bool esl_txq_put(esl_txq_t *q, void const * const *parts, uint16_t const *sizes, uint8_t count) {
+    esl_txq_msg_begin(q);
+    for (uint8_t i = 0; i < count; i++) {
+        esl_txq_msg_append(q, parts[i], sizes[i]);
+    }
+    return esl_txq_msg_end(q);
+}
+
+uint16_t esl_txq_next(esl_txq_t *q, uint8_t const **data) {
+    if (q->in_flight || q->head == q->tail) {
+        return 0;
+    }
+
+    uint16_t start = q->tail & RING_MASK;
+    uint16_t used = esl_txq_used(q);
+    q->in_flight = ESL_TX_RING_SIZE - start < used ? ESL_TX_RING_SIZE - start : used;
+    q->transfers++;
+    *data = &q->ring[start];
+    return q->in_flight;
+}
+
+void esl_txq_sent(esl_txq_t *q) {
+    q->tail += q->in_flight;
+    q->in_flight = 0;
+}
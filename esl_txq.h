@@ -0,0 +1,42 @@
+#ifndef ESL_TXQ_H
+#define ESL_TXQ_H
+
+#include "sdk_config.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Output byte queue in front of a transport that sends one buffer at a
+// time. Writers append whole messages without waiting; the transport takes
+// the longest contiguous run, and frees it once sent. Thread context only.
+
+typedef struct {
+    uint8_t ring[ESL_TX_RING_SIZE];
+    uint16_t head;              // Next byte to write
+    uint16_t tail;              // First byte not yet sent
+    uint16_t in_flight;         // Bytes from tail handed to the transport
+    uint16_t high_water;        // Most bytes ever queued
+    uint16_t msg_head;          // End of the message being built
+    bool msg_dropped;           // It didn't fit, or was cancelled
+    uint32_t transfers;
+    uint32_t dropped;           // Messages that didn't fit
+} esl_txq_t;
+
+void esl_txq_init(esl_txq_t *q);
+void esl_txq_clear(esl_txq_t *q);           // Drops queued data, keeps the counters
+uint16_t esl_txq_used(esl_txq_t const *q);
+uint16_t esl_txq_free(esl_txq_t const *q);
+
+// Queues the parts of one message back to back, all of them or none
+bool esl_txq_put(esl_txq_t *q, void const * const *parts, uint16_t const *sizes, uint8_t count);
+// Builds one message in place, piece by piece, without a staging buffer.
+// The transport only sees it once it is ended, and if any piece didn't
+// fit none of it is queued. One message at a time.
+void esl_txq_msg_begin(esl_txq_t *q);
+void esl_txq_msg_append(esl_txq_t *q, void const *data, uint16_t size);
+void esl_txq_msg_cancel(esl_txq_t *q);      // Drops the message without counting it
+bool esl_txq_msg_end(esl_txq_t *q);
+// Next run to send, 0 while a transfer is in flight or nothing is queued
+uint16_t esl_txq_next(esl_txq_t *q, uint8_t const **data);
+void esl_txq_sent(esl_txq_t *q);            // The run from esl_txq_next() is done
+
+#endif // ESL_TXQ_H
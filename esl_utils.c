@@ -45,4 +45,4 @@ void rgb_to_hsv(uint8_t r, uint8_t g, uint8_t b, uint16_t* hue, uint8_t* saturat
         }
         if (*hue >= 360) *hue -= 360;
     }
-}
\ No newline at end of file
+}
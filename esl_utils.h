@@ -3,7 +3,37 @@
 
 #include <stdint.h>
 
+typedef enum {
+    ESL_SUCCESS                 = 0x0000,
+    ESL_ERR_NVMC_MEMORY_FULL    = 0x1000,
+    ESL_ERR_NVMC_NOT_WRITABLE   = 0x1001,
+    ESL_ERR_NVMC_NOT_FOUND      = 0x1002,
+    ESL_ERR_NVMC_EXISTS         = 0x1003,
+    ESL_ERR_CLI_VALUE_ERROR     = 0x2000,
+    ESL_ERR_CLI_EMPTY           = 0x2001,
+    ESL_ERR_CLI_NOT_FOUND       = 0x2002,
+    ESL_ERR_CLI_ARG_COUNT       = 0x2003,
+    ESL_ERR_CLI_ARG_RANGE       = 0x2004,
+    ESL_ERR_CLI_ARG_LENGTH      = 0x2005,
+    ESL_ERR_FRAME_INVALID       = 0x3000,
+    ESL_ERR_FRAME_CRC           = 0x3001,
+    ESL_ERROR                   = 0x4000,
+    ESL_ERR_BUSY                = 0x4001,
+} esl_ret_code_t;
+
 void hsv_to_rgb(uint16_t hue, uint8_t saturation, uint8_t value, uint8_t *r, uint8_t *g, uint8_t *b );
 void rgb_to_hsv(uint8_t r, uint8_t g, uint8_t b, uint16_t* hue, uint8_t* saturation, uint8_t* value);
 
+// DWT cycle counter, used for execution time accounting
+void esl_cycles_init(void);
+uint32_t esl_cycles_get(void);
+#define ESL_CYCLES_TO_US(cycles)    ((cycles) / 64)     // 64 MHz core clock
+
+// Stack high water: the free stack is painted once at startup, the deepest
+// word that lost the pattern marks the most ever used
+#define ESL_STACK_PAINT             (0xC5C5C5C5)
+void esl_stack_paint(void);
+uint32_t esl_stack_used_max(void);
+uint32_t esl_stack_size(void);
+
 #endif
\ No newline at end of file
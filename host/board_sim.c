@@ -0,0 +1,205 @@
+#include "board_sim.h"
+#include "app_timer.h"
+#include "nrf_gpio.h"
+#include "nrfx_gpiote.h"
+#include "pwm_sim.h"
+
+#include <poll.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#define TIMERS_MAX                  (16)
+#define PWM_WAKE_MAX_MS             (10)    // Periods are played in batches this long
+#define RTC_MASK                    (0xFFFFFF)
+
+NRF_GPIO_Type board_sim_ports[2];
+static uint32_t pin_outputs[2];
+
+static app_timer_t *timers[TIMERS_MAX];
+static uint8_t timers_count = 0;
+static uint64_t pwm_played_us = 0;
+
+static int wake_fd = -1;
+static short wake_events = 0;
+static int wake_max_ms = -1;
+
+static uint64_t now_us(void) {
+    static uint64_t start_us = 0;
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t us = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    if (start_us == 0) {
+        start_us = us;
+    }
+    return us - start_us;
+}
+
+static uint64_t now_ticks(void) {
+    return now_us() * APP_TIMER_CLOCK_FREQ / 1000000;
+}
+
+// GPIO
+
+void nrf_gpio_cfg_output(uint32_t pin_number) {
+    pin_outputs[pin_number >> 5] |= 1u << (pin_number & 0x1F);
+}
+
+void nrf_gpio_cfg_input(uint32_t pin_number, nrf_gpio_pin_pull_t pull_config) {
+    uint32_t bit = 1u << (pin_number & 0x1F);
+    NRF_GPIO_Type *port = &board_sim_ports[pin_number >> 5];
+
+    pin_outputs[pin_number >> 5] &= ~bit;
+    if (pull_config == NRF_GPIO_PIN_PULLUP) {
+        port->IN |= bit;
+    } else {
+        port->IN &= ~bit;
+    }
+}
+
+void nrf_gpio_pin_write(uint32_t pin_number, uint32_t value) {
+    uint32_t bit = 1u << (pin_number & 0x1F);
+    NRF_GPIO_Type *port = &board_sim_ports[pin_number >> 5];
+
+    if (value) {
+        port->OUT |= bit;
+    } else {
+        port->OUT &= ~bit;
+    }
+}
+
+uint32_t nrf_gpio_pin_read(uint32_t pin_number) {
+    uint32_t bit = 1u << (pin_number & 0x1F);
+    NRF_GPIO_Type const *port = &board_sim_ports[pin_number >> 5];
+    uint32_t levels = (pin_outputs[pin_number >> 5] & bit) ? port->OUT : port->IN;
+    return (levels & bit) != 0;
+}
+
+uint32_t nrf_gpio_port_in_read(NRF_GPIO_Type const *p_reg) {
+    return p_reg->IN;
+}
+
+// GPIOTE
+
+static bool gpiote_initialized = false;
+
+nrfx_err_t nrfx_gpiote_init(void) {
+    gpiote_initialized = true;
+    return NRFX_SUCCESS;
+}
+
+bool nrfx_gpiote_is_init(void) {
+    return gpiote_initialized;
+}
+
+nrfx_err_t nrfx_gpiote_in_init(nrfx_gpiote_pin_t pin, nrfx_gpiote_in_config_t const *p_config,
+                               nrfx_gpiote_evt_handler_t evt_handler) {
+    nrf_gpio_cfg_input(pin, p_config->pull);
+    return NRFX_SUCCESS;
+}
+
+void nrfx_gpiote_in_event_enable(nrfx_gpiote_pin_t pin, bool int_enable) {
+}
+
+// APP_TIMER
+
+ret_code_t app_timer_init(void) {
+    return NRF_SUCCESS;
+}
+
+ret_code_t app_timer_create(app_timer_id_t const *p_timer_id, app_timer_mode_t mode,
+                            app_timer_timeout_handler_t timeout_handler) {
+    app_timer_t *timer = *p_timer_id;
+
+    if (timers_count >= TIMERS_MAX) {
+        return NRF_ERROR_NO_MEM;
+    }
+    timer->handler = timeout_handler;
+    timer->mode = mode;
+    timer->active = false;
+    timers[timers_count++] = timer;
+    return NRF_SUCCESS;
+}
+
+ret_code_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void *p_context) {
+    timer_id->due = now_ticks() + timeout_ticks;
+    timer_id->period = timeout_ticks;
+    timer_id->p_context = p_context;
+    timer_id->active = true;
+    return NRF_SUCCESS;
+}
+
+ret_code_t app_timer_stop(app_timer_id_t timer_id) {
+    timer_id->active = false;
+    return NRF_SUCCESS;
+}
+
+uint32_t app_timer_cnt_get(void) {
+    return now_ticks() & RTC_MASK;
+}
+
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from) {
+    return (ticks_to - ticks_from) & RTC_MASK;
+}
+
+// INTERRUPTS AND SLEEP
+
+void board_sim_irq(void) {
+    uint64_t now = now_ticks();
+
+    for (uint8_t i = 0; i < timers_count; i++) {
+        app_timer_t *timer = timers[i];
+        if (!timer->active || timer->due > now) {
+            continue;
+        }
+        if (timer->mode == APP_TIMER_MODE_REPEATED && timer->period > 0) {
+            timer->due += timer->period;
+            if (timer->due <= now) {
+                timer->due = now + timer->period;   // Missed ticks are dropped
+            }
+        } else {
+            timer->active = false;
+        }
+        timer->handler(timer->p_context);
+    }
+
+    uint64_t us = now_us();
+    uint32_t period_us = pwm_sim_period_us();
+    if (!pwm_sim_is_playing() || period_us == 0) {
+        pwm_played_us = us;
+    } else if (us - pwm_played_us >= period_us) {
+        uint32_t periods = (us - pwm_played_us) / period_us;
+        pwm_played_us += (uint64_t)periods * period_us;
+        pwm_sim_advance(periods);
+    }
+}
+
+void board_sim_wake_fd_set(int fd, short events, int max_ms) {
+    wake_fd = fd;
+    wake_events = events;
+    wake_max_ms = max_ms;
+}
+
+void board_sim_wfe(void) {
+    uint64_t now = now_ticks();
+    int timeout_ms = wake_max_ms;
+
+    for (uint8_t i = 0; i < timers_count; i++) {
+        if (!timers[i]->active) {
+            continue;
+        }
+        uint64_t ticks = timers[i]->due > now ? timers[i]->due - now : 0;
+        int ms = (ticks * 1000 + APP_TIMER_CLOCK_FREQ - 1) / APP_TIMER_CLOCK_FREQ;
+        if (timeout_ms < 0 || ms < timeout_ms) {
+            timeout_ms = ms;
+        }
+    }
+    if (pwm_sim_is_playing() && (timeout_ms < 0 || timeout_ms > PWM_WAKE_MAX_MS)) {
+        timeout_ms = PWM_WAKE_MAX_MS;
+    }
+
+    struct pollfd pfd = { .fd = wake_fd, .events = wake_events };
+    poll(&pfd, 1, timeout_ms);     // A negative fd only times out
+    board_sim_irq();
+}
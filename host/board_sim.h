@@ -0,0 +1,23 @@
+#ifndef BOARD_SIM_H
+#define BOARD_SIM_H
+
+#include <stdint.h>
+
+// The board around the firmware, for host builds: GPIO and GPIOTE with
+// nothing attached, app_timer on the monotonic clock, the PWM advanced in
+// real time, and the core's sleep. Timers and PWM periods take effect at
+// board_sim_irq(), the host's one interrupt point, so the firmware's
+// handlers never run concurrently with its main loop.
+
+// Runs expired timers and advances the PWM to now
+void board_sim_irq(void);
+
+// __WFE(): waits until the watched descriptor is ready, a timer is due or
+// the PWM needs another period, then runs board_sim_irq()
+void board_sim_wfe(void);
+
+// Descriptor the sleep wakes up for, poll() events. fd -1 watches nothing;
+// max_ms bounds the sleep, -1 for no bound.
+void board_sim_wake_fd_set(int fd, short events, int max_ms);
+
+#endif // BOARD_SIM_H
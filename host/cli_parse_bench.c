@@ -0,0 +1,179 @@
+// Parse and dispatch cost of the CLI, per command line, with the real
+// command table and handlers stubbed out. The previous parser (copy,
+// strtok, malloc, linear strcmp, atoi) runs on the same lines for comparison.
+//   cli_parse_bench
+
+#include "esl_cli_cmds.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ROUNDS                      (200000)
+
+static uint32_t dispatched = 0;
+
+#define STUB(name) \
+    esl_ret_code_t name(esl_cli_arg_t const *args, uint8_t arg_count) { dispatched++; return ESL_SUCCESS; }
+
+STUB(esl_cli_cmd_rgb)
+STUB(esl_cli_cmd_hsv)
+STUB(esl_cli_cmd_add_rgb_color)
+STUB(esl_cli_cmd_add_hsv_color)
+STUB(esl_cli_cmd_add_current_color)
+STUB(esl_cli_cmd_list_colors)
+STUB(esl_cli_cmd_help)
+STUB(esl_cli_cmd_stats)
+STUB(esl_cli_cmd_save)
+STUB(esl_cli_cmd_apply_color)
+STUB(esl_cli_cmd_del_color)
+STUB(esl_cli_cmd_rename_color)
+STUB(esl_cli_cmd_clip_rec)
+STUB(esl_cli_cmd_clip_key)
+STUB(esl_cli_cmd_clip_fade)
+STUB(esl_cli_cmd_clip_end)
+STUB(esl_cli_cmd_clip_play)
+STUB(esl_cli_cmd_clip_stop)
+STUB(esl_cli_cmd_clip_list)
+STUB(esl_cli_cmd_clip_erase)
+STUB(esl_cli_cmd_macro_add)
+STUB(esl_cli_cmd_macro_run)
+STUB(esl_cli_cmd_macro_del)
+STUB(esl_cli_cmd_macro_list)
+STUB(esl_cli_cmd_macro_erase)
+STUB(esl_cli_cmd_output)
+
+static const char * const lines[] = {
+    "rgb 255 128 0",
+    "hsv 200 100 50",
+    "add_rgb_color 10 20 30 sunset",
+    "apply_color sunset",
+    "rename_color sunset dawn",
+    "clip_key 255 0 0 25",
+    "clip_play 3 loop",
+    "stats",
+};
+
+typedef struct {
+    const char *line;
+    esl_ret_code_t expected;
+} check_t;
+
+static const check_t checks[] = {
+    { "rgb 255 0 0", ESL_SUCCESS },
+    { "  rgb\t1   2 3  ", ESL_SUCCESS },
+    { "", ESL_ERR_CLI_EMPTY },
+    { "rgbw 1 2 3", ESL_ERR_CLI_NOT_FOUND },
+    { "rgb 1 2", ESL_ERR_CLI_ARG_COUNT },
+    { "rgb 1 2 3 4", ESL_ERR_CLI_ARG_COUNT },
+    { "rgb 256 0 0", ESL_ERR_CLI_ARG_RANGE },
+    { "rgb -1 0 0", ESL_ERR_CLI_ARG_RANGE },
+    { "rgb 4294967551 0 0", ESL_ERR_CLI_VALUE_ERROR },    // atoi() wrapped this to 255
+    { "rgb 12x 0 0", ESL_ERR_CLI_VALUE_ERROR },
+    { "hsv 361 0 0", ESL_ERR_CLI_ARG_RANGE },
+    { "apply_color abcdefghijklmnopqrstuvwxyz0123456", ESL_ERR_CLI_ARG_LENGTH },
+    { "clip_play 1", ESL_SUCCESS },
+    { "clip_play 1 once", ESL_ERR_CLI_VALUE_ERROR },
+    { "help", ESL_SUCCESS },
+    { "macro_add dusk \"rgb 255 80 0; save\"", ESL_SUCCESS },
+    { "macro_add dusk rgb 255 80 0", ESL_ERR_CLI_ARG_COUNT },
+    { "output cbor", ESL_SUCCESS },
+    { "output xml", ESL_ERR_CLI_VALUE_ERROR },
+    { "output jso", ESL_ERR_CLI_VALUE_ERROR },
+};
+
+// The parser this replaced, minus the USB output
+static const char * const old_names[] = {
+    "rgb", "hsv", "add_rgb_color", "add_hsv_color", "add_current_color", "apply_color", "del_color",
+    "rename_color", "list_colors", "clip_rec", "clip_key", "clip_fade", "clip_end", "clip_play",
+    "clip_stop", "clip_list", "clip_erase", "save", "stats", "help",
+};
+
+static volatile int old_sink;
+
+static void old_process(const char *cmd_line) {
+    char temp_cmd[ESL_CLI_LINE_SIZE + 1];
+    strncpy(temp_cmd, cmd_line, sizeof(temp_cmd) - 1);
+    temp_cmd[sizeof(temp_cmd) - 1] = '\0';
+
+    char *token = strtok(temp_cmd, " ");
+    if (!token) {
+        return;
+    }
+    char *command = malloc(strlen(token) + 1);
+    strcpy(command, token);
+
+    char *args[4];
+    int arg_count = 0;
+    while ((token = strtok(NULL, " ")) != NULL && arg_count < 4) {
+        args[arg_count++] = token;
+    }
+    for (size_t i = 0; i < sizeof(old_names) / sizeof(old_names[0]); i++) {
+        if (strcmp(old_names[i], command) == 0) {
+            int sum = 0;
+            for (int a = 0; a < arg_count; a++) {
+                sum += atoi(args[a]);     // Every handler converted its args
+            }
+            old_sink = sum;
+            dispatched++;
+            break;
+        }
+    }
+    free(command);
+}
+
+static void new_process(const char *cmd_line) {
+    char line[ESL_CLI_LINE_SIZE];     // esl_line hands out a writable buffer
+    esl_cli_parsed_t parsed;
+
+    strcpy(line, cmd_line);
+    if (esl_cli_parse(line, esl_cli_cmds, esl_cli_cmds_count, &parsed) == ESL_SUCCESS) {
+        parsed.cmd->handler(parsed.args, parsed.arg_count);
+    }
+}
+
+static double bench(void (*process)(const char *)) {
+    size_t count = sizeof(lines) / sizeof(lines[0]);
+    struct timespec t0, t1;
+
+    dispatched = 0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint32_t r = 0; r < ROUNDS; r++) {
+        for (size_t i = 0; i < count; i++) {
+            process(lines[i]);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (dispatched != ROUNDS * count) {
+        printf("only %u of %u lines dispatched\n", dispatched, (unsigned)(ROUNDS * count));
+    }
+    return ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / (ROUNDS * count);
+}
+
+int main(void) {
+    int failures = 0;
+
+    if (!esl_cli_table_is_sorted(esl_cli_cmds, esl_cli_cmds_count)) {
+        printf("command table not sorted\n");
+        return 1;
+    }
+    for (size_t i = 0; i < sizeof(checks) / sizeof(checks[0]); i++) {
+        char line[ESL_CLI_LINE_SIZE];
+        esl_cli_parsed_t parsed;
+        strcpy(line, checks[i].line);
+        esl_ret_code_t res = esl_cli_parse(line, esl_cli_cmds, esl_cli_cmds_count, &parsed);
+        if (res != checks[i].expected) {
+            printf("'%s': got 0x%04x, expected 0x%04x\n", checks[i].line, res, checks[i].expected);
+            failures++;
+        }
+    }
+
+    double old_ns = bench(old_process);
+    double new_ns = bench(new_process);
+    printf("%zu commands, %zu lines x %u rounds\n", esl_cli_cmds_count, sizeof(lines) / sizeof(lines[0]), ROUNDS);
+    printf("old parser: %6.1f ns per line\n", old_ns);
+    printf("new parser: %6.1f ns per line\n", new_ns);
+    printf("checks failed: %d\n", failures);
+    return failures ? 1 : 0;
+}
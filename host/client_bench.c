@@ -0,0 +1,229 @@
+// Binary protocol throughput, messages per second in lockstep (wait for
+// each reply) and pipelined (up to WINDOW requests in flight) modes.
+//   client_bench /dev/ttyACM0     -> against the board
+//   client_bench --loopback       -> against the board's framing code
+//                                    answering from a thread on a socketpair
+//   client_bench /dev/ttyACM0 --stream <hz> <seconds>
+//                                 -> streams a color sweep and prints the
+//                                    board's jitter buffer stats
+
+#include "esl_client.h"
+#include "esl_line.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOCKSTEP_COUNT              (20000)
+#define PIPELINED_COUNT             (100000)
+#define WINDOW                      (8)
+
+typedef struct {
+    int fd;
+    uint8_t rgb[3];
+    uint32_t requests;
+    uint32_t lines;
+} responder_t;
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void respond(responder_t *r, uint8_t const *frame, uint16_t size) {
+    esl_msg_t req;
+    if (esl_frame_decode(frame, size, &req) != ESL_SUCCESS) {
+        return;
+    }
+    r->requests++;
+
+    esl_msg_t reply = { .type = req.type | ESL_MSG_REPLY, .seq = req.seq, .len = 1 };
+    reply.payload[0] = ESL_MSG_OK;
+    if (req.type == ESL_MSG_SET_RGB && req.len == 3) {
+        memcpy(r->rgb, req.payload, 3);
+    } else if (req.type == ESL_MSG_QUERY) {
+        memcpy(&reply.payload[1], r->rgb, 3);
+        reply.len = 8;
+    } else if (req.type != ESL_MSG_SAVE) {
+        reply.payload[0] = ESL_MSG_ERR_UNKNOWN;
+    }
+
+    uint8_t wire[ESL_FRAME_WIRE_MAX];
+    if (write(r->fd, wire, esl_frame_encode(&reply, wire)) < 0) {
+        return;
+    }
+}
+
+// Runs the receive side the way the board does: echo, line ring, assembler
+static void *responder_thread(void *arg) {
+    responder_t *r = arg;
+    static esl_line_t lines;
+    uint8_t buf[64];
+    char echo[2 * sizeof(buf)];
+    ssize_t n;
+
+    esl_line_init(&lines);
+    while ((n = read(r->fd, buf, sizeof(buf))) > 0) {
+        uint16_t echo_len = esl_line_echo(&lines, buf, n, echo);
+        if (echo_len && write(r->fd, echo, echo_len) < 0) {
+            break;
+        }
+
+        uint16_t taken = 0;
+        while (taken < n) {
+            taken += esl_line_push(&lines, buf + taken, n - taken);
+
+            void *data;
+            uint16_t size;
+            esl_line_result_t res;
+            while ((res = esl_line_get(&lines, &data, &size)) != ESL_LINE_NONE) {
+                if (res == ESL_LINE_FRAME) {
+                    respond(r, data, size);
+                } else {
+                    r->lines++;
+                }
+            }
+        }
+    }
+    return NULL;
+}
+
+static bool run_lockstep(esl_client_t *c) {
+    double start = now_s();
+    for (uint32_t i = 0; i < LOCKSTEP_COUNT; i++) {
+        if (esl_client_set_rgb(c, i, i >> 8, 0x55) != ESL_MSG_OK) {
+            printf("lockstep: request %u failed\n", i);
+            return false;
+        }
+    }
+    double elapsed = now_s() - start;
+
+    esl_client_color_t color;
+    uint32_t last = LOCKSTEP_COUNT - 1;
+    if (esl_client_query(c, &color) != ESL_MSG_OK
+        || color.r != (uint8_t)last || color.g != (uint8_t)(last >> 8) || color.b != 0x55) {
+        printf("lockstep: query doesn't match the last color set\n");
+        return false;
+    }
+    printf("lockstep:  %6u messages, %8.0f msg/s, %6.1f us round trip\n",
+           LOCKSTEP_COUNT, LOCKSTEP_COUNT / elapsed, elapsed * 1e6 / LOCKSTEP_COUNT);
+    return true;
+}
+
+static bool run_pipelined(esl_client_t *c) {
+    uint32_t sent = 0;
+    uint32_t done = 0;
+    uint8_t expected_seq = c->seq;
+    esl_msg_t reply;
+
+    double start = now_s();
+    while (done < PIPELINED_COUNT) {
+        while (sent < PIPELINED_COUNT && sent - done < WINDOW) {
+            uint8_t rgb[3] = { sent, sent >> 8, sent >> 16 };
+            if (esl_client_send(c, ESL_MSG_SET_RGB, rgb, sizeof(rgb)) < 0) {
+                printf("pipelined: send failed\n");
+                return false;
+            }
+            sent++;
+        }
+        if (!esl_client_recv(c, &reply, ESL_CLIENT_TIMEOUT_MS)) {
+            printf("pipelined: reply %u timed out\n", done);
+            return false;
+        }
+        if (reply.seq != expected_seq++ || reply.payload[0] != ESL_MSG_OK) {
+            printf("pipelined: reply %u out of order or failed\n", done);
+            return false;
+        }
+        done++;
+    }
+    double elapsed = now_s() - start;
+
+    printf("pipelined: %6u messages, %8.0f msg/s, window %u\n",
+           PIPELINED_COUNT, PIPELINED_COUNT / elapsed, WINDOW);
+    return true;
+}
+
+static bool run_stream(esl_client_t *c, uint32_t hz, uint32_t seconds) {
+    esl_client_stream_stats_t stats;
+
+    if (esl_client_stream_start(c, 0) != ESL_MSG_OK) {
+        printf("stream: start failed\n");
+        return false;
+    }
+    double start = now_s();
+    for (uint32_t i = 0; i < hz * seconds; i++) {
+        double due = start + (double)i / hz;
+        while (now_s() < due) {
+            usleep(200);
+        }
+        uint8_t level = i * 256 / hz;   // One sweep a second
+        esl_client_stream_frame(c, (uint32_t)((due - start) * 1000), level, 255 - level, 0);
+    }
+    usleep(200000);     // Let the buffer drain
+    if (esl_client_stream_stop(c, &stats) != ESL_MSG_OK) {
+        printf("stream: stop failed\n");
+        return false;
+    }
+    printf("stream: %u Hz, frames=%u, applied=%u, underruns=%u, overruns=%u\n",
+           hz, stats.frames, stats.applied, stats.underruns, stats.overruns);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    esl_client_t client;
+    responder_t responder = { 0 };
+    pthread_t thread;
+    bool loopback = argc > 1 && strcmp(argv[1], "--loopback") == 0;
+
+    if (argc == 5 && strcmp(argv[2], "--stream") == 0) {
+        if (esl_client_open(&client, argv[1]) != 0) {
+            perror(argv[1]);
+            return 1;
+        }
+        bool ok = run_stream(&client, atoi(argv[3]), atoi(argv[4]));
+        esl_client_close(&client);
+        return ok ? 0 : 1;
+    }
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <tty> [--stream <hz> <seconds>] | --loopback\n", argv[0]);
+        return 2;
+    }
+
+    if (loopback) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+            perror("socketpair");
+            return 1;
+        }
+        responder.fd = fds[1];
+        pthread_create(&thread, NULL, responder_thread, &responder);
+        esl_client_attach(&client, fds[0]);
+    } else if (esl_client_open(&client, argv[1]) != 0) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    // Text on the same port has to pass the framing untouched
+    char const text[] = "\rstats\r\n";
+    if (write(client.fd, text, sizeof(text) - 1) < 0) {
+        perror("write");
+        return 1;
+    }
+
+    bool ok = run_lockstep(&client) && run_pipelined(&client);
+    printf("frames bad=%u, text bytes skipped=%u\n", client.frames_bad, client.text_bytes);
+
+    if (loopback) {
+        shutdown(client.fd, SHUT_WR);
+        pthread_join(thread, NULL);
+        printf("responder: requests=%u, text lines=%u\n", responder.requests, responder.lines);
+        close(responder.fd);
+    }
+    esl_client_close(&client);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,208 @@
+// Clip playback against the keyframes it was recorded from. A clip is
+// recorded through esl_clip into the simulated flash and played on the
+// simulated PWM, with the scheduler run only every so many PWM periods, as
+// a busy main loop would. Every period output while the stream plays is
+// compared with an expansion of the keyframes done here from scratch. Below
+// one chunk of latency the output has to match exactly with no underruns;
+// above it, underruns have to be counted.
+//   clip_check
+
+#include "esl_clip.h"
+#include "esl_nvmc.h"
+#include "esl_pwm.h"
+#include "esl_sched.h"
+#include "nvmc_sim.h"
+#include "pwm_sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAME_MS                    (10)
+#define LOOP_PASSES                 (3)
+#define SAMPLES_MAX                 (200000)
+#define BUSY_TRIES_MAX              (100000)
+
+typedef struct {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    uint8_t frames;
+    bool fade;
+} keyframe_t;
+
+// Fades of different lengths and directions, holds, a fade that doesn't
+// divide evenly and one spanning several chunks
+static const keyframe_t keys[] = {
+    { 255,   0,   0,   5, false },
+    {   0, 255,   0,  20, true  },
+    {   0,   0, 255,   3, false },
+    { 255, 255, 255,  40, true  },
+    {  17,  99, 201,   7, true  },
+    {  17,  99, 201,   1, false },
+    {   0,   0,   0,  97, true  },
+    { 128,  64,  32,  16, false },
+    { 250,   3, 128,  33, true  },
+};
+#define KEYS                        (sizeof(keys) / sizeof(keys[0]))
+
+static esl_pwm_context_t pwm_ctx;
+static uint8_t samples[SAMPLES_MAX][3];
+static uint32_t sample_count;
+static bool done;
+static int failures = 0;
+
+static void sample_handler(nrf_pwm_values_individual_t const *values) {
+    if (pwm_ctx.streaming && sample_count < SAMPLES_MAX) {
+        samples[sample_count][0] = values->channel_1;
+        samples[sample_count][1] = values->channel_2;
+        samples[sample_count][2] = values->channel_3;
+        sample_count++;
+    }
+}
+
+static void done_handler(void) {
+    done = true;
+}
+
+// Frame n of the clip played in a loop, fades into the first keyframe start
+// from black and then from the end of the pass before
+static void reference_frame(uint32_t n, uint8_t rgb[3]) {
+    uint8_t prev[3] = { 0, 0, 0 };
+
+    for (;;) {
+        for (uint32_t k = 0; k < KEYS; k++) {
+            uint8_t target[3] = { keys[k].r, keys[k].g, keys[k].b };
+            if (n < keys[k].frames) {
+                for (uint8_t i = 0; i < 3; i++) {
+                    rgb[i] = keys[k].fade ? prev[i] + ((int)target[i] - prev[i]) * (int)(n + 1) / keys[k].frames
+                                          : target[i];
+                }
+                return;
+            }
+            n -= keys[k].frames;
+            memcpy(prev, target, sizeof(prev));
+        }
+    }
+}
+
+static uint8_t clip_record(void) {
+    esl_ret_code_t res;
+    uint8_t idx = 0;
+
+    if (esl_clip_record_start(FRAME_MS) != ESL_SUCCESS) {
+        printf("recording could not start\n");
+        exit(1);
+    }
+    for (uint32_t k = 0; k < KEYS; k++) {
+        for (uint32_t tries = 0; (res = esl_clip_record_key(keys[k].r, keys[k].g, keys[k].b, keys[k].frames,
+                                                            keys[k].fade)) == ESL_ERR_BUSY &&
+             tries < BUSY_TRIES_MAX; tries++) {
+            esl_nvmc_process();
+        }
+        if (res != ESL_SUCCESS) {
+            printf("keyframe %u not recorded\n", k);
+            exit(1);
+        }
+    }
+    for (uint32_t tries = 0; (res = esl_clip_record_end(&idx)) == ESL_ERR_BUSY && tries < BUSY_TRIES_MAX; tries++) {
+        esl_nvmc_process();
+    }
+    esl_nvmc_flush();
+    if (res != ESL_SUCCESS || esl_clip_count() != 1) {
+        printf("clip not recorded\n");
+        exit(1);
+    }
+    return idx;
+}
+
+// Plays the clip with the scheduler run `latency` periods after work was
+// posted, returns the underruns counted
+static uint32_t play(uint8_t idx, bool loop, uint32_t periods_max, uint32_t latency) {
+    esl_clip_stats_t stats;
+    uint32_t waited = 0;
+
+    esl_clip_stats_get(&stats);
+    uint32_t underruns = stats.underruns;
+    sample_count = 0;
+    done = false;
+    esl_clip_play(idx, loop, done_handler);
+    for (uint32_t t = 0; t < periods_max && !done; t++) {
+        pwm_sim_advance(1);
+        if (!esl_sched_is_empty() && waited++ >= latency) {
+            esl_sched_execute();
+            waited = 0;
+        }
+    }
+    esl_clip_stop();
+    esl_clip_stats_get(&stats);
+    return stats.underruns - underruns;
+}
+
+// Each frame holds for whole PWM periods. After the last frame its color
+// stays until the buffer holding it has played out.
+static uint32_t mismatches_count(uint32_t frames, uint32_t frame_periods) {
+    uint32_t bad = 0;
+    uint8_t rgb[3];
+
+    for (uint32_t s = 0; s < sample_count; s++) {
+        uint32_t frame = s / frame_periods;
+        reference_frame(frame < frames ? frame : frames - 1, rgb);
+        if (memcmp(samples[s], rgb, sizeof(rgb)) != 0) {
+            if (bad == 0) {
+                printf("  period %u, frame %u: %u %u %u, expected %u %u %u\n", s, frame,
+                       samples[s][0], samples[s][1], samples[s][2], rgb[0], rgb[1], rgb[2]);
+            }
+            bad++;
+        }
+    }
+    return bad;
+}
+
+int main(void) {
+    if (nvmc_sim_init(NULL) != NVMC_SIM_OK) {
+        printf("flash region could not be mapped\n");
+        return 1;
+    }
+    esl_nvmc_init();
+    esl_sched_init();
+    esl_pwm_init(&pwm_ctx);
+    esl_clip_init(&pwm_ctx);
+    pwm_sim_sample_handler_set(sample_handler);
+
+    uint8_t idx = clip_record();
+    esl_clip_info_t info;
+    esl_clip_info_get(idx, &info);
+    uint32_t frame_periods = FRAME_MS * 1000 / pwm_sim_period_us();
+    uint32_t chunk = ESL_CLIP_CHUNK_FRAMES * frame_periods;
+    uint32_t pass = info.frames * frame_periods;
+    printf("clip: %u keyframes, %u frames, %u periods of %u us per frame, chunk %u periods\n",
+           info.keyframes, info.frames, frame_periods, pwm_sim_period_us(), chunk);
+
+    const uint32_t latencies[] = { 0, 1, frame_periods, chunk / 2, chunk - 1 };
+    for (uint32_t i = 0; i < sizeof(latencies) / sizeof(latencies[0]); i++) {
+        for (uint8_t loop = 0; loop < 2; loop++) {
+            uint32_t frames = loop ? LOOP_PASSES * info.frames : info.frames;
+            uint32_t periods = loop ? LOOP_PASSES * pass : 2 * pass + 4 * chunk;
+            uint32_t underruns = play(idx, loop, periods, latencies[i]);
+            uint32_t bad = mismatches_count(frames, frame_periods);
+            bool ended = loop || done;
+            printf("latency %3u periods, %s: %6u periods, %u wrong, %u underruns%s\n", latencies[i],
+                   loop ? "looped" : "once  ", sample_count, bad, underruns, ended ? "" : ", never ended");
+            if (bad || underruns || !ended || sample_count < frames * frame_periods) {
+                failures++;
+            }
+        }
+    }
+
+    // Past one chunk the refill comes after its buffer is due
+    uint32_t underruns = play(idx, true, LOOP_PASSES * pass, chunk + frame_periods);
+    printf("latency %3u periods, looped: %u underruns counted\n", chunk + frame_periods, underruns);
+    if (underruns == 0) {
+        failures++;
+    }
+
+    printf("checks failed: %d\n", failures);
+    nvmc_sim_deinit();
+    return failures ? 1 : 0;
+}
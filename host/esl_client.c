@@ -0,0 +1,220 @@
+#include "esl_client.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+static bool write_all(int fd, uint8_t const *data, uint16_t size) {
+    while (size) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool fill(esl_client_t *c, int timeout_ms) {
+    struct pollfd pfd = { .fd = c->fd, .events = POLLIN };
+    int res;
+
+    do {
+        res = poll(&pfd, 1, timeout_ms);
+    } while (res < 0 && errno == EINTR);
+    if (res <= 0) {
+        return false;
+    }
+
+    ssize_t n = read(c->fd, c->rx, sizeof(c->rx));
+    if (n <= 0) {
+        return false;
+    }
+    c->rx_len = n;
+    c->rx_pos = 0;
+    return true;
+}
+
+int esl_client_open(esl_client_t *c, const char *path) {
+    int fd = open(path, O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        return ESL_CLIENT_ERR_IO;
+    }
+
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tio.c_cc[VMIN] = 1;
+        tio.c_cc[VTIME] = 0;
+        tcsetattr(fd, TCSANOW, &tio);
+        tcflush(fd, TCIOFLUSH);
+    }
+    esl_client_attach(c, fd);
+    return 0;
+}
+
+void esl_client_attach(esl_client_t *c, int fd) {
+    memset(c, 0, sizeof(*c));
+    c->fd = fd;
+}
+
+void esl_client_close(esl_client_t *c) {
+    if (c->fd >= 0) {
+        close(c->fd);
+        c->fd = -1;
+    }
+}
+
+int esl_client_send(esl_client_t *c, uint8_t type, void const *payload, uint8_t len) {
+    esl_msg_t msg = { .type = type, .seq = c->seq++, .len = len };
+    uint8_t wire[ESL_FRAME_WIRE_MAX];
+
+    if (len > ESL_FRAME_PAYLOAD_MAX) {
+        return ESL_CLIENT_ERR_IO;
+    }
+    memcpy(msg.payload, payload, len);
+    if (!write_all(c->fd, wire, esl_frame_encode(&msg, wire))) {
+        return ESL_CLIENT_ERR_IO;
+    }
+    return msg.seq;
+}
+
+// Same framing rules as the board: a delimiter right after an opening one
+// opens the frame again
+bool esl_client_recv(esl_client_t *c, esl_msg_t *msg, int timeout_ms) {
+    for (;;) {
+        if (c->rx_pos == c->rx_len && !fill(c, timeout_ms)) {
+            return false;
+        }
+
+        uint8_t byte = c->rx[c->rx_pos++];
+        if (!c->in_frame) {
+            if (byte == ESL_FRAME_DELIM) {
+                c->in_frame = true;
+                c->frame_len = 0;
+                c->frame_overflow = false;
+            } else {
+                c->text_bytes++;
+            }
+        } else if (byte != ESL_FRAME_DELIM) {
+            if (c->frame_len < sizeof(c->frame)) {
+                c->frame[c->frame_len++] = byte;
+            } else {
+                c->frame_overflow = true;
+            }
+        } else if (c->frame_len) {
+            c->in_frame = false;
+            if (!c->frame_overflow && esl_frame_decode(c->frame, c->frame_len, msg) == ESL_SUCCESS) {
+                return true;
+            }
+            c->frames_bad++;
+        }
+    }
+}
+
+int esl_client_request(esl_client_t *c, esl_msg_t const *req, esl_msg_t *reply) {
+    int seq = esl_client_send(c, req->type, req->payload, req->len);
+    if (seq < 0) {
+        return ESL_CLIENT_ERR_IO;
+    }
+
+    while (esl_client_recv(c, reply, ESL_CLIENT_TIMEOUT_MS)) {
+        if (reply->seq == seq && reply->type == (req->type | ESL_MSG_REPLY)) {
+            return reply->len ? reply->payload[0] : ESL_CLIENT_ERR_IO;
+        }
+    }
+    return ESL_CLIENT_ERR_IO;
+}
+
+int esl_client_set_rgb(esl_client_t *c, uint8_t r, uint8_t g, uint8_t b) {
+    esl_msg_t req = { .type = ESL_MSG_SET_RGB, .len = 3, .payload = { r, g, b } };
+    esl_msg_t reply;
+    return esl_client_request(c, &req, &reply);
+}
+
+int esl_client_set_hsv(esl_client_t *c, uint16_t hue, uint8_t saturation, uint8_t brightness) {
+    esl_msg_t req = {
+        .type = ESL_MSG_SET_HSV,
+        .len = 4,
+        .payload = { hue & 0xFF, hue >> 8, saturation, brightness }
+    };
+    esl_msg_t reply;
+    return esl_client_request(c, &req, &reply);
+}
+
+int esl_client_save(esl_client_t *c) {
+    esl_msg_t req = { .type = ESL_MSG_SAVE };
+    esl_msg_t reply;
+    return esl_client_request(c, &req, &reply);
+}
+
+int esl_client_apply(esl_client_t *c, const char *name) {
+    esl_msg_t req = { .type = ESL_MSG_APPLY, .len = strlen(name) };
+    esl_msg_t reply;
+
+    if (req.len == 0 || strlen(name) > ESL_FRAME_PAYLOAD_MAX) {
+        return ESL_MSG_ERR_LENGTH;
+    }
+    memcpy(req.payload, name, req.len);
+    return esl_client_request(c, &req, &reply);
+}
+
+int esl_client_query(esl_client_t *c, esl_client_color_t *color) {
+    esl_msg_t req = { .type = ESL_MSG_QUERY };
+    esl_msg_t reply;
+
+    int status = esl_client_request(c, &req, &reply);
+    if (status != ESL_MSG_OK) {
+        return status;
+    }
+    if (reply.len < 8) {
+        return ESL_CLIENT_ERR_IO;
+    }
+    color->r = reply.payload[1];
+    color->g = reply.payload[2];
+    color->b = reply.payload[3];
+    color->hue = reply.payload[4] | (reply.payload[5] << 8);
+    color->saturation = reply.payload[6];
+    color->brightness = reply.payload[7];
+    return ESL_MSG_OK;
+}
+
+static uint32_t get_le32(uint8_t const *src) {
+    return src[0] | (src[1] << 8) | (src[2] << 16) | ((uint32_t)src[3] << 24);
+}
+
+int esl_client_stream_start(esl_client_t *c, uint16_t delay_ms) {
+    esl_msg_t req = { .type = ESL_MSG_STREAM_START, .len = 2, .payload = { delay_ms & 0xFF, delay_ms >> 8 } };
+    esl_msg_t reply;
+    return esl_client_request(c, &req, &reply);
+}
+
+int esl_client_stream_frame(esl_client_t *c, uint32_t timestamp_ms, uint8_t r, uint8_t g, uint8_t b) {
+    uint8_t payload[7] = { timestamp_ms, timestamp_ms >> 8, timestamp_ms >> 16, timestamp_ms >> 24, r, g, b };
+    return esl_client_send(c, ESL_MSG_STREAM_FRAME, payload, sizeof(payload)) < 0 ? ESL_CLIENT_ERR_IO : ESL_MSG_OK;
+}
+
+int esl_client_stream_stop(esl_client_t *c, esl_client_stream_stats_t *stats) {
+    esl_msg_t req = { .type = ESL_MSG_STREAM_STOP };
+    esl_msg_t reply;
+
+    int status = esl_client_request(c, &req, &reply);
+    if (status != ESL_MSG_OK || stats == NULL) {
+        return status;
+    }
+    if (reply.len < 17) {
+        return ESL_CLIENT_ERR_IO;
+    }
+    stats->frames = get_le32(&reply.payload[1]);
+    stats->applied = get_le32(&reply.payload[5]);
+    stats->underruns = get_le32(&reply.payload[9]);
+    stats->overruns = get_le32(&reply.payload[13]);
+    return ESL_MSG_OK;
+}
@@ -0,0 +1,71 @@
+#ifndef ESL_CLIENT_H
+#define ESL_CLIENT_H
+
+#include "esl_frame.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Host side of the binary control protocol. Works on any file descriptor:
+// the board's CDC tty, or one end of a socket for loopback tests. Text and
+// JSON from the CLI sharing the port are skipped. The board doesn't answer
+// requests while the CLI is in CBOR mode, see esl_frame.h.
+
+#define ESL_CLIENT_TIMEOUT_MS       (500)
+#define ESL_CLIENT_ERR_IO           (-1)    // Timeout, closed port or bad reply
+
+typedef struct {
+    int fd;
+    uint8_t seq;
+    uint8_t rx[512];
+    uint16_t rx_len;
+    uint16_t rx_pos;
+    uint8_t frame[ESL_FRAME_ENCODED_MAX];
+    uint16_t frame_len;
+    bool in_frame;
+    bool frame_overflow;
+    uint32_t frames_bad;        // Failed decode or too long
+    uint32_t text_bytes;        // CLI output skipped between frames
+} esl_client_t;
+
+typedef struct {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    uint16_t hue;
+    uint8_t saturation;
+    uint8_t brightness;
+} esl_client_color_t;
+
+// Opens a tty in raw mode
+int esl_client_open(esl_client_t *c, const char *path);
+void esl_client_attach(esl_client_t *c, int fd);
+void esl_client_close(esl_client_t *c);
+
+// Sends a request and returns its seq, or ESL_CLIENT_ERR_IO
+int esl_client_send(esl_client_t *c, uint8_t type, void const *payload, uint8_t len);
+// Waits for the next valid frame. Returns false on timeout or closed port.
+bool esl_client_recv(esl_client_t *c, esl_msg_t *msg, int timeout_ms);
+// Sends and waits for the matching reply, stale replies are skipped.
+// Returns the reply status or ESL_CLIENT_ERR_IO.
+int esl_client_request(esl_client_t *c, esl_msg_t const *req, esl_msg_t *reply);
+
+int esl_client_set_rgb(esl_client_t *c, uint8_t r, uint8_t g, uint8_t b);
+int esl_client_set_hsv(esl_client_t *c, uint16_t hue, uint8_t saturation, uint8_t brightness);
+int esl_client_save(esl_client_t *c);
+int esl_client_apply(esl_client_t *c, const char *name);
+int esl_client_query(esl_client_t *c, esl_client_color_t *color);
+
+typedef struct {
+    uint32_t frames;
+    uint32_t applied;
+    uint32_t underruns;
+    uint32_t overruns;
+} esl_client_stream_stats_t;
+
+// Frames are sent without waiting, timestamps in ms on any clock that
+// started with the stream. delay_ms 0 keeps the board's default.
+int esl_client_stream_start(esl_client_t *c, uint16_t delay_ms);
+int esl_client_stream_frame(esl_client_t *c, uint32_t timestamp_ms, uint8_t r, uint8_t g, uint8_t b);
+int esl_client_stream_stop(esl_client_t *c, esl_client_stream_stats_t *stats);
+
+#endif // ESL_CLIENT_H
@@ -0,0 +1,44 @@
+// The firmware on Linux: main.c and the modules under it on the simulated
+// board, with the CLI and the binary protocol on a pseudo-terminal, to be
+// driven with a terminal program, scripts or client_bench and profiled
+// with the usual tools.
+//   esl_host [--flash <file>] [--link <path>]
+//     --flash keeps colors, clips and macros in file across runs
+//     --link  makes path a symlink to the terminal
+
+#include "nvmc_sim.h"
+#include "transport_pty.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int firmware_main(void);    // main() of main.c, renamed for this build
+
+static void on_signal(int sig) {
+    exit(0);                // atexit handlers remove the link
+}
+
+int main(int argc, char **argv) {
+    const char *flash_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--flash") == 0 && i + 1 < argc) {
+            flash_path = argv[++i];
+        } else if (strcmp(argv[i], "--link") == 0 && i + 1 < argc) {
+            transport_pty_link_set(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--flash <file>] [--link <path>]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (nvmc_sim_init(flash_path) != NVMC_SIM_OK) {
+        fprintf(stderr, "couldn't set up the flash\n");
+        return 1;
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    return firmware_main();
+}
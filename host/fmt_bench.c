@@ -0,0 +1,286 @@
+// Cost of a reply: the previous path (snprintf into a stack buffer, then
+// prefix, message and suffix copied into the output queue) against
+// esl_reply writing straight into the queue, in text, JSON and CBOR. In
+// text both have to produce the same bytes. Stack use is measured on a
+// painted thread stack.
+//
+// Host times don't stand in for the board's cycles. stats in text can come
+// out slower here than snprintf: each of its 23 fields is a label and a
+// number appended on their own, about 46 bounds-checked copies into the
+// ring, against one pass through glibc's vfprintf and a single copy. What
+// esl_reply saves is the 4 KB of stack, which holds on any build.
+//   fmt_bench
+
+#include "esl_reply.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ROUNDS                      (20000)
+#define STACK_SIZE                  (64 * 1024)
+#define STACK_PAINT                 (0xC5)
+#define LIST_ENTRIES                (15)
+
+#define ANSI_GREEN                  "\033[32m"
+#define ANSI_WHITE                  "\033[37m"
+#define ANSI_RESET                  "\033[0m"
+
+static esl_txq_t txq;
+
+typedef struct {
+    const char *name;
+    uint8_t r, g, b;
+} color_t;
+
+static color_t colors[LIST_ENTRIES];
+
+// The previous reply path
+static void old_msg_write(const char *msg) {
+    static const char suffix[] = ANSI_RESET "\n\r";
+    const char *prefix = ANSI_GREEN "[SUCCESS] " ANSI_WHITE;
+
+    void const *parts[] = { prefix, msg, suffix };
+    uint16_t sizes[] = { strlen(prefix), strlen(msg), sizeof(suffix) - 1 };
+    esl_txq_put(&txq, parts, sizes, 3);
+}
+
+static void old_rgb(void) {
+    char rgb_msg[100];
+    snprintf(rgb_msg, sizeof(rgb_msg), "RGB updated: R=%d, G=%d, B=%d", 255, 128, 7);
+    old_msg_write(rgb_msg);
+}
+
+static void old_list(void) {
+    char ret_msg[1024] = "Saved Colors:\n\r";
+    for (int i = 0; i < LIST_ENTRIES; i++) {
+        char temp_buf[100];
+        snprintf(temp_buf, sizeof(temp_buf), "%d. Name: %s | R: %d, G: %d, B: %d\n\r",
+                 i + 1, colors[i].name, colors[i].r, colors[i].g, colors[i].b);
+        strncat(ret_msg, temp_buf, sizeof(ret_msg) - strlen(ret_msg) - 1);
+    }
+    old_msg_write(ret_msg);
+}
+
+// A quarter of the stats reply, with main.c's labels
+static void old_stats(void) {
+    char stats_msg[1820];
+    snprintf(
+        stats_msg, sizeof(stats_msg),
+        "Power: sleep=%lu ms (%lu%%), wakeups=%lu\n\r"
+        "Last color log: saves=%lu, erases=%lu (%lu per 10k saves), next record=%lu\n\r"
+        "Flash: erases=%lu, write failures=%lu, busy replies=%lu, max stall write=%lu us erase=%lu us\n\r"
+        "Port RX: commands=%lu, packets=%lu, bytes=%lu, pauses=%lu, waits for TX=%lu\n\r"
+        "Port TX: queued=%lu B, high water=%lu/%lu B, transfers=%lu, dropped full=%lu closed=%lu\n\r",
+        3600123ul, 97ul, 48211ul, 1520ul, 3ul, 19ul, 412ul, 17ul, 0ul, 0ul, 52ul, 85012ul,
+        9210ul, 9811ul, 301244ul, 0ul, 2ul, 0ul, 1733ul, 4096ul, 9302ul, 0ul, 14ul
+    );
+    old_msg_write(stats_msg);
+}
+
+// esl_reply, as main.c does it: prefix and tags from cli_reply_begin(),
+// values with their keys and labels, suffix from cli_reply_end(). The
+// listing is one message here, main.c sends each entry as its own.
+static esl_reply_mode_t mode;
+static esl_reply_t reply;
+
+static esl_reply_t *new_begin(const char *cmd) {
+    static const esl_fmt_lit_t prefix = ESL_FMT_LIT(ANSI_GREEN "[SUCCESS] " ANSI_WHITE);
+    esl_txq_msg_begin(&txq);
+    if (mode == ESL_REPLY_MODE_TEXT) {
+        esl_fmt_lit(&txq, &prefix);
+    }
+    esl_reply_open(&reply, &txq, mode);
+    esl_reply_tag(&reply, "status", "ok");
+    esl_reply_tag(&reply, "cmd", cmd);
+    return &reply;
+}
+
+static void new_end(void) {
+    static const esl_fmt_lit_t suffix = ESL_FMT_LIT(ANSI_RESET "\n\r");
+    if (mode == ESL_REPLY_MODE_TEXT) {
+        esl_fmt_lit(&txq, &suffix);
+    }
+    esl_reply_close(&reply);
+    esl_txq_msg_end(&txq);
+}
+
+static void new_rgb(void) {
+    esl_reply_t *r = new_begin("rgb");
+    ESL_REPLY_TEXT(r, "RGB updated: ");
+    esl_reply_u32(r, "r", "R=", 255);
+    esl_reply_u32(r, "g", ", G=", 128);
+    esl_reply_u32(r, "b", ", B=", 7);
+    new_end();
+}
+
+static void new_list(void) {
+    esl_reply_t *r = new_begin("list_colors");
+    ESL_REPLY_TEXT(r, "Saved Colors:\n\r");
+    esl_reply_list_begin(r, "colors");
+    for (uint32_t i = 0; i < LIST_ENTRIES; i++) {
+        esl_reply_obj_begin(r, NULL);
+        esl_reply_u32(r, NULL, NULL, i + 1);
+        esl_reply_str(r, "name", ". Name: ", colors[i].name);
+        esl_reply_u32(r, "r", " | R: ", colors[i].r);
+        esl_reply_u32(r, "g", ", G: ", colors[i].g);
+        esl_reply_u32(r, "b", ", B: ", colors[i].b);
+        ESL_REPLY_TEXT(r, "\n\r");
+        esl_reply_obj_end(r);
+    }
+    esl_reply_list_end(r);
+    new_end();
+}
+
+static void new_stats(void) {
+    esl_reply_t *r = new_begin("stats");
+    esl_reply_obj_begin(r, "power");
+    esl_reply_u32(r, "sleep_ms", "Power: sleep=", 3600123);
+    esl_reply_u32(r, "sleep_pct", " ms (", 97);
+    esl_reply_u32(r, "wakeups", "%), wakeups=", 48211);
+    esl_reply_obj_end(r);
+    esl_reply_obj_begin(r, "last_color_log");
+    esl_reply_u32(r, "saves", "\n\rLast color log: saves=", 1520);
+    esl_reply_u32(r, "erases", ", erases=", 3);
+    esl_reply_u32(r, "erases_per_10k", " (", 19);
+    esl_reply_u32(r, "next_record", " per 10k saves), next record=", 412);
+    esl_reply_obj_end(r);
+    esl_reply_obj_begin(r, "flash");
+    esl_reply_u32(r, "erases", "\n\rFlash: erases=", 17);
+    esl_reply_u32(r, "write_failures", ", write failures=", 0);
+    esl_reply_u32(r, "queue_full", ", busy replies=", 0);
+    esl_reply_u32(r, "max_write_stall_us", ", max stall write=", 52);
+    esl_reply_u32(r, "max_erase_stall_us", " us erase=", 85012);
+    esl_reply_obj_end(r);
+    esl_reply_obj_begin(r, "port_rx");
+    esl_reply_u32(r, "commands", " us\n\rPort RX: commands=", 9210);
+    esl_reply_u32(r, "packets", ", packets=", 9811);
+    esl_reply_u32(r, "bytes", ", bytes=", 301244);
+    esl_reply_u32(r, "pauses", ", pauses=", 0);
+    esl_reply_u32(r, "tx_waits", ", waits for TX=", 2);
+    esl_reply_obj_end(r);
+    esl_reply_obj_begin(r, "port_tx");
+    esl_reply_u32(r, "queued", "\n\rPort TX: queued=", 0);
+    esl_reply_u32(r, "high_water", " B, high water=", 1733);
+    esl_reply_u32(r, "size", "/", 4096);
+    esl_reply_u32(r, "transfers", " B, transfers=", 9302);
+    esl_reply_u32(r, "dropped_full", ", dropped full=", 0);
+    esl_reply_u32(r, "dropped_closed", " closed=", 14);
+    esl_reply_obj_end(r);
+    ESL_REPLY_TEXT(r, "\n\r");
+    new_end();
+}
+
+typedef struct {
+    const char *name;
+    void (*old_fn)(void);
+    void (*new_fn)(void);
+} reply_t;
+
+static const reply_t replies[] = {
+    { "rgb", old_rgb, new_rgb },
+    { "list_colors", old_list, new_list },
+    { "stats", old_stats, new_stats },
+};
+
+// Takes everything queued, as the transport would
+static uint16_t drain(uint8_t *out, uint16_t size) {
+    uint8_t const *data;
+    uint16_t len, total = 0;
+    while ((len = esl_txq_next(&txq, &data)) != 0) {
+        if (total + len <= size) {
+            memcpy(out + total, data, len);
+        }
+        total += len;
+        esl_txq_sent(&txq);
+    }
+    return total;
+}
+
+static double bench(void (*fn)(void)) {
+    struct timespec t0, t1;
+    uint8_t sink[ESL_TX_RING_SIZE];
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint32_t i = 0; i < ROUNDS; i++) {
+        fn();
+        drain(sink, sizeof(sink));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / ROUNDS;
+}
+
+static void *stack_run(void *arg) {
+    ((void (*)(void))arg)();
+    return NULL;
+}
+
+static void stack_nop(void) {
+}
+
+static uint8_t stack[STACK_SIZE] __attribute__((aligned(4096)));
+
+// Deepest byte touched on a painted stack, the stack grows down
+static size_t stack_used(void (*fn)(void)) {
+    pthread_attr_t attr;
+    pthread_t thread;
+
+    memset(stack, STACK_PAINT, STACK_SIZE);
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, stack, STACK_SIZE);
+    pthread_create(&thread, &attr, stack_run, (void *)fn);
+    pthread_join(thread, NULL);
+    pthread_attr_destroy(&attr);
+
+    size_t untouched = 0;
+    while (untouched < STACK_SIZE && stack[untouched] == STACK_PAINT) {
+        untouched++;
+    }
+    drain(NULL, 0);
+    return STACK_SIZE - untouched;
+}
+
+int main(void) {
+    static const char * const names[] = { "sunset", "dawn", "ocean", "forest", "lavender" };
+    static const char * const mode_names[] = { "text", "json", "cbor" };
+    uint8_t old_out[ESL_TX_RING_SIZE];
+    uint8_t new_out[ESL_TX_RING_SIZE];
+    int failures = 0;
+
+    for (int i = 0; i < LIST_ENTRIES; i++) {
+        colors[i] = (color_t){ names[i % 5], i * 17, 255 - i * 9, i };
+    }
+    esl_txq_init(&txq);
+
+    size_t base = stack_used(stack_nop);
+    printf("%-12s %-5s %10s %10s %12s %12s %8s\n", "reply", "mode", "old ns", "new ns", "old stack B", "new stack B",
+           "bytes");
+    for (size_t i = 0; i < sizeof(replies) / sizeof(replies[0]); i++) {
+        reply_t const *r = &replies[i];
+
+        r->old_fn();
+        uint16_t old_len = drain(old_out, sizeof(old_out));
+        double old_ns = bench(r->old_fn);
+        size_t old_stack = stack_used(r->old_fn) - base;
+
+        for (mode = ESL_REPLY_MODE_TEXT; mode <= ESL_REPLY_MODE_CBOR; mode++) {
+            r->new_fn();
+            uint16_t new_len = drain(new_out, sizeof(new_out));
+            if (mode == ESL_REPLY_MODE_TEXT && (old_len != new_len || memcmp(old_out, new_out, old_len) != 0)) {
+                printf("%s: output differs (%u vs %u bytes)\n", r->name, old_len, new_len);
+                failures++;
+            }
+            if (mode == ESL_REPLY_MODE_TEXT) {
+                printf("%-12s %-5s %10.0f %10.0f %12zu %12zu %8u\n", r->name, mode_names[mode], old_ns,
+                       bench(r->new_fn), old_stack, stack_used(r->new_fn) - base, new_len);
+            } else {
+                printf("%-12s %-5s %10s %10.0f %12s %12zu %8u\n", r->name, mode_names[mode], "",
+                       bench(r->new_fn), "", stack_used(r->new_fn) - base, new_len);
+            }
+        }
+    }
+    printf("outputs differing: %d\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,19 @@
+#ifndef APP_ERROR_H__
+#define APP_ERROR_H__
+
+// Host stand-in. Errors stop the program where the board would reset.
+
+#include "sdk_errors.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define APP_ERROR_CHECK(err_code) \
+    do { \
+        ret_code_t const app_err = (err_code); \
+        if (app_err != NRF_SUCCESS) { \
+            fprintf(stderr, "%s:%d: error 0x%x\n", __FILE__, __LINE__, (unsigned)app_err); \
+            abort(); \
+        } \
+    } while (0)
+
+#endif // APP_ERROR_H__
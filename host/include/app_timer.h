@@ -0,0 +1,47 @@
+#ifndef APP_TIMER_H__
+#define APP_TIMER_H__
+
+// Host stand-in, backed by board_sim.c. Timers run on the monotonic clock
+// and fire from board_sim_irq(), the host's interrupt point. Like the real
+// header, it pulls in the SDK configuration.
+
+#include "sdk_config.h"
+#include "sdk_errors.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define APP_TIMER_CLOCK_FREQ        (32768)
+#define APP_TIMER_TICKS(ms)         ((uint32_t)(((uint64_t)(ms) * APP_TIMER_CLOCK_FREQ + 500) / 1000))
+
+typedef void (*app_timer_timeout_handler_t)(void *p_context);
+
+typedef enum {
+    APP_TIMER_MODE_SINGLE_SHOT,
+    APP_TIMER_MODE_REPEATED
+} app_timer_mode_t;
+
+typedef struct {
+    app_timer_timeout_handler_t handler;
+    app_timer_mode_t mode;
+    bool active;
+    uint64_t due;               // Ticks since start
+    uint32_t period;
+    void *p_context;
+} app_timer_t;
+
+typedef app_timer_t *app_timer_id_t;
+
+#define APP_TIMER_DEF(timer_id) \
+    static app_timer_t timer_id##_data; \
+    static app_timer_id_t const timer_id = &timer_id##_data
+
+ret_code_t app_timer_init(void);
+ret_code_t app_timer_create(app_timer_id_t const *p_timer_id, app_timer_mode_t mode,
+                            app_timer_timeout_handler_t timeout_handler);
+ret_code_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void *p_context);
+ret_code_t app_timer_stop(app_timer_id_t timer_id);
+uint32_t app_timer_cnt_get(void);           // 24 bits, like the RTC
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from);
+
+#endif // APP_TIMER_H__
@@ -0,0 +1,10 @@
+#ifndef APP_UTIL_PLATFORM_H__
+#define APP_UTIL_PLATFORM_H__
+
+// Host stand-in. Simulated interrupts run synchronously from the caller, so
+// critical regions have nothing to mask.
+
+#define CRITICAL_REGION_ENTER()     {
+#define CRITICAL_REGION_EXIT()      }
+
+#endif // APP_UTIL_PLATFORM_H__
@@ -0,0 +1,10 @@
+#ifndef CRC16_H__
+#define CRC16_H__
+
+// Host stand-in for the SDK crc16 library, same CRC-16/CCITT variant
+
+#include <stdint.h>
+
+uint16_t crc16_compute(uint8_t const * p_data, uint32_t size, uint16_t const * p_crc);
+
+#endif // CRC16_H__
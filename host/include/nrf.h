@@ -0,0 +1,11 @@
+#ifndef NRF_H
+#define NRF_H
+
+// Host stand-in. The core's sleep waits for the simulated board's next
+// event instead.
+
+#include "board_sim.h"
+
+#define __WFE()                     board_sim_wfe()
+
+#endif // NRF_H
@@ -0,0 +1,6 @@
+#ifndef NRF_DELAY_H__
+#define NRF_DELAY_H__
+
+// Host stand-in, nothing the application uses
+
+#endif // NRF_DELAY_H__
@@ -0,0 +1,16 @@
+#ifndef NRF_DRV_CLOCK_H__
+#define NRF_DRV_CLOCK_H__
+
+// Host stand-in, the monotonic clock is always running
+
+#include "sdk_errors.h"
+#include <stddef.h>
+
+static inline ret_code_t nrf_drv_clock_init(void) {
+    return NRF_SUCCESS;
+}
+
+static inline void nrf_drv_clock_lfclk_request(void *p_handler_item) {
+}
+
+#endif // NRF_DRV_CLOCK_H__
@@ -0,0 +1,33 @@
+#ifndef NRF_GPIO_H__
+#define NRF_GPIO_H__
+
+// Host stand-in, backed by board_sim.c. Nothing is attached: outputs keep
+// what was written and inputs read as their pull leaves them.
+
+#include <stdint.h>
+
+#define NRF_GPIO_PIN_MAP(port, pin)     (((port) << 5) | ((pin) & 0x1F))
+
+typedef enum {
+    NRF_GPIO_PIN_NOPULL     = 0,
+    NRF_GPIO_PIN_PULLDOWN   = 1,
+    NRF_GPIO_PIN_PULLUP     = 3,
+} nrf_gpio_pin_pull_t;
+
+typedef struct {
+    uint32_t OUT;
+    uint32_t IN;
+} NRF_GPIO_Type;
+
+extern NRF_GPIO_Type board_sim_ports[2];
+
+#define NRF_P0                      (&board_sim_ports[0])
+#define NRF_P1                      (&board_sim_ports[1])
+
+void nrf_gpio_cfg_output(uint32_t pin_number);
+void nrf_gpio_cfg_input(uint32_t pin_number, nrf_gpio_pin_pull_t pull_config);
+void nrf_gpio_pin_write(uint32_t pin_number, uint32_t value);
+uint32_t nrf_gpio_pin_read(uint32_t pin_number);
+uint32_t nrf_gpio_port_in_read(NRF_GPIO_Type const *p_reg);
+
+#endif // NRF_GPIO_H__
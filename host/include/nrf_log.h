@@ -0,0 +1,19 @@
+#ifndef NRF_LOG_H_
+#define NRF_LOG_H_
+
+// Host stand-in for the nrf_log frontend. Messages go to stderr when the
+// library is built with HOST_LOG=1, and are dropped otherwise.
+
+#ifdef HOST_LOG
+#include <stdio.h>
+#define HOST_LOG_PRINT(level, ...)  do { fprintf(stderr, level ": " __VA_ARGS__); fputc('\n', stderr); } while (0)
+#else
+#define HOST_LOG_PRINT(level, ...)  do { } while (0)
+#endif
+
+#define NRF_LOG_ERROR(...)          HOST_LOG_PRINT("error", __VA_ARGS__)
+#define NRF_LOG_WARNING(...)        HOST_LOG_PRINT("warning", __VA_ARGS__)
+#define NRF_LOG_INFO(...)           HOST_LOG_PRINT("info", __VA_ARGS__)
+#define NRF_LOG_DEBUG(...)          HOST_LOG_PRINT("debug", __VA_ARGS__)
+
+#endif // NRF_LOG_H_
@@ -0,0 +1,8 @@
+#ifndef NRF_LOG_BACKEND_USB_H
+#define NRF_LOG_BACKEND_USB_H
+
+// Host stand-in, see nrf_log.h
+
+#define LOG_BACKEND_USB_PROCESS()           do { } while (0)
+
+#endif // NRF_LOG_BACKEND_USB_H
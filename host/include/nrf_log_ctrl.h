@@ -0,0 +1,12 @@
+#ifndef NRF_LOG_CTRL_H
+#define NRF_LOG_CTRL_H
+
+// Host stand-in, messages are written as they are logged, see nrf_log.h
+
+#include "sdk_errors.h"
+#include <stdbool.h>
+
+#define NRF_LOG_INIT(timestamp_func)    (NRF_SUCCESS)
+#define NRF_LOG_PROCESS()               (false)
+
+#endif // NRF_LOG_CTRL_H
@@ -0,0 +1,8 @@
+#ifndef NRF_LOG_DEFAULT_BACKENDS_H__
+#define NRF_LOG_DEFAULT_BACKENDS_H__
+
+// Host stand-in, see nrf_log.h
+
+#define NRF_LOG_DEFAULT_BACKENDS_INIT()     do { } while (0)
+
+#endif // NRF_LOG_DEFAULT_BACKENDS_H__
@@ -0,0 +1,6 @@
+#ifndef NRFX_CLOCK_H__
+#define NRFX_CLOCK_H__
+
+// Host stand-in, nothing the application uses
+
+#endif // NRFX_CLOCK_H__
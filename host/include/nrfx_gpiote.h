@@ -0,0 +1,42 @@
+#ifndef NRFX_GPIOTE_H__
+#define NRFX_GPIOTE_H__
+
+// Host stand-in, backed by board_sim.c. Pins never change, so no event
+// ever comes. Like the real header, it pulls in the SDK configuration.
+
+#include "sdk_config.h"
+#include "nrf_gpio.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef uint32_t nrfx_err_t;
+typedef uint32_t nrfx_gpiote_pin_t;
+
+#define NRFX_SUCCESS                (0x0BAD0000)
+
+typedef enum {
+    NRF_GPIOTE_POLARITY_LOTOHI = 1,
+    NRF_GPIOTE_POLARITY_HITOLO,
+    NRF_GPIOTE_POLARITY_TOGGLE
+} nrf_gpiote_polarity_t;
+
+typedef struct {
+    nrf_gpiote_polarity_t sense;
+    nrf_gpio_pin_pull_t pull;
+    bool is_watcher;
+    bool hi_accuracy;
+    bool skip_gpio_setup;
+} nrfx_gpiote_in_config_t;
+
+#define NRFX_GPIOTE_CONFIG_IN_SENSE_TOGGLE(hi_accu) \
+    { .sense = NRF_GPIOTE_POLARITY_TOGGLE, .pull = NRF_GPIO_PIN_NOPULL, .hi_accuracy = (hi_accu) }
+
+typedef void (*nrfx_gpiote_evt_handler_t)(nrfx_gpiote_pin_t pin, nrf_gpiote_polarity_t action);
+
+nrfx_err_t nrfx_gpiote_init(void);
+bool nrfx_gpiote_is_init(void);
+nrfx_err_t nrfx_gpiote_in_init(nrfx_gpiote_pin_t pin, nrfx_gpiote_in_config_t const *p_config,
+                               nrfx_gpiote_evt_handler_t evt_handler);
+void nrfx_gpiote_in_event_enable(nrfx_gpiote_pin_t pin, bool int_enable);
+
+#endif // NRFX_GPIOTE_H__
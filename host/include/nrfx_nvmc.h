@@ -0,0 +1,22 @@
+#ifndef NRFX_NVMC_H__
+#define NRFX_NVMC_H__
+
+// Host stand-in for the nrfx NVMC driver, backed by nvmc_sim.c. Only the
+// calls used by the application are provided.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef uint32_t nrfx_err_t;
+
+#define NRFX_SUCCESS                (0x0BAD0000)
+#define NRFX_ERROR_INVALID_ADDR     (0x0BAD0010)
+
+nrfx_err_t nrfx_nvmc_page_erase(uint32_t address);
+nrfx_err_t nrfx_nvmc_page_partial_erase_init(uint32_t address, uint32_t duration_ms);
+bool nrfx_nvmc_page_partial_erase_continue(void);
+bool nrfx_nvmc_word_writable_check(uint32_t address, uint32_t value);
+void nrfx_nvmc_word_write(uint32_t address, uint32_t value);
+bool nrfx_nvmc_write_done_check(void);
+
+#endif // NRFX_NVMC_H__
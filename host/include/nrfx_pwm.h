@@ -0,0 +1,82 @@
+#ifndef NRFX_PWM_H__
+#define NRFX_PWM_H__
+
+// Host stand-in for the nrfx PWM driver, backed by pwm_sim.c. Only the
+// calls and types used by the application are provided. Like the real
+// header, it pulls in the SDK configuration.
+
+#include "sdk_config.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef uint32_t nrfx_err_t;
+
+typedef struct {
+    uint8_t drv_inst_idx;
+} nrfx_pwm_t;
+
+#define NRFX_PWM_INSTANCE(id)       { .drv_inst_idx = (id) }
+
+typedef struct {
+    uint16_t channel_0;
+    uint16_t channel_1;
+    uint16_t channel_2;
+    uint16_t channel_3;
+} nrf_pwm_values_individual_t;
+
+typedef union {
+    uint16_t const *p_raw;
+    nrf_pwm_values_individual_t const *p_individual;
+} nrf_pwm_values_t;
+
+typedef struct {
+    nrf_pwm_values_t values;
+    uint16_t length;            // In 16-bit values
+    uint32_t repeats;           // Extra PWM periods each value is played
+    uint32_t end_delay;
+} nrf_pwm_sequence_t;
+
+#define NRF_PWM_VALUES_LENGTH(array)    (sizeof(array) / sizeof(uint16_t))
+
+typedef enum { NRF_PWM_CLK_500kHz = 5 } nrf_pwm_clk_t;
+typedef enum { NRF_PWM_MODE_UP } nrf_pwm_mode_t;
+typedef enum { NRF_PWM_LOAD_COMMON, NRF_PWM_LOAD_GROUPED, NRF_PWM_LOAD_INDIVIDUAL, NRF_PWM_LOAD_WAVE_FORM } nrf_pwm_dec_load_t;
+typedef enum { NRF_PWM_STEP_AUTO, NRF_PWM_STEP_TRIGGERED } nrf_pwm_dec_step_t;
+
+typedef struct {
+    uint8_t output_pins[4];
+    uint8_t irq_priority;
+    nrf_pwm_clk_t base_clock;
+    nrf_pwm_mode_t count_mode;
+    uint16_t top_value;
+    nrf_pwm_dec_load_t load_mode;
+    nrf_pwm_dec_step_t step_mode;
+} nrfx_pwm_config_t;
+
+#define NRFX_PWM_DEFAULT_CONFIG     { .top_value = 1000 }
+
+typedef enum {
+    NRFX_PWM_EVT_FINISHED,
+    NRFX_PWM_EVT_END_SEQ0,
+    NRFX_PWM_EVT_END_SEQ1,
+    NRFX_PWM_EVT_STOPPED
+} nrfx_pwm_evt_type_t;
+
+typedef void (*nrfx_pwm_handler_t)(nrfx_pwm_evt_type_t event_type);
+
+#define NRFX_PWM_FLAG_STOP                  (0x01)
+#define NRFX_PWM_FLAG_LOOP                  (0x02)
+#define NRFX_PWM_FLAG_SIGNAL_END_SEQ0       (0x04)
+#define NRFX_PWM_FLAG_SIGNAL_END_SEQ1       (0x08)
+#define NRFX_PWM_FLAG_NO_EVT_FINISHED       (0x10)
+
+nrfx_err_t nrfx_pwm_init(nrfx_pwm_t const *p_instance, nrfx_pwm_config_t const *p_config,
+                         nrfx_pwm_handler_t handler);
+uint32_t nrfx_pwm_simple_playback(nrfx_pwm_t const *p_instance, nrf_pwm_sequence_t const *p_sequence,
+                                  uint16_t playback_count, uint32_t flags);
+uint32_t nrfx_pwm_complex_playback(nrfx_pwm_t const *p_instance, nrf_pwm_sequence_t const *p_sequence_0,
+                                   nrf_pwm_sequence_t const *p_sequence_1, uint16_t playback_count,
+                                   uint32_t flags);
+bool nrfx_pwm_stop(nrfx_pwm_t const *p_instance, bool wait_until_stopped);
+
+#endif // NRFX_PWM_H__
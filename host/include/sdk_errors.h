@@ -0,0 +1,13 @@
+#ifndef SDK_ERRORS_H__
+#define SDK_ERRORS_H__
+
+// Host stand-in, only the codes the application checks
+
+#include <stdint.h>
+
+typedef uint32_t ret_code_t;
+
+#define NRF_SUCCESS                 (0)
+#define NRF_ERROR_NO_MEM            (4)
+
+#endif // SDK_ERRORS_H__
@@ -0,0 +1,853 @@
+// Power cut recovery and boot time of the saved colors, on the simulated
+// NVMC. Every kind of color change is replayed with power cut before and
+// during each flash operation it does in turn, then booted again: each name has to come
+// back as it was before or after the change, the index, count and listing
+// have to agree, and the store has to stay writable. Also reports the boot
+// scan time of an empty store, a full one and one whose compaction was cut
+// short. The last color log gets the same cuts in the middle of a page and
+// on a page switch, and its page erases per 10k saves are counted. Pages of
+// the fixed size record format are converted at boot, with and without
+// power cut during the conversion, and nothing may be lost either way. The
+// flash taken per color is reported against the fixed size format.
+// Random trials then run mixed changes over a small set of names with
+// background work in between and cut power at a random point. Every name
+// has to come back with one of the values it held since the last cut, and
+// the next trial goes on from what came back.
+//   nvmc_check
+
+#include "esl_nvmc.h"
+#include "nvmc_sim.h"
+#include "nrfx_nvmc.h"
+#include "crc16.h"
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STORE_MAX                   (ESL_NVMC_INDEX_SIZE)
+#define BUSY_TRIES_MAX              (100000)
+#define BASE_COLORS                 (40)
+#define FULL_COLORS                 (700)
+#define BOOTS                       (20)
+#define RGB_SAVES                   (10000)
+#define RGB_LOG_WORDS               (PAGE_SIZE / sizeof(uint32_t))
+#define V1_SLOTS                    ((PAGE_SIZE - 2 * sizeof(uint32_t)) / sizeof(v1_record_t))
+#define V1_PAGES                    (ESL_NVMC_COLOR_PAGES - 1)
+#define V1_RECORDS_MAX              (V1_PAGES * V1_SLOTS)
+#define V1_CUT_PAGES                (2)
+#define V1_CUT_RECORDS              (40)
+#define TRIALS                      (400)
+#define TRIAL_OPS                   (60)
+#define TRIAL_NAMES                 (24)
+#define TRIAL_SEED                  (0x2545F491)
+#define ABSENT                      (UINT32_MAX)
+
+typedef enum {
+    OP_ADD,
+    OP_DELETE,
+    OP_RENAME
+} op_kind_t;
+
+typedef struct {
+    op_kind_t kind;
+    const char *name;
+    const char *new_name;
+    uint32_t value;
+} op_t;
+
+typedef struct {
+    char name[ESL_NVMC_COLOR_NAME_LEN];
+    uint32_t value;
+} entry_t;
+
+// Fixed size record format that came before records sized to their name
+typedef struct {
+    uint8_t state;
+    uint8_t version;
+    uint16_t crc;
+    uint32_t seq;
+    esl_nvmc_saved_color_t color;
+} v1_record_t;
+
+typedef struct {
+    uint32_t count;
+    entry_t entries[STORE_MAX];
+} store_t;
+
+static jmp_buf cut_jmp;
+static uint8_t *base;
+static store_t before, after, now, again;
+static int failures = 0;
+
+static void cut_handler(void) {
+    longjmp(cut_jmp, 1);
+}
+
+// Two cut points per flash operation: before it starts and while it runs
+static void cut_arm(uint32_t point) {
+    nvmc_sim_cut_arm((point + 1) / 2, point % 2 ? NVMC_SIM_CUT_BEFORE : NVMC_SIM_CUT_TORN, cut_handler);
+}
+
+static uint32_t rgb_value(esl_nvmc_saved_color_t const *color) {
+    esl_nvmc_rgb_data_t const *rgb = &color->fields.rgb_data;
+    return rgb->r_val | rgb->g_val << 8 | (uint32_t)rgb->b_val << 16;
+}
+
+static esl_ret_code_t op_try(op_t const *op) {
+    esl_nvmc_saved_color_t color;
+
+    switch (op->kind) {
+    case OP_ADD:
+        memset(&color, 0, sizeof(color));
+        strncpy(color.fields.color_name, op->name, sizeof(color.fields.color_name) - 1);
+        color.fields.rgb_data.magic_number = ESL_NVMC_BYTE_VALID;
+        color.fields.rgb_data.r_val = op->value;
+        color.fields.rgb_data.g_val = op->value >> 8;
+        color.fields.rgb_data.b_val = op->value >> 16;
+        return esl_nvmc_color_add(&color);
+    case OP_DELETE:
+        return esl_nvmc_color_delete(op->name);
+    default:
+        return esl_nvmc_color_rename(op->name, op->new_name);
+    }
+}
+
+// Busy is not an error here, the queue is run until the change goes in
+static esl_ret_code_t op_run(op_t const *op) {
+    esl_ret_code_t res;
+    for (uint32_t tries = 0; (res = op_try(op)) == ESL_ERR_BUSY && tries < BUSY_TRIES_MAX; tries++) {
+        esl_nvmc_process();
+    }
+    return res;
+}
+
+// Reads the store through the listing and checks it against the index
+static bool store_read(store_t *store, const char *label) {
+    esl_nvmc_saved_color_t color;
+    uint32_t iter = 0;
+    bool ok = true;
+
+    store->count = 0;
+    while (esl_nvmc_color_next(&iter, &color)) {
+        if (store->count == STORE_MAX) {
+            printf("%s: listing runs past %u colors\n", label, STORE_MAX);
+            return false;
+        }
+        entry_t *entry = &store->entries[store->count++];
+        strcpy(entry->name, color.fields.color_name);
+        entry->value = rgb_value(&color);
+
+        esl_nvmc_saved_color_t found;
+        if (esl_nvmc_color_find(entry->name, &found) != ESL_SUCCESS ||
+            rgb_value(&found) != entry->value) {
+            printf("%s: '%s' listed but not found as listed\n", label, entry->name);
+            ok = false;
+        }
+        for (uint32_t i = 0; i + 1 < store->count; i++) {
+            if (strcmp(store->entries[i].name, entry->name) == 0) {
+                printf("%s: '%s' listed twice\n", label, entry->name);
+                ok = false;
+            }
+        }
+    }
+    if (store->count != esl_nvmc_color_count()) {
+        printf("%s: %u colors listed, count says %u\n", label, store->count, esl_nvmc_color_count());
+        ok = false;
+    }
+    return ok;
+}
+
+static entry_t const * store_find(store_t const *store, const char *name) {
+    for (uint32_t i = 0; i < store->count; i++) {
+        if (strcmp(store->entries[i].name, name) == 0) {
+            return &store->entries[i];
+        }
+    }
+    return NULL;
+}
+
+static bool store_equal(store_t const *a, store_t const *b) {
+    if (a->count != b->count) {
+        return false;
+    }
+    for (uint32_t i = 0; i < a->count; i++) {
+        entry_t const *other = store_find(b, a->entries[i].name);
+        if (other == NULL || other->value != a->entries[i].value) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// A name is as before or as after the change, or present in one and absent
+// in the other. A rename may leave both names behind, but never neither.
+static bool name_ok(const char *name) {
+    entry_t const *cur = store_find(&now, name);
+    entry_t const *old = store_find(&before, name);
+    entry_t const *new = store_find(&after, name);
+
+    if (cur == NULL) {
+        return old == NULL || new == NULL;
+    }
+    return (old && old->value == cur->value) || (new && new->value == cur->value);
+}
+
+// Boots the store as power came back, then checks it, lets it finish what
+// it queues at boot, boots again and makes sure it can still take a color
+static bool recovered_ok(const char *label, uint32_t cut, bool rename) {
+    nvmc_sim_stats_t sim;
+    bool ok;
+
+    esl_nvmc_init();
+    ok = store_read(&now, label);
+    for (uint32_t i = 0; i < now.count; i++) {
+        ok &= name_ok(now.entries[i].name);
+    }
+    for (uint32_t i = 0; i < before.count; i++) {
+        ok &= name_ok(before.entries[i].name);
+    }
+    for (uint32_t i = 0; i < after.count; i++) {
+        ok &= name_ok(after.entries[i].name);
+    }
+    uint32_t lo = before.count < after.count ? before.count : after.count;
+    uint32_t hi = (before.count > after.count ? before.count : after.count) + (rename ? 1 : 0);
+    if (now.count < lo || now.count > hi) {
+        printf("%s, cut %u: %u colors, expected %u to %u\n", label, cut, now.count, lo, hi);
+        ok = false;
+    }
+
+    esl_nvmc_flush();
+    esl_nvmc_init();
+    ok &= store_read(&again, label);
+    if (!store_equal(&now, &again)) {
+        printf("%s, cut %u: store changed over the second boot\n", label, cut);
+        ok = false;
+    }
+
+    op_t probe = { OP_ADD, "probe", NULL, 0x123456 };
+    esl_nvmc_saved_color_t color;
+    if (op_run(&probe) != ESL_SUCCESS && now.count < ESL_NVMC_INDEX_SIZE * 3 / 4) {
+        printf("%s, cut %u: store no longer takes colors\n", label, cut);
+        ok = false;
+    } else {
+        esl_nvmc_flush();
+        esl_nvmc_init();
+        if (esl_nvmc_color_find("probe", &color) != ESL_SUCCESS) {
+            printf("%s, cut %u: new color lost over a boot\n", label, cut);
+            ok = false;
+        }
+    }
+
+    nvmc_sim_stats_get(&sim);
+    if (sim.violations) {
+        printf("%s, cut %u: %u flash rule violations\n", label, cut, sim.violations);
+        ok = false;
+    }
+    return ok;
+}
+
+// Runs the change from the base store once without a cut to learn how many
+// flash operations it takes and what it leaves, then once per cut point
+static void replay(const char *label, op_t const *op) {
+    nvmc_sim_snapshot_restore(base);
+    esl_nvmc_init();
+    store_read(&before, label);
+    uint32_t start = nvmc_sim_ops_get();
+    if (op_run(op) != ESL_SUCCESS) {
+        printf("%s: change failed without a cut\n", label);
+        failures++;
+        return;
+    }
+    esl_nvmc_flush();
+    uint32_t ops = nvmc_sim_ops_get() - start;
+    store_read(&after, label);
+
+    uint32_t bad = 0;
+    for (uint32_t cut = 1; cut <= 2 * ops; cut++) {
+        nvmc_sim_snapshot_restore(base);
+        nvmc_sim_stats_reset();
+        esl_nvmc_init();
+        if (setjmp(cut_jmp) == 0) {
+            cut_arm(cut);
+            op_run(op);
+            esl_nvmc_flush();
+        }
+        nvmc_sim_cut_disarm();
+        if (!recovered_ok(label, cut, op->kind == OP_RENAME)) {
+            bad++;
+        }
+    }
+    char title[32];
+    snprintf(title, sizeof(title), "%s:", label);
+    printf("%-22s %5u cut points, %u failed\n", title, 2 * ops, bad);
+    failures += bad;
+}
+
+static void base_build(uint32_t colors) {
+    nvmc_sim_erase_all();
+    esl_nvmc_init();
+    for (uint32_t i = 0; i < colors; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "color%u", i);
+        op_t op = { OP_ADD, name, NULL, i * 0x010203 };
+        op_run(&op);
+        // Some replaced copies, so pages hold dead records too
+        if (i % 3 == 0) {
+            op.value++;
+            op_run(&op);
+        }
+    }
+    esl_nvmc_flush();
+    nvmc_sim_snapshot_save(base);
+}
+
+// Keeps replacing colors in a scattered order until a save starts a
+// compaction, and leaves the store as it was just before that save in base
+static op_t compaction_base_build(uint32_t colors) {
+    static char name[16];
+    esl_nvmc_stats_t stats;
+
+    base_build(colors);
+    for (uint32_t i = 0; ; i++) {
+        snprintf(name, sizeof(name), "color%u", i * 7919 % colors);
+        op_t op = { OP_ADD, name, NULL, i + 0x100 };
+        nvmc_sim_snapshot_save(base);
+        esl_nvmc_stats_get(&stats);
+        uint32_t compactions = stats.colors_compactions;
+        op_run(&op);
+        esl_nvmc_flush();
+        esl_nvmc_stats_get(&stats);
+        if (stats.colors_compactions != compactions) {
+            return op;
+        }
+    }
+}
+
+static void boot_time(const char *label) {
+    esl_nvmc_stats_t stats;
+    uint64_t cycles = 0;
+
+    for (uint32_t i = 0; i < BOOTS; i++) {
+        esl_nvmc_init();
+        esl_nvmc_stats_get(&stats);
+        cycles += stats.colors_scan_cycles;
+    }
+    printf("boot scan, %-18s %6llu us, %u colors, pages summarized %u, scanned %u\n", label,
+           (unsigned long long)ESL_CYCLES_TO_US(cycles / BOOTS), esl_nvmc_color_count(),
+           stats.colors_pages_summarized, stats.colors_pages_scanned);
+}
+
+static void boot_times(op_t const *compaction) {
+    nvmc_sim_erase_all();
+    boot_time("empty store:");
+
+    esl_nvmc_init();
+    for (uint32_t i = 0; ; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "full%u", i);
+        op_t op = { OP_ADD, name, NULL, i };
+        if (op_run(&op) != ESL_SUCCESS) {
+            break;
+        }
+    }
+    esl_nvmc_flush();
+    boot_time("full store:");
+
+    // Cut halfway through the moves of a compaction
+    nvmc_sim_snapshot_restore(base);
+    esl_nvmc_init();
+    uint32_t start = nvmc_sim_ops_get();
+    op_run(compaction);
+    esl_nvmc_flush();
+    uint32_t ops = nvmc_sim_ops_get() - start;
+
+    nvmc_sim_snapshot_restore(base);
+    esl_nvmc_init();
+    if (setjmp(cut_jmp) == 0) {
+        nvmc_sim_cut_arm(ops / 2, NVMC_SIM_CUT_TORN, cut_handler);
+        op_run(compaction);
+        esl_nvmc_flush();
+    }
+    nvmc_sim_cut_disarm();
+    boot_time("compaction cut:");
+}
+
+static void words_write(uint32_t addr, void const *src, size_t size) {
+    uint32_t const *words = src;
+    for (size_t i = 0; i < size / sizeof(uint32_t); i++) {
+        nrfx_nvmc_word_write(addr + i * sizeof(uint32_t), words[i]);
+    }
+}
+
+// Fills pages the way the fixed size format did, slot by slot, with names
+// replaced, deleted, left with two live copies by a cut replace, and one
+// record torn before its header. The newest live copy of each name is what
+// has to come back, it goes to expected.
+static void v1_build(uint32_t pages, uint32_t per_page, store_t *expected) {
+    static v1_record_t records[V1_RECORDS_MAX];
+    static uint32_t addrs[V1_RECORDS_MAX];
+    uint32_t total = pages * per_page;
+    uint32_t names = total * 3 / 4;
+
+    nvmc_sim_erase_all();
+    for (uint32_t i = 0; i < total; i++) {
+        uint32_t page = i / per_page;
+        uint32_t n = i < names ? i : i * 7 % names;
+        v1_record_t *record = &records[i];
+
+        if (i % per_page == 0) {
+            uint32_t header[2] = { 100 + page, ~(100 + page) };
+            words_write(COLORS_START_ADDR + page * PAGE_SIZE, header, sizeof(header));
+        }
+        addrs[i] = COLORS_START_ADDR + page * PAGE_SIZE + sizeof(uint32_t[2]) + i % per_page * sizeof(*record);
+
+        // The first page gets the longest names
+        memset(record, 0, sizeof(*record));
+        char *name = record->color.fields.color_name;
+        int len = snprintf(name, ESL_NVMC_COLOR_NAME_LEN, "old%u", n);
+        if (n < per_page) {
+            memset(name + len, 'x', ESL_NVMC_COLOR_NAME_LEN - 1 - len);
+        }
+        record->color.fields.rgb_data.magic_number = ESL_NVMC_BYTE_VALID;
+        record->color.fields.rgb_data.r_val = i;
+        record->color.fields.rgb_data.g_val = i >> 8;
+        record->color.fields.rgb_data.b_val = 0x5A;
+        record->seq = i;
+        record->state = ESL_NVMC_BYTE_VALID;
+        record->version = 1;
+        record->crc = crc16_compute((uint8_t const *)&record->seq,
+                                    sizeof(record->seq) + sizeof(record->color), NULL);
+        words_write(addrs[i] + sizeof(uint32_t), &record->seq, sizeof(*record) - sizeof(uint32_t));
+        if (i % 37 == 5) {
+            record->state = 0xFF;
+            continue;
+        }
+        words_write(addrs[i], record, sizeof(uint32_t));
+
+        // Replaced copies are tombstoned, except every third one
+        for (uint32_t j = 0; i >= names && j < i; j++) {
+            if (records[j].state == ESL_NVMC_BYTE_VALID && j % 3 != 0 &&
+                strcmp(records[j].color.fields.color_name, record->color.fields.color_name) == 0) {
+                records[j].state = ESL_NVMC_BYTE_DELETED;
+                words_write(addrs[j], &records[j], sizeof(uint32_t));
+            }
+        }
+        if (i % 9 == 4) {
+            record->state = ESL_NVMC_BYTE_DELETED;
+            words_write(addrs[i], record, sizeof(uint32_t));
+        }
+    }
+
+    // An entry of the old summary page, which knows none of the new pages
+    uint32_t summary[5] = { 0x1234, 100, 0x55, 0, 0 };
+    words_write(COLORS_SUMMARY_PG_ADDR, summary, sizeof(summary));
+
+    expected->count = 0;
+    for (uint32_t i = total; i-- > 0; ) {
+        v1_record_t const *record = &records[i];
+        if (record->state == ESL_NVMC_BYTE_VALID && !store_find(expected, record->color.fields.color_name)) {
+            entry_t *entry = &expected->entries[expected->count++];
+            strcpy(entry->name, record->color.fields.color_name);
+            entry->value = rgb_value(&record->color);
+        }
+    }
+}
+
+// The converted store holds exactly the expected colors, before and after
+// another boot, and takes new ones
+static bool v1_converted_ok(const char *label, store_t const *expected) {
+    nvmc_sim_stats_t sim;
+    bool ok = store_read(&now, label);
+
+    if (!store_equal(&now, expected)) {
+        printf("%s: %u colors after conversion, expected %u\n", label, now.count, expected->count);
+        ok = false;
+    }
+    esl_nvmc_flush();
+    esl_nvmc_init();
+    ok &= store_read(&again, label);
+    if (!store_equal(&now, &again)) {
+        printf("%s: store changed over the second boot\n", label);
+        ok = false;
+    }
+    op_t probe = { OP_ADD, "probe", NULL, 0x123456 };
+    if (op_run(&probe) != ESL_SUCCESS) {
+        printf("%s: store no longer takes colors\n", label);
+        ok = false;
+    }
+    esl_nvmc_flush();
+    nvmc_sim_stats_get(&sim);
+    if (sim.violations) {
+        printf("%s: %u flash rule violations\n", label, sim.violations);
+        ok = false;
+    }
+    return ok;
+}
+
+// Flash taken per color with short names, against the fixed size
+// esl_nvmc_saved_color_t every color used to take
+static void density(void) {
+    esl_nvmc_stats_t stats;
+
+    nvmc_sim_erase_all();
+    esl_nvmc_init();
+    for (uint32_t i = 0; i < 100; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "c%05u", i);
+        op_t op = { OP_ADD, name, NULL, i };
+        op_run(&op);
+    }
+    esl_nvmc_flush();
+    esl_nvmc_stats_get(&stats);
+    uint32_t each = stats.colors_bytes_used / esl_nvmc_color_count();
+    uint32_t before = sizeof(esl_nvmc_saved_color_t);
+    printf("density: %u B per color with 6 character names, %u B before (%u.%02ux)\n",
+           each, before, before / each, before * 100 / each % 100);
+    if (each > 16) {
+        failures++;
+    }
+}
+
+static void v1_convert(void) {
+    static store_t expected;
+    esl_nvmc_stats_t stats;
+
+    v1_build(V1_PAGES, V1_SLOTS, &expected);
+    nvmc_sim_stats_reset();
+    esl_nvmc_init();
+    esl_nvmc_stats_get(&stats);
+    uint32_t converted = stats.colors_migrated;
+    bool ok = v1_converted_ok("old format", &expected) && converted == expected.count;
+    printf("old format: %u records on %u pages, %u colors converted in %llu us, %s\n",
+           (unsigned)V1_RECORDS_MAX, V1_PAGES, converted,
+           (unsigned long long)ESL_CYCLES_TO_US(stats.colors_scan_cycles), ok ? "ok" : "failed");
+    failures += ok ? 0 : 1;
+
+    // Cut at every point of a smaller conversion
+    v1_build(V1_CUT_PAGES, V1_CUT_RECORDS, &expected);
+    nvmc_sim_snapshot_save(base);
+    uint32_t start = nvmc_sim_ops_get();
+    esl_nvmc_init();
+    uint32_t ops = nvmc_sim_ops_get() - start;
+
+    uint32_t bad = 0;
+    for (uint32_t cut = 1; cut <= 2 * ops; cut++) {
+        char label[40];
+        snprintf(label, sizeof(label), "old format conversion, cut %u", cut);
+        nvmc_sim_snapshot_restore(base);
+        nvmc_sim_stats_reset();
+        if (setjmp(cut_jmp) == 0) {
+            cut_arm(cut);
+            esl_nvmc_init();
+        }
+        nvmc_sim_cut_disarm();
+        esl_nvmc_init();
+        if (!v1_converted_ok(label, &expected)) {
+            bad++;
+        }
+    }
+    printf("%-22s %5u cut points, %u failed\n", "old format conversion:", 2 * ops, bad);
+    failures += bad;
+}
+
+static esl_ret_code_t rgb_save_run(uint32_t value) {
+    esl_ret_code_t res;
+    for (uint32_t tries = 0; (res = esl_nvmc_last_rgb_save(value, value >> 8, value >> 16)) == ESL_ERR_BUSY &&
+         tries < BUSY_TRIES_MAX; tries++) {
+        esl_nvmc_process();
+    }
+    return res;
+}
+
+static uint32_t rgb_loaded(void) {
+    esl_nvmc_rgb_data_t rgb;
+    if (!esl_nvmc_last_rgb_load(&rgb)) {
+        return UINT32_MAX;
+    }
+    return rgb.r_val | rgb.g_val << 8 | (uint32_t)rgb.b_val << 16;
+}
+
+static uint32_t rgb_erases(void) {
+    return nvmc_sim_page_erases_get(LAST_COLOR_PG_ADDR) + nvmc_sim_page_erases_get(LAST_COLOR_SPARE_PG_ADDR);
+}
+
+// The log appends one word per save and erases a page once per page full
+static void rgb_wear(void) {
+    nvmc_sim_erase_all();
+    esl_nvmc_init();
+    uint32_t erases = rgb_erases();
+
+    for (uint32_t i = 0; i < RGB_SAVES; i++) {
+        if (rgb_save_run(i) != ESL_SUCCESS) {
+            printf("last color: save %u failed\n", i);
+            failures++;
+            return;
+        }
+        esl_nvmc_flush();
+    }
+    erases = rgb_erases() - erases;
+
+    uint32_t limit = RGB_SAVES / RGB_LOG_WORDS + 1;
+    esl_nvmc_init();
+    if (rgb_loaded() != RGB_SAVES - 1) {
+        printf("last color: wrong color after boot\n");
+        failures++;
+    }
+    printf("last color: %u saves, %u page erases (%u per 10k saves, limit %u)\n",
+           RGB_SAVES, erases, erases * 10000 / RGB_SAVES, limit);
+    if (erases > limit) {
+        failures++;
+    }
+}
+
+// Saves a new color after `saved` others with power cut at each cut point
+// in turn. The old or the new color has to come back, and the log
+// has to keep taking colors.
+static void rgb_replay(const char *label, uint32_t saved) {
+    const uint32_t old_value = 0x010203 + saved - 1;
+    const uint32_t new_value = 0xA0B0C0;
+
+    nvmc_sim_erase_all();
+    esl_nvmc_init();
+    for (uint32_t i = 0; i < saved; i++) {
+        rgb_save_run(0x010203 + i);
+    }
+    esl_nvmc_flush();
+    nvmc_sim_snapshot_save(base);
+
+    esl_nvmc_init();
+    uint32_t start = nvmc_sim_ops_get();
+    rgb_save_run(new_value);
+    esl_nvmc_flush();
+    uint32_t ops = nvmc_sim_ops_get() - start;
+
+    uint32_t bad = 0;
+    for (uint32_t cut = 1; cut <= 2 * ops; cut++) {
+        nvmc_sim_snapshot_restore(base);
+        nvmc_sim_stats_reset();
+        esl_nvmc_init();
+        if (setjmp(cut_jmp) == 0) {
+            cut_arm(cut);
+            rgb_save_run(new_value);
+            esl_nvmc_flush();
+        }
+        nvmc_sim_cut_disarm();
+
+        esl_nvmc_init();
+        uint32_t value = rgb_loaded();
+        bool ok = value == old_value || value == new_value;
+        if (!ok) {
+            printf("%s, cut %u: loaded %06X\n", label, cut, value);
+        }
+        esl_nvmc_flush();
+        for (uint32_t i = 0; ok && i < 3; i++) {
+            ok = rgb_save_run(0x300000 + i) == ESL_SUCCESS;
+            esl_nvmc_flush();
+            esl_nvmc_init();
+            ok = ok && rgb_loaded() == 0x300000 + i;
+        }
+        nvmc_sim_stats_t sim;
+        nvmc_sim_stats_get(&sim);
+        if (!ok || sim.violations) {
+            printf("%s, cut %u: log broken after the cut\n", label, cut);
+            ok = false;
+        }
+        bad += ok ? 0 : 1;
+    }
+    char title[32];
+    snprintf(title, sizeof(title), "%s:", label);
+    printf("%-22s %5u cut points, %u failed\n", title, 2 * ops, bad);
+    failures += bad;
+}
+
+// Values a name held since the last cut, any of them may come back
+typedef struct {
+    char name[ESL_NVMC_COLOR_NAME_LEN];
+    uint32_t count;
+    uint32_t values[TRIAL_OPS + 1];
+} history_t;
+
+static history_t histories[TRIAL_NAMES];
+static uint32_t rand_state = TRIAL_SEED;
+
+static uint32_t rand_next(void) {
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+static uint32_t history_last(history_t const *history) {
+    return history->values[history->count - 1];
+}
+
+static void history_push(history_t *history, uint32_t value) {
+    if (history_last(history) != value) {
+        history->values[history->count++] = value;
+    }
+}
+
+// Recovered names, each has to be one of its values since the last cut
+static bool trial_recovered_ok(uint32_t trial) {
+    char label[32];
+    bool ok;
+
+    snprintf(label, sizeof(label), "random trial %u", trial);
+    esl_nvmc_init();
+    ok = store_read(&now, label);
+    for (uint32_t i = 0; i < now.count; i++) {
+        if (strncmp(now.entries[i].name, "trial", 5) != 0) {
+            printf("%s: unknown name '%s'\n", label, now.entries[i].name);
+            ok = false;
+        }
+    }
+    for (uint32_t i = 0; i < TRIAL_NAMES; i++) {
+        history_t *history = &histories[i];
+        entry_t const *entry = store_find(&now, history->name);
+        uint32_t value = entry ? entry->value : ABSENT;
+        bool known = false;
+        for (uint32_t h = 0; h < history->count; h++) {
+            known |= history->values[h] == value;
+        }
+        if (!known) {
+            printf("%s: '%s' came back as %06X, never held since the last cut\n",
+                   label, history->name, value);
+            ok = false;
+        }
+        history->values[0] = value;
+        history->count = 1;
+    }
+
+    esl_nvmc_flush();
+    esl_nvmc_init();
+    ok &= store_read(&again, label);
+    if (!store_equal(&now, &again)) {
+        printf("%s: store changed over the second boot\n", label);
+        ok = false;
+    }
+
+    nvmc_sim_stats_t sim;
+    nvmc_sim_stats_get(&sim);
+    if (sim.violations) {
+        printf("%s: %u flash rule violations\n", label, sim.violations);
+        ok = false;
+    }
+    nvmc_sim_stats_reset();
+    return ok;
+}
+
+static void trial_run(void) {
+    for (uint32_t i = 0; i < TRIAL_OPS; i++) {
+        history_t *history = &histories[rand_next() % TRIAL_NAMES];
+        history_t *target = &histories[rand_next() % TRIAL_NAMES];
+        uint32_t kind = rand_next() % 8;
+        op_t op;
+
+        if (kind < 5) {
+            op = (op_t){ OP_ADD, history->name, NULL, rand_next() & 0xFFFFFF };
+        } else if (kind < 7) {
+            op = (op_t){ OP_DELETE, history->name, NULL, 0 };
+        } else {
+            op = (op_t){ OP_RENAME, history->name, target->name, 0 };
+        }
+
+        // Pushed first, the change may be on its way to flash by the time
+        // op_run() comes back
+        uint32_t old_value = history_last(history);
+        uint32_t count = history->count;
+        uint32_t target_count = target->count;
+        history_push(history, op.kind == OP_ADD ? op.value : ABSENT);
+        if (op.kind == OP_RENAME) {
+            history_push(target, old_value);
+        }
+
+        if (op_run(&op) != ESL_SUCCESS) {
+            // Nothing changed, drop what was pushed
+            target->count = target_count;
+            history->count = count;
+        }
+        for (uint32_t slices = rand_next() % 4; slices > 0; slices--) {
+            esl_nvmc_process();
+        }
+    }
+    esl_nvmc_flush();
+}
+
+// Random changes with power cut at a random flash operation. Trials that
+// finish before the cut are checked the same way.
+static void random_trials(void) {
+    esl_nvmc_stats_t stats;
+    uint32_t cuts = 0;
+    uint32_t bad = 0;
+    uint32_t compactions = 0;
+
+    nvmc_sim_erase_all();
+    nvmc_sim_stats_reset();
+    esl_nvmc_init();
+    for (uint32_t i = 0; i < TRIAL_NAMES; i++) {
+        // Names of different lengths, so records differ in size
+        snprintf(histories[i].name, sizeof(histories[i].name), "trial%u%.*s", i,
+                 (int)(i % 20), "--------------------");
+        histories[i].values[0] = ABSENT;
+        histories[i].count = 1;
+    }
+
+    for (uint32_t trial = 0; trial < TRIALS; trial++) {
+        volatile bool cut = true;
+        if (setjmp(cut_jmp) == 0) {
+            cut_arm(1 + rand_next() % 800);
+            trial_run();
+            cut = false;
+        }
+        nvmc_sim_cut_disarm();
+        esl_nvmc_stats_get(&stats);
+        compactions += stats.colors_compactions;
+        cuts += cut ? 1 : 0;
+        if (!trial_recovered_ok(trial)) {
+            bad++;
+        }
+    }
+    printf("random cuts: %u trials of %u changes, %u cut short, %u compactions, %u failed\n",
+           TRIALS, TRIAL_OPS, cuts, compactions, bad);
+    failures += bad;
+}
+
+int main(void) {
+    if (nvmc_sim_init(NULL) != NVMC_SIM_OK) {
+        printf("flash region could not be mapped\n");
+        return 1;
+    }
+    base = malloc(nvmc_sim_snapshot_size());
+
+    base_build(BASE_COLORS);
+    op_t save = { OP_ADD, "new color", NULL, 0xABCDEF };
+    op_t replace = { OP_ADD, "color7", NULL, 0x00FF00 };
+    op_t delete = { OP_DELETE, "color12", NULL, 0 };
+    op_t rename = { OP_RENAME, "color20", "renamed color", 0 };
+    replay("save", &save);
+    replay("replace", &replace);
+    replay("delete", &delete);
+    replay("rename", &rename);
+
+    op_t compaction = compaction_base_build(BASE_COLORS);
+    replay("save with compaction", &compaction);
+    op_t full_compaction = compaction_base_build(FULL_COLORS);
+    replay("full store compaction", &full_compaction);
+
+    boot_times(&compaction);
+
+    density();
+    v1_convert();
+
+    rgb_replay("last color save", 5);
+    rgb_replay("last color page switch", RGB_LOG_WORDS);
+    rgb_wear();
+
+    random_trials();
+
+    printf("checks failed: %d\n", failures);
+    nvmc_sim_deinit();
+    free(base);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,287 @@
+#include "nvmc_sim.h"
+#include "nrfx_nvmc.h"
+#include "esl_nvmc.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define SIM_START_ADDR              APP_DATA_START_ADDR
+#define SIM_END_ADDR                APP_DATA_END_ADDR
+#define SIM_SIZE                    (SIM_END_ADDR - SIM_START_ADDR)
+#define SIM_PAGES                   (SIM_SIZE / PAGE_SIZE)
+#define SIM_WORDS                   (SIM_SIZE / sizeof(uint32_t))
+#define WORD_ERASED                 (0xFFFFFFFF)
+
+static uint8_t *flash = NULL;
+static int flash_fd = -1;
+static uint8_t word_writes[SIM_WORDS];      // Writes since the last erase
+static uint32_t page_erases[SIM_PAGES];
+static nvmc_sim_stats_t sim_stats;
+
+static uint32_t ops = 0;
+static uint32_t cut_at = 0;
+static bool cut_armed = false;
+static nvmc_sim_cut_t cut_kind = NVMC_SIM_CUT_TORN;
+static nvmc_sim_cut_handler_t cut_handler = NULL;
+
+static uint32_t erase_addr;
+static uint32_t erase_elapsed_ms;
+static uint32_t erase_step_ms;
+static bool erase_active = false;
+
+static bool in_range(uint32_t addr, uint32_t size) {
+    return flash != NULL && addr >= SIM_START_ADDR && addr + size <= SIM_END_ADDR;
+}
+
+static uint32_t * word_at(uint32_t addr) {
+    return (uint32_t *)(flash + (addr - SIM_START_ADDR));
+}
+
+static void violation(const char *what, uint32_t addr) {
+    sim_stats.violations++;
+    fprintf(stderr, "nvmc_sim: %s at 0x%08x\n", what, (unsigned)addr);
+}
+
+// Counts an operation and reports whether power is cut during it
+static bool op_cut(void) {
+    ops++;
+    if (!cut_armed || ops != cut_at) {
+        return false;
+    }
+    cut_armed = false;
+    return true;
+}
+
+static void power_cut(void) {
+    if (cut_handler == NULL) {
+        exit(NVMC_SIM_EXIT_POWER_CUT);
+    }
+    cut_handler();
+}
+
+static void page_erase_now(uint32_t page_addr, uint32_t bytes) {
+    uint32_t first = (page_addr - SIM_START_ADDR) / sizeof(uint32_t);
+
+    memset(word_at(page_addr), 0xFF, bytes);
+    memset(&word_writes[first], 0, bytes / sizeof(uint32_t));
+}
+
+nvmc_sim_ret_t nvmc_sim_init(const char *path) {
+    int flags = MAP_SHARED;
+
+    nvmc_sim_deinit();
+    if (path) {
+        flash_fd = open(path, O_RDWR | O_CREAT, 0644);
+        if (flash_fd < 0) {
+            return NVMC_SIM_ERR_FILE;
+        }
+        // A new file reads back as erased flash
+        off_t size = lseek(flash_fd, 0, SEEK_END);
+        if (size < (off_t)SIM_SIZE) {
+            uint8_t erased[PAGE_SIZE];
+            memset(erased, 0xFF, sizeof(erased));
+            for (off_t pos = size & ~(off_t)(PAGE_SIZE - 1); pos < (off_t)SIM_SIZE; pos += PAGE_SIZE) {
+                if (pwrite(flash_fd, erased, PAGE_SIZE, pos) != PAGE_SIZE) {
+                    nvmc_sim_deinit();
+                    return NVMC_SIM_ERR_FILE;
+                }
+            }
+        }
+    } else {
+        flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    }
+
+    // The address is only a hint, so check it was honoured
+    void *map = mmap((void *)(uintptr_t)SIM_START_ADDR, SIM_SIZE, PROT_READ | PROT_WRITE, flags, flash_fd, 0);
+    if (map == MAP_FAILED || map != (void *)(uintptr_t)SIM_START_ADDR) {
+        if (map != MAP_FAILED) {
+            munmap(map, SIM_SIZE);
+        }
+        nvmc_sim_deinit();
+        return NVMC_SIM_ERR_MAP;
+    }
+    flash = map;
+    if (!path) {
+        memset(flash, 0xFF, SIM_SIZE);
+    }
+
+    memset(word_writes, 0, sizeof(word_writes));
+    memset(page_erases, 0, sizeof(page_erases));
+    memset(&sim_stats, 0, sizeof(sim_stats));
+    ops = 0;
+    cut_armed = false;
+    erase_active = false;
+    return NVMC_SIM_OK;
+}
+
+void nvmc_sim_deinit(void) {
+    if (flash) {
+        munmap(flash, SIM_SIZE);
+        flash = NULL;
+    }
+    if (flash_fd >= 0) {
+        close(flash_fd);
+        flash_fd = -1;
+    }
+}
+
+void nvmc_sim_erase_all(void) {
+    if (flash) {
+        memset(flash, 0xFF, SIM_SIZE);
+        memset(word_writes, 0, sizeof(word_writes));
+    }
+}
+
+void nvmc_sim_cut_arm(uint32_t after_ops, nvmc_sim_cut_t cut, nvmc_sim_cut_handler_t handler) {
+    cut_at = ops + after_ops;
+    cut_kind = cut;
+    cut_handler = handler;
+    cut_armed = after_ops > 0;
+}
+
+void nvmc_sim_cut_disarm(void) {
+    cut_armed = false;
+}
+
+uint32_t nvmc_sim_ops_get(void) {
+    return ops;
+}
+
+size_t nvmc_sim_snapshot_size(void) {
+    return SIM_SIZE + sizeof(word_writes);
+}
+
+void nvmc_sim_snapshot_save(void *buf) {
+    memcpy(buf, flash, SIM_SIZE);
+    memcpy((uint8_t *)buf + SIM_SIZE, word_writes, sizeof(word_writes));
+}
+
+// An erase in progress is lost, as after a reset
+void nvmc_sim_snapshot_restore(void const *buf) {
+    memcpy(flash, buf, SIM_SIZE);
+    memcpy(word_writes, (uint8_t const *)buf + SIM_SIZE, sizeof(word_writes));
+    erase_active = false;
+}
+
+uint32_t nvmc_sim_page_erases_get(uint32_t page_addr) {
+    if (!in_range(page_addr, PAGE_SIZE)) {
+        return 0;
+    }
+    return page_erases[(page_addr - SIM_START_ADDR) / PAGE_SIZE];
+}
+
+void nvmc_sim_stats_get(nvmc_sim_stats_t *stats) {
+    *stats = sim_stats;
+}
+
+void nvmc_sim_stats_reset(void) {
+    memset(&sim_stats, 0, sizeof(sim_stats));
+}
+
+nrfx_err_t nrfx_nvmc_page_erase(uint32_t address) {
+    if (address % PAGE_SIZE != 0 || !in_range(address, PAGE_SIZE)) {
+        violation("page erase out of range", address);
+        return NRFX_ERROR_INVALID_ADDR;
+    }
+
+    sim_stats.busy_us += NVMC_SIM_ERASE_MS * 1000;
+    if (op_cut()) {
+        if (cut_kind == NVMC_SIM_CUT_TORN) {
+            page_erase_now(address, PAGE_SIZE / 2);
+        }
+        power_cut();
+        return NRFX_SUCCESS;
+    }
+    page_erase_now(address, PAGE_SIZE);
+    page_erases[(address - SIM_START_ADDR) / PAGE_SIZE]++;
+    sim_stats.page_erases++;
+    return NRFX_SUCCESS;
+}
+
+nrfx_err_t nrfx_nvmc_page_partial_erase_init(uint32_t address, uint32_t duration_ms) {
+    if (address % PAGE_SIZE != 0 || !in_range(address, PAGE_SIZE) || duration_ms == 0) {
+        violation("partial erase out of range", address);
+        return NRFX_ERROR_INVALID_ADDR;
+    }
+    erase_addr = address;
+    erase_step_ms = duration_ms;
+    erase_elapsed_ms = 0;
+    erase_active = true;
+    return NRFX_SUCCESS;
+}
+
+// The page only reads as erased once the steps add up to a full erase time
+bool nrfx_nvmc_page_partial_erase_continue(void) {
+    if (!erase_active) {
+        violation("partial erase not started", 0);
+        return true;
+    }
+
+    erase_elapsed_ms += erase_step_ms;
+    sim_stats.busy_us += erase_step_ms * 1000;
+    sim_stats.partial_erase_steps++;
+    if (op_cut()) {
+        if (cut_kind == NVMC_SIM_CUT_TORN) {
+            page_erase_now(erase_addr, PAGE_SIZE / 2);
+        }
+        erase_active = false;
+        power_cut();
+        return true;
+    }
+    if (erase_elapsed_ms < NVMC_SIM_ERASE_MS) {
+        return false;
+    }
+
+    page_erase_now(erase_addr, PAGE_SIZE);
+    page_erases[(erase_addr - SIM_START_ADDR) / PAGE_SIZE]++;
+    sim_stats.page_erases++;
+    erase_active = false;
+    return true;
+}
+
+bool nrfx_nvmc_word_writable_check(uint32_t address, uint32_t value) {
+    if (address % sizeof(uint32_t) != 0 || !in_range(address, sizeof(uint32_t))) {
+        return false;
+    }
+    return (*word_at(address) & value) == value;
+}
+
+// Programming can only clear bits, whatever is asked for
+void nrfx_nvmc_word_write(uint32_t address, uint32_t value) {
+    if (address % sizeof(uint32_t) != 0 || !in_range(address, sizeof(uint32_t))) {
+        violation("misaligned or out of range write", address);
+        return;
+    }
+
+    uint32_t *word = word_at(address);
+    uint8_t *writes = &word_writes[(address - SIM_START_ADDR) / sizeof(uint32_t)];
+    if ((*word & value) != value) {
+        violation("write needs a 0 -> 1 transition", address);
+    }
+    if (*writes >= NVMC_SIM_MAX_WRITES) {
+        violation("word written too often since erase", address);
+    } else {
+        (*writes)++;
+    }
+
+    sim_stats.busy_us += NVMC_SIM_WRITE_US;
+    sim_stats.words_written++;
+    if (op_cut()) {
+        if (cut_kind == NVMC_SIM_CUT_TORN) {
+            *word &= value | 0xFFFF0000;
+        } else if (*writes > 0) {
+            (*writes)--;
+        }
+        power_cut();
+        return;
+    }
+    *word &= value;
+}
+
+bool nrfx_nvmc_write_done_check(void) {
+    return true;
+}
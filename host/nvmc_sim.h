@@ -0,0 +1,62 @@
+#ifndef NVMC_SIM_H
+#define NVMC_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// RAM backed NOR flash behind the nrfx_nvmc calls, for host builds. The
+// application data region is mapped at its real address, so flash reads
+// through pointers work unchanged. Writes and erases follow the nRF52840
+// rules and every breach is counted as a violation.
+
+#define NVMC_SIM_WRITE_US           (41)        // tWRITE
+#define NVMC_SIM_ERASE_MS           (85)        // tERASEPAGE
+#define NVMC_SIM_MAX_WRITES         (2)         // nWRITE, writes per word between erases
+#define NVMC_SIM_EXIT_POWER_CUT     (3)         // Exit status when a cut has no handler
+
+typedef enum {
+    NVMC_SIM_OK,
+    NVMC_SIM_ERR_MAP,           // Region could not be mapped at its address
+    NVMC_SIM_ERR_FILE
+} nvmc_sim_ret_t;
+
+typedef struct {
+    uint32_t words_written;
+    uint32_t page_erases;
+    uint32_t partial_erase_steps;
+    uint32_t violations;        // 0 -> 1 writes, misaligned or out of range access, too many writes
+    uint64_t busy_us;           // Time the CPU would have stalled on the NVMC
+} nvmc_sim_stats_t;
+
+// Called when the armed power cut hits. It should not return (longjmp or
+// exit); if it does, execution goes on with the interrupted operation left
+// half done.
+typedef void (*nvmc_sim_cut_handler_t)(void);
+
+// path keeps the contents in a file across runs, NULL starts erased
+nvmc_sim_ret_t nvmc_sim_init(const char *path);
+void nvmc_sim_deinit(void);
+void nvmc_sim_erase_all(void);
+
+typedef enum {
+    NVMC_SIM_CUT_TORN,          // Word left half programmed, page half erased
+    NVMC_SIM_CUT_BEFORE         // Operation not started, the one before it done
+} nvmc_sim_cut_t;
+
+// Cuts power at the ops-th flash operation from now, a word write or an
+// erase step
+void nvmc_sim_cut_arm(uint32_t ops, nvmc_sim_cut_t cut, nvmc_sim_cut_handler_t handler);
+void nvmc_sim_cut_disarm(void);
+uint32_t nvmc_sim_ops_get(void);    // Operations done since init
+
+// Flash contents and per word write counts, to replay from one state
+size_t nvmc_sim_snapshot_size(void);
+void nvmc_sim_snapshot_save(void *buf);
+void nvmc_sim_snapshot_restore(void const *buf);
+
+uint32_t nvmc_sim_page_erases_get(uint32_t page_addr);     // Wear of one page
+void nvmc_sim_stats_get(nvmc_sim_stats_t *stats);
+void nvmc_sim_stats_reset(void);    // Keeps the wear counters
+
+#endif // NVMC_SIM_H
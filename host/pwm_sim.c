@@ -0,0 +1,119 @@
+#include "pwm_sim.h"
+
+#include <string.h>
+
+// Base clock frequencies in kHz, indexed by nrf_pwm_clk_t
+static const uint32_t clk_khz[] = { 16000, 8000, 4000, 2000, 1000, 500, 250, 125 };
+
+static nrfx_pwm_handler_t evt_handler = NULL;
+static pwm_sim_sample_handler_t sample_handler = NULL;
+static uint32_t period_us;
+
+static nrf_pwm_sequence_t const *seqs[2];
+static uint32_t flags;
+static uint32_t loops_left;     // Playbacks of the pair after this one, unless looping
+static bool playing = false;
+static uint8_t seq_idx;
+static uint16_t value_idx;      // In individual values
+static uint32_t repeat;
+static pwm_sim_stats_t sim_stats;
+
+nrfx_err_t nrfx_pwm_init(nrfx_pwm_t const *p_instance, nrfx_pwm_config_t const *p_config,
+                         nrfx_pwm_handler_t handler) {
+    evt_handler = handler;
+    period_us = (uint32_t)p_config->top_value * 1000 / clk_khz[p_config->base_clock];
+    playing = false;
+    memset(&sim_stats, 0, sizeof(sim_stats));
+    return 0;
+}
+
+static void playback_start(nrf_pwm_sequence_t const *seq0, nrf_pwm_sequence_t const *seq1,
+                           uint16_t count, uint32_t playback_flags) {
+    seqs[0] = seq0;
+    seqs[1] = seq1;
+    flags = playback_flags;
+    loops_left = count - 1;
+    seq_idx = 0;
+    value_idx = 0;
+    repeat = 0;
+    playing = true;
+    sim_stats.playbacks++;
+}
+
+// As in nrfx, a simple playback plays the sequence twice per loop
+uint32_t nrfx_pwm_simple_playback(nrfx_pwm_t const *p_instance, nrf_pwm_sequence_t const *p_sequence,
+                                  uint16_t playback_count, uint32_t flags) {
+    playback_start(p_sequence, p_sequence, (playback_count + 1) / 2, flags);
+    return 0;
+}
+
+uint32_t nrfx_pwm_complex_playback(nrfx_pwm_t const *p_instance, nrf_pwm_sequence_t const *p_sequence_0,
+                                   nrf_pwm_sequence_t const *p_sequence_1, uint16_t playback_count,
+                                   uint32_t flags) {
+    playback_start(p_sequence_0, p_sequence_1, playback_count, flags);
+    return 0;
+}
+
+bool nrfx_pwm_stop(nrfx_pwm_t const *p_instance, bool wait_until_stopped) {
+    playing = false;
+    return true;
+}
+
+static void seq_end(void) {
+    nrfx_pwm_evt_type_t evt = seq_idx == 0 ? NRFX_PWM_EVT_END_SEQ0 : NRFX_PWM_EVT_END_SEQ1;
+    uint32_t signal = seq_idx == 0 ? NRFX_PWM_FLAG_SIGNAL_END_SEQ0 : NRFX_PWM_FLAG_SIGNAL_END_SEQ1;
+
+    value_idx = 0;
+    repeat = 0;
+    seq_idx ^= 1;
+    if (seq_idx == 0 && !(flags & NRFX_PWM_FLAG_LOOP)) {
+        if (loops_left == 0) {
+            playing = false;
+        } else {
+            loops_left--;
+        }
+    }
+
+    if ((flags & signal) && evt_handler) {
+        sim_stats.seq_ends++;
+        evt_handler(evt);
+    }
+    if (!playing && !(flags & NRFX_PWM_FLAG_NO_EVT_FINISHED) && evt_handler) {
+        evt_handler(NRFX_PWM_EVT_FINISHED);
+    }
+}
+
+void pwm_sim_advance(uint32_t periods) {
+    while (periods-- > 0 && playing) {
+        nrf_pwm_sequence_t const *seq = seqs[seq_idx];
+        nrf_pwm_values_individual_t values = seq->values.p_individual[value_idx];
+
+        sim_stats.periods++;
+        if (sample_handler) {
+            sample_handler(&values);
+        }
+        if (++repeat <= seq->repeats) {
+            continue;
+        }
+        repeat = 0;
+        if (++value_idx == seq->length / 4) {
+            seq_end();
+        }
+    }
+}
+
+void pwm_sim_sample_handler_set(pwm_sim_sample_handler_t handler) {
+    sample_handler = handler;
+}
+
+bool pwm_sim_is_playing(void) {
+    return playing;
+}
+
+uint32_t pwm_sim_period_us(void) {
+    return period_us;
+}
+
+void pwm_sim_stats_get(pwm_sim_stats_t *stats) {
+    *stats = sim_stats;
+}
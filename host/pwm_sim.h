@@ -0,0 +1,28 @@
+#ifndef PWM_SIM_H
+#define PWM_SIM_H
+
+#include "nrfx_pwm.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// PWM peripheral behind the nrfx_pwm calls, for host builds. Time only moves
+// when the caller advances it, one PWM period at a time. Values are read
+// from the sequences as they are played, like EasyDMA does, and the driver
+// handler is called right away for END_SEQ events, as the interrupt would.
+
+// Called once per PWM period with the duty cycles being output
+typedef void (*pwm_sim_sample_handler_t)(nrf_pwm_values_individual_t const *values);
+
+typedef struct {
+    uint64_t periods;           // Periods advanced while playing
+    uint32_t playbacks;         // Playbacks started
+    uint32_t seq_ends;          // END_SEQ events signalled
+} pwm_sim_stats_t;
+
+void pwm_sim_sample_handler_set(pwm_sim_sample_handler_t handler);
+void pwm_sim_advance(uint32_t periods);
+bool pwm_sim_is_playing(void);
+uint32_t pwm_sim_period_us(void);
+void pwm_sim_stats_get(pwm_sim_stats_t *stats);
+
+#endif // PWM_SIM_H
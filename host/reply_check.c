@@ -0,0 +1,893 @@
+// Checks the machine readable reply formats on the firmware itself. main.c
+// runs on the simulated board with this check on the other end of its
+// port, and a script running every command in the command table is sent in
+// all three modes. Text has to come out as before, JSON has to be one valid
+// object per line, and CBOR has to decode (strictly, shortest form, text
+// keys) to the same values as the JSON, only counters and flags may differ
+// between the runs. Strings in both have to be UTF-8. A listing far longer
+// than the output queue has to come out as one document all the same,
+// after the summary of a batch it ends, with every reply counted. Binary
+// requests then share the session with the CLI in each mode. A few replies
+// built here cover what the commands don't: every CBOR argument size, both
+// signs, nesting.
+//   reply_check
+
+#define _GNU_SOURCE
+
+#include "esl_reply.h"
+#include "esl_cli_cmds.h"
+#include "esl_client.h"
+#include "esl_nvmc.h"
+#include "esl_sched.h"
+#include "nvmc_sim.h"
+#include "transport_script.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define OUT_MAX                     TRANSPORT_SCRIPT_OUT_MAX
+#define LISTED_COLORS               (300)
+#define QUIET_PASSES                (3)     // Main loop passes with nothing sent and nothing to do
+#define PASSES_MAX                  (1000000)
+
+int firmware_main(void);    // main() of main.c, renamed for this build
+
+typedef struct {
+    const char *line;
+    const char *status;         // Of the first reply
+    const char *text;           // Text mode, ANSI colors left out; NULL: not compared
+    uint8_t replies;            // Messages sent for the line, 0 for one
+    const char *last;           // Text mode, what the last one starts with; NULL: not compared
+} step_t;
+
+// Every command in the table at least once, leaving the stores as they were
+static const step_t script[] = {
+    { "help", "ok" },
+    { "rgb 255 24 0", "ok", "[SUCCESS] RGB updated: R=255, G=24, B=0\n\r" },
+    { "hsv 120 100 50", "ok" },
+    { "add_rgb_color 10 20 30 back\\slash", "ok" },
+    { "add_hsv_color 200 50 50 caf\xc3\xa9", "ok" },
+    { "add_current_color tab", "ok" },
+    { "add_rgb_color 1 2 3 bad\xc3(", "error", "[ERROR] add_rgb_color: arg 4 is not valid UTF-8\n\r" },
+    { "apply_color back\\slash", "ok" },
+    { "rename_color tab tab2", "ok" },
+    { "list_colors", "ok" },
+    { "del_color tab2", "ok" },
+    { "del_color back\\slash", "ok" },
+    { "del_color caf\xc3\xa9", "ok" },
+    { "save", "ok" },
+    { "clip_rec 20", "ok" },
+    { "clip_key 255 0 0 5", "ok" },
+    { "clip_fade 0 0 255 10", "ok" },
+    { "clip_end", "ok" },
+    { "clip_list", "ok" },
+    { "clip_play 0 loop", "ok" },
+    { "clip_stop", "ok" },
+    { "clip_erase", "ok" },
+    { "clip_list", "ok", "[SUCCESS] Clips:\n\r\n\r" },
+    { "macro_add m \"rgb 1 2 3; hsv 4 5 6\"", "ok" },
+    { "macro_add l \"hsv 4 5 6; list_colors\"", "ok" },
+    { "macro_list", "ok" },
+    { "macro_run m", "ok" },
+    { "macro_run l", "ok", NULL, 2, "[SUCCESS] Saved Colors:" },
+    { "rgb 7 8 9; macro_run l", "error", NULL, 2 },
+    { "macro_del m", "ok" },
+    { "macro_erase", "ok" },
+    { "stats", "ok" },
+    { "rgb 1 2 3; stats", "ok", NULL, 2 },
+    { "rgb 1 2 3; list_colors", "ok", NULL, 2, "[SUCCESS] Saved Colors:" },
+    { "rgb 300 0 0", "error" },
+    { "no_such_command", "error" },
+};
+#define STEPS                       (sizeof(script) / sizeof(script[0]))
+
+static const char * const mode_names[] = { "text", "json", "cbor" };
+
+static int failures = 0;
+
+static void fail(const char *sample, const char *mode, const char *what) {
+    printf("%s, %s: %s\n", sample, mode, what);
+    failures++;
+}
+
+// Replies built here, for what no command sends
+
+static esl_txq_t txq;
+
+// Every argument size CBOR has, and both signs
+static void reply_numbers(esl_reply_t *r) {
+    esl_reply_obj_begin(r, "sizes");
+    esl_reply_u32(r, "a", "a=", 23);
+    esl_reply_u32(r, "b", " b=", 24);
+    esl_reply_u32(r, "c", " c=", 255);
+    esl_reply_u32(r, "d", " d=", 256);
+    esl_reply_u32(r, "e", " e=", 65535);
+    esl_reply_u32(r, "f", " f=", 65536);
+    esl_reply_u32(r, "g", " g=", UINT32_MAX);
+    esl_reply_obj_end(r);
+    esl_reply_i32(r, "min", " (", -24);
+    esl_reply_i32(r, "max", "-", -25);
+    esl_reply_i32(r, "low", " ", INT32_MIN);
+    esl_reply_hex32(r, "handler", " work ", 0x2000beef);
+    esl_reply_bool(r, "running", ", running", true);
+    esl_reply_bool(r, "pending", ")", false);
+    esl_reply_tag(r, "error", "range");
+}
+
+static void reply_nested(esl_reply_t *r) {
+    esl_reply_obj_begin(r, "a");
+    esl_reply_obj_begin(r, "b");
+    esl_reply_list_begin(r, "c");
+    esl_reply_obj_begin(r, NULL);
+    esl_reply_obj_end(r);
+    esl_reply_obj_begin(r, NULL);
+    esl_reply_u32(r, "d", "d=", 1);
+    esl_reply_obj_end(r);
+    esl_reply_list_end(r);
+    esl_reply_obj_end(r);
+    esl_reply_u32(r, "e", " e=", 2);
+    esl_reply_obj_end(r);
+    esl_reply_u32(r, "f", " f=", 3);
+}
+
+typedef struct {
+    const char *name;
+    void (*build)(esl_reply_t *r);
+    const char *text;
+} sample_t;
+
+static const sample_t samples[] = {
+    { "numbers", reply_numbers, "a=23 b=24 c=255 d=256 e=65535 f=65536 g=4294967295 (-24--25 -2147483648"
+      " work 0x2000beef, running)" },
+    { "nested", reply_nested, "d=1 e=2 f=3" },
+};
+
+static uint32_t render(esl_reply_mode_t mode, sample_t const *s, uint8_t *out) {
+    esl_reply_t r;
+    uint8_t const *data;
+    uint16_t len;
+    uint32_t total = 0;
+
+    esl_txq_msg_begin(&txq);
+    esl_reply_open(&r, &txq, mode);
+    s->build(&r);
+    esl_reply_close(&r);
+    if (!esl_txq_msg_end(&txq) || r.depth != 0) {
+        return 0;
+    }
+    while ((len = esl_txq_next(&txq, &data)) != 0) {
+        memcpy(out + total, data, len);
+        total += len;
+        esl_txq_sent(&txq);
+    }
+    return total;
+}
+
+// Both formats are decoded to values, strictly: JSON as RFC 8259 has it
+// (integers only, as the firmware writes no other numbers), CBOR as RFC
+// 8949 (shortest form, text keys), and text in either has to be UTF-8
+// (RFC 3629). The values are written out the same way whatever they came
+// from, strings as their length and bytes, and compared as written. With
+// kinds_only numbers become # and true and false ?, for runs whose
+// counters and flags differ.
+
+#define STRING_MAX                  (4096)
+
+typedef struct {
+    uint8_t const *p;
+    uint8_t const *end;
+    char *out;
+    bool kinds_only;
+} dec_t;
+
+static bool utf8_valid(uint8_t const *s, uint32_t len) {
+    static const uint32_t min[] = { 0, 0x80, 0x800, 0x10000 };
+
+    for (uint32_t i = 0; i < len; ) {
+        uint32_t cp;
+        uint8_t n;
+        if (s[i] < 0x80) {
+            i++;
+            continue;
+        } else if ((s[i] & 0xE0) == 0xC0) {
+            n = 1;
+            cp = s[i] & 0x1F;
+        } else if ((s[i] & 0xF0) == 0xE0) {
+            n = 2;
+            cp = s[i] & 0x0F;
+        } else if ((s[i] & 0xF8) == 0xF0) {
+            n = 3;
+            cp = s[i] & 0x07;
+        } else {
+            return false;
+        }
+        if (i + n >= len) {
+            return false;
+        }
+        for (uint8_t k = 1; k <= n; k++) {
+            if ((s[i + k] & 0xC0) != 0x80) {
+                return false;
+            }
+            cp = (cp << 6) | (s[i + k] & 0x3F);
+        }
+        if (cp < min[n] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+            return false;
+        }
+        i += n + 1;
+    }
+    return true;
+}
+
+static void out_char(dec_t *d, char c) {
+    *d->out++ = c;
+}
+
+static bool out_string(dec_t *d, uint8_t const *str, uint32_t len) {
+    if (!utf8_valid(str, len) || memchr(str, '\0', len) != NULL) {
+        return false;
+    }
+    d->out += sprintf(d->out, "%u:", len);
+    memcpy(d->out, str, len);
+    d->out += len;
+    return true;
+}
+
+static void out_number(dec_t *d, long long value) {
+    if (d->kinds_only) {
+        out_char(d, '#');
+    } else {
+        d->out += sprintf(d->out, "%lld", value);
+    }
+}
+
+static void out_bool(dec_t *d, bool value) {
+    if (d->kinds_only) {
+        out_char(d, '?');
+    } else {
+        d->out += sprintf(d->out, "%s", value ? "true" : "false");
+    }
+}
+
+// JSON
+
+static bool json_value(dec_t *d);
+
+static bool json_word(dec_t *d, const char *word) {
+    size_t len = strlen(word);
+    if ((size_t)(d->end - d->p) < len || memcmp(d->p, word, len) != 0) {
+        return false;
+    }
+    d->p += len;
+    return true;
+}
+
+static bool json_hex4(dec_t *d, uint32_t *value) {
+    *value = 0;
+    for (int i = 0; i < 4; i++) {
+        char const *digit;
+        if (d->p == d->end || *d->p == '\0' || (digit = strchr("0123456789abcdef", tolower(*d->p))) == NULL) {
+            return false;
+        }
+        *value = (*value << 4) | (digit - "0123456789abcdef");
+        d->p++;
+    }
+    return true;
+}
+
+// A \u escape, with the second half of a surrogate pair, as UTF-8
+static uint32_t json_escape_u(dec_t *d, uint8_t *buf) {
+    uint32_t cp, low;
+
+    if (!json_hex4(d, &cp) || (cp >= 0xDC00 && cp <= 0xDFFF)) {
+        return 0;
+    }
+    if (cp >= 0xD800 && cp <= 0xDBFF) {
+        if (!json_word(d, "\\u") || !json_hex4(d, &low) || low < 0xDC00 || low > 0xDFFF) {
+            return 0;
+        }
+        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+    }
+    if (cp < 0x80) {
+        buf[0] = cp;
+        return 1;
+    } else if (cp < 0x800) {
+        buf[0] = 0xC0 | (cp >> 6);
+        buf[1] = 0x80 | (cp & 0x3F);
+        return 2;
+    } else if (cp < 0x10000) {
+        buf[0] = 0xE0 | (cp >> 12);
+        buf[1] = 0x80 | ((cp >> 6) & 0x3F);
+        buf[2] = 0x80 | (cp & 0x3F);
+        return 3;
+    }
+    buf[0] = 0xF0 | (cp >> 18);
+    buf[1] = 0x80 | ((cp >> 12) & 0x3F);
+    buf[2] = 0x80 | ((cp >> 6) & 0x3F);
+    buf[3] = 0x80 | (cp & 0x3F);
+    return 4;
+}
+
+static bool json_string(dec_t *d) {
+    static const char escaped[] = "\"\\/bfnrt";
+    static const char unescaped[] = "\"\\/\b\f\n\r\t";
+    static uint8_t str[STRING_MAX];
+    uint32_t len = 0;
+
+    if (!json_word(d, "\"")) {
+        return false;
+    }
+    while (d->p < d->end && len < STRING_MAX - 4) {
+        uint8_t c = *d->p++;
+        if (c == '"') {
+            return out_string(d, str, len);
+        }
+        if (c < 0x20) {
+            return false;
+        }
+        if (c != '\\') {
+            str[len++] = c;
+            continue;
+        }
+        if (d->p == d->end) {
+            return false;
+        }
+        c = *d->p++;
+        char const *esc = c != '\0' ? strchr(escaped, c) : NULL;
+        if (c == 'u') {
+            uint32_t n = json_escape_u(d, str + len);
+            if (n == 0) {
+                return false;
+            }
+            len += n;
+        } else if (esc != NULL) {
+            str[len++] = unescaped[esc - escaped];
+        } else {
+            return false;
+        }
+    }
+    return false;
+}
+
+static bool json_number(dec_t *d) {
+    uint8_t const *start = d->p;
+
+    if (d->p < d->end && *d->p == '-') {
+        d->p++;
+    }
+    if (d->p == d->end || *d->p < '0' || *d->p > '9') {
+        return false;
+    }
+    if (*d->p == '0') {
+        d->p++;
+    } else {
+        while (d->p < d->end && *d->p >= '0' && *d->p <= '9') {
+            d->p++;
+        }
+    }
+    if (d->p < d->end && strchr(".eE0123456789", *d->p) != NULL) {
+        return false;
+    }
+    if (d->p - start > 11) {
+        return false;
+    }
+    char digits[16];
+    memcpy(digits, start, d->p - start);
+    digits[d->p - start] = '\0';
+    out_number(d, strtoll(digits, NULL, 10));
+    return true;
+}
+
+static bool json_nested(dec_t *d, char close, bool keys) {
+    out_char(d, *d->p++);
+    if (d->p < d->end && *d->p == close) {
+        out_char(d, *d->p++);
+        return true;
+    }
+    while (true) {
+        if (keys) {
+            if (!json_string(d) || !json_word(d, ":")) {
+                return false;
+            }
+            out_char(d, ':');
+        }
+        if (!json_value(d) || d->p == d->end) {
+            return false;
+        }
+        char c = *d->p++;
+        out_char(d, c);
+        if (c == close) {
+            return true;
+        }
+        if (c != ',') {
+            return false;
+        }
+    }
+}
+
+static bool json_value(dec_t *d) {
+    if (d->p == d->end) {
+        return false;
+    }
+    switch (*d->p) {
+    case '{':
+        return json_nested(d, '}', true);
+    case '[':
+        return json_nested(d, ']', false);
+    case '"':
+        return json_string(d);
+    case 't':
+        out_bool(d, true);
+        return json_word(d, "true");
+    case 'f':
+        out_bool(d, false);
+        return json_word(d, "false");
+    default:
+        return json_number(d);
+    }
+}
+
+// CBOR
+
+static bool cbor_arg(dec_t *d, uint8_t info, uint32_t *value) {
+    uint8_t size = info == 24 ? 1 : info == 25 ? 2 : info == 26 ? 4 : 0;
+    if (info < 24) {
+        *value = info;
+        return true;
+    }
+    if (size == 0 || d->end - d->p < size) {
+        return false;
+    }
+    *value = 0;
+    for (uint8_t i = 0; i < size; i++) {
+        *value = (*value << 8) | *d->p++;
+    }
+    // Shortest form only
+    uint32_t min = size == 1 ? 24 : size == 2 ? 0x100 : 0x10000;
+    return *value >= min;
+}
+
+static bool cbor_item(dec_t *d, bool key);
+
+static bool cbor_nested(dec_t *d, bool map) {
+    bool first = true;
+    out_char(d, map ? '{' : '[');
+    while (d->p < d->end && *d->p != 0xFF) {
+        if (!first) {
+            out_char(d, ',');
+        }
+        first = false;
+        if (map) {
+            if (!cbor_item(d, true)) {
+                return false;
+            }
+            out_char(d, ':');
+        }
+        if (!cbor_item(d, false)) {
+            return false;
+        }
+    }
+    if (d->p == d->end) {
+        return false;
+    }
+    d->p++;
+    out_char(d, map ? '}' : ']');
+    return true;
+}
+
+static bool cbor_item(dec_t *d, bool key) {
+    if (d->p == d->end) {
+        return false;
+    }
+    uint8_t head = *d->p++;
+    uint8_t major = head >> 5;
+    uint32_t value;
+
+    if (key && major != 3) {
+        return false;
+    }
+    if (head == 0x9F || head == 0xBF) {
+        return cbor_nested(d, head == 0xBF);
+    }
+    if (head == 0xF4 || head == 0xF5) {
+        out_bool(d, head == 0xF5);
+        return true;
+    }
+    if (!cbor_arg(d, head & 0x1F, &value)) {
+        return false;
+    }
+    switch (major) {
+    case 0:
+        out_number(d, value);
+        return true;
+    case 1:
+        out_number(d, -1 - (long long)value);
+        return true;
+    case 3:
+        if ((uint32_t)(d->end - d->p) < value) {
+            return false;
+        }
+        d->p += value;
+        return out_string(d, d->p - value, value);
+    default:
+        return false;
+    }
+}
+
+// Checks shared by both
+
+// One valid JSON object per line, every line ended. Returns the objects,
+// each decoded on a line of its own, or 0.
+static uint32_t json_lines_decode(uint8_t const *data, uint32_t size, char *out, bool kinds_only) {
+    uint8_t const *end = data + size;
+    uint32_t count = 0;
+
+    if (size == 0 || data[size - 1] != '\n') {
+        return 0;
+    }
+    while (data < end) {
+        uint8_t const *eol = memchr(data, '\n', end - data);
+        dec_t d = { data, eol, out, kinds_only };
+        if (*data != '{' || !json_value(&d) || d.p != d.end) {
+            return 0;
+        }
+        out = d.out;
+        *out++ = '\n';
+        data = eol + 1;
+        count++;
+    }
+    *out = '\0';
+    return count;
+}
+
+// The same for top level CBOR maps, back to back
+static uint32_t cbor_lines_decode(uint8_t const *data, uint32_t size, char *out, bool kinds_only) {
+    dec_t d = { data, data + size, out, kinds_only };
+    uint32_t count = 0;
+
+    while (d.p < d.end) {
+        if (*d.p != 0xBF || !cbor_item(&d, false)) {
+            return 0;
+        }
+        out_char(&d, '\n');
+        count++;
+    }
+    *d.out = '\0';
+    return count;
+}
+
+static void sample_check(sample_t const *s) {
+    static uint8_t text[4096], json[4096], cbor[4096];
+    static char json_decoded[8192], cbor_decoded[8192];
+
+    uint32_t text_len = render(ESL_REPLY_MODE_TEXT, s, text);
+    uint32_t json_len = render(ESL_REPLY_MODE_JSON, s, json);
+    uint32_t cbor_len = render(ESL_REPLY_MODE_CBOR, s, cbor);
+
+    if (text_len != strlen(s->text) || memcmp(text, s->text, text_len) != 0) {
+        fail(s->name, "text", "differs");
+    }
+    if (json_lines_decode(json, json_len, json_decoded, false) != 1) {
+        fail(s->name, "json", "invalid");
+    } else if (cbor_lines_decode(cbor, cbor_len, cbor_decoded, false) != 1) {
+        fail(s->name, "cbor", "invalid");
+    } else if (strcmp(cbor_decoded, json_decoded) != 0) {
+        fail(s->name, "cbor", "doesn't match json");
+        printf("  json: %s  cbor: %s", json_decoded, cbor_decoded);
+    }
+    printf("%-36s text %6u B, json %6u B, cbor %6u B\n", s->name, text_len, json_len, cbor_len);
+}
+
+// The firmware, driven through its port
+
+static char json_runs[STEPS][OUT_MAX / 4];  // Decoded, for the CBOR run
+static uint32_t sizes[STEPS][3];
+
+// Leaves out ANSI color sequences
+static uint32_t text_plain(uint8_t const *in, uint32_t size, char *out) {
+    uint32_t len = 0;
+
+    for (uint32_t i = 0; i < size; i++) {
+        if (in[i] == 0x1B) {
+            while (i < size && in[i] != 'm') {
+                i++;
+            }
+            continue;
+        }
+        out[len++] = in[i];
+    }
+    out[len] = '\0';
+    return len;
+}
+
+// Messages in a text reply, found by their prefixes, and where the last starts
+static uint32_t text_messages(char const *plain, char const **last) {
+    uint32_t count = 0;
+
+    for (char const *c = plain; *c; c++) {
+        if (strncmp(c, "[SUCCESS] ", 10) == 0 || strncmp(c, "[ERROR] ", 8) == 0) {
+            *last = c;
+            count++;
+        }
+    }
+    return count;
+}
+
+static void reply_check(uint32_t step, esl_reply_mode_t mode, uint8_t const *out, uint32_t size) {
+    static char plain[OUT_MAX];
+    static char decoded[2 * OUT_MAX];
+    step_t const *s = &script[step];
+    const char *name = s->line;
+    uint32_t replies = s->replies ? s->replies : 1;
+    char const *last = NULL;
+    char expected[64];
+
+    sizes[step][mode] = size;
+    if (out == NULL) {
+        fail(name, mode_names[mode], "too long");
+        return;
+    }
+
+    if (mode == ESL_REPLY_MODE_TEXT) {
+        uint32_t line_len = strlen(s->line);
+        // Input is echoed, with the line end as \r\n
+        if (size < line_len + 2 || memcmp(out, s->line, line_len) != 0 || memcmp(out + line_len, "\r\n", 2) != 0) {
+            fail(name, "text", "no echo");
+            return;
+        }
+        uint32_t len = text_plain(out + line_len + 2, size - line_len - 2, plain);
+        snprintf(expected, sizeof(expected), "[%s] ", strcmp(s->status, "ok") == 0 ? "SUCCESS" : "ERROR");
+        if (strncmp(plain, expected, strlen(expected)) != 0 || len < 2 || strcmp(plain + len - 2, "\n\r") != 0) {
+            fail(name, "text", "not a reply");
+        } else if (text_messages(plain, &last) != replies) {
+            fail(name, "text", "wrong number of replies");
+        } else if (s->last != NULL && strncmp(last, s->last, strlen(s->last)) != 0) {
+            fail(name, "text", "wrong reply last");
+        } else if (s->text != NULL && strcmp(plain, s->text) != 0) {
+            fail(name, "text", "differs");
+            for (char const *c = plain; *c; c++) {
+                printf(*c >= ' ' ? "%c" : "\\x%02x", *c);
+            }
+            printf("\n");
+        }
+        return;
+    }
+
+    if (mode == ESL_REPLY_MODE_JSON) {
+        uint32_t objects = json_lines_decode(out, size, json_runs[step], true);
+        if (objects == 0) {
+            fail(name, "json", "invalid");
+            return;
+        }
+        snprintf(expected, sizeof(expected), "{\"status\":\"%s\"", s->status);
+        if (strncmp((char const *)out, expected, strlen(expected)) != 0) {
+            fail(name, "json", "wrong status");
+        }
+        if (objects != replies) {
+            fail(name, "json", "wrong number of replies");
+        }
+        return;
+    }
+
+    uint32_t items = cbor_lines_decode(out, size, decoded, true);
+    if (items == 0) {
+        fail(name, "cbor", "invalid");
+        return;
+    }
+    if (strchr(decoded, 0x1B) != NULL) {
+        fail(name, "cbor", "ANSI escape");
+    }
+    if (items != replies) {
+        fail(name, "cbor", "wrong number of replies");
+    }
+    if (strcmp(decoded, json_runs[step]) != 0) {
+        fail(name, "cbor", "doesn't match json");
+        printf("  json: %.300s\n  cbor: %.300s\n", json_runs[step], decoded);
+    }
+}
+
+// Text commands and binary requests in one session, each line written
+// together with a request. Output goes through esl_client's framing, which
+// has to find the reply to every request in text and JSON mode, also once
+// zero bytes in CBOR output had it take them for frames. In CBOR mode
+// requests are dropped and the output has to be nothing but the CBOR reply
+// to the line.
+typedef struct {
+    const char *line;
+    uint8_t type;
+    uint8_t payload[3];
+    uint8_t len;
+    bool reply;
+    uint32_t rgb;               // A query's answer, 0xRRGGBB
+} shared_step_t;
+
+static const shared_step_t shared_script[] = {
+    { "output text", ESL_MSG_SET_RGB, { 10, 20, 0 }, 3, true },
+    { "rgb 1 2 0", ESL_MSG_QUERY, { 0 }, 0, true, 0x010200 },
+    { "output json", ESL_MSG_QUERY, { 0 }, 0, true, 0x010200 },
+    { "rgb 3 0 4", ESL_MSG_QUERY, { 0 }, 0, true, 0x030004 },
+    { "output cbor", ESL_MSG_SET_RGB, { 9, 9, 9 }, 3, false },
+    { "rgb 5 0 6", ESL_MSG_SET_RGB, { 9, 9, 9 }, 3, false },
+    { "output text", ESL_MSG_QUERY, { 0 }, 0, true, 0x050006 },
+};
+#define SHARED_STEPS                (sizeof(shared_script) / sizeof(shared_script[0]))
+
+static esl_client_t client;
+static int client_pipe[2];                  // Output in, client out
+
+static void shared_check(shared_step_t const *s, uint8_t seq, uint8_t const *out, uint32_t size) {
+    static char decoded[2 * OUT_MAX];
+    esl_msg_t msg;
+    uint32_t frames = 0;
+    bool ok = true;
+
+    if (out == NULL || write(client_pipe[1], out, size) != (ssize_t)size) {
+        fail(s->line, "shared", "too long");
+        return;
+    }
+    while (esl_client_recv(&client, &msg, 0)) {
+        frames++;
+        ok = ok && msg.type == (s->type | ESL_MSG_REPLY) && msg.seq == seq && msg.len >= 1 &&
+             msg.payload[0] == ESL_MSG_OK;
+        if (s->type == ESL_MSG_QUERY) {
+            uint32_t rgb = (uint32_t)msg.payload[1] << 16 | msg.payload[2] << 8 | msg.payload[3];
+            ok = ok && msg.len == 8 && rgb == s->rgb;
+        }
+    }
+    if (frames != (s->reply ? 1 : 0) || !ok) {
+        fail(s->line, "shared", s->reply ? "wrong reply" : "reply in CBOR mode");
+    }
+    if (!s->reply && cbor_lines_decode(out, size, decoded, true) != 1) {
+        fail(s->line, "shared", "CBOR broken up");
+    }
+    printf("%-36s + request 0x%02x: %u replies, %u bytes skipped, %u bad frames\n", s->line, s->type, frames,
+           client.text_bytes, client.frames_bad);
+}
+
+static void shared_send(shared_step_t const *s, uint8_t seq) {
+    esl_msg_t req = { .type = s->type, .seq = seq, .len = s->len };
+    uint8_t wire[ESL_FRAME_WIRE_MAX];
+
+    memcpy(req.payload, s->payload, s->len);
+    transport_script_output_clear();
+    transport_script_send(s->line, strlen(s->line));
+    transport_script_send("\r\n", 2);
+    transport_script_send(wire, esl_frame_encode(&req, wire));
+}
+
+// Where the script is: colors added for the listing first, then the
+// script once per mode, each run started by switching to its mode, then
+// the shared session
+static uint32_t colors_added = 0;
+static esl_reply_mode_t mode = ESL_REPLY_MODE_TEXT;
+static int32_t step = -1;                   // -1: the mode switch
+static uint32_t shared = 0;
+static bool started = false;
+static uint32_t quiet = 0;
+static uint32_t passes = 0;
+static uint32_t seen = 0;
+
+static void finish(void) {
+    uint32_t longest = 0;
+
+    for (uint32_t i = 0; i < STEPS; i++) {
+        printf("%-36s text %6u B, json %6u B, cbor %6u B\n", script[i].line, sizes[i][0], sizes[i][1], sizes[i][2]);
+        if (sizes[i][ESL_REPLY_MODE_JSON] > longest) {
+            longest = sizes[i][ESL_REPLY_MODE_JSON];
+        }
+    }
+    // The listing has to have gone through the queue several times over
+    if (longest < 2 * ESL_TX_RING_SIZE) {
+        fail("list_colors", "json", "shorter than the output queue");
+    }
+    for (size_t i = 0; i < esl_cli_cmds_count; i++) {
+        size_t len = strlen(esl_cli_cmds[i].name);
+        bool found = false;
+        for (uint32_t j = 0; j < STEPS && !found; j++) {
+            found = strncmp(script[j].line, esl_cli_cmds[i].name, len) == 0 &&
+                    (script[j].line[len] == ' ' || script[j].line[len] == '\0');
+        }
+        if (!found && strcmp(esl_cli_cmds[i].name, "output") != 0) {
+            fail(esl_cli_cmds[i].name, "script", "not covered");
+        }
+    }
+    printf("%zu commands in the table, checks failed: %d\n", esl_cli_cmds_count, failures);
+    exit(failures ? 1 : 0);
+}
+
+static void line_send(const char *line) {
+    transport_script_output_clear();
+    transport_script_send(line, strlen(line));
+    transport_script_send("\r\n", 2);
+    started = true;
+    seen = 0;
+    quiet = 0;
+    passes = 0;
+}
+
+// Called every main loop pass. A reply is taken as complete once a few
+// passes went by with no input left, nothing sent and nothing to do.
+static void script_step(void) {
+    uint32_t size;
+    uint8_t const *out = transport_script_output(&size);
+    char line[64];
+
+    if (started) {
+        if (++passes > PASSES_MAX) {
+            fail(mode > ESL_REPLY_MODE_CBOR ? shared_script[shared].line : step >= 0 ? script[step].line : "output",
+                 mode > ESL_REPLY_MODE_CBOR ? "shared" : mode_names[mode], "no reply");
+            finish();
+        }
+        if (size != seen || transport_script_rx_pending() || !esl_sched_is_empty() || esl_nvmc_is_busy()) {
+            seen = size;
+            quiet = 0;
+            return;
+        }
+        if (++quiet < QUIET_PASSES) {
+            return;
+        }
+    }
+
+    if (colors_added < LISTED_COLORS) {
+        if (started) {
+            if (out == NULL || memmem(out, size, "[SUCCESS]", 9) == NULL) {
+                fail("add_rgb_color", "text", "color not added");
+            }
+            colors_added++;
+        }
+        if (colors_added < LISTED_COLORS) {
+            snprintf(line, sizeof(line), "add_rgb_color %u 0 0 color%03u", colors_added & 0xFF, colors_added);
+            line_send(line);
+            return;
+        }
+    }
+
+    if (mode > ESL_REPLY_MODE_CBOR) {
+        shared_check(&shared_script[shared], shared, out, size);
+        shared++;
+    } else {
+        if (step >= 0) {
+            reply_check(step, mode, out, size);
+        }
+        if (++step == STEPS) {
+            mode++;
+            step = -1;
+        }
+    }
+    if (mode > ESL_REPLY_MODE_CBOR) {
+        if (shared == SHARED_STEPS) {
+            finish();
+        }
+        shared_send(&shared_script[shared], shared);
+        started = true;
+        seen = 0;
+        quiet = 0;
+        passes = 0;
+    } else if (step == -1) {
+        snprintf(line, sizeof(line), "output %s", mode_names[mode]);
+        line_send(line);
+    } else {
+        line_send(script[step].line);
+    }
+}
+
+int main(void) {
+    esl_txq_init(&txq);
+    for (size_t i = 0; i < sizeof(samples) / sizeof(samples[0]); i++) {
+        sample_check(&samples[i]);
+    }
+
+    if (nvmc_sim_init(NULL) != NVMC_SIM_OK) {
+        printf("flash region could not be mapped\n");
+        return 1;
+    }
+    if (pipe(client_pipe) != 0) {
+        printf("no pipe for the client\n");
+        return 1;
+    }
+    esl_client_attach(&client, client_pipe[0]);
+    transport_script_step_set(script_step);
+    return firmware_main();
+}
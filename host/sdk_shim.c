@@ -0,0 +1,46 @@
+#include "crc16.h"
+#include "esl_utils.h"
+#include "nvmc_sim.h"
+
+#include <time.h>
+
+// Same algorithm as components/libraries/crc16 of the SDK
+uint16_t crc16_compute(uint8_t const * p_data, uint32_t size, uint16_t const * p_crc) {
+    uint16_t crc = (p_crc == NULL) ? 0xFFFF : *p_crc;
+
+    for (uint32_t i = 0; i < size; i++) {
+        crc  = (uint8_t)(crc >> 8) | (crc << 8);
+        crc ^= p_data[i];
+        crc ^= (uint8_t)(crc & 0xFF) >> 4;
+        crc ^= (crc << 8) << 4;
+        crc ^= ((crc & 0xFF) << 4) << 1;
+    }
+    return crc;
+}
+
+// Cycles of a 64 MHz core: host time plus the time the CPU would have
+// stalled on the simulated NVMC
+void esl_cycles_init(void) {
+}
+
+uint32_t esl_cycles_get(void) {
+    struct timespec now;
+    nvmc_sim_stats_t stats;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    nvmc_sim_stats_get(&stats);
+    uint64_t us = (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000 + stats.busy_us;
+    return (uint32_t)(us * 64);
+}
+
+// The host runs on its own stack, nothing is measured
+void esl_stack_paint(void) {
+}
+
+uint32_t esl_stack_used_max(void) {
+    return 0;
+}
+
+uint32_t esl_stack_size(void) {
+    return 0;
+}
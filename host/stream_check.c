@@ -0,0 +1,136 @@
+// Color stream playout against arrival jitter. 100 Hz frames are pushed into
+// esl_stream as they would arrive from the host, each held back by a random
+// amount up to the jitter, and played on the simulated PWM. While the
+// jitter stays below the playout delay every frame has to reach the LEDs,
+// in order, 10 ms after the one before give or take one tick, with no
+// underruns. Above it, underruns have to be counted. Every stream has to
+// start its stats from zero.
+//   stream_check
+
+#include "esl_pwm.h"
+#include "esl_sched.h"
+#include "esl_stream.h"
+#include "pwm_sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAME_MS                    (10)
+#define FRAMES                      (300)
+#define TICK_US                     (ESL_STREAM_TICK_PERIODS * pwm_sim_period_us())
+
+static esl_pwm_context_t pwm_ctx;
+static uint32_t period;             // PWM periods advanced in the current run
+static uint32_t starts[FRAMES];     // Period each frame's color first showed up
+static bool seen[FRAMES];
+static int32_t last_frame;
+static uint32_t rand_state = 0x2545F491;
+static int failures = 0;
+
+static uint32_t rand_next(void) {
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+// Frame k shows as R, G = k, B = 0x5A, which no color before the stream has
+static void sample_handler(nrf_pwm_values_individual_t const *values) {
+    int32_t k = values->channel_1 | (values->channel_2 << 8);
+
+    if (pwm_ctx.streaming && values->channel_3 == 0x5A && k < FRAMES && k != last_frame) {
+        if (!seen[k]) {
+            starts[k] = period;
+        }
+        seen[k] = true;
+        last_frame = k;
+    }
+}
+
+// Streams FRAMES frames, frame k sent at k * FRAME_MS and arriving up to
+// jitter_ms later, never before the frame sent ahead of it. The first one
+// comes right on time, so the playout clock is set as early as it can be
+// and late ones have the least to spare. Returns the frames that reached
+// the LEDs out of place, too early or too late.
+static uint32_t run(uint16_t delay_ms, uint32_t jitter_ms, esl_stream_stats_t *stats) {
+    uint32_t arrival_us[FRAMES];
+    uint32_t period_us = pwm_sim_period_us();
+    uint32_t bad = 0;
+
+    for (uint32_t k = 0; k < FRAMES; k++) {
+        arrival_us[k] = (k * FRAME_MS + (k ? rand_next() % (jitter_ms + 1) : 0)) * 1000;
+        if (k > 0 && arrival_us[k] < arrival_us[k - 1]) {
+            arrival_us[k] = arrival_us[k - 1];
+        }
+    }
+    memset(seen, 0, sizeof(seen));
+    last_frame = -1;
+    period = 0;
+
+    esl_stream_start(delay_ms);
+    for (uint32_t k = 0; k < FRAMES || esl_stream_depth() > 0; period++) {
+        for (; k < FRAMES && arrival_us[k] <= period * period_us; k++) {
+            esl_stream_push(k * FRAME_MS, k & 0xFF, k >> 8, 0x5A);
+        }
+        pwm_sim_advance(1);
+    }
+    pwm_sim_advance(2 * ESL_STREAM_TICK_PERIODS);
+    esl_stream_stop();
+    esl_stream_stats_get(stats);
+
+    for (uint32_t k = 0; k < FRAMES; k++) {
+        if (!seen[k]) {
+            bad++;
+            continue;
+        }
+        if (k > 0 && seen[k - 1]) {
+            int32_t diff_us = (int32_t)((starts[k] - starts[k - 1]) * period_us) - FRAME_MS * 1000;
+            if (diff_us > (int32_t)TICK_US || diff_us < -(int32_t)TICK_US) {
+                bad++;
+            }
+        }
+    }
+    return bad;
+}
+
+int main(void) {
+    static const struct {
+        uint16_t delay_ms;              // 0 for ESL_STREAM_DELAY_MS
+        uint32_t jitter_ms;
+    } cases[] = {
+        { 0, 0 },
+        { 0, 10 },
+        { 0, ESL_STREAM_DELAY_MS - 5 },
+        { 2 * ESL_STREAM_DELAY_MS, 60 },
+    };
+    esl_stream_stats_t stats;
+
+    esl_sched_init();
+    esl_pwm_init(&pwm_ctx);
+    esl_stream_init(&pwm_ctx);
+    pwm_sim_sample_handler_set(sample_handler);
+    printf("stream: %u frames at %u Hz, tick %u us\n", FRAMES, 1000 / FRAME_MS, TICK_US);
+
+    for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        uint16_t delay = cases[i].delay_ms ? cases[i].delay_ms : ESL_STREAM_DELAY_MS;
+        uint32_t bad = run(cases[i].delay_ms, cases[i].jitter_ms, &stats);
+        printf("delay %3u ms, jitter up to %3u ms: %u applied, %u off time, %u underruns, max depth %u\n",
+               delay, cases[i].jitter_ms, stats.applied, bad, stats.underruns, stats.max_depth);
+        if (bad || stats.underruns || stats.overruns || stats.frames != FRAMES || stats.applied != FRAMES) {
+            failures++;
+        }
+    }
+
+    // Frames later than the delay have nothing left to play from
+    uint32_t jitter = ESL_STREAM_DELAY_MS + 20;
+    run(0, jitter, &stats);
+    printf("delay %3u ms, jitter up to %3u ms: %u underruns counted\n", ESL_STREAM_DELAY_MS, jitter,
+           stats.underruns);
+    if (stats.underruns == 0 || stats.frames != FRAMES) {
+        failures++;
+    }
+
+    printf("checks failed: %d\n", failures);
+    return failures ? 1 : 0;
+}
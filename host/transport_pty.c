@@ -0,0 +1,141 @@
+#define _GNU_SOURCE
+
+#include "transport_pty.h"
+#include "esl_transport.h"
+#include "board_sim.h"
+#include "sdk_config.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define PEER_POLL_MS                (50)    // How soon an opened terminal is noticed
+
+static esl_transport_handler_t evt_handler;
+static const char *link_path = NULL;
+static int master = -1;
+static bool peer = false;
+static bool rx_paused = false;
+static uint8_t const *tx_data;
+static uint16_t tx_left = 0;
+static bool tx_active = false;
+
+void transport_pty_link_set(const char *path) {
+    link_path = path;
+}
+
+static void fail(const char *what) {
+    perror(what);
+    exit(1);
+}
+
+static void link_remove(void) {
+    unlink(link_path);
+}
+
+static void pty_init(esl_transport_handler_t handler) {
+    struct termios tio;
+
+    evt_handler = handler;
+    master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        fail("pty");
+    }
+    const char *name = ptsname(master);
+
+    // Raw like a CDC ACM port: no echo, line editing or CR/LF mapping. The
+    // settings stay with the terminal for whoever opens it next.
+    int slave = open(name, O_RDWR | O_NOCTTY);
+    if (slave < 0 || tcgetattr(slave, &tio) != 0) {
+        fail(name);
+    }
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+    close(slave);
+
+    if (link_path != NULL) {
+        unlink(link_path);
+        if (symlink(name, link_path) != 0) {
+            fail(link_path);
+        }
+        atexit(link_remove);
+    }
+    fprintf(stderr, "CLI on %s\n", link_path != NULL ? link_path : name);
+}
+
+// Hangup is reported while no one has the terminal side open
+static bool peer_check(void) {
+    struct pollfd pfd = { .fd = master, .events = POLLIN };
+    poll(&pfd, 1, 0);
+    return !(pfd.revents & POLLHUP);
+}
+
+static void tx_write(void) {
+    while (tx_left > 0) {
+        ssize_t n = write(master, tx_data, tx_left);
+        if (n <= 0) {
+            return;
+        }
+        tx_data += n;
+        tx_left -= n;
+    }
+}
+
+static void pty_process(void) {
+    bool now = peer_check();
+
+    if (now != peer) {
+        peer = now;
+        tx_left = 0;
+        tx_active = false;
+        rx_paused = false;
+        evt_handler(peer ? ESL_TRANSPORT_EVT_OPEN : ESL_TRANSPORT_EVT_CLOSE, NULL, 0);
+    }
+
+    if (peer) {
+        tx_write();
+        if (tx_active && tx_left == 0) {
+            tx_active = false;
+            evt_handler(ESL_TRANSPORT_EVT_TX_DONE, NULL, 0);
+        }
+
+        uint8_t buf[READ_SIZE];
+        ssize_t n;
+        while (!rx_paused && (n = read(master, buf, sizeof(buf))) > 0) {
+            rx_paused = !evt_handler(ESL_TRANSPORT_EVT_RX, buf, n);
+        }
+    }
+
+    if (!peer) {
+        board_sim_wake_fd_set(-1, 0, PEER_POLL_MS);
+    } else {
+        board_sim_wake_fd_set(master, (rx_paused ? 0 : POLLIN) | (tx_active ? POLLOUT : 0), -1);
+    }
+    board_sim_irq();
+}
+
+static bool pty_tx(uint8_t const *data, uint16_t size) {
+    if (!peer) {
+        return false;
+    }
+    tx_data = data;
+    tx_left = size;
+    tx_active = true;
+    tx_write();
+    return true;
+}
+
+static void pty_rx_resume(void) {
+    rx_paused = false;
+}
+
+esl_transport_t const esl_transport_pty = {
+    .init = pty_init,
+    .process = pty_process,
+    .tx = pty_tx,
+    .rx_resume = pty_rx_resume,
+};
@@ -0,0 +1,11 @@
+#ifndef TRANSPORT_PTY_H
+#define TRANSPORT_PTY_H
+
+// esl_transport_pty puts the CLI on a pseudo-terminal. A peer counts as
+// there while something holds the terminal side open.
+
+// Also makes path a symlink to the terminal, so scripts find it. Call
+// before init.
+void transport_pty_link_set(const char *path);
+
+#endif // TRANSPORT_PTY_H
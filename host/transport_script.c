@@ -0,0 +1,96 @@
+#include "transport_script.h"
+#include "esl_transport.h"
+#include "board_sim.h"
+#include "sdk_config.h"
+
+#include <string.h>
+
+#define RX_MAX                      (4096)
+
+static esl_transport_handler_t evt_handler;
+static transport_script_step_t step_handler = NULL;
+static bool peer = false;
+static bool rx_paused = false;
+static bool tx_active = false;
+
+static uint8_t rx_buf[RX_MAX];
+static uint32_t rx_len = 0;
+static uint32_t rx_pos = 0;
+static uint8_t out[TRANSPORT_SCRIPT_OUT_MAX];
+static uint32_t out_len = 0;
+
+void transport_script_step_set(transport_script_step_t step) {
+    step_handler = step;
+}
+
+bool transport_script_send(void const *data, uint32_t size) {
+    if (rx_pos == rx_len) {
+        rx_pos = rx_len = 0;
+    }
+    if (size > RX_MAX - rx_len) {
+        return false;
+    }
+    memcpy(&rx_buf[rx_len], data, size);
+    rx_len += size;
+    return true;
+}
+
+bool transport_script_rx_pending(void) {
+    return rx_pos < rx_len;
+}
+
+uint8_t const *transport_script_output(uint32_t *size) {
+    *size = out_len;
+    return out_len <= TRANSPORT_SCRIPT_OUT_MAX ? out : NULL;
+}
+
+void transport_script_output_clear(void) {
+    out_len = 0;
+}
+
+static void script_init(esl_transport_handler_t handler) {
+    evt_handler = handler;
+}
+
+static void script_process(void) {
+    if (!peer) {
+        peer = true;
+        evt_handler(ESL_TRANSPORT_EVT_OPEN, NULL, 0);
+    }
+    if (tx_active) {
+        tx_active = false;
+        evt_handler(ESL_TRANSPORT_EVT_TX_DONE, NULL, 0);
+    }
+    while (!rx_paused && rx_pos < rx_len) {
+        uint32_t size = rx_len - rx_pos < READ_SIZE ? rx_len - rx_pos : READ_SIZE;
+        rx_pos += size;
+        rx_paused = !evt_handler(ESL_TRANSPORT_EVT_RX, &rx_buf[rx_pos - size], size);
+    }
+    if (step_handler != NULL) {
+        step_handler();
+    }
+
+    // Never sleeps, the check is always ready for more
+    board_sim_wake_fd_set(-1, 0, 0);
+    board_sim_irq();
+}
+
+static bool script_tx(uint8_t const *data, uint16_t size) {
+    if (out_len + size <= TRANSPORT_SCRIPT_OUT_MAX) {
+        memcpy(&out[out_len], data, size);
+    }
+    out_len += size;
+    tx_active = true;
+    return true;
+}
+
+static void script_rx_resume(void) {
+    rx_paused = false;
+}
+
+esl_transport_t const esl_transport_script = {
+    .init = script_init,
+    .process = script_process,
+    .tx = script_tx,
+    .rx_resume = script_rx_resume,
+};
@@ -0,0 +1,28 @@
+#ifndef TRANSPORT_SCRIPT_H
+#define TRANSPORT_SCRIPT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// esl_transport_script puts a host check on the other end of the port, no
+// terminal in between. The peer is there from the first pass of the main
+// loop. Every transfer completes on the next pass, and what it sent is
+// kept for the check to take.
+
+// Called once per main loop pass, after the events of that pass
+typedef void (*transport_script_step_t)(void);
+
+// Call before init
+void transport_script_step_set(transport_script_step_t step);
+// Queued and received in READ_SIZE runs over the next passes, held back
+// while the firmware pauses reads. False if it doesn't fit.
+bool transport_script_send(void const *data, uint32_t size);
+bool transport_script_rx_pending(void);
+#define TRANSPORT_SCRIPT_OUT_MAX    (256 * 1024)
+
+// Output sent since the last transport_script_output_clear(), NULL once
+// that was more than TRANSPORT_SCRIPT_OUT_MAX
+uint8_t const *transport_script_output(uint32_t *size);
+void transport_script_output_clear(void);
+
+#endif // TRANSPORT_SCRIPT_H
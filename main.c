@@ -1,21 +1,33 @@
 #include "esl_gpio.h"
+#include "esl_input.h"
 #include "esl_utils.h"
 #include "esl_pwm.h"
+#include "esl_sched.h"
+#include "esl_power.h"
+#include "esl_clock.h"
+#include "esl_nvmc.h"
+#include "esl_clip.h"
+#include "esl_macro.h"
+#include "esl_line.h"
+#include "esl_txq.h"
+#include "esl_reply.h"
+#include "esl_frame.h"
+#include "esl_stream.h"
+#include "esl_transport.h"
+#include "esl_cli_cmds.h"
 
 #include "nrf_gpio.h"
 #include "nrf_delay.h"
 #include "nrfx_gpiote.h"
+#include "app_error.h"
 #include "app_timer.h"
+#include "app_util_platform.h"
 #include "nrfx_clock.h"
 #include "nrf_drv_clock.h"
-#include "nrfx_nvmc.h"
 #include "nrf_log.h"
 #include "nrf_log_ctrl.h"
 #include "nrf_log_default_backends.h"
 #include "nrf_log_backend_usb.h"
-#include "app_usbd.h"
-#include "app_usbd_serial_num.h"
-#include "app_usbd_cdc_acm.h"
 
 #include <stdint.h>
 #include <stdbool.h>
@@ -27,173 +39,200 @@
 
 #define DEBOUNCE_DELAY              APP_TIMER_TICKS(DEBOUNCE_DELAY_MS)
 #define DOUBLE_CLICK_DELAY          APP_TIMER_TICKS(DOUBLE_CLICK_DELAY_MS)
-#define BOOTLOADER_START_ADDR       (0x000E0000)
-#define PAGE_SIZE                   (0x1000)
-#define APP_DATA_END_ADDR           BOOTLOADER_START_ADDR
-#define APP_DATA_START_ADDR         BOOTLOADER_START_ADDR - 3 * PAGE_SIZE
-#define SAVED_COLORS_PG_ADDR        APP_DATA_START_ADDR + PAGE_SIZE
-#define LAST_COLOR_PG_ADDR          APP_DATA_START_ADDR
+#define LED_TIMER_PERIOD            APP_TIMER_TICKS(LED_TIMER_PERIOD_MS)
+#define RGB_COMMIT_DELAY            APP_TIMER_TICKS(ESL_RGB_COMMIT_DELAY_MS)
+// Flash queue full or compaction still running, nothing was changed
+#define FLASH_BUSY_MSG              "Flash busy, try again"
 
 typedef enum {
-    ESL_SUCCESS                 = 0x0000,
-    ESL_ERR_NVMC_MEMORY_FULL    = 0x1000,
-    ESL_ERR_NVMC_NOT_WRITABLE   = 0x1001,
-    ESL_ERR_CLI_VALUE_ERROR     = 0x2000,
-    ESL_ERROR                   = 0x4000,
-} esl_ret_code_t;
-
-typedef struct {
-    uint8_t magic_number;
-    uint8_t r_val;
-    uint8_t g_val;
-    uint8_t b_val;
-} esl_nvmc_rgb_data_t;
-
-typedef union {
-    struct
-    {
-        esl_nvmc_rgb_data_t rgb_data;
-        char                color_name[32];
-    } fields;
-    uint8_t bits[36];
-} __attribute__((packed)) esl_nvmc_saved_color_t;
+    ESL_CLI_MSG_TYPE_SUCCESS    = 0,
+    ESL_CLI_MSG_TYPE_ERROR      = 1,
+    ESL_CLI_MSG_TYPE_INPUT      = 2,
+    ESL_CLI_MSG_TYPE_WARNING    = 3
+} esl_cli_msg_type_t;
 
+// Activity that may delay the LED timer, used to classify tick jitter
 typedef enum {
-    ESL_USB_MSG_TYPE_SUCCESS    = 0,
-    ESL_USB_MSG_TYPE_ERROR      = 1,
-    ESL_USB_MSG_TYPE_INPUT      = 2,
-    ESL_USB_MSG_TYPE_WARNING    = 3
-} esl_usb_msg_type_t;
-
-typedef char* esl_cli_cmd_arg_t;
-
-typedef esl_ret_code_t (*esl_cli_cmd_handler_t)(esl_cli_cmd_arg_t *args, int arg_count);
+    ESL_LOAD_NONE   = 0,
+    ESL_LOAD_TX     = 1 << 0,
+    ESL_LOAD_FLASH  = 1 << 1,
+    ESL_LOAD_COUNT  = 1 << 2
+} esl_load_flags_t;
 
 typedef struct {
-    const char *command_name;
-    const char *command_description;
-    esl_cli_cmd_handler_t handler;
-    int args_count;                  // Number of expected args
-} esl_cli_cmd_entry_t;
+    uint32_t samples;
+    uint32_t max_ticks;
+    uint64_t sum_ticks;
+} esl_jitter_stats_t;
 
 /**
  * Static & Global Variables
  */
 static esl_pwm_context_t pwm_ctx;
 
-// NVMC
-static uint32_t curr_addr = SAVED_COLORS_PG_ADDR;
-static esl_nvmc_saved_color_t * saved_colors;
-static uint32_t saved_colors_count = 0;
-
 // TIMERS
 APP_TIMER_DEF(debounce_timer_id);
 APP_TIMER_DEF(double_click_timer_id);
 APP_TIMER_DEF(led_timer_id);
+APP_TIMER_DEF(rgb_commit_timer_id);
+static bool led_timer_running = false;
+static uint64_t led_timer_stopped_at = 0;
+static uint64_t led_timer_last_tick = 0;
+static uint64_t led_ticks_avoided = 0;
+static esl_jitter_stats_t led_jitter[ESL_LOAD_COUNT];
+static volatile bool tx_busy = false;
+
+// Current color write-back
+static volatile bool rgb_dirty = false;
+static uint32_t rgb_changes = 0;
 
 // IRQ
+static int8_t sw1_btn_id = -1;
 static volatile bool awaiting_second_click = false;
 static volatile bool single_click_processed = false;
 
-// USB
-static char m_rx_buffer[READ_SIZE];
-static volatile bool esl_usb_tx_done;
-static char command_buffer[ESL_USB_COMM_BUFFER_SIZE];
-static volatile char* current_command = command_buffer;
+// USB, or whichever transport ESL_TRANSPORT picks
+static esl_transport_t const * const transport = &ESL_TRANSPORT;
+static esl_line_t rx_lines;
+static bool rx_paused = false;              // Ring too full for another packet
+static bool rx_tx_wait = false;             // Input held until output drains
+static bool rx_work_pending = false;
+static esl_txq_t txq;
+static bool port_open = false;
+static uint32_t tx_closed_drops = 0;
+static uint32_t rx_packets = 0;
+static uint32_t rx_bytes = 0;
+static uint32_t rx_commands = 0;
+static uint64_t cli_parse_cycles = 0;       // Parse and lookup, without the handler
+static uint32_t cli_parse_max_cycles = 0;
+static uint32_t rx_pauses = 0;
+static uint32_t rx_tx_waits = 0;
+static uint32_t msgs = 0;                   // Binary protocol requests handled
+static uint32_t msg_crc_errors = 0;
+static uint32_t msg_invalid = 0;
+static uint32_t msg_cbor_drops = 0;         // Requests while the CLI is in CBOR mode
+static uint32_t cli_replies = 0;            // Text replies, with formatting time
+static uint64_t cli_reply_cycles = 0;
+static uint32_t cli_reply_max_cycles = 0;
+static esl_reply_mode_t cli_reply_mode = ESL_REPLY_MODE_TEXT;  // Back to text when the port opens
+static esl_reply_t cli_reply;               // The one being built
+
+// Listings, sent an entry at a time as output space frees up
+typedef bool (*cli_list_next_t)(esl_reply_t *r, uint32_t *cursor, uint32_t n);
+static struct {
+    bool active;
+    bool work_pending;
+    cli_list_next_t next;       // Writes entry n, false once there are no more
+    const char *trailer;        // Text after the last entry
+    uint32_t cursor;
+    uint32_t n;
+    esl_reply_t reply;
+} cli_list;
+static uint32_t cli_lists = 0;
+static uint32_t cli_list_entries = 0;
+static uint32_t cli_list_waits = 0;         // Times an entry waited for TX
+static uint32_t cli_list_drops = 0;         // Machine mode replies that would land inside one
+
+// CLI batches
+static uint8_t cli_batch_depth = 0;         // Color changes wait for the outermost batch
+static bool cli_batch_color_changed = false;
+static bool cli_batch_multi = false;        // Inside a line or macro with several commands
+static bool cli_batch_quiet = false;        // Success replies of the running command left out
+static const char *cli_cmd_running = NULL;  // Named in machine mode replies
+static uint32_t cli_batches = 0;            // Lines and macros with several commands
+static uint32_t cli_batch_cmds = 0;
+static uint32_t cli_batch_rollbacks = 0;
+static uint32_t cli_batch_tx_stops = 0;     // Batches stopped with no room left for a reply
+static uint32_t cli_batch_updates_saved = 0;    // Color updates merged into the last one
+static uint32_t macro_runs = 0;
 
 /**
  * Functions' Forward Declarations
  */
 
 // INIT FUNCTIONS
-void init_button_interrupt();
+void init_inputs();
 void init_timers();
 static void lfclk_request(void);
-static void esl_nvmc_init();
+static void restore_last_rgb(void);
 
 // HANDLERS
 void debounce_timeout_handler(void *p_context);
 void double_click_timeout_handler(void *p_context);
-static void esl_usb_ev_handler(app_usbd_class_inst_t const * p_inst,
-                           app_usbd_cdc_acm_user_event_t event);
-void button_gpiote_handler(nrfx_gpiote_pin_t pin, nrf_gpiote_polarity_t action);
+static bool transport_evt_handler(esl_transport_evt_t evt, uint8_t const *data, uint16_t size);
+void input_evt_handler(esl_input_evt_t const *evt);
 void led_timer_timeout_handler(void * p_context);
-
-// NVMC Functions
-static esl_ret_code_t esl_nvmc_write(uint32_t addr, const void *src);
-static esl_ret_code_t esl_nvmc_save_curr_rgb();
-static esl_ret_code_t esl_nvmc_read(uint32_t addr, void *buffer, size_t size);
-
-// USB Functions
-void esl_cli_process_cmd();
-void esl_usb_msg_write(const char* msg, esl_usb_msg_type_t msg_type);
-// static uint32_t esl_nvmc_get_curr_addr(uint32_t start_pg_addr);
-
-// Command handlers
-esl_ret_code_t esl_cli_cmd_rgb(esl_cli_cmd_arg_t *args, int arg_count);
-esl_ret_code_t esl_cli_cmd_hsv(esl_cli_cmd_arg_t *args, int arg_count);
-esl_ret_code_t esl_cli_cmd_add_rgb_color(esl_cli_cmd_arg_t *args, int arg_count) {return ESL_ERROR;}
-esl_ret_code_t esl_cli_cmd_add_hsv_color(esl_cli_cmd_arg_t *args, int arg_count) {return ESL_ERROR;}
-esl_ret_code_t esl_cli_cmd_add_current_color(esl_cli_cmd_arg_t *args, int arg_count);
-esl_ret_code_t esl_cli_cmd_list_colors(esl_cli_cmd_arg_t *args, int arg_count);
-esl_ret_code_t esl_cli_cmd_help(esl_cli_cmd_arg_t *args, int arg_count);
-esl_ret_code_t esl_cli_cmd_apply_color(esl_cli_cmd_arg_t *args, int arg_count) {return ESL_ERROR;}
-
-esl_cli_cmd_handler_t esl_cli_cmd_handler_find(char* cmd_name);
-
-static esl_cli_cmd_entry_t command_table[] = {
-    { "rgb", "rgb <R> <G> <B>: set new color based on RGB\n\r", esl_cli_cmd_rgb, 3 },
-    { "hsv", "hsv <H> <S> <V>: set new color based on HSV\n\r", esl_cli_cmd_hsv, 3 },
-    { "add_rgb_color", "add_rgb_color <R> <G> <B> <color_name>: save RGB color\n\r", esl_cli_cmd_add_rgb_color, 4 },
-    { "add_hsv_color", "add_hsv_color <H> <S> <V> <color_name>: save HSV color\n\r", esl_cli_cmd_add_hsv_color, 4 },
-    { "add_current_color", "add_current_color <color_name>: save current color\n\r", esl_cli_cmd_add_current_color, 1 },
-    { "apply_color", "apply_color <color_name>: apply saved color\n\r", esl_cli_cmd_apply_color, 1 },
-    { "list_colors", "list_colors: display all saved colors\n\r", esl_cli_cmd_list_colors, 0 },
-    { "help", "help: show list of commands\n\r", esl_cli_cmd_help, 0 }
-};
-
-#define ESL_CLI_CMD_MAX_ARGS 4
-#define COMMAND_TABLE_SIZE (sizeof(command_table) / sizeof(command_table[0]))
-
-APP_USBD_CDC_ACM_GLOBAL_DEF(
-    esl_usb_cdc_acm,
-    esl_usb_ev_handler,
-    CDC_ACM_COMM_INTERFACE,
-    CDC_ACM_DATA_INTERFACE,
-    CDC_ACM_COMM_EPIN,
-    CDC_ACM_DATA_EPIN,
-    CDC_ACM_DATA_EPOUT,
-    APP_USBD_CDC_COMM_PROTOCOL_NONE
-);
+static bool led_timer_work_pending(void);
+static void led_timer_refresh(void);
+void rgb_commit_timeout_handler(void *p_context);
+static void rgb_changed(void);
+static void rgb_commit(void);
+static void color_set_rgb(uint8_t r, uint8_t g, uint8_t b);
+static void color_set_hsv(uint16_t hue, uint8_t saturation, uint8_t brightness);
+static void color_apply(void);
+
+// SCHEDULED WORK
+static void rx_work(void *p_data, uint16_t data_size);
+static void save_curr_rgb_work(void *p_data, uint16_t data_size);
+
+
+// Port and CLI Functions
+static void tx_kick(void);
+static void msg_process(uint8_t const *frame, uint16_t size);
+void esl_cli_process_cmd(char *cmd_line);
+static esl_ret_code_t cli_batch_run(char *line);
+void esl_cli_msg_write(const char* msg, esl_cli_msg_type_t msg_type);
+static esl_reply_t *cli_reply_begin(esl_cli_msg_type_t msg_type);
+static void cli_reply_end(void);
+static void cli_list_begin(esl_reply_t *r, const char *key, cli_list_next_t next, const char *trailer);
+static void cli_list_work(void *p_data, uint16_t data_size);
+static void rx_tx_wait_end(void);
+static void reply_rgb(esl_reply_t *r, uint8_t red, uint8_t green, uint8_t blue);
 
 int main(void) {
+    esl_stack_paint();
     ret_code_t ret = NRF_LOG_INIT(NULL);
     APP_ERROR_CHECK(ret);
 
+    esl_sched_init();
+    esl_txq_init(&txq);
     lfclk_request();
     init_timers();
-    init_button_interrupt();
+    esl_clock_init();
+    init_inputs();
     NRF_LOG_DEFAULT_BACKENDS_INIT();
     cfg_pins();
     led_off_all();
     esl_pwm_init(&pwm_ctx);
     esl_nvmc_init();
+    esl_clip_init(&pwm_ctx);
+    esl_macro_init();
+    esl_stream_init(&pwm_ctx);
+    restore_last_rgb();
+    if (!esl_cli_table_is_sorted(esl_cli_cmds, esl_cli_cmds_count)) {
+        NRF_LOG_ERROR("CLI command table not sorted, lookups will fail");
+    }
 
-    app_usbd_class_inst_t const * class_cdc_acm = app_usbd_cdc_acm_class_inst_get(&esl_usb_cdc_acm);
-    ret = app_usbd_class_append(class_cdc_acm);
-    APP_ERROR_CHECK(ret);
+    transport->init(transport_evt_handler);
+
+    esl_power_init();
+    led_timer_stopped_at = esl_clock_ticks();
+    led_timer_refresh();
 
-    ret = app_timer_start(led_timer_id, APP_TIMER_TICKS(10), NULL);
-    APP_ERROR_CHECK(ret);
     while (1) {
 
-        while (app_usbd_event_queue_process())
-        {
-        }
+        transport->process();
+
+        esl_sched_execute();
+
+        // One flash slice per pass keeps USB and scheduled work responsive
+        bool flash_pending = esl_nvmc_process();
 
         LOG_BACKEND_USB_PROCESS();
-        if (!NRF_LOG_PROCESS())
+        if (!NRF_LOG_PROCESS() && esl_sched_is_empty() && !flash_pending)
         {
+            // USB, timer and GPIOTE interrupts all wake the core
+            esl_power_idle();
         }
     }
     return 0;
@@ -208,6 +247,7 @@ void init_timers() {
     app_timer_create(&debounce_timer_id, APP_TIMER_MODE_SINGLE_SHOT, debounce_timeout_handler);
     app_timer_create(&double_click_timer_id, APP_TIMER_MODE_SINGLE_SHOT, double_click_timeout_handler);
     app_timer_create(&led_timer_id, APP_TIMER_MODE_REPEATED, led_timer_timeout_handler);
+    app_timer_create(&rgb_commit_timer_id, APP_TIMER_MODE_SINGLE_SHOT, rgb_commit_timeout_handler);
 }
 
 static void lfclk_request(void)
@@ -217,11 +257,9 @@ static void lfclk_request(void)
     nrf_drv_clock_lfclk_request(NULL);
 }
 
-static void esl_nvmc_init() {
-    // Retrieve last saved color
+static void restore_last_rgb(void) {
     esl_nvmc_rgb_data_t retrieved_rgb;
-    esl_nvmc_read(LAST_COLOR_PG_ADDR, &retrieved_rgb, sizeof(retrieved_rgb));
-    if (retrieved_rgb.magic_number == ESL_NVMC_BYTE_VALID) {
+    if (esl_nvmc_last_rgb_load(&retrieved_rgb)) {
         pwm_ctx.rgb_state.red = retrieved_rgb.r_val;
         pwm_ctx.rgb_state.green = retrieved_rgb.g_val;
         pwm_ctx.rgb_state.blue = retrieved_rgb.b_val;
@@ -235,55 +273,51 @@ static void esl_nvmc_init() {
             &pwm_ctx.hsv_state.brightness
         );
         esl_pwm_update_rgb(&pwm_ctx);
-
-    } else if (retrieved_rgb.magic_number != ESL_NVMC_BYTE_VALID) {
-        nrfx_nvmc_page_erase(LAST_COLOR_PG_ADDR);
-    }
-
-    // Retrieve all user saved colors
-    saved_colors = (esl_nvmc_saved_color_t *)malloc(PAGE_SIZE);
-
-    if (saved_colors == NULL) {
-        NRF_LOG_ERROR("Memory allocation failed!");
-        return;
-    }
-
-    while (curr_addr < SAVED_COLORS_PG_ADDR + PAGE_SIZE) {
-        esl_nvmc_saved_color_t retrieved_color;
-        esl_nvmc_read(curr_addr, &retrieved_color, sizeof(retrieved_color));
-
-        if (retrieved_color.fields.rgb_data.magic_number == ESL_NVMC_BYTE_VALID) {
-            saved_colors[saved_colors_count++] = retrieved_color;
-            curr_addr += sizeof(esl_nvmc_saved_color_t);
-            NRF_LOG_INFO("Color name: %s", NRF_LOG_PUSH(retrieved_color.fields.color_name));
-            NRF_LOG_INFO("r: %d, g: %d, b: %d", retrieved_color.fields.rgb_data.r_val, retrieved_color.fields.rgb_data.g_val, retrieved_color.fields.rgb_data.b_val);
-        } else if (retrieved_color.fields.rgb_data.magic_number == ESL_NVMC_BYTE_NOT_INIT) {
-            NRF_LOG_INFO("Retrieved all saved colors! count: %d", saved_colors_count);
-            return;
-        } else {
-            NRF_LOG_ERROR("Memory Corrupted");
-            nrfx_nvmc_page_erase(SAVED_COLORS_PG_ADDR);
-            break;
-        }
     }
 }
 
-void init_button_interrupt() {
-    if(!nrfx_gpiote_is_init()) {
-        nrfx_gpiote_init();
-    }
+void init_inputs() {
+    esl_input_init(input_evt_handler);
+    sw1_btn_id = esl_input_button_add(SW1, NRF_GPIO_PIN_PULLUP, true);
 
-    nrfx_gpiote_in_config_t in_config = NRFX_GPIOTE_CONFIG_IN_SENSE_LOTOHI(true);
-    in_config.pull = NRF_GPIO_PIN_PULLUP;
-    nrfx_gpiote_in_init(SW1, &in_config, button_gpiote_handler);
-    nrfx_gpiote_in_event_enable(SW1, true);
+#if defined(ESL_INPUT_ENC_PIN_A) && defined(ESL_INPUT_ENC_PIN_B)
+    esl_input_encoder_add(ESL_INPUT_ENC_PIN_A, ESL_INPUT_ENC_PIN_B, NRF_GPIO_PIN_PULLUP);
+#endif
 }
 
 // HANDLERS
-void button_gpiote_handler(nrfx_gpiote_pin_t pin, nrf_gpiote_polarity_t action) {
-    if (pin == SW1) {
-        single_click_processed = false;
-        app_timer_start(debounce_timer_id, DEBOUNCE_DELAY, NULL);
+void input_evt_handler(esl_input_evt_t const *evt) {
+    switch (evt->type) {
+    case ESL_INPUT_EVT_BTN_PRESSED:
+        if (evt->id == sw1_btn_id) {
+            led_timer_refresh();
+        }
+        break;
+    case ESL_INPUT_EVT_BTN_RELEASED:
+        if (evt->id == sw1_btn_id) {
+            single_click_processed = false;
+            app_timer_start(debounce_timer_id, DEBOUNCE_DELAY, NULL);
+            led_timer_refresh();
+        }
+        break;
+    case ESL_INPUT_EVT_ENC_STEP:
+        // Any encoder adjusts the component selected by the current input mode
+        if (pwm_ctx.current_input_mode != ESL_PWM_IN_NO_INPUT) {
+            esl_pwm_step_hsv(&pwm_ctx, evt->direction);
+            hsv_to_rgb(
+                pwm_ctx.hsv_state.hue,
+                pwm_ctx.hsv_state.saturation,
+                pwm_ctx.hsv_state.brightness,
+                &pwm_ctx.rgb_state.red,
+                &pwm_ctx.rgb_state.green,
+                &pwm_ctx.rgb_state.blue
+            );
+            esl_pwm_update_rgb(&pwm_ctx);
+            led_timer_refresh();
+        }
+        break;
+    default:
+        break;
     }
 }
 
@@ -297,15 +331,13 @@ void debounce_timeout_handler(void *p_context) {
         awaiting_second_click = false;
         if (pwm_ctx.current_input_mode++ == ESL_PWM_IN_BRIGHTNESS) {
             pwm_ctx.current_input_mode = ESL_PWM_IN_NO_INPUT;
-            esl_ret_code_t res = esl_nvmc_save_curr_rgb();
-            if (res == ESL_SUCCESS) {
-                NRF_LOG_INFO("Current Color saved");
-            }
+            rgb_changed();
         }
         if (pwm_ctx.current_blink_mode++ == ESL_PWM_CONST_ON) {
             pwm_ctx.current_blink_mode = ESL_PWM_CONST_OFF;
         }
         NRF_LOG_INFO("INPUT MODE CHANGED: %d", pwm_ctx.current_input_mode);
+        led_timer_refresh();
     }
 }
 
@@ -313,77 +345,105 @@ void double_click_timeout_handler(void *p_context) {
     // Timeout expired without a second click
     awaiting_second_click = false;
     single_click_processed = true;
+    led_timer_refresh();
+}
+
+// Queues a received packet for the line assembler and echoes its text back
+// with a single write. False once the ring can't take another packet.
+static bool rx_packet(char const *data, size_t size) {
+    char echo[2 * READ_SIZE];
+    uint16_t echo_len = esl_line_echo(&rx_lines, data, size, echo);
+
+    // Machine modes only get replies
+    if (echo_len && cli_reply_mode == ESL_REPLY_MODE_TEXT) {
+        void const *parts[] = { echo };
+        esl_txq_put(&txq, parts, &echo_len, 1);
+        tx_kick();
+    }
+
+    esl_line_push(&rx_lines, data, size);
+    rx_packets++;
+    rx_bytes += size;
+    if (!rx_work_pending) {
+        rx_work_pending = esl_sched_post(ESL_SCHED_PRIO_NORMAL, rx_work, NULL, 0);
+    }
+
+    // The transport holds off the host until rx_work() frees up room
+    if (esl_line_free(&rx_lines) < READ_SIZE) {
+        rx_paused = true;
+        rx_pauses++;
+        return false;
+    }
+    return true;
 }
 
-static void esl_usb_ev_handler(app_usbd_class_inst_t const * p_inst,
-                               app_usbd_cdc_acm_user_event_t event)
+static bool transport_evt_handler(esl_transport_evt_t evt, uint8_t const *data, uint16_t size)
 {
-    switch (event)
+    switch (evt)
     {
-    case APP_USBD_CDC_ACM_USER_EVT_PORT_OPEN:
+    case ESL_TRANSPORT_EVT_OPEN:
     {
-        ret_code_t ret;
         NRF_LOG_INFO("PORT IS OPEN");
-        ret = app_usbd_cdc_acm_read(&esl_usb_cdc_acm, m_rx_buffer, READ_SIZE);
-        UNUSED_VARIABLE(ret);
+        port_open = true;
+        cli_reply_mode = ESL_REPLY_MODE_TEXT;
+        cli_list.active = false;
+        esl_txq_clear(&txq);
+        esl_line_init(&rx_lines);
+        rx_paused = false;
         break;
     }
-    case APP_USBD_CDC_ACM_USER_EVT_PORT_CLOSE:
+    case ESL_TRANSPORT_EVT_CLOSE:
     {
         NRF_LOG_WARNING("PORT IS CLOSED");
+        // Nobody is listening, queued output goes away
+        port_open = false;
+        cli_list.active = false;
+        esl_txq_clear(&txq);
+        tx_busy = false;
+        esl_stream_stop();
+        led_timer_refresh();
+        // Host went away, don't leave the color waiting for the idle timer
+        esl_sched_post(ESL_SCHED_PRIO_LOW, save_curr_rgb_work, NULL, 0);
         break;
     }
-    case APP_USBD_CDC_ACM_USER_EVT_TX_DONE:
+    case ESL_TRANSPORT_EVT_TX_DONE:
     {
-        esl_usb_tx_done = true;
-        break;
-    }
-    case APP_USBD_CDC_ACM_USER_EVT_RX_DONE:
-    {
-        ret_code_t ret;
-        do
-        {
-            if (m_rx_buffer[0] == '\r' || m_rx_buffer[0] == '\n')
-            {
-                app_usbd_cdc_acm_write(&esl_usb_cdc_acm, "\r\n", 2);
-
-                *current_command = '\0';
-                current_command = command_buffer;
-                esl_cli_process_cmd();
-            }
-            else
-            {
-                if ((current_command - command_buffer) < ESL_USB_COMM_BUFFER_SIZE - 1)
-                {
-                    *current_command = m_rx_buffer[0];
-                    current_command++;
-                } else {
-                    esl_usb_msg_write("Too long command", ESL_USB_MSG_TYPE_ERROR);
-                    current_command = command_buffer;
-                }
-
-                app_usbd_cdc_acm_write(&esl_usb_cdc_acm,
-                                       m_rx_buffer,
-                                       READ_SIZE);
-            }
-
-            /* Fetch data until internal buffer is empty */
-            ret = app_usbd_cdc_acm_read(&esl_usb_cdc_acm,
-                                        m_rx_buffer,
-                                        READ_SIZE);
-        } while (ret == NRF_SUCCESS);
+        esl_txq_sent(&txq);
+        tx_busy = false;
+        tx_kick();
+        if (cli_list.active && !cli_list.work_pending) {
+            cli_list.work_pending = esl_sched_post(ESL_SCHED_PRIO_NORMAL, cli_list_work, NULL, 0);
+        }
+        rx_tx_wait_end();
         break;
     }
+    case ESL_TRANSPORT_EVT_RX:
+        return rx_packet((char const *)data, size);
     default:
         break;
     }
+    return true;
 }
 
 void led_timer_timeout_handler(void * p_context) {
-    esl_pwm_update_led1(&pwm_ctx);
+    // Animations advance by the real time elapsed since the previous tick
+    uint64_t now = esl_clock_ticks();
+    uint32_t dt_ticks = now - led_timer_last_tick;
+    led_timer_last_tick = now;
+
+    uint8_t load = (tx_busy ? ESL_LOAD_TX : 0) | (esl_nvmc_is_busy() ? ESL_LOAD_FLASH : 0);
+    esl_jitter_stats_t *jitter = &led_jitter[load];
+    uint32_t deviation = dt_ticks > LED_TIMER_PERIOD ? dt_ticks - LED_TIMER_PERIOD : LED_TIMER_PERIOD - dt_ticks;
+    jitter->samples++;
+    jitter->sum_ticks += deviation;
+    if (deviation > jitter->max_ticks) {
+        jitter->max_ticks = deviation;
+    }
+
+    esl_pwm_update_led1(&pwm_ctx, dt_ticks);
     if (pwm_ctx.current_input_mode != ESL_PWM_IN_NO_INPUT) {
         if (btn_is_pressed() && single_click_processed) {
-            esl_pwm_update_hsv(&pwm_ctx);
+            esl_pwm_update_hsv(&pwm_ctx, dt_ticks);
             hsv_to_rgb(
                 pwm_ctx.hsv_state.hue,
                 pwm_ctx.hsv_state.saturation,
@@ -397,328 +457,1294 @@ void led_timer_timeout_handler(void * p_context) {
     }
 
     esl_pwm_play_seq(&pwm_ctx);
+
+    if (!led_timer_work_pending()) {
+        led_timer_refresh();
+    }
 }
 
-// NVMC
-static esl_ret_code_t esl_nvmc_write(uint32_t addr, void const * src)
-{
-    size_t size = sizeof(src);
-    if (!nrfx_nvmc_word_writable_check(addr, size)) {
-        return ESL_ERR_NVMC_NOT_WRITABLE;
+// The LED timer only runs while LED1 blinks or the button adjusts the color
+static bool led_timer_work_pending(void) {
+    if (pwm_ctx.current_blink_mode == ESL_PWM_BLINK_SLOW ||
+        pwm_ctx.current_blink_mode == ESL_PWM_BLINK_FAST) {
+        return true;
     }
+    return pwm_ctx.current_input_mode != ESL_PWM_IN_NO_INPUT &&
+           btn_is_pressed() && single_click_processed;
+}
 
-    nrfx_nvmc_words_write(addr, src, 9);
+// Start or stop the LED timer to match the current state. When stopping,
+// the static output is rendered once so it stays on the LEDs.
+static void led_timer_refresh(void) {
+    CRITICAL_REGION_ENTER();
+    if (led_timer_work_pending()) {
+        if (!led_timer_running) {
+            led_timer_last_tick = esl_clock_ticks();
+            led_ticks_avoided += (led_timer_last_tick - led_timer_stopped_at) / LED_TIMER_PERIOD;
+            led_timer_running = true;
+            app_timer_start(led_timer_id, LED_TIMER_PERIOD, NULL);
+        }
+    } else {
+        esl_pwm_update_led1(&pwm_ctx, 0);
+        esl_pwm_play_seq(&pwm_ctx);
+        if (led_timer_running) {
+            app_timer_stop(led_timer_id);
+            led_timer_running = false;
+            led_timer_stopped_at = esl_clock_ticks();
+        }
+    }
+    CRITICAL_REGION_EXIT();
+}
 
-    while (!nrfx_nvmc_write_done_check()) {}
+// SCHEDULED WORK
+// Runs one received command line or binary request per pass, so other work
+// gets its turn between the lines of a script
+static void rx_work(void *p_data, uint16_t data_size) {
+    void *data;
+    uint16_t size;
+
+    // The reply might not fit, or would land inside a listing. TX_DONE
+    // picks up again once there is room.
+    if (cli_list.active || esl_txq_free(&txq) < ESL_TX_RESERVE) {
+        rx_work_pending = false;
+        rx_tx_wait = true;
+        rx_tx_waits++;
+        return;
+    }
 
-    return ESL_SUCCESS;
-}
+    esl_line_result_t res = esl_line_get(&rx_lines, &data, &size);
 
-static esl_ret_code_t esl_nvmc_read(uint32_t addr, void *buffer, size_t size) {
-    if (addr % sizeof(uint32_t) != 0) {
-        NRF_LOG_ERROR("Address is not aligned!");
-        return ESL_ERROR;
+    // Decided before fetching, packets fetched now post the work themselves
+    rx_work_pending = res != ESL_LINE_NONE &&
+                          esl_sched_post(ESL_SCHED_PRIO_NORMAL, rx_work, NULL, 0);
+    if (rx_paused && esl_line_free(&rx_lines) >= READ_SIZE) {
+        rx_paused = false;
+        transport->rx_resume();
+    }
+
+    switch (res) {
+    case ESL_LINE_READY:
+        rx_commands++;
+        esl_cli_process_cmd(data);
+        break;
+    case ESL_LINE_TOO_LONG:
+        esl_cli_msg_write("Too long command", ESL_CLI_MSG_TYPE_ERROR);
+        break;
+    case ESL_LINE_FRAME:
+        msg_process(data, size);
+        break;
+    default:
+        break;
     }
-    memcpy(buffer, (const void *)addr, size);
-    return ESL_SUCCESS;
 }
 
+static void save_curr_rgb_work(void *p_data, uint16_t data_size) {
+    rgb_commit();
+}
 
-static esl_ret_code_t esl_nvmc_save_curr_rgb() {
-    esl_nvmc_rgb_data_t curr_rgb = {
-        .magic_number = ESL_NVMC_BYTE_VALID,
-        .r_val = pwm_ctx.rgb_state.red,
-        .g_val = pwm_ctx.rgb_state.green,
-        .b_val = pwm_ctx.rgb_state.blue
-    };
+// CURRENT COLOR WRITE-BACK
+void rgb_commit_timeout_handler(void *p_context) {
+    esl_sched_post(ESL_SCHED_PRIO_LOW, save_curr_rgb_work, NULL, 0);
+}
 
-    uint32_t bits = 0;
-    memcpy(&bits, &curr_rgb, sizeof(curr_rgb));
+// Marks the current color for saving. Every change restarts the idle timer,
+// so a burst of changes ends up as a single flash write.
+static void rgb_changed(void) {
+    CRITICAL_REGION_ENTER();
+    rgb_dirty = true;
+    rgb_changes++;
+    CRITICAL_REGION_EXIT();
 
-    nrfx_nvmc_page_erase(LAST_COLOR_PG_ADDR);
+    app_timer_stop(rgb_commit_timer_id);
+    app_timer_start(rgb_commit_timer_id, RGB_COMMIT_DELAY, NULL);
+}
 
-    if (nrfx_nvmc_word_writable_check(LAST_COLOR_PG_ADDR, bits)) {
-        nrfx_nvmc_word_write(LAST_COLOR_PG_ADDR, bits);
+static void color_set_rgb(uint8_t r, uint8_t g, uint8_t b) {
+    pwm_ctx.rgb_state.red = r;
+    pwm_ctx.rgb_state.green = g;
+    pwm_ctx.rgb_state.blue = b;
+    rgb_to_hsv(
+        pwm_ctx.rgb_state.red,
+        pwm_ctx.rgb_state.green,
+        pwm_ctx.rgb_state.blue,
+        &pwm_ctx.hsv_state.hue,
+        &pwm_ctx.hsv_state.saturation,
+        &pwm_ctx.hsv_state.brightness
+    );
+    color_apply();
+}
 
-        NRF_LOG_INFO("Address: 0x%x", LAST_COLOR_PG_ADDR);
-        NRF_LOG_INFO("RGB Data: %d %d %d", curr_rgb.r_val, curr_rgb.g_val, curr_rgb.b_val);
-        return ESL_SUCCESS;
-    } else {
-        NRF_LOG_ERROR("Not writable");
+static void color_set_hsv(uint16_t hue, uint8_t saturation, uint8_t brightness) {
+    pwm_ctx.hsv_state.hue = hue;
+    pwm_ctx.hsv_state.saturation = saturation;
+    pwm_ctx.hsv_state.brightness = brightness;
+    hsv_to_rgb(
+        pwm_ctx.hsv_state.hue,
+        pwm_ctx.hsv_state.saturation,
+        pwm_ctx.hsv_state.brightness,
+        &pwm_ctx.rgb_state.red,
+        &pwm_ctx.rgb_state.green,
+        &pwm_ctx.rgb_state.blue
+    );
+    color_apply();
+}
+
+// Puts the color in pwm_ctx on the LEDs. Inside a batch only the last one
+// counts, so it waits for the end.
+static void color_apply(void) {
+    if (cli_batch_depth) {
+        if (cli_batch_color_changed) {
+            cli_batch_updates_saved++;
+        }
+        cli_batch_color_changed = true;
+        return;
     }
+    esl_pwm_update_rgb(&pwm_ctx);
+    led_timer_refresh();
+    rgb_changed();
+}
 
-    return ESL_ERROR;
+// A pending timer expiry after an early commit finds nothing to do
+static void rgb_commit(void) {
+    bool dirty;
+
+    CRITICAL_REGION_ENTER();
+    dirty = rgb_dirty;
+    rgb_dirty = false;
+    CRITICAL_REGION_EXIT();
+
+    if (!dirty) {
+        return;
+    }
+
+    esl_ret_code_t res = esl_nvmc_last_rgb_save(pwm_ctx.rgb_state.red, pwm_ctx.rgb_state.green, pwm_ctx.rgb_state.blue);
+    if (res == ESL_SUCCESS) {
+        NRF_LOG_INFO("Current Color saved");
+    } else if (res == ESL_ERR_BUSY) {
+        // Flash queue full, try again after another idle delay
+        rgb_changed();
+    }
 }
 
-// USB
-esl_cli_cmd_handler_t esl_cli_cmd_handler_find(char* cmd_name) {
-    if (cmd_name == NULL) {
-        return NULL;
+// BINARY PROTOCOL
+static esl_msg_status_t msg_apply(esl_msg_t const *req) {
+    char name[ESL_NVMC_COLOR_NAME_LEN];
+    esl_nvmc_saved_color_t color;
+
+    if (req->len == 0 || req->len >= sizeof(name)) {
+        return ESL_MSG_ERR_LENGTH;
     }
+    memcpy(name, req->payload, req->len);
+    name[req->len] = '\0';
+    if (esl_nvmc_color_find(name, &color) != ESL_SUCCESS) {
+        return ESL_MSG_ERR_NOT_FOUND;
+    }
+    color_set_rgb(color.fields.rgb_data.r_val, color.fields.rgb_data.g_val, color.fields.rgb_data.b_val);
+    return ESL_MSG_OK;
+}
 
-    for (int cmd_idx = 0; cmd_idx < COMMAND_TABLE_SIZE; cmd_idx++) {
-        if (strcmp(command_table[cmd_idx].command_name, cmd_name) == 0) {
-            return command_table[cmd_idx].handler;
-        }
+static void put_le32(uint8_t *dst, uint32_t val) {
+    for (uint8_t i = 0; i < 4; i++) {
+        dst[i] = val >> (8 * i);
     }
-    return NULL;
 }
 
-void esl_cli_process_cmd() {
-    char temp_cmd[ESL_USB_COMM_BUFFER_SIZE + 1];
-    strncpy(temp_cmd, (const char*)current_command, sizeof(temp_cmd) - 1);
-    temp_cmd[sizeof(temp_cmd) - 1] = '\0';
+static void msg_stream_stop(esl_msg_t *reply) {
+    esl_stream_stats_t stats;
+
+    esl_stream_stop();
+    led_timer_refresh();
+    esl_stream_stats_get(&stats);
+    put_le32(&reply->payload[1], stats.frames);
+    put_le32(&reply->payload[5], stats.applied);
+    put_le32(&reply->payload[9], stats.underruns);
+    put_le32(&reply->payload[13], stats.overruns);
+    reply->len = 17;
+}
 
-    // Split the command
-    char* token = strtok(temp_cmd, " ");
-    if (!token) {
-        esl_usb_msg_write("No command provided", ESL_USB_MSG_TYPE_ERROR);
+// Handles one request and queues its reply. Frames that don't decode are
+// dropped without a reply, the client times out and retries. So are all
+// requests in CBOR output mode, whose zero bytes the client can't tell
+// from frame delimiters, and a reply would break up the CBOR.
+static void msg_process(uint8_t const *frame, uint16_t size) {
+    esl_msg_t req;
+    esl_ret_code_t res = esl_frame_decode(frame, size, &req);
+    if (res != ESL_SUCCESS) {
+        if (res == ESL_ERR_FRAME_CRC) {
+            msg_crc_errors++;
+        } else {
+            msg_invalid++;
+        }
         return;
     }
+    if (cli_reply_mode == ESL_REPLY_MODE_CBOR) {
+        msg_cbor_drops++;
+        return;
+    }
+    msgs++;
 
-    char* command = malloc(strlen(token) + 1);
-    strcpy(command, token);
-
-    esl_cli_cmd_arg_t args[ESL_CLI_CMD_MAX_ARGS];
-    int arg_count = 0;
+    esl_msg_t reply = { .type = req.type | ESL_MSG_REPLY, .seq = req.seq, .len = 1 };
+    esl_msg_status_t status = ESL_MSG_OK;
 
-    // Parse values
-    while ((token = strtok(NULL, " ")) != NULL) {
-        if (arg_count >= ESL_CLI_CMD_MAX_ARGS) {
-            esl_usb_msg_write("Too many args", ESL_USB_MSG_TYPE_ERROR);
+    switch (req.type) {
+    // Stream frames come at up to 200 Hz, they are counted, not answered
+    case ESL_MSG_STREAM_FRAME: {
+        if (req.len != 7) {
+            msg_invalid++;
             return;
         }
-        NRF_LOG_INFO("args[%d]: %s", arg_count, NRF_LOG_PUSH(token));
-        args[arg_count] = token;
-        arg_count++;
+        uint32_t timestamp = req.payload[0] | (req.payload[1] << 8) | (req.payload[2] << 16) |
+                             ((uint32_t)req.payload[3] << 24);
+        esl_stream_push(timestamp, req.payload[4], req.payload[5], req.payload[6]);
+        return;
     }
 
-    esl_cli_cmd_handler_t cmd_handler = esl_cli_cmd_handler_find(command);
-    if (cmd_handler) {
-        NRF_LOG_INFO("Args count: %d", arg_count);
-        esl_ret_code_t res = cmd_handler(args, arg_count);
-        if (res != ESL_SUCCESS) {
-            esl_usb_msg_write("Error occurred", ESL_USB_MSG_TYPE_ERROR);
+    case ESL_MSG_STREAM_START:
+        if (req.len != 0 && req.len != 2) {
+            status = ESL_MSG_ERR_LENGTH;
+            break;
         }
-    } else {
-        esl_usb_msg_write("Command not found", ESL_USB_MSG_TYPE_ERROR);
+        esl_clip_stop();
+        esl_stream_start(req.len ? req.payload[0] | (req.payload[1] << 8) : 0);
+        break;
+
+    case ESL_MSG_STREAM_STOP:
+        msg_stream_stop(&reply);
+        break;
+
+    case ESL_MSG_SET_RGB:
+        if (req.len != 3) {
+            status = ESL_MSG_ERR_LENGTH;
+            break;
+        }
+        color_set_rgb(req.payload[0], req.payload[1], req.payload[2]);
+        break;
+
+    case ESL_MSG_SET_HSV: {
+        if (req.len != 4) {
+            status = ESL_MSG_ERR_LENGTH;
+            break;
+        }
+        uint16_t hue = req.payload[0] | (req.payload[1] << 8);
+        if (hue > 360 || req.payload[2] > 100 || req.payload[3] > 100) {
+            status = ESL_MSG_ERR_VALUE;
+            break;
+        }
+        color_set_hsv(hue, req.payload[2], req.payload[3]);
+        break;
     }
 
-    free(command);
+    case ESL_MSG_SAVE:
+        rgb_dirty = true;
+        rgb_commit();
+        break;
+
+    case ESL_MSG_APPLY:
+        status = msg_apply(&req);
+        break;
+
+    case ESL_MSG_QUERY:
+        reply.payload[1] = pwm_ctx.rgb_state.red;
+        reply.payload[2] = pwm_ctx.rgb_state.green;
+        reply.payload[3] = pwm_ctx.rgb_state.blue;
+        reply.payload[4] = pwm_ctx.hsv_state.hue & 0xFF;
+        reply.payload[5] = pwm_ctx.hsv_state.hue >> 8;
+        reply.payload[6] = pwm_ctx.hsv_state.saturation;
+        reply.payload[7] = pwm_ctx.hsv_state.brightness;
+        reply.len = 8;
+        break;
+
+    default:
+        status = ESL_MSG_ERR_UNKNOWN;
+        break;
+    }
+    reply.payload[0] = status;
+
+    if (port_open) {
+        uint8_t wire[ESL_FRAME_WIRE_MAX];
+        uint16_t wire_size = esl_frame_encode(&reply, wire);
+        void const *parts[] = { wire };
+        esl_txq_put(&txq, parts, &wire_size, 1);
+        tx_kick();
+    }
 }
 
-// CLI command handlers
-esl_ret_code_t esl_cli_cmd_rgb(esl_cli_cmd_arg_t* args, int args_count) {
-    if (args_count == 3) {
-        uint8_t r_val = atoi(args[0]);
-        uint8_t g_val = atoi(args[1]);
-        uint8_t b_val = atoi(args[2]);
-
-        if (
-            r_val >= 0 && r_val <= 255 &&
-            g_val >= 0 && g_val <= 255 &&
-            b_val >= 0 && b_val <= 255
-        ) {
-            pwm_ctx.rgb_state.red = r_val;
-            pwm_ctx.rgb_state.green = g_val;
-            pwm_ctx.rgb_state.blue = b_val;
-
-            rgb_to_hsv(
-                pwm_ctx.rgb_state.red,
-                pwm_ctx.rgb_state.green,
-                pwm_ctx.rgb_state.blue,
-                &pwm_ctx.hsv_state.hue,
-                &pwm_ctx.hsv_state.saturation,
-                &pwm_ctx.hsv_state.brightness
-            );
-            esl_pwm_update_rgb(&pwm_ctx);
-            char rgb_msg[100];
-            snprintf(
-                rgb_msg, sizeof(rgb_msg), "RGB updated: R=%d, G=%d, B=%d",
-                pwm_ctx.rgb_state.red,
-                pwm_ctx.rgb_state.green,
-                pwm_ctx.rgb_state.blue
-            );
-            esl_usb_msg_write(rgb_msg, ESL_USB_MSG_TYPE_SUCCESS);
-            return ESL_SUCCESS;
+// CLI
+static void cli_parse_error(esl_ret_code_t res, esl_cli_parsed_t const *parsed) {
+    esl_cli_cmd_t const *cmd = parsed->cmd;
+    esl_cli_arg_spec_t const *spec = cmd && cmd->args ? &cmd->args[parsed->bad_arg] : NULL;
+
+    switch (res) {
+    case ESL_ERR_CLI_EMPTY:
+        esl_cli_msg_write("No command provided", ESL_CLI_MSG_TYPE_ERROR);
+        return;
+    case ESL_ERR_CLI_NOT_FOUND:
+        esl_cli_msg_write("Command not found", ESL_CLI_MSG_TYPE_ERROR);
+        return;
+    default:
+        break;
+    }
+
+    esl_reply_t *r = cli_reply_begin(ESL_CLI_MSG_TYPE_ERROR);
+    esl_reply_str(r, "at", NULL, cmd->name);
+    switch (res) {
+    case ESL_ERR_CLI_ARG_COUNT:
+        esl_reply_tag(r, "error", "arg_count");
+        esl_reply_u32(r, "min", ": ", cmd->args_min);
+        if (cmd->args_min != cmd->args_max) {
+            esl_reply_u32(r, "max", " to ", cmd->args_max);
+        }
+        ESL_REPLY_TEXT(r, " args expected");
+        break;
+    case ESL_ERR_CLI_VALUE_ERROR:
+        esl_reply_tag(r, "error", "value");
+        esl_reply_u32(r, "arg", ": arg ", parsed->bad_arg + 1);
+        if (spec->type == ESL_CLI_ARG_FLAG || spec->type == ESL_CLI_ARG_CHOICE) {
+            esl_reply_str(r, "expected", " has to be '", spec->word);
+            ESL_REPLY_TEXT(r, "'");
+        } else if (spec->type == ESL_CLI_ARG_STR) {
+            ESL_REPLY_TEXT(r, " is not valid UTF-8");
         } else {
-            esl_usb_msg_write("RGB values out of range (0-255)", ESL_USB_MSG_TYPE_ERROR);
-            return ESL_ERROR;
+            ESL_REPLY_TEXT(r, " is not a number");
         }
-    } else {
-       esl_usb_msg_write("RGB command requires 3 args", ESL_USB_MSG_TYPE_ERROR);
-       return ESL_ERROR;
+        break;
+    case ESL_ERR_CLI_ARG_RANGE:
+        esl_reply_tag(r, "error", "range");
+        esl_reply_u32(r, "arg", ": arg ", parsed->bad_arg + 1);
+        esl_reply_i32(r, "min", " out of range (", spec->min);
+        esl_reply_i32(r, "max", "-", spec->max);
+        ESL_REPLY_TEXT(r, ")");
+        break;
+    case ESL_ERR_CLI_ARG_LENGTH:
+        esl_reply_tag(r, "error", "length");
+        esl_reply_u32(r, "arg", ": arg ", parsed->bad_arg + 1);
+        esl_reply_u32(r, "max", " has to be max ", spec->max);
+        ESL_REPLY_TEXT(r, " characters");
+        break;
+    default:
+        esl_reply_tag(r, "error", "args");
+        ESL_REPLY_TEXT(r, ": invalid args");
+        break;
     }
-    return ESL_ERROR;
+    cli_reply_end();
 }
 
-esl_ret_code_t esl_cli_cmd_hsv(esl_cli_cmd_arg_t* args, int args_count) {
-    if (args_count == 3) {
-        uint16_t hue = atoi(args[0]);
-        uint8_t saturation = atoi(args[1]);
-        uint8_t brightness = atoi(args[2]);
-        if (
-            hue >= 0 && hue <= 360 &&
-            saturation >= 0 && saturation <= 100 &&
-            brightness >= 0 && brightness <= 100
-        ) {
-            pwm_ctx.hsv_state.hue = hue;
-            pwm_ctx.hsv_state.saturation = saturation;
-            pwm_ctx.hsv_state.brightness = brightness;
-            hsv_to_rgb(
-                pwm_ctx.hsv_state.hue,
-                pwm_ctx.hsv_state.saturation,
-                pwm_ctx.hsv_state.brightness,
-                &pwm_ctx.rgb_state.red,
-                &pwm_ctx.rgb_state.green,
-                &pwm_ctx.rgb_state.blue
-            );
-            esl_pwm_update_rgb(&pwm_ctx);
-            char hsv_msg[100];
-            snprintf(
-                hsv_msg, sizeof(hsv_msg), "HSV updated: H=%d, S=%d, V=%d",
-                pwm_ctx.hsv_state.hue,
-                pwm_ctx.hsv_state.saturation, pwm_ctx.hsv_state.
-                brightness
-            );
-            esl_usb_msg_write(hsv_msg, ESL_USB_MSG_TYPE_SUCCESS);
-            return ESL_SUCCESS;
-        } else {
-            esl_usb_msg_write("HSV values out of range (H: 0-360, S/V: 0-100)", ESL_USB_MSG_TYPE_ERROR);
+// Parses every command of a line in place, without running any. Empty
+// commands between separators are left out.
+static esl_ret_code_t cli_batch_parse(char *line, esl_cli_parsed_t *parsed, uint8_t *count) {
+    char *cursor = line;
+    char *cmd_line;
+    esl_cli_parsed_t one;
+
+    *count = 0;
+    while ((cmd_line = esl_cli_split(&cursor)) != NULL) {
+        uint32_t start = esl_cycles_get();
+        esl_ret_code_t res = esl_cli_parse(cmd_line, esl_cli_cmds, esl_cli_cmds_count, &one);
+        uint32_t cycles = esl_cycles_get() - start;
+        cli_parse_cycles += cycles;
+        if (cycles > cli_parse_max_cycles) {
+            cli_parse_max_cycles = cycles;
+        }
+
+        if (res == ESL_ERR_CLI_EMPTY && (*count > 0 || cursor != NULL)) {
+            continue;
+        }
+        if (res != ESL_SUCCESS) {
+            cli_parse_error(res, &one);
+            return res;
+        }
+        if (*count > 0 && parsed[*count - 1].cmd->ends_batch) {
+            esl_reply_t *r = cli_reply_begin(ESL_CLI_MSG_TYPE_ERROR);
+            esl_reply_tag(r, "error", "batch_listing");
+            esl_reply_str(r, "at", NULL, parsed[*count - 1].cmd->name);
+            ESL_REPLY_TEXT(r, " lists, it has to come last");
+            cli_reply_end();
             return ESL_ERROR;
         }
-    } else {
-       esl_usb_msg_write("HSV command requires 3 args", ESL_USB_MSG_TYPE_ERROR);
-       return ESL_ERROR;
+        if (*count == ESL_CLI_BATCH_MAX) {
+            esl_reply_t *r = cli_reply_begin(ESL_CLI_MSG_TYPE_ERROR);
+            esl_reply_tag(r, "error", "batch_max");
+            esl_reply_u32(r, "max", "Max ", ESL_CLI_BATCH_MAX);
+            ESL_REPLY_TEXT(r, " commands per line");
+            cli_reply_end();
+            return ESL_ERROR;
+        }
+        parsed[(*count)++] = one;
     }
-    return ESL_ERROR;
+    return ESL_SUCCESS;
 }
 
-esl_ret_code_t esl_cli_cmd_add_current_color(esl_cli_cmd_arg_t* args, int args_count) {
-    if (args_count == 1) {
-        if (sizeof(args[0]) > 32) {
-            esl_usb_msg_write("Color name has to be max 32 characters", ESL_USB_MSG_TYPE_ERROR);
-            return ESL_ERROR;
+// Commands separated by ';' run as one batch: nothing runs unless all of
+// them parse, and the color they leave behind is put on the LEDs once, at
+// the end. If a command fails, the rest is skipped and the color goes back
+// to what it was before the batch; flash changes already made stay.
+// Commands that change something only reply on failure, queries reply as
+// they would on their own. The reserve checked before the line was taken
+// only covers one reply, so each later command needs it again, or the
+// batch stops there the same way. A listing, always last, can't fail and
+// runs once the batch is wrapped up, so its entries follow the summary
+// instead of having it land among them. A macro that lists can't be run
+// from a batch, whose summary would come after the listing.
+static esl_ret_code_t cli_batch_run(char *line) {
+    esl_cli_parsed_t parsed[ESL_CLI_BATCH_MAX];
+    uint8_t count;
+
+    esl_ret_code_t res = cli_batch_parse(line, parsed, &count);
+    if (res != ESL_SUCCESS) {
+        return res;
+    }
+    if (cli_batch_multi && parsed[count - 1].cmd->ends_batch) {
+        esl_reply_t *r = cli_reply_begin(ESL_CLI_MSG_TYPE_ERROR);
+        esl_reply_tag(r, "error", "batch_listing");
+        esl_reply_str(r, "at", NULL, parsed[count - 1].cmd->name);
+        ESL_REPLY_TEXT(r, " lists, a macro with it has to run on its own");
+        cli_reply_end();
+        return ESL_ERROR;
+    }
+
+    esl_pwm_rgb_t rgb = pwm_ctx.rgb_state;
+    esl_pwm_hsv_t hsv = pwm_ctx.hsv_state;
+    bool multi = cli_batch_multi;
+    bool quiet = cli_batch_quiet;
+    const char *outer_cmd = cli_cmd_running;
+    bool tx_full = false;
+    uint8_t done;
+
+    if (count > 1) {
+        cli_batches++;
+        cli_batch_cmds += count;
+        cli_batch_multi = true;
+    }
+    cli_batch_depth++;
+    for (done = 0; done < count; done++) {
+        if (done > 0 && esl_txq_free(&txq) < ESL_TX_RESERVE) {
+            tx_full = true;
+            res = ESL_ERR_BUSY;
+            break;
+        }
+        if (parsed[done].cmd->ends_batch) {
+            break;
         }
-        esl_nvmc_saved_color_t new_color = {
-            .fields = {
-                .rgb_data = {
-                    .r_val = pwm_ctx.rgb_state.red,
-                    .g_val = pwm_ctx.rgb_state.green,
-                    .b_val = pwm_ctx.rgb_state.blue,
-                    .magic_number = ESL_NVMC_BYTE_VALID
-                },
-            }
-        };
-
-        strncpy(new_color.fields.color_name, args[0], sizeof(new_color.fields.color_name) - 1);
-        new_color.fields.color_name[sizeof(new_color.fields.color_name) - 1] = '\0';
-
-        esl_ret_code_t res = esl_nvmc_write(curr_addr, &new_color);
+        cli_cmd_running = parsed[done].cmd->name;
+        cli_batch_quiet = cli_batch_multi && parsed[done].cmd->quiet_in_batch;
+        res = parsed[done].cmd->handler(parsed[done].args, parsed[done].arg_count);
         if (res != ESL_SUCCESS) {
-            esl_usb_msg_write("Couldn't save current color", ESL_USB_MSG_TYPE_ERROR);
-            return ESL_ERROR;
+            break;
         }
-        saved_colors[saved_colors_count++] = new_color;
-        curr_addr += sizeof(esl_nvmc_saved_color_t);
+    }
+    cli_cmd_running = outer_cmd;
+    cli_batch_depth--;
+    cli_batch_multi = multi;
+    cli_batch_quiet = quiet;
+
+    if (res != ESL_SUCCESS) {
+        if (count > 1) {
+            cli_batch_rollbacks++;
+            cli_batch_tx_stops += tx_full;
+            esl_reply_t *r = cli_reply_begin(ESL_CLI_MSG_TYPE_ERROR);
+            esl_reply_tag(r, "error", tx_full ? "batch_tx_full" : "batch");
+            esl_reply_str(r, "at", NULL, parsed[done].cmd->name);
+            esl_reply_u32(r, "done", tx_full ? " not run, output full, " : " failed, ", done);
+            esl_reply_u32(r, "count", " of ", count);
+            ESL_REPLY_TEXT(r, " commands done, color unchanged");
+            cli_reply_end();
+        } else {
+            esl_cli_msg_write("Error occurred", ESL_CLI_MSG_TYPE_ERROR);
+        }
+        pwm_ctx.rgb_state = rgb;
+        pwm_ctx.hsv_state = hsv;
+        if (cli_batch_depth == 0) {
+            cli_batch_color_changed = false;
+        }
+        return res;
+    }
 
-        char ret_msg[100];
-        snprintf(
-            ret_msg, sizeof(ret_msg), "New Color saved:\n\rName: %s, R=%d, G=%d, B=%d",
-            new_color.fields.color_name,
-            new_color.fields.rgb_data.r_val,
-            new_color.fields.rgb_data.g_val,
-            new_color.fields.rgb_data.b_val
-        );
-        esl_usb_msg_write(ret_msg, ESL_USB_MSG_TYPE_SUCCESS);
+    if (cli_batch_depth == 0 && cli_batch_color_changed) {
+        cli_batch_color_changed = false;
+        color_apply();
+    }
+    if (count > 1) {
+        esl_reply_t *r = cli_reply_begin(ESL_CLI_MSG_TYPE_SUCCESS);
+        esl_reply_u32(r, "count", NULL, count);
+        ESL_REPLY_TEXT(r, " commands done: ");
+        reply_rgb(r, pwm_ctx.rgb_state.red, pwm_ctx.rgb_state.green, pwm_ctx.rgb_state.blue);
+        cli_reply_end();
+    }
+    if (done < count) {
+        cli_cmd_running = parsed[done].cmd->name;
+        res = parsed[done].cmd->handler(parsed[done].args, parsed[done].arg_count);
+        cli_cmd_running = outer_cmd;
+    }
+    return res;
+}
+
+// Parses the line in place and runs its commands. Handlers only get
+// arguments that passed the command's schema.
+void esl_cli_process_cmd(char *cmd_line) {
+    cli_batch_run(cmd_line);
+}
+
+// CLI command handlers
+esl_ret_code_t esl_cli_cmd_rgb(esl_cli_arg_t const *args, uint8_t arg_count) {
+    color_set_rgb(args[0].num, args[1].num, args[2].num);
+    esl_reply_t *r = cli_reply_begin(ESL_CLI_MSG_TYPE_SUCCESS);
+    ESL_REPLY_TEXT(r, "RGB updated: ");
+    reply_rgb(r, pwm_ctx.rgb_state.red, pwm_ctx.rgb_state.green, pwm_ctx.rgb_state.blue);
+    cli_reply_end();
+    return ESL_SUCCESS;
+}
+
+esl_ret_code_t esl_cli_cmd_hsv(esl_cli_arg_t const *args, uint8_t arg_count) {
+    color_set_hsv(args[0].num, args[1].num, args[2].num);
+    esl_reply_t *r = cli_reply_begin(ESL_CLI_MSG_TYPE_SUCCESS);
+    esl_reply_u32(r, "h", "HSV updated: H=", pwm_ctx.hsv_state.hue);
+    esl_reply_u32(r, "s", ", S=", pwm_ctx.hsv_state.saturation);
+    esl_reply_u32(r, "v", ", V=", pwm_ctx.hsv_state.brightness);
+    cli_reply_end();
+    return ESL_SUCCESS;
+}
+
+static esl_ret_code_t save_named_color(const char *name, uint8_t r, uint8_t g, uint8_t b) {
+    esl_nvmc_saved_color_t new_color = {
+        .fields = {
+            .rgb_data = {
+                .r_val = r,
+                .g_val = g,
+                .b_val = b,
+                .magic_number = ESL_NVMC_BYTE_VALID
+            },
+        }
+    };
+
+    strncpy(new_color.fields.color_name, name, sizeof(new_color.fields.color_name) - 1);
+
+    esl_ret_code_t res = esl_nvmc_color_add(&new_color);
+    if (res == ESL_ERR_NVMC_MEMORY_FULL) {
+        esl_cli_msg_write("No space left for colors", ESL_CLI_MSG_TYPE_ERROR);
+        return ESL_ERROR;
+    } else if (res == ESL_ERR_BUSY) {
+        esl_cli_msg_write(FLASH_BUSY_MSG, ESL_CLI_MSG_TYPE_ERROR);
+        return ESL_ERROR;
+    } else if (res != ESL_SUCCESS) {
+        esl_cli_msg_write("Couldn't save color", ESL_CLI_MSG_TYPE_ERROR);
+        return ESL_ERROR;
+    }
+
+    esl_reply_t *reply = cli_reply_begin(ESL_CLI_MSG_TYPE_SUCCESS);
+    esl_reply_str(reply, "name", "New Color saved:\n\rName: ", new_color.fields.color_name);
+    ESL_REPLY_TEXT(reply, ", ");
+    reply_rgb(reply, r, g, b);
+    cli_reply_end();
+    return ESL_SUCCESS;
+}
+
+esl_ret_code_t esl_cli_cmd_add_rgb_color(esl_cli_arg_t const *args, uint8_t arg_count) {
+    return save_named_color(args[3].str, args[0].num, args[1].num, args[2].num);
+}
+
+esl_ret_code_t esl_cli_cmd_add_hsv_color(esl_cli_arg_t const *args, uint8_t arg_count) {
+    uint8_t r_val, g_val, b_val;
+    hsv_to_rgb(args[0].num, args[1].num, args[2].num, &r_val, &g_val, &b_val);
+    return save_named_color(args[3].str, r_val, g_val, b_val);
+}
+
+esl_ret_code_t esl_cli_cmd_add_current_color(esl_cli_arg_t const *args, uint8_t arg_count) {
+    return save_named_color(args[0].str, pwm_ctx.rgb_state.red, pwm_ctx.rgb_state.green, pwm_ctx.rgb_state.blue);
+}
+
+esl_ret_code_t esl_cli_cmd_apply_color(esl_cli_arg_t const *args, uint8_t arg_count) {
+    esl_nvmc_saved_color_t color;
+    if (esl_nvmc_color_find(args[0].str, &color) != ESL_SUCCESS) {
+        esl_cli_msg_write("Color not found", ESL_CLI_MSG_TYPE_ERROR);
+        return ESL_ERROR;
+    }
+
+    color_set_rgb(color.fields.rgb_data.r_val, color.fields.rgb_data.g_val, color.fields.rgb_data.b_val);
+
+    esl_reply_t *r = cli_reply_begin(ESL_CLI_MSG_TYPE_SUCCESS);
+    esl_reply_str(r, "name", "Color applied: ", color.fields.color_name);
+    ESL_REPLY_TEXT(r, ", ");
+    reply_rgb(r, pwm_ctx.rgb_state.red, pwm_ctx.rgb_state.green, pwm_ctx.rgb_state.blue);
+    cli_reply_end();
+    return ESL_SUCCESS;
+}
+
+esl_ret_code_t esl_cli_cmd_del_color(esl_cli_arg_t const *args, uint8_t arg_count) {
+    esl_ret_code_t res = esl_nvmc_color_delete(args[0].str);
+    if (res == ESL_ERR_NVMC_NOT_FOUND) {
+        esl_cli_msg_write("Color not found", ESL_CLI_MSG_TYPE_ERROR);
+        return ESL_ERROR;
+    } else if (res == ESL_ERR_BUSY) {
+        esl_cli_msg_write(FLASH_BUSY_MSG, ESL_CLI_MSG_TYPE_ERROR);
+        return ESL_ERROR;
+    } else if (res != ESL_SUCCESS) {
+        esl_cli_msg_write("Couldn't delete color", ESL_CLI_MSG_TYPE_ERROR);
+        return ESL_ERROR;
+    }
+    esl_cli_msg_write("Color deleted", ESL_CLI_MSG_TYPE_SUCCESS);
+    return ESL_SUCCESS;
+}
+
+esl_ret_code_t esl_cli_cmd_rename_color(esl_cli_arg_t const *args, uint8_t arg_count) {
+    esl_ret_code_t res = esl_nvmc_color_rename(args[0].str, args[1].str);
+    switch (res) {
+    case ESL_SUCCESS:
+        esl_cli_msg_write("Color renamed", ESL_CLI_MSG_TYPE_SUCCESS);
         return ESL_SUCCESS;
-    } else {
-       esl_usb_msg_write("Command requires 1 arg", ESL_USB_MSG_TYPE_ERROR);
-       return ESL_ERROR;
+    case ESL_ERR_NVMC_NOT_FOUND:
+        esl_cli_msg_write("Color not found", ESL_CLI_MSG_TYPE_ERROR);
+        break;
+    case ESL_ERR_NVMC_EXISTS:
+        esl_cli_msg_write("Color name already used", ESL_CLI_MSG_TYPE_ERROR);
+        break;
+    case ESL_ERR_BUSY:
+        esl_cli_msg_write(FLASH_BUSY_MSG, ESL_CLI_MSG_TYPE_ERROR);
+        break;
+    default:
+        esl_cli_msg_write("Couldn't rename color", ESL_CLI_MSG_TYPE_ERROR);
+        break;
     }
     return ESL_ERROR;
 }
 
-esl_ret_code_t esl_cli_cmd_list_colors(esl_cli_cmd_arg_t *args, int arg_count) {
-    if (arg_count == 0) {
-        NRF_LOG_INFO("Colors count: %d", saved_colors_count);
-        char ret_msg[1024] = "Saved Colors:\n\r";
-        for (int color_idx = 0; color_idx < saved_colors_count; ++color_idx) {
-            esl_nvmc_saved_color_t color = saved_colors[color_idx];
-            NRF_LOG_INFO("Current idx: %d", color_idx);
-            NRF_LOG_INFO("Color Name: %s", NRF_LOG_PUSH(color.fields.color_name));
-
-            char temp_buf[100];
-            snprintf(
-                temp_buf, sizeof(temp_buf), "%d. Name: %s | R: %d, G: %d, B: %d\n\r",
-                color_idx + 1,
-                color.fields.color_name,
-                color.fields.rgb_data.r_val,
-                color.fields.rgb_data.g_val,
-                color.fields.rgb_data.b_val
-            );
-            strncat(ret_msg, temp_buf, sizeof(ret_msg) - strlen(ret_msg) - 1);
+// The cursor is the color log iterator, so each entry costs the same
+static bool list_colors_next(esl_reply_t *r, uint32_t *cursor, uint32_t n) {
+    esl_nvmc_saved_color_t color;
+    if (!esl_nvmc_color_next(cursor, &color)) {
+        return false;
+    }
+    esl_reply_obj_begin(r, NULL);
+    esl_reply_u32(r, NULL, NULL, n + 1);
+    esl_reply_str(r, "name", ". Name: ", color.fields.color_name);
+    esl_reply_u32(r, "r", " | R: ", color.fields.rgb_data.r_val);
+    esl_reply_u32(r, "g", ", G: ", color.fields.rgb_data.g_val);
+    esl_reply_u32(r, "b", ", B: ", color.fields.rgb_data.b_val);
+    ESL_REPLY_TEXT(r, "\n\r");
+    esl_reply_obj_end(r);
+    return true;
+}
+
+esl_ret_code_t esl_cli_cmd_list_colors(esl_cli_arg_t const *args, uint8_t arg_count) {
+    NRF_LOG_INFO("Colors count: %d", esl_nvmc_color_count());
+    esl_reply_t *r = cli_reply_begin(ESL_CLI_MSG_TYPE_SUCCESS);
+    ESL_REPLY_TEXT(r, "Saved Colors:\n\r");
+    cli_list_begin(r, "colors", list_colors_next, NULL);
+    return ESL_SUCCESS;
+}
+
+esl_ret_code_t esl_cli_cmd_clip_rec(esl_cli_arg_t const *args, uint8_t arg_count) {
+    esl_ret_code_t res = esl_clip_record_start(args[0].num);
+    if (res == ESL_ERR_NVMC_MEMORY_FULL) {
+        esl_cli_msg_write("No room for another clip", ESL_CLI_MSG_TYPE_ERROR);
+        return ESL_ERROR;
+    } else if (res != ESL_SUCCESS) {
+        esl_cli_msg_write("Already recording", ESL_CLI_MSG_TYPE_ERROR);
+        return ESL_ERROR;
+    }
+    esl_cli_msg_write("Recording clip", ESL_CLI_MSG_TYPE_SUCCESS);
+    return ESL_SUCCESS;
+}
+
+static esl_ret_code_t clip_key_add(esl_cli_arg_t const *args, bool fade) {
+    esl_ret_code_t res = esl_clip_record_key(args[0].num, args[1].num, args[2].num, args[3].num, fade);
+    if (res == ESL_ERR_NVMC_MEMORY_FULL) {
+        esl_cli_msg_write("Clip memory full", ESL_CLI_MSG_TYPE_ERROR);
+        return ESL_ERROR;
+    } else if (res == ESL_ERR_BUSY) {
+        esl_cli_msg_write(FLASH_BUSY_MSG, ESL_CLI_MSG_TYPE_ERROR);
+        return ESL_ERROR;
+    } else if (res != ESL_SUCCESS) {
+        esl_cli_msg_write("Not recording, use clip_rec first", ESL_CLI_MSG_TYPE_ERROR);
+        return ESL_ERROR;
+    }
+    esl_cli_msg_write("Keyframe added", ESL_CLI_MSG_TYPE_SUCCESS);
+    return ESL_SUCCESS;
+}
+
+esl_ret_code_t esl_cli_cmd_clip_key(esl_cli_arg_t const *args, uint8_t arg_count) {
+    return clip_key_add(args, false);
+}
+
+esl_ret_code_t esl_cli_cmd_clip_fade(esl_cli_arg_t const *args, uint8_t arg_count) {
+    return clip_key_add(args, true);
+}
+
+esl_ret_code_t esl_cli_cmd_clip_end(esl_cli_arg_t const *args, uint8_t arg_count) {
+    uint8_t clip_idx;
+    esl_ret_code_t res = esl_clip_record_end(&clip_idx);
+    if (res == ESL_ERR_BUSY) {
+        esl_cli_msg_write(FLASH_BUSY_MSG, ESL_CLI_MSG_TYPE_ERROR);
+        return ESL_ERROR;
+    } else if (res != ESL_SUCCESS) {
+        esl_cli_msg_write("No keyframes recorded", ESL_CLI_MSG_TYPE_ERROR);
+        return ESL_ERROR;
+    }
+    esl_reply_t *r = cli_reply_begin(ESL_CLI_MSG_TYPE_SUCCESS);
+    esl_reply_u32(r, "clip", "Clip ", clip_idx);
+    ESL_REPLY_TEXT(r, " saved");
+    cli_reply_end();
+    return ESL_SUCCESS;
+}
+
+// Called from the scheduler when a clip has played to its end
+static void clip_done(void) {
+    led_timer_refresh();
+    esl_cli_msg_write("Clip finished", ESL_CLI_MSG_TYPE_SUCCESS);
+}
+
+esl_ret_code_t esl_cli_cmd_clip_play(esl_cli_arg_t const *args, uint8_t arg_count) {
+    bool loop = arg_count == 2 && args[1].num;
+    esl_stream_stop();
+    if (esl_clip_play(args[0].num, loop, clip_done) != ESL_SUCCESS) {
+        esl_cli_msg_write("Clip not found", ESL_CLI_MSG_TYPE_ERROR);
+        return ESL_ERROR;
+    }
+    esl_cli_msg_write(loop ? "Clip playing in a loop" : "Clip playing", ESL_CLI_MSG_TYPE_SUCCESS);
+    return ESL_SUCCESS;
+}
+
+esl_ret_code_t esl_cli_cmd_clip_stop(esl_cli_arg_t const *args, uint8_t arg_count) {
+    esl_clip_stop();
+    led_timer_refresh();
+    esl_cli_msg_write("Clip stopped", ESL_CLI_MSG_TYPE_SUCCESS);
+    return ESL_SUCCESS;
+}
+
+static bool clip_list_next(esl_reply_t *r, uint32_t *cursor, uint32_t n) {
+    esl_clip_info_t info;
+    if (*cursor > UINT8_MAX || !esl_clip_info_get(*cursor, &info)) {
+        return false;
+    }
+    esl_reply_obj_begin(r, NULL);
+    esl_reply_u32(r, "clip", NULL, *cursor);
+    esl_reply_u32(r, "keyframes", ". keyframes: ", info.keyframes);
+    esl_reply_u32(r, "frames", ", frames: ", info.frames);
+    esl_reply_u32(r, "frame_ms", " x ", info.frame_ms);
+    esl_reply_u32(r, "ms", " ms (", info.frames * info.frame_ms);
+    ESL_REPLY_TEXT(r, " ms)\n\r");
+    esl_reply_obj_end(r);
+    (*cursor)++;
+    return true;
+}
+
+esl_ret_code_t esl_cli_cmd_clip_list(esl_cli_arg_t const *args, uint8_t arg_count) {
+    esl_reply_t *r = cli_reply_begin(ESL_CLI_MSG_TYPE_SUCCESS);
+    ESL_REPLY_TEXT(r, "Clips:\n\r");
+    cli_list_begin(r, "clips", clip_list_next, NULL);
+    return ESL_SUCCESS;
+}
+
+esl_ret_code_t esl_cli_cmd_clip_erase(esl_cli_arg_t const *args, uint8_t arg_count) {
+    esl_ret_code_t res = esl_clip_erase_all();
+    if (res == ESL_ERR_BUSY) {
+        esl_cli_msg_write(FLASH_BUSY_MSG, ESL_CLI_MSG_TYPE_ERROR);
+        return ESL_ERROR;
+    } else if (res != ESL_SUCCESS) {
+        esl_cli_msg_write("Couldn't erase clips", ESL_CLI_MSG_TYPE_ERROR);
+        return ESL_ERROR;
+    }
+    led_timer_refresh();
+    esl_cli_msg_write("Clips erased", ESL_CLI_MSG_TYPE_SUCCESS);
+    return ESL_SUCCESS;
+}
+
+// Commands are checked when the macro is stored, and can't touch macros
+esl_ret_code_t esl_cli_cmd_macro_add(esl_cli_arg_t const *args, uint8_t arg_count) {
+    char text[ESL_MACRO_TEXT_LEN];
+    esl_cli_parsed_t parsed[ESL_CLI_BATCH_MAX];
+    uint8_t count;
+
+    strcpy(text, args[1].str);
+    if (cli_batch_parse(text, parsed, &count) != ESL_SUCCESS) {
+        return ESL_ERROR;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        if (strncmp(parsed[i].cmd->name, "macro_", 6) == 0) {
+            esl_cli_msg_write("Macros can't use macro commands", ESL_CLI_MSG_TYPE_ERROR);
+            return ESL_ERROR;
         }
-        esl_usb_msg_write(ret_msg, ESL_USB_MSG_TYPE_SUCCESS);
-        return ESL_SUCCESS;
-    } else {
-        esl_usb_msg_write("Command requires 0 args", ESL_USB_MSG_TYPE_ERROR);
+    }
+
+    esl_ret_code_t res = esl_macro_add(args[0].str, args[1].str);
+    if (res == ESL_ERR_NVMC_MEMORY_FULL) {
+        esl_cli_msg_write("No room for another macro, use macro_erase", ESL_CLI_MSG_TYPE_ERROR);
+        return ESL_ERROR;
+    } else if (res == ESL_ERR_CLI_VALUE_ERROR) {
+        esl_cli_msg_write("Macros can only hold printable characters", ESL_CLI_MSG_TYPE_ERROR);
+        return ESL_ERROR;
+    } else if (res == ESL_ERR_BUSY) {
+        esl_cli_msg_write(FLASH_BUSY_MSG, ESL_CLI_MSG_TYPE_ERROR);
+        return ESL_ERROR;
+    } else if (res != ESL_SUCCESS) {
+        esl_cli_msg_write("Couldn't save macro", ESL_CLI_MSG_TYPE_ERROR);
         return ESL_ERROR;
     }
-    
-    return ESL_ERROR;
+
+    esl_reply_t *r = cli_reply_begin(ESL_CLI_MSG_TYPE_SUCCESS);
+    esl_reply_str(r, "name", "Macro saved: ", args[0].str);
+    esl_reply_u32(r, "commands", ", ", count);
+    ESL_REPLY_TEXT(r, " commands");
+    cli_reply_end();
+    return ESL_SUCCESS;
+}
+
+esl_ret_code_t esl_cli_cmd_macro_run(esl_cli_arg_t const *args, uint8_t arg_count) {
+    char text[ESL_MACRO_TEXT_LEN];
+
+    if (esl_macro_find(args[0].str, text, sizeof(text)) != ESL_SUCCESS) {
+        esl_cli_msg_write("Macro not found", ESL_CLI_MSG_TYPE_ERROR);
+        return ESL_ERROR;
+    }
+    macro_runs++;
+    return cli_batch_run(text);
 }
 
-esl_ret_code_t esl_cli_cmd_help(esl_cli_cmd_arg_t *args, int arg_count) {
-    if (arg_count != 0) {
-        esl_usb_msg_write("help: No arguments expected", ESL_USB_MSG_TYPE_ERROR);
+esl_ret_code_t esl_cli_cmd_macro_del(esl_cli_arg_t const *args, uint8_t arg_count) {
+    esl_ret_code_t res = esl_macro_delete(args[0].str);
+    if (res == ESL_ERR_NVMC_NOT_FOUND) {
+        esl_cli_msg_write("Macro not found", ESL_CLI_MSG_TYPE_ERROR);
+        return ESL_ERROR;
+    } else if (res == ESL_ERR_BUSY) {
+        esl_cli_msg_write(FLASH_BUSY_MSG, ESL_CLI_MSG_TYPE_ERROR);
+        return ESL_ERROR;
+    } else if (res != ESL_SUCCESS) {
+        esl_cli_msg_write("Couldn't delete macro", ESL_CLI_MSG_TYPE_ERROR);
         return ESL_ERROR;
     }
+    esl_cli_msg_write("Macro deleted", ESL_CLI_MSG_TYPE_SUCCESS);
+    return ESL_SUCCESS;
+}
 
-    char help_msg[1024] = "Available Commands:\n\r";
+static bool macro_list_next(esl_reply_t *r, uint32_t *cursor, uint32_t n) {
+    char name[ESL_MACRO_NAME_LEN];
+    char text[ESL_MACRO_TEXT_LEN];
+    if (*cursor > UINT8_MAX || !esl_macro_get(*cursor, name, sizeof(name), text, sizeof(text))) {
+        return false;
+    }
+    esl_reply_obj_begin(r, NULL);
+    esl_reply_u32(r, NULL, NULL, n + 1);
+    esl_reply_str(r, "name", ". ", name);
+    esl_reply_str(r, "text", ": ", text);
+    ESL_REPLY_TEXT(r, "\n\r");
+    esl_reply_obj_end(r);
+    (*cursor)++;
+    return true;
+}
+
+esl_ret_code_t esl_cli_cmd_macro_list(esl_cli_arg_t const *args, uint8_t arg_count) {
+    esl_reply_t *r = cli_reply_begin(ESL_CLI_MSG_TYPE_SUCCESS);
+    ESL_REPLY_TEXT(r, "Macros:\n\r");
+    cli_list_begin(r, "macros", macro_list_next, NULL);
+    return ESL_SUCCESS;
+}
 
-    for (size_t cmd_idx = 0; cmd_idx < COMMAND_TABLE_SIZE; cmd_idx++) {
-        strncat(help_msg, command_table[cmd_idx].command_description, sizeof(help_msg) - strlen(help_msg) - 1);
+esl_ret_code_t esl_cli_cmd_macro_erase(esl_cli_arg_t const *args, uint8_t arg_count) {
+    esl_ret_code_t res = esl_macro_erase_all();
+    if (res == ESL_ERR_BUSY) {
+        esl_cli_msg_write(FLASH_BUSY_MSG, ESL_CLI_MSG_TYPE_ERROR);
+        return ESL_ERROR;
+    } else if (res != ESL_SUCCESS) {
+        esl_cli_msg_write("Couldn't erase macros", ESL_CLI_MSG_TYPE_ERROR);
+        return ESL_ERROR;
     }
+    esl_cli_msg_write("Macros erased", ESL_CLI_MSG_TYPE_SUCCESS);
+    return ESL_SUCCESS;
+}
 
-    esl_usb_msg_write(help_msg, ESL_USB_MSG_TYPE_SUCCESS);
+// This reply already comes in the new format. Binary requests are dropped
+// while it is CBOR, see msg_process().
+esl_ret_code_t esl_cli_cmd_output(esl_cli_arg_t const *args, uint8_t arg_count) {
+    cli_reply_mode = args[0].num;
+    esl_cli_msg_write("Output format changed", ESL_CLI_MSG_TYPE_SUCCESS);
     return ESL_SUCCESS;
 }
 
-void esl_usb_msg_write(const char* msg, esl_usb_msg_type_t msg_type) {
-    char formatted_msg[1500]; // Buffer for the formatted message
+static bool help_next(esl_reply_t *r, uint32_t *cursor, uint32_t n) {
+    if (*cursor >= esl_cli_cmds_count) {
+        return false;
+    }
+    const char *desc = esl_cli_cmds[*cursor].description;
+    uint16_t len = strlen(desc);
+    // The line end is for the terminal only
+    while (len > 0 && (desc[len - 1] == '\n' || desc[len - 1] == '\r')) {
+        len--;
+    }
+    esl_reply_obj_begin(r, NULL);
+    esl_reply_tag(r, "name", esl_cli_cmds[*cursor].name);
+    esl_reply_strn(r, "usage", NULL, desc, len);
+    esl_reply_str(r, NULL, NULL, desc + len);
+    esl_reply_obj_end(r);
+    (*cursor)++;
+    return true;
+}
 
-    switch (msg_type) {
-    case ESL_USB_MSG_TYPE_INPUT:
-        snprintf(formatted_msg, sizeof(formatted_msg), ANSI_COLOR_GREEN ">>> " ANSI_COLOR_WHITE "%s" ANSI_COLOR_RESET "\n\r", msg);
-        break;
+esl_ret_code_t esl_cli_cmd_help(esl_cli_arg_t const *args, uint8_t arg_count) {
+    esl_reply_t *r = cli_reply_begin(ESL_CLI_MSG_TYPE_SUCCESS);
+    ESL_REPLY_TEXT(r, "Available Commands:\n\r");
+    cli_list_begin(r, "commands", help_next,
+                   "<cmd>; <cmd>...: run commands as one batch, one color update at the end\n\r");
+    return ESL_SUCCESS;
+}
 
-    case ESL_USB_MSG_TYPE_SUCCESS:
-        snprintf(formatted_msg, sizeof(formatted_msg), ANSI_COLOR_GREEN "[SUCCESS] " ANSI_COLOR_WHITE "%s" ANSI_COLOR_RESET "\n\r", msg);
-        break;
+esl_ret_code_t esl_cli_cmd_save(esl_cli_arg_t const *args, uint8_t arg_count) {
+    rgb_dirty = true;
+    rgb_commit();
+    esl_cli_msg_write("Current color saved", ESL_CLI_MSG_TYPE_SUCCESS);
+    return ESL_SUCCESS;
+}
 
-    case ESL_USB_MSG_TYPE_ERROR:
-        snprintf(formatted_msg, sizeof(formatted_msg), ANSI_COLOR_RED "[ERROR] " ANSI_COLOR_WHITE "%s" ANSI_COLOR_RESET "\n\r", msg);
-        break;
+esl_ret_code_t esl_cli_cmd_stats(esl_cli_arg_t const *args, uint8_t arg_count) {
 
-    case ESL_USB_MSG_TYPE_WARNING:
-        snprintf(formatted_msg, sizeof(formatted_msg), ANSI_COLOR_YELLOW "[WARNING] " ANSI_COLOR_WHITE "%s" ANSI_COLOR_RESET "\n\r", msg);
-        break;
+    esl_power_stats_t power_stats;
+    esl_power_stats_get(&power_stats);
+    uint64_t total_ticks = power_stats.sleep_ticks + power_stats.awake_ticks;
 
-    default:
-        snprintf(formatted_msg, sizeof(formatted_msg), ANSI_COLOR_RED "[UNKNOWN] " ANSI_COLOR_WHITE "%s" ANSI_COLOR_RESET "\n\r", msg);
-        break;
+    uint64_t ticks_avoided = led_ticks_avoided;
+    if (!led_timer_running) {
+        ticks_avoided += (esl_clock_ticks() - led_timer_stopped_at) / LED_TIMER_PERIOD;
     }
 
-    ret_code_t ret = app_usbd_cdc_acm_write(&esl_usb_cdc_acm, formatted_msg, strlen(formatted_msg));
-    esl_usb_tx_done = false;
-    if (ret == NRF_SUCCESS) {
-        while (!esl_usb_tx_done)
-        {
-            while (app_usbd_event_queue_process())
-            {
-                /* Wait until we're ready to send the data again */
-            }
+    esl_nvmc_stats_t nvmc_stats;
+    esl_nvmc_stats_get(&nvmc_stats);
+    esl_clip_stats_t clip_stats;
+    esl_clip_stats_get(&clip_stats);
+    esl_stream_stats_t stream_stats;
+    esl_stream_stats_get(&stream_stats);
+    esl_macro_stats_t macro_stats;
+    esl_macro_stats_get(&macro_stats);
+
+    uint32_t colors = esl_nvmc_color_count();
+    esl_reply_t *r = cli_reply_begin(ESL_CLI_MSG_TYPE_SUCCESS);
+
+    esl_reply_obj_begin(r, "power");
+    esl_reply_u32(r, "sleep_ms", "Power: sleep=", ESL_CLOCK_TICKS_TO_MS(power_stats.sleep_ticks));
+    esl_reply_u32(r, "sleep_pct", " ms (", total_ticks ? power_stats.sleep_ticks * 100 / total_ticks : 0);
+    esl_reply_u32(r, "wakeups", "%), wakeups=", power_stats.wakeups);
+    esl_reply_obj_end(r);
+    ESL_REPLY_TEXT(r, "\n\rLED timer: ");
+    esl_reply_obj_begin(r, "led_timer");
+    esl_reply_bool(r, "running", led_timer_running ? "running" : "stopped", led_timer_running);
+    esl_reply_u32(r, "ticks_avoided", ", ticks avoided=", ticks_avoided);
+    esl_reply_u32(r, "avoided_per_h", " (", total_ticks ? ticks_avoided * 3600 * ESL_CLOCK_FREQ / total_ticks : 0);
+    ESL_REPLY_TEXT(r, "/h)\n\r");
+    esl_reply_obj_end(r);
+
+    esl_reply_obj_begin(r, "last_color_log");
+    esl_reply_u32(r, "saves", "Last color log: saves=", nvmc_stats.last_rgb_saves);
+    esl_reply_u32(r, "erases", ", erases=", nvmc_stats.last_rgb_erases);
+    esl_reply_u32(r, "erases_per_10k", " (", nvmc_stats.last_rgb_saves ?
+                  (uint64_t)nvmc_stats.last_rgb_erases * 10000 / nvmc_stats.last_rgb_saves : 0);
+    esl_reply_u32(r, "next_record", " per 10k saves), next record=", nvmc_stats.last_rgb_idx);
+    esl_reply_obj_end(r);
+    esl_reply_obj_begin(r, "write_back");
+    esl_reply_u32(r, "changes", "\n\rColor write-back: changes=", rgb_changes);
+    esl_reply_u32(r, "writes_avoided", ", writes avoided=",
+                  rgb_changes > nvmc_stats.last_rgb_saves ? rgb_changes - nvmc_stats.last_rgb_saves : 0);
+    esl_reply_u32(r, "unchanged", " (unchanged=", nvmc_stats.last_rgb_unchanged);
+    esl_reply_bool(r, "pending", rgb_dirty ? "), pending\n\r" : ")\n\r", rgb_dirty);
+    esl_reply_obj_end(r);
+
+    esl_reply_obj_begin(r, "colors");
+    esl_reply_u32(r, "count", "Saved colors: ", colors);
+    esl_reply_u32(r, "flash_used", ", flash used=", nvmc_stats.colors_bytes_used);
+    esl_reply_u32(r, "flash_max", "/", nvmc_stats.colors_bytes_max);
+    esl_reply_u32(r, "bytes_each", " B (", colors ? nvmc_stats.colors_bytes_used / colors : 0);
+    esl_reply_u32(r, "decode_avg_cycles", " B each), decode avg=",
+                  nvmc_stats.colors_decodes ? nvmc_stats.colors_decode_cycles / nvmc_stats.colors_decodes : 0);
+    esl_reply_u32(r, "pending_reads", " cycles, reads of queued records=", nvmc_stats.colors_pending_reads);
+    esl_reply_u32(r, "compactions", "\n\rColor store: compactions=", nvmc_stats.colors_compactions);
+    esl_reply_u32(r, "torn", ", torn=", nvmc_stats.colors_torn);
+    esl_reply_u32(r, "rollbacks", ", rollbacks=", nvmc_stats.colors_rollbacks);
+    esl_reply_u32(r, "migrated", ", converted=", nvmc_stats.colors_migrated);
+    esl_reply_u32(r, "boot_scan_us", ", boot scan=", ESL_CYCLES_TO_US(nvmc_stats.colors_scan_cycles));
+    esl_reply_u32(r, "pages_scanned", " us (pages scanned=", nvmc_stats.colors_pages_scanned);
+    esl_reply_u32(r, "pages_summarized", ", summarized=", nvmc_stats.colors_pages_summarized);
+    esl_reply_obj_end(r);
+    esl_reply_obj_begin(r, "flash");
+    esl_reply_u32(r, "erases", ")\n\rFlash: erases=", nvmc_stats.page_erases);
+    esl_reply_u32(r, "write_failures", ", write failures=", nvmc_stats.write_failures);
+    esl_reply_u32(r, "queue_full", ", busy replies=", nvmc_stats.queue_full);
+    esl_reply_u32(r, "max_write_stall_us", ", max stall write=", ESL_CYCLES_TO_US(nvmc_stats.max_write_stall_cycles));
+    esl_reply_u32(r, "max_erase_stall_us", " us erase=", ESL_CYCLES_TO_US(nvmc_stats.max_erase_stall_cycles));
+    ESL_REPLY_TEXT(r, " us\n\r");
+    esl_reply_obj_end(r);
+
+    esl_reply_obj_begin(r, "clips");
+    esl_reply_u32(r, "count", "Clips: ", esl_clip_count());
+    esl_reply_bool(r, "playing", esl_clip_is_playing() ? ", playing" : ", stopped", esl_clip_is_playing());
+    esl_reply_u32(r, "chunks", ", chunks=", clip_stats.chunks);
+    esl_reply_u32(r, "underruns", ", underruns=", clip_stats.underruns);
+    esl_reply_u32(r, "max_refill_us", ", max refill=", ESL_CYCLES_TO_US(clip_stats.max_refill_cycles));
+    ESL_REPLY_TEXT(r, " us\n\rStream: ");
+    esl_reply_obj_end(r);
+    esl_reply_obj_begin(r, "stream");
+    esl_reply_bool(r, "active", esl_stream_is_active() ? "active" : "stopped", esl_stream_is_active());
+    esl_reply_u32(r, "frames", ", frames=", stream_stats.frames);
+    esl_reply_u32(r, "applied", ", applied=", stream_stats.applied);
+    esl_reply_u32(r, "underruns", ", underruns=", stream_stats.underruns);
+    esl_reply_u32(r, "overruns", ", overruns=", stream_stats.overruns);
+    esl_reply_u32(r, "early", ", early=", stream_stats.early);
+    esl_reply_u32(r, "out_of_order", ", out of order=", stream_stats.out_of_order);
+    esl_reply_u32(r, "max_depth", ", max depth=", stream_stats.max_depth);
+    esl_reply_u32(r, "buf_frames", "/", ESL_STREAM_BUF_FRAMES);
+    esl_reply_obj_end(r);
+
+    esl_reply_obj_begin(r, "port_rx");
+    esl_reply_u32(r, "commands", "\n\rPort RX: commands=", rx_commands);
+    esl_reply_u32(r, "packets", ", packets=", rx_packets);
+    esl_reply_u32(r, "bytes", ", bytes=", rx_bytes);
+    esl_reply_u32(r, "pauses", ", pauses=", rx_pauses);
+    esl_reply_u32(r, "tx_waits", ", waits for TX=", rx_tx_waits);
+    esl_reply_obj_end(r);
+    esl_reply_obj_begin(r, "cli_parse");
+    esl_reply_u32(r, "avg_cycles", "\n\rCLI parse: avg=", rx_commands ? cli_parse_cycles / rx_commands : 0);
+    esl_reply_u32(r, "max_cycles", " cycles, max=", cli_parse_max_cycles);
+    esl_reply_obj_end(r);
+    esl_reply_obj_begin(r, "cli_batches");
+    esl_reply_u32(r, "count", " cycles\n\rCLI batches: ", cli_batches);
+    esl_reply_u32(r, "commands", ", commands=", cli_batch_cmds);
+    esl_reply_u32(r, "rolled_back", ", rolled back=", cli_batch_rollbacks);
+    esl_reply_u32(r, "tx_full", ", output full=", cli_batch_tx_stops);
+    esl_reply_u32(r, "updates_saved", ", color updates saved=", cli_batch_updates_saved);
+    esl_reply_obj_end(r);
+    esl_reply_obj_begin(r, "macros");
+    esl_reply_u32(r, "count", "\n\rMacros: ", esl_macro_count());
+    esl_reply_u32(r, "runs", ", runs=", macro_runs);
+    esl_reply_u32(r, "torn", ", torn=", macro_stats.torn);
+    esl_reply_u32(r, "failed", ", failed writes=", macro_stats.failed);
+    esl_reply_u32(r, "flash_used", ", flash used=", macro_stats.bytes_used);
+    esl_reply_u32(r, "flash_free", " B, free=", macro_stats.bytes_free);
+    esl_reply_obj_end(r);
+    esl_reply_obj_begin(r, "port_tx");
+    esl_reply_u32(r, "queued", " B\n\rPort TX: queued=", esl_txq_used(&txq));
+    esl_reply_u32(r, "high_water", " B, high water=", txq.high_water);
+    esl_reply_u32(r, "size", "/", ESL_TX_RING_SIZE);
+    esl_reply_u32(r, "transfers", " B, transfers=", txq.transfers);
+    esl_reply_u32(r, "dropped_full", ", dropped full=", txq.dropped);
+    esl_reply_u32(r, "dropped_closed", " closed=", tx_closed_drops);
+    esl_reply_obj_end(r);
+    esl_reply_obj_begin(r, "replies");
+    esl_reply_u32(r, "count", "\n\rReplies: ", cli_replies);
+    esl_reply_u32(r, "avg_cycles", ", format avg=", cli_replies ? cli_reply_cycles / cli_replies : 0);
+    esl_reply_u32(r, "max_cycles", " cycles, max=", cli_reply_max_cycles);
+    esl_reply_u32(r, "stack_max", " cycles, stack max=", esl_stack_used_max());
+    esl_reply_u32(r, "stack_size", "/", esl_stack_size());
+    esl_reply_obj_end(r);
+    esl_reply_obj_begin(r, "listings");
+    esl_reply_u32(r, "count", " B\n\rListings: ", cli_lists);
+    esl_reply_u32(r, "entries", ", entries=", cli_list_entries);
+    esl_reply_u32(r, "tx_waits", ", waits for TX=", cli_list_waits);
+    esl_reply_u32(r, "dropped", ", replies dropped=", cli_list_drops);
+    esl_reply_obj_end(r);
+    esl_reply_obj_begin(r, "binary");
+    esl_reply_u32(r, "requests", "\n\rBinary protocol: requests=", msgs);
+    esl_reply_u32(r, "crc_errors", ", crc errors=", msg_crc_errors);
+    esl_reply_u32(r, "invalid", ", invalid=", msg_invalid);
+    esl_reply_u32(r, "cbor_dropped", ", dropped in CBOR mode=", msg_cbor_drops);
+    esl_reply_u32(r, "too_long", ", too long=", rx_lines.frames_dropped);
+    esl_reply_obj_end(r);
+    esl_reply_u32(r, "sched_dropped", "\n\rScheduler: dropped=", esl_sched_dropped_get());
+    ESL_REPLY_TEXT(r, "\n\r");
+
+    esl_sched_stats_t const *item;
+    static const char * const load_names[ESL_LOAD_COUNT] = { "idle", "tx", "flash", "tx+flash" };
+    esl_reply_list_begin(r, "led_jitter");
+    for (uint8_t load = 0; load < ESL_LOAD_COUNT; load++) {
+        esl_jitter_stats_t const *jitter = &led_jitter[load];
+        if (jitter->samples == 0) {
+            continue;
         }
+        esl_reply_obj_begin(r, NULL);
+        esl_reply_str(r, "load", "  LED tick jitter (", load_names[load]);
+        esl_reply_u32(r, "n", "): n=", jitter->samples);
+        esl_reply_u32(r, "avg_us", " avg=", ESL_CLOCK_TICKS_TO_US(jitter->sum_ticks / jitter->samples));
+        esl_reply_u32(r, "max_us", " us max=", ESL_CLOCK_TICKS_TO_US(jitter->max_ticks));
+        ESL_REPLY_TEXT(r, " us\n\r");
+        esl_reply_obj_end(r);
+    }
+    esl_reply_list_end(r);
+
+    esl_reply_list_begin(r, "work");
+    for (uint8_t idx = 0; (item = esl_sched_stats_get(idx)) != NULL; idx++) {
+        esl_reply_obj_begin(r, NULL);
+        esl_reply_hex32(r, "handler", "  work ", (uint32_t)(uintptr_t)item->handler);
+        esl_reply_u32(r, "runs", ": runs=", item->runs);
+        esl_reply_u32(r, "avg_cycles", " avg=", item->total_cycles / item->runs);
+        esl_reply_u32(r, "max_cycles", " max=", item->max_cycles);
+        ESL_REPLY_TEXT(r, " cycles\n\r");
+        esl_reply_obj_end(r);
+    }
+    esl_reply_list_end(r);
+
+    cli_reply_end();
+    return ESL_SUCCESS;
+}
+
+// Prefixes rendered at compile time, indexed by esl_cli_msg_type_t
+#define CLI_MSG_PREFIX(color, tag)  ESL_FMT_LIT(color tag ANSI_COLOR_WHITE)
+
+static const esl_fmt_lit_t cli_msg_prefixes[] = {
+    [ESL_CLI_MSG_TYPE_SUCCESS]  = CLI_MSG_PREFIX(ANSI_COLOR_GREEN, "[SUCCESS] "),
+    [ESL_CLI_MSG_TYPE_ERROR]    = CLI_MSG_PREFIX(ANSI_COLOR_RED, "[ERROR] "),
+    [ESL_CLI_MSG_TYPE_INPUT]    = CLI_MSG_PREFIX(ANSI_COLOR_GREEN, ">>> "),
+    [ESL_CLI_MSG_TYPE_WARNING]  = CLI_MSG_PREFIX(ANSI_COLOR_YELLOW, "[WARNING] "),
+};
+static const esl_fmt_lit_t cli_msg_prefix_unknown = CLI_MSG_PREFIX(ANSI_COLOR_RED, "[UNKNOWN] ");
+// The same, as the status of a machine mode reply
+static const char * const cli_msg_statuses[] = {
+    [ESL_CLI_MSG_TYPE_SUCCESS]  = "ok",
+    [ESL_CLI_MSG_TYPE_ERROR]    = "error",
+    [ESL_CLI_MSG_TYPE_INPUT]    = "input",
+    [ESL_CLI_MSG_TYPE_WARNING]  = "warning",
+};
+static uint32_t cli_reply_start;
+
+// Starts a message for the host, described with esl_reply_*() straight
+// into the output queue in the session's format, and sent by
+// cli_reply_end(). Output is dropped while the port is closed, or when the
+// queue has no room for the whole message.
+static esl_reply_t *cli_reply_begin(esl_cli_msg_type_t msg_type) {
+    bool known = msg_type < sizeof(cli_msg_prefixes) / sizeof(cli_msg_prefixes[0]);
+
+    cli_reply_start = esl_cycles_get();
+    esl_txq_msg_begin(&txq);
+
+    if (cli_batch_quiet && msg_type == ESL_CLI_MSG_TYPE_SUCCESS) {
+        esl_txq_msg_cancel(&txq);
+    } else if (cli_list.active && cli_reply_mode != ESL_REPLY_MODE_TEXT) {
+        // Would break up the listing's document, text can take it between lines
+        cli_list_drops++;
+        esl_txq_msg_cancel(&txq);
+    } else if (!port_open) {
+        tx_closed_drops++;
+        esl_txq_msg_cancel(&txq);
+    }
+    if (cli_reply_mode == ESL_REPLY_MODE_TEXT) {
+        esl_fmt_lit(&txq, known ? &cli_msg_prefixes[msg_type] : &cli_msg_prefix_unknown);
+    }
+
+    esl_reply_open(&cli_reply, &txq, cli_reply_mode);
+    esl_reply_tag(&cli_reply, "status", known ? cli_msg_statuses[msg_type] : "unknown");
+    if (cli_cmd_running != NULL) {
+        esl_reply_tag(&cli_reply, "cmd", cli_cmd_running);
+    }
+    return &cli_reply;
+}
+
+static void cli_reply_end(void) {
+    static const esl_fmt_lit_t suffix = ESL_FMT_LIT(ANSI_COLOR_RESET "\n\r");
+
+    if (cli_reply.mode == ESL_REPLY_MODE_TEXT) {
+        esl_fmt_lit(&txq, &suffix);
+    }
+    esl_reply_close(&cli_reply);
+    if (esl_txq_msg_end(&txq)) {
+        tx_kick();
+    }
+
+    uint32_t cycles = esl_cycles_get() - cli_reply_start;
+    cli_replies++;
+    cli_reply_cycles += cycles;
+    if (cycles > cli_reply_max_cycles) {
+        cli_reply_max_cycles = cycles;
+    }
+}
+
+// Queues a message for the host and returns right away
+void esl_cli_msg_write(const char* msg, esl_cli_msg_type_t msg_type) {
+    esl_reply_t *r = cli_reply_begin(msg_type);
+    esl_reply_str(r, "msg", NULL, msg);
+    cli_reply_end();
+}
+
+// Sends what r holds so far as the head of a listing under key, then the
+// entries next() writes, one message each as the output queue has room for
+// them, and the trailer and end of the reply after the last. Input waits
+// until the listing is done. Nothing is listed if the head was dropped.
+static void cli_list_begin(esl_reply_t *r, const char *key, cli_list_next_t next, const char *trailer) {
+    esl_reply_list_begin(r, key);
+    bool sent = esl_txq_msg_end(&txq);
+    if (!sent) {
+        return;
+    }
+    tx_kick();
+
+    cli_list.reply = *r;
+    cli_list.next = next;
+    cli_list.trailer = trailer;
+    cli_list.cursor = 0;
+    cli_list.n = 0;
+    cli_list.active = true;
+    cli_lists++;
+    cli_list_work(NULL, 0);
+}
+
+static void cli_list_end(void) {
+    esl_reply_t *r = &cli_list.reply;
+
+    esl_reply_list_end(r);
+    if (cli_list.trailer != NULL) {
+        esl_reply_str(r, NULL, NULL, cli_list.trailer);
+    }
+    // Finished like any other reply, timing only the last piece
+    cli_list.active = false;
+    cli_reply = *r;
+    cli_reply_start = esl_cycles_get();
+    cli_reply_end();
+    rx_tx_wait_end();
+}
+
+// Fills the output queue with entries, TX_DONE runs it again once there
+// is room for more
+static void cli_list_work(void *p_data, uint16_t data_size) {
+    cli_list.work_pending = false;
+    while (cli_list.active) {
+        if (esl_txq_free(&txq) < ESL_LIST_ENTRY_MAX) {
+            cli_list_waits++;
+            return;
+        }
+        esl_txq_msg_begin(&txq);
+        if (!cli_list.next(&cli_list.reply, &cli_list.cursor, cli_list.n)) {
+            cli_list_end();
+            return;
+        }
+        cli_list.n++;
+        cli_list_entries++;
+        if (esl_txq_msg_end(&txq)) {
+            tx_kick();
+        }
+    }
+}
+
+// Input held back for output picks up again once there is room
+static void rx_tx_wait_end(void) {
+    if (rx_tx_wait && !cli_list.active && esl_txq_free(&txq) >= ESL_TX_RESERVE) {
+        rx_tx_wait = false;
+        if (!rx_work_pending) {
+            rx_work_pending = esl_sched_post(ESL_SCHED_PRIO_NORMAL, rx_work, NULL, 0);
+        }
+    }
+}
+
+// R=.., G=.., B=..
+static void reply_rgb(esl_reply_t *r, uint8_t red, uint8_t green, uint8_t blue) {
+    esl_reply_u32(r, "r", "R=", red);
+    esl_reply_u32(r, "g", ", G=", green);
+    esl_reply_u32(r, "b", ", B=", blue);
+}
+
+// Sends the next run of queued output unless a transfer is in flight
+static void tx_kick(void) {
+    uint8_t const *data;
+    uint16_t size = esl_txq_next(&txq, &data);
+
+    if (size == 0) {
+        return;
+    }
+    if (transport->tx(data, size)) {
+        tx_busy = true;
+    } else {
+        // Port went away under us
+        esl_txq_clear(&txq);
     }
 }
\ No newline at end of file
@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+"""Measures CLI command throughput over the USB CDC port.
+
+Sends a batch of commands the way a script would, back to back without
+waiting, and counts replies until every command has answered. Run it
+against two firmware builds to compare them:
+
+    tools/cli_bench.py /dev/ttyACM0 --count 500
+    tools/cli_bench.py /dev/ttyACM0 --command "hsv 120 100 50" --lockstep
+
+or against the host build, started with host/_build/esl_host --link /tmp/esl_tty:
+
+    tools/cli_bench.py /tmp/esl_tty --count 20000
+
+Needs pyserial.
+"""
+
+import argparse
+import sys
+import threading
+import time
+
+import serial
+
+REPLY_MARKERS = (b"[SUCCESS] ", b"[ERROR] ", b"[WARNING] ")
+
+
+def count_replies(data):
+    return sum(data.count(marker) for marker in REPLY_MARKERS)
+
+
+def read_replies(port, expected, timeout):
+    data = b""
+    deadline = time.monotonic() + timeout
+    while count_replies(data) < expected:
+        if time.monotonic() > deadline:
+            break
+        data += port.read(port.in_waiting or 1)
+    return count_replies(data)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("port")
+    parser.add_argument("--count", type=int, default=200)
+    parser.add_argument("--command", default="rgb 10 20 30")
+    parser.add_argument("--lockstep", action="store_true",
+                        help="wait for each reply before sending the next command")
+    parser.add_argument("--timeout", type=float, default=30.0)
+    args = parser.parse_args()
+
+    line = (args.command + "\r\n").encode()
+    with serial.Serial(args.port, timeout=0.1) as port:
+        port.reset_input_buffer()
+
+        start = time.monotonic()
+        if args.lockstep:
+            replies = 0
+            for _ in range(args.count):
+                port.write(line)
+                replies += read_replies(port, 1, args.timeout)
+        else:
+            # Written from another thread, so the echo and replies are read
+            # while the batch is still going out and neither side stalls on
+            # a full buffer
+            writer = threading.Thread(target=port.write, args=(line * args.count,), daemon=True)
+            writer.start()
+            replies = read_replies(port, args.count, args.timeout)
+            writer.join(args.timeout)
+        elapsed = time.monotonic() - start
+
+    print("%d/%d replies in %.3f s: %.1f commands/s, %.2f ms per command"
+          % (replies, args.count, elapsed, replies / elapsed, elapsed * 1000 / max(replies, 1)))
+    return 0 if replies == args.count else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())